@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Heap cost of N sub-devices behind a gateway: N sessions on one CoAP engine
+ * against N clients of IOT_CoAP_Init(). Nothing is sent, the plain coap://
+ * URL only opens UDP sockets, so no server is needed.
+ *
+ *   ./coap_gateway-bench [-n sessions]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <malloc.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+
+#define BENCH_SERVER_URL        "coap://127.0.0.1:5683"
+#define BENCH_DEFAULT_SESSIONS  500
+
+static long bench_heap_used(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return (long)mallinfo2().uordblks;
+#else
+    return (long)mallinfo().uordblks;
+#endif
+}
+
+static void bench_devinfo(iotx_deviceinfo_t *p_devinfo, int index)
+{
+    memset(p_devinfo, 0x00, sizeof(iotx_deviceinfo_t));
+    strncpy(p_devinfo->product_key, "vtkkbrpmxmF", IOTX_PRODUCT_KEY_LEN);
+    snprintf(p_devinfo->device_name, sizeof(p_devinfo->device_name), "IoTxSensor%04d", index);
+    snprintf(p_devinfo->device_id, sizeof(p_devinfo->device_id), "IoTxSensor%04d.1", index);
+    strncpy(p_devinfo->device_secret, "Stk4IUErQUBc1tWRWEKWb5ACra4hFDYF", IOTX_DEVICE_SECRET_LEN);
+}
+
+int main(int argc, char **argv)
+{
+    int                         opt;
+    int                         i, count = BENCH_DEFAULT_SESSIONS, opened = 0;
+    long                        base, engine_cost, session_cost, client_cost;
+    unsigned int                start, session_ms, client_ms;
+    iotx_deviceinfo_t           devinfo;
+    iotx_coap_config_t          config;
+    iotx_coap_engine_config_t   engine_config;
+    iotx_coap_engine_context_t *p_engine = NULL;
+    iotx_coap_context_t       **contexts = NULL;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            default:
+                HAL_Printf("usage: %s [-n sessions]\r\n", argv[0]);
+                return 0;
+        }
+    }
+    if (count <= 0) {
+        return -1;
+    }
+
+    contexts = malloc(count * sizeof(iotx_coap_context_t *));
+    if (NULL == contexts) {
+        return -1;
+    }
+    IOT_OpenLog("coap_gateway");
+    IOT_SetLogLevel(IOT_LOG_ERROR);
+
+    /* gateway: one engine, count sessions */
+    memset(&engine_config, 0x00, sizeof(engine_config));
+    engine_config.p_url = BENCH_SERVER_URL;
+
+    base = bench_heap_used();
+    p_engine = IOT_CoAP_EngineInit(&engine_config);
+    if (NULL == p_engine) {
+        HAL_Printf("Create engine failed\r\n");
+        free(contexts);
+        return -1;
+    }
+    engine_cost = bench_heap_used() - base;
+
+    base = bench_heap_used();
+    start = HAL_UptimeMs();
+    for (i = 0; i < count; i++) {
+        bench_devinfo(&devinfo, i);
+        contexts[i] = IOT_CoAP_SessionOpen(p_engine, &devinfo, NULL);
+        if (NULL == contexts[i]) {
+            HAL_Printf("Open session %d failed\r\n", i);
+            break;
+        }
+    }
+    opened = i;
+    session_ms = HAL_UptimeMs() - start;
+    session_cost = bench_heap_used() - base;
+    IOT_CoAP_EngineDeinit(&p_engine);
+
+    HAL_Printf("engine         : 1 socket, %ld bytes\r\n", engine_cost);
+    HAL_Printf("sessions       : %d opened in %u ms, %ld bytes, %ld bytes/session\r\n",
+               opened, session_ms, session_cost, 0 == opened ? 0 : session_cost / opened);
+
+    /* one client per device, each with its own socket and buffers */
+    memset(&config, 0x00, sizeof(config));
+    config.p_url = BENCH_SERVER_URL;
+    config.p_devinfo = &devinfo;
+
+    base = bench_heap_used();
+    start = HAL_UptimeMs();
+    for (i = 0; i < count; i++) {
+        bench_devinfo(&devinfo, i);
+        contexts[i] = IOT_CoAP_Init(&config);
+        if (NULL == contexts[i]) {
+            HAL_Printf("Create client %d failed, out of sockets?\r\n", i);
+            break;
+        }
+    }
+    opened = i;
+    client_ms = HAL_UptimeMs() - start;
+    client_cost = bench_heap_used() - base;
+    for (i = 0; i < opened; i++) {
+        IOT_CoAP_Deinit(&contexts[i]);
+    }
+
+    HAL_Printf("clients        : %d sockets, %d created in %u ms, %ld bytes, %ld bytes/client\r\n",
+               opened, opened, client_ms, client_cost, 0 == opened ? 0 : client_cost / opened);
+
+    free(contexts);
+    IOT_CloseLog();
+    return 0;
+}
@@ -152,6 +152,25 @@ int demo_device_shadow(char *msg_buf, char *msg_readbuf)
         HAL_SleepMs(1000);
     } while (0);
 
+    do {
+        int i;
+        iotx_shadow_report_stats_t stats;
+
+        /* Or let IOT_Shadow_Yield() report the changed attributes only,
+         * the changes made within 500ms go in one update */
+        IOT_Shadow_SetReportWindow(h_shadow, 500);
+        for (i = 0; i < 5; i++) {
+            temperature += 1;
+            IOT_Shadow_MarkDirty(h_shadow, &attr_temperature);
+            IOT_Shadow_Yield(h_shadow, 200);
+        }
+        IOT_Shadow_Yield(h_shadow, 1000);
+
+        IOT_Shadow_GetReportStats(h_shadow, &stats);
+        SHADOW_TRACE("reports: %u, attributes: %u, bytes: %u, saved: %u",
+                     stats.reports, stats.attrs_sent, stats.bytes_sent, stats.bytes_saved);
+    } while (0);
+
 
     /* Delete the two attributes */
     IOT_Shadow_DeleteAttribute(h_shadow, &attr_temperature);
@@ -38,6 +38,9 @@ TARGET              += coap-example
 SRCS_coap-example   := coap/coap-example.c
 SRCS                += coap/coap-example.c
 
+TARGET                    += coap_gateway-bench
+SRCS_coap_gateway-bench   := coap/coap_gateway-bench.c
+
     ifneq (,$(filter -DOTA_ENABLED,$(CFLAGS)))
     ifneq (,$(filter -DOTA_SIGNAL_CHANNEL=2,$(CFLAGS)))
     TARGET                += ota_coap-example
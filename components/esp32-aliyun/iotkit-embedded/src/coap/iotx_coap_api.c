@@ -26,12 +26,15 @@
 #include "utils_hmac.h"
 #include "CoAPMessage.h"
 #include "CoAPExport.h"
+#include "CoAPObserve.h"
 
 #define IOTX_SIGN_LENGTH         (40+1)
 #define IOTX_SIGN_SOURCE_LEN     (256)
 #define IOTX_AUTH_TOKEN_LEN      (192+1)
 #define IOTX_COAP_INIT_TOKEN     (0x01020304)
 #define IOTX_LIST_MAX_ITEM       (10)
+#define IOTX_ENGINE_MAX_ITEM     (255)
+#define IOTX_AUTH_WAIT_MS        (10000)
 
 
 #define IOTX_AUTH_STR      "auth"
@@ -41,16 +44,30 @@
 #define IOTX_COAP_ONLINE_DTLS_SERVER_URL "coaps://%s.iot-as-coap.cn-shanghai.aliyuncs.com:5684"
 
 
+typedef struct {
+    CoAPContext         *p_coap_ctx;
+    unsigned short       session_id;    /* last session id handed out */
+    struct list_head     session_list;
+} iotx_coap_engine_t;
+
 typedef struct {
     char                *p_auth_token;
     int                  auth_token_len;
     char                 is_authed;
+    char                 auth_pending;  /* authentication sent, no response yet */
     iotx_deviceinfo_t   *p_devinfo;
     CoAPContext          *p_coap_ctx;
     unsigned int         coap_token;
     iotx_event_handle_t  event_handle;
+    iotx_coap_engine_t  *p_engine;
+    char                 owns_engine;   /* created by IOT_CoAP_Init() */
+    unsigned short       session_id;    /* appended to the tokens of gateway sessions, 0 for none */
+    struct list_head     session_list;
 } iotx_coap_t;
 
+/* a session and the device info and auth token it points to are one allocation */
+#define IOTX_SESSION_SIZE   (sizeof(iotx_coap_t) + sizeof(iotx_deviceinfo_t) + IOTX_AUTH_TOKEN_LEN)
+
 
 int iotx_calc_sign(const char *p_device_secret, const char *p_client_id,
                    const char *p_device_name, const char *p_product_key, char sign[IOTX_SIGN_LENGTH])
@@ -118,6 +135,7 @@ static void iotx_device_name_auth_callback(void *user, void *p_message)
     COAP_DEBUG("* Response Code : 0x%x", message->header.code);
     COAP_DEBUG("* Payload: %s", message->payload);
 
+    p_iotx_coap->auth_pending = 0;
     switch (message->header.code) {
         case COAP_MSG_CODE_205_CONTENT: {
             ret_code = iotx_get_token_from_json((char *)message->payload, p_iotx_coap->p_auth_token, p_iotx_coap->auth_token_len);
@@ -139,15 +157,28 @@ static void iotx_device_name_auth_callback(void *user, void *p_message)
 
 }
 
-static unsigned int iotx_get_coap_token(iotx_coap_t       *p_iotx_coap, unsigned char *p_encoded_data)
+static unsigned int iotx_encode_coap_token(iotx_coap_t *p_iotx_coap, unsigned int value,
+                                           unsigned char *p_encoded_data)
 {
-    unsigned int value = p_iotx_coap->coap_token;
     p_encoded_data[0] = (unsigned char)((value & 0x00FF) >> 0);
     p_encoded_data[1] = (unsigned char)((value & 0xFF00) >> 8);
     p_encoded_data[2] = (unsigned char)((value & 0xFF0000) >> 16);
     p_encoded_data[3] = (unsigned char)((value & 0xFF000000) >> 24);
+    if (0 == p_iotx_coap->session_id) {
+        return sizeof(unsigned int);
+    }
+
+    /* sessions of one engine share the pending list, the id keeps their tokens apart */
+    p_encoded_data[4] = (unsigned char)((p_iotx_coap->session_id & 0x00FF) >> 0);
+    p_encoded_data[5] = (unsigned char)((p_iotx_coap->session_id & 0xFF00) >> 8);
+    return sizeof(unsigned int) + sizeof(unsigned short);
+}
+
+static unsigned int iotx_get_coap_token(iotx_coap_t       *p_iotx_coap, unsigned char *p_encoded_data)
+{
+    unsigned int value = p_iotx_coap->coap_token;
     p_iotx_coap->coap_token++;
-    return sizeof(unsigned int);
+    return iotx_encode_coap_token(p_iotx_coap, value, p_encoded_data);
 }
 
 void iotx_event_notifyer(unsigned int code, CoAPMessage *message)
@@ -223,6 +254,8 @@ int IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context)
 {
     int len = 0;
     int ret = COAP_SUCCESS;
+    unsigned int      start = 0;
+    unsigned int      elapsed = 0;
     CoAPContext      *p_coap_ctx = NULL;
     iotx_coap_t      *p_iotx_coap = NULL;
     CoAPMessage       message;
@@ -268,17 +301,27 @@ int IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context)
     CoAPMessagePayload_set(&message, p_payload, strlen((char *)p_payload));
     COAP_DEBUG("The payload is: %p", message.payload);
     COAP_DEBUG("Send authentication message to server");
+    p_iotx_coap->auth_pending = 1;
     ret = CoAPMessage_send(p_coap_ctx, &message);
     coap_free(p_payload);
     CoAPMessage_destory(&message);
 
     if (COAP_SUCCESS != ret) {
         COAP_DEBUG("Send authentication message to server failed ret = %d", ret);
+        p_iotx_coap->auth_pending = 0;
         return IOTX_ERR_SEND_MSG_FAILED;
     }
 
-    ret = CoAPMessage_recv(p_coap_ctx, 10000, 2);
-    if (0 < ret && !p_iotx_coap->is_authed) {
+    /* other sessions of the engine may be answered first, wait for our own response */
+    start = HAL_UptimeMs();
+    while (p_iotx_coap->auth_pending) {
+        elapsed = HAL_UptimeMs() - start;
+        if (IOTX_AUTH_WAIT_MS <= elapsed
+            || 0 == CoAPMessage_recv(p_coap_ctx, IOTX_AUTH_WAIT_MS - elapsed, 1)) {
+            break;
+        }
+    }
+    if (!p_iotx_coap->is_authed) {
         COAP_INFO("CoAP authenticate failed");
         return IOTX_ERR_AUTH_FAILED;
     }
@@ -385,6 +428,8 @@ int IOT_CoAP_SendMessage(iotx_coap_context_t *p_context, char *p_path, iotx_mess
         CoAPMessage_destory(&message);
         if (COAP_ERROR_DATA_SIZE == ret) {
             return IOTX_ERR_MSG_TOO_LOOG;
+        } else if (COAP_SUCCESS != ret) {
+            return IOTX_ERR_SEND_MSG_FAILED;
         }
         return IOTX_SUCCESS;
     } else {
@@ -393,6 +438,154 @@ int IOT_CoAP_SendMessage(iotx_coap_context_t *p_context, char *p_path, iotx_mess
     }
 }
 
+int IOT_CoAP_Observe(iotx_coap_context_t *p_context, char *p_path, iotx_message_t *p_message,
+                     unsigned int *p_observe_id)
+{
+    int len = 0;
+    int ret = IOTX_SUCCESS;
+    CoAPContext      *p_coap_ctx = NULL;
+    iotx_coap_t      *p_iotx_coap = NULL;
+    CoAPMessage      message;
+    unsigned char    token[8] = {0};
+
+    p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_context || NULL == p_path || NULL == p_message || NULL == p_observe_id ||
+        NULL == p_message->resp_callback || (NULL != p_iotx_coap && NULL == p_iotx_coap->p_coap_ctx)) {
+        COAP_ERR("Invalid paramter p_context %p, p_uri %p, p_message %p",
+                 p_context, p_path, p_message);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    if (!p_iotx_coap->is_authed) {
+        return IOTX_ERR_NOT_AUTHED;
+    }
+
+    p_coap_ctx = (CoAPContext *)p_iotx_coap->p_coap_ctx;
+    *p_observe_id = p_iotx_coap->coap_token;
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_CON);
+    CoAPMessageCode_set(&message, COAP_MSG_CODE_GET);
+    CoAPMessageId_set(&message, CoAPMessageId_gen(p_coap_ctx));
+    len = iotx_get_coap_token(p_iotx_coap, token);
+    CoAPMessageToken_set(&message, token, len);
+    CoAPMessageUserData_set(&message, (void *)p_iotx_coap);
+    CoAPMessageHandler_set(&message, p_message->resp_callback);
+
+    /* options go in ascending number order, Observe(6) comes before Uri-Path(11) */
+    CoAPUintOption_add(&message, COAP_OPTION_OBSERVE, COAP_OBSERVE_REGISTER);
+    ret = iotx_split_path_2_option(p_path, &message);
+    if (IOTX_SUCCESS != ret) {
+        CoAPMessage_destory(&message);
+        return ret;
+    }
+
+    if (IOTX_CONTENT_TYPE_CBOR == p_message->content_type) {
+        CoAPUintOption_add(&message, COAP_OPTION_ACCEPT, COAP_CT_APP_CBOR);
+    } else {
+        CoAPUintOption_add(&message, COAP_OPTION_ACCEPT, COAP_CT_APP_JSON);
+    }
+    CoAPStrOption_add(&message,  COAP_OPTION_AUTH_TOKEN,
+                      (unsigned char *)p_iotx_coap->p_auth_token, strlen(p_iotx_coap->p_auth_token));
+
+    ret = CoAPObserve_register(p_coap_ctx, &message);
+    CoAPMessage_destory(&message);
+    if (COAP_ERROR_DATA_SIZE == ret) {
+        return IOTX_ERR_MSG_TOO_LOOG;
+    } else if (COAP_SUCCESS != ret) {
+        return IOTX_ERR_SEND_MSG_FAILED;
+    }
+
+    return IOTX_SUCCESS;
+}
+
+int IOT_CoAP_ObserveCancel(iotx_coap_context_t *p_context, unsigned int observe_id)
+{
+    iotx_coap_t      *p_iotx_coap = NULL;
+    unsigned char    token[8] = {0};
+    int              len = 0;
+
+    p_iotx_coap = (iotx_coap_t *)p_context;
+    if (NULL == p_iotx_coap || NULL == p_iotx_coap->p_coap_ctx) {
+        COAP_ERR("Invalid paramter");
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    len = iotx_encode_coap_token(p_iotx_coap, observe_id, token);
+    if (COAP_SUCCESS != CoAPObserve_cancel(p_iotx_coap->p_coap_ctx, token, len)) {
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    return IOTX_SUCCESS;
+}
+
+int IOT_CoAP_GetDTLSStats(iotx_coap_context_t *p_context, iotx_coap_dtls_stats_t *p_stats)
+{
+    iotx_coap_t *p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_iotx_coap || NULL == p_iotx_coap->p_coap_ctx || NULL == p_stats) {
+        COAP_ERR("Invalid paramter p_context %p, p_stats %p", p_context, p_stats);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+#ifdef COAP_DTLS_SUPPORT
+    if (COAP_ENDPOINT_DTLS == p_iotx_coap->p_coap_ctx->network.ep_type) {
+        coap_dtls_stats_t *p_dtls_stats = &p_iotx_coap->p_coap_ctx->network.dtls_stats;
+
+        memset(p_stats, 0x00, sizeof(iotx_coap_dtls_stats_t));
+        p_stats->handshakes   = p_dtls_stats->handshakes;
+        p_stats->resumed      = p_dtls_stats->resumed;
+        p_stats->bytes_sent   = p_dtls_stats->bytes_sent;
+        p_stats->bytes_recv   = p_dtls_stats->bytes_recv;
+        p_stats->round_trips  = p_dtls_stats->round_trips;
+        p_stats->last_time_ms = p_dtls_stats->last.time_ms;
+        p_stats->cid          = p_dtls_stats->last.cid;
+        return IOTX_SUCCESS;
+    }
+#endif
+
+    return IOTX_ERR_INVALID_PARAM;
+}
+
+int IOT_CoAP_SaveDTLSSession(unsigned char *p_buf, int *p_len)
+{
+#ifdef COAP_DTLS_SUPPORT
+    unsigned int ret = COAP_SUCCESS;
+    unsigned int len = 0;
+
+    if (NULL == p_buf || NULL == p_len || 0 >= *p_len) {
+        COAP_ERR("Invalid paramter p_buf %p, p_len %p", p_buf, p_len);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    len = (unsigned int)*p_len;
+    ret = CoAPNetworkDTLS_saveSession(p_buf, &len);
+    if (COAP_ERROR_DATA_SIZE == ret) {
+        return IOTX_ERR_BUFF_TOO_SHORT;
+    } else if (COAP_SUCCESS != ret) {
+        return IOTX_ERR_INVALID_PARAM;
+    }
+    *p_len = (int)len;
+    return IOTX_SUCCESS;
+#else
+    return IOTX_ERR_INVALID_PARAM;
+#endif
+}
+
+int IOT_CoAP_LoadDTLSSession(unsigned char *p_buf, int len)
+{
+#ifdef COAP_DTLS_SUPPORT
+    if (NULL == p_buf || 0 >= len
+        || COAP_SUCCESS != CoAPNetworkDTLS_loadSession(p_buf, (unsigned int)len)) {
+        COAP_ERR("Invalid paramter p_buf %p, len %d", p_buf, len);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+    return IOTX_SUCCESS;
+#else
+    return IOTX_ERR_INVALID_PARAM;
+#endif
+}
 
 int IOT_CoAP_GetMessagePayload(void *p_message, unsigned char **pp_payload, int *p_len)
 {
@@ -426,130 +619,226 @@ int  IOT_CoAP_GetMessageCode(void *p_message, iotx_coap_resp_code_t *p_resp_code
 }
 
 
-iotx_coap_context_t *IOT_CoAP_Init(iotx_coap_config_t *p_config)
+static iotx_coap_engine_t *iotx_coap_engine_new(char *p_url, char *p_product_key,
+        int wait_time_ms, unsigned char maxcount)
 {
     CoAPInitParam param;
     char url[128] = {0};
-    iotx_coap_t *p_iotx_coap = NULL;
+    iotx_coap_engine_t *p_iotx_engine = NULL;
 
-    if (NULL == p_config) {
-        COAP_ERR("Invalid paramter p_config %p", p_config);
+    p_iotx_engine = coap_malloc(sizeof(iotx_coap_engine_t));
+    if (NULL == p_iotx_engine) {
+        COAP_ERR(" Allocate memory for iotx_coap_engine_t failed");
         return NULL;
     }
-    if (NULL == p_config->p_devinfo) {
-        COAP_ERR("Invalid paramter p_devinfo %p", p_config->p_devinfo);
+    memset(p_iotx_engine, 0x00, sizeof(iotx_coap_engine_t));
+    INIT_LIST_HEAD(&p_iotx_engine->session_list);
+
+    /*Create coap context*/
+    memset(&param, 0x00, sizeof(CoAPInitParam));
+
+    if (NULL != p_url) {
+        param.url = p_url;
+    } else {
+        HAL_Snprintf(url, sizeof(url), IOTX_COAP_ONLINE_DTLS_SERVER_URL, p_product_key);
+        param.url = url;
+        COAP_INFO("Using default CoAP server: %s", url);
+    }
+    param.maxcount = maxcount;
+    param.notifier = (CoAPEventNotifier)iotx_event_notifyer;
+    param.waittime = wait_time_ms;
+    p_iotx_engine->p_coap_ctx = CoAPContext_create(&param);
+    if (NULL == p_iotx_engine->p_coap_ctx) {
+        COAP_ERR(" Create coap context failed");
+        coap_free(p_iotx_engine);
         return NULL;
     }
 
-    p_iotx_coap = coap_malloc(sizeof(iotx_coap_t));
+    return p_iotx_engine;
+}
+
+static int iotx_coap_engine_session_id(iotx_coap_engine_t *p_iotx_engine)
+{
+    int          count = 0;
+    iotx_coap_t *p_iotx_coap = NULL;
+    char         used = 0;
+
+    for (count = 0; count < 0xFFFF; count++) {
+        p_iotx_engine->session_id++;
+        if (0 == p_iotx_engine->session_id) {
+            continue;
+        }
+
+        used = 0;
+        list_for_each_entry(p_iotx_coap, &p_iotx_engine->session_list, session_list) {
+            if (p_iotx_coap->session_id == p_iotx_engine->session_id) {
+                used = 1;
+                break;
+            }
+        }
+        if (!used) {
+            return p_iotx_engine->session_id;
+        }
+    }
+
+    return 0;
+}
+
+static iotx_coap_t *iotx_coap_session_new(iotx_coap_engine_t *p_iotx_engine,
+        iotx_deviceinfo_t *p_devinfo, unsigned short session_id)
+{
+    iotx_coap_t *p_iotx_coap = NULL;
+
+    p_iotx_coap = coap_malloc(IOTX_SESSION_SIZE);
     if (NULL == p_iotx_coap) {
         COAP_ERR(" Allocate memory for iotx_coap_context_t failed");
         return NULL;
     }
-    memset(p_iotx_coap, 0x00, sizeof(iotx_coap_t));
-
-    p_iotx_coap->p_auth_token = coap_malloc(IOTX_AUTH_TOKEN_LEN);
-    if (NULL == p_iotx_coap->p_auth_token) {
-        COAP_ERR(" Allocate memory for auth token failed");
-        goto err;
-    }
-    memset(p_iotx_coap->p_auth_token, 0x00, IOTX_AUTH_TOKEN_LEN);
+    memset(p_iotx_coap, 0x00, IOTX_SESSION_SIZE);
+    p_iotx_coap->p_devinfo = (iotx_deviceinfo_t *)(p_iotx_coap + 1);
+    p_iotx_coap->p_auth_token = (char *)(p_iotx_coap->p_devinfo + 1);
 
     /*Set the client isn't authed*/
     p_iotx_coap->is_authed = false;
     p_iotx_coap->auth_token_len = IOTX_AUTH_TOKEN_LEN;
 
-    /*Get deivce information*/
-    p_iotx_coap->p_devinfo = coap_malloc(sizeof(iotx_deviceinfo_t));
-    if (NULL == p_iotx_coap->p_devinfo) {
-        COAP_ERR(" Allocate memory for iotx_deviceinfo_t failed");
-        goto err;
-    }
-    memset(p_iotx_coap->p_devinfo, 0x00, sizeof(iotx_deviceinfo_t));
-
     /*It should be implement by the user*/
-    if (NULL != p_config->p_devinfo) {
-        memset(p_iotx_coap->p_devinfo, 0x00, sizeof(iotx_deviceinfo_t));
-        strncpy(p_iotx_coap->p_devinfo->device_id,    p_config->p_devinfo->device_id,   IOTX_DEVICE_ID_LEN);
-        strncpy(p_iotx_coap->p_devinfo->product_key,  p_config->p_devinfo->product_key, IOTX_PRODUCT_KEY_LEN);
-        strncpy(p_iotx_coap->p_devinfo->device_secret, p_config->p_devinfo->device_secret, IOTX_DEVICE_SECRET_LEN);
-        strncpy(p_iotx_coap->p_devinfo->device_name,  p_config->p_devinfo->device_name, IOTX_DEVICE_NAME_LEN);
-    }
+    strncpy(p_iotx_coap->p_devinfo->device_id,    p_devinfo->device_id,   IOTX_DEVICE_ID_LEN);
+    strncpy(p_iotx_coap->p_devinfo->product_key,  p_devinfo->product_key, IOTX_PRODUCT_KEY_LEN);
+    strncpy(p_iotx_coap->p_devinfo->device_secret, p_devinfo->device_secret, IOTX_DEVICE_SECRET_LEN);
+    strncpy(p_iotx_coap->p_devinfo->device_name,  p_devinfo->device_name, IOTX_DEVICE_NAME_LEN);
 
     /*Init coap token*/
     p_iotx_coap->coap_token = IOTX_COAP_INIT_TOKEN;
+    p_iotx_coap->session_id = session_id;
 
-    /*Create coap context*/
-    memset(&param, 0x00, sizeof(CoAPInitParam));
+    p_iotx_coap->p_engine = p_iotx_engine;
+    p_iotx_coap->p_coap_ctx = p_iotx_engine->p_coap_ctx;
+    list_add_tail(&p_iotx_coap->session_list, &p_iotx_engine->session_list);
 
-    if (NULL !=  p_config->p_url) {
-        param.url = p_config->p_url;
-    } else {
-        HAL_Snprintf(url, sizeof(url), IOTX_COAP_ONLINE_DTLS_SERVER_URL, p_iotx_coap->p_devinfo->product_key);
-        param.url = url;
-        COAP_INFO("Using default CoAP server: %s", url);
+    return p_iotx_coap;
+}
+
+static void iotx_coap_session_free(iotx_coap_t *p_iotx_coap)
+{
+    /* nothing may call back into the session once it is gone */
+    CoAPMessage_purge(p_iotx_coap->p_coap_ctx, p_iotx_coap);
+    list_del_init(&p_iotx_coap->session_list);
+
+    p_iotx_coap->is_authed = false;
+    p_iotx_coap->auth_token_len = 0;
+    p_iotx_coap->p_coap_ctx = NULL;
+    coap_free(p_iotx_coap);
+}
+
+iotx_coap_context_t *IOT_CoAP_Init(iotx_coap_config_t *p_config)
+{
+    iotx_coap_t *p_iotx_coap = NULL;
+    iotx_coap_engine_t *p_iotx_engine = NULL;
+
+    if (NULL == p_config) {
+        COAP_ERR("Invalid paramter p_config %p", p_config);
+        return NULL;
     }
-    param.maxcount = IOTX_LIST_MAX_ITEM;
-    param.notifier = (CoAPEventNotifier)iotx_event_notifyer;
-    param.waittime = p_config->wait_time_ms;
-    p_iotx_coap->p_coap_ctx = CoAPContext_create(&param);
-    if (NULL == p_iotx_coap->p_coap_ctx) {
-        COAP_ERR(" Create coap context failed");
-        goto err;
+    if (NULL == p_config->p_devinfo) {
+        COAP_ERR("Invalid paramter p_devinfo %p", p_config->p_devinfo);
+        return NULL;
     }
 
+    p_iotx_engine = iotx_coap_engine_new(p_config->p_url, p_config->p_devinfo->product_key,
+                                         p_config->wait_time_ms, IOTX_LIST_MAX_ITEM);
+    if (NULL == p_iotx_engine) {
+        return NULL;
+    }
+
+    /* a single client keeps the 4 bytes tokens, session id 0 */
+    p_iotx_coap = iotx_coap_session_new(p_iotx_engine, p_config->p_devinfo, 0);
+    if (NULL == p_iotx_coap) {
+        IOT_CoAP_EngineDeinit((iotx_coap_engine_context_t **)&p_iotx_engine);
+        return NULL;
+    }
+    p_iotx_coap->owns_engine = 1;
 
     /*Register the event handle to notify the application */
     p_iotx_coap->event_handle = p_config->event_handle;
 
     return (iotx_coap_context_t *)p_iotx_coap;
-err:
-    /* Error, release the memory */
-    if (NULL != p_iotx_coap) {
-        if (NULL != p_iotx_coap->p_devinfo) {
-            coap_free(p_iotx_coap->p_devinfo);
-        }
-        if (NULL != p_iotx_coap->p_auth_token) {
-            coap_free(p_iotx_coap->p_auth_token);
-        }
-        if (NULL != p_iotx_coap->p_coap_ctx) {
-            CoAPContext_free(p_iotx_coap->p_coap_ctx);
-        }
-
-        p_iotx_coap->auth_token_len = 0;
-        p_iotx_coap->is_authed = false;
-        coap_free(p_iotx_coap);
-    }
-    return NULL;
 }
 
 void IOT_CoAP_Deinit(iotx_coap_context_t **pp_context)
 {
     iotx_coap_t *p_iotx_coap = NULL;
+    iotx_coap_engine_t *p_iotx_engine = NULL;
 
     if (NULL != pp_context && NULL != *pp_context) {
         p_iotx_coap = (iotx_coap_t *)*pp_context;
-        p_iotx_coap->is_authed = false;
-        p_iotx_coap->auth_token_len = 0;
-        p_iotx_coap->coap_token = IOTX_COAP_INIT_TOKEN;
+        p_iotx_engine = p_iotx_coap->owns_engine ? p_iotx_coap->p_engine : NULL;
 
-        if (NULL != p_iotx_coap->p_auth_token) {
-            coap_free(p_iotx_coap->p_auth_token);
-            p_iotx_coap->p_auth_token = NULL;
+        iotx_coap_session_free(p_iotx_coap);
+        if (NULL != p_iotx_engine) {
+            IOT_CoAP_EngineDeinit((iotx_coap_engine_context_t **)&p_iotx_engine);
         }
+        *pp_context = NULL;
+    }
+}
 
-        if (NULL != p_iotx_coap->p_devinfo) {
-            coap_free(p_iotx_coap->p_devinfo);
-            p_iotx_coap->p_devinfo = NULL;
-        }
+iotx_coap_engine_context_t *IOT_CoAP_EngineInit(iotx_coap_engine_config_t *p_config)
+{
+    if (NULL == p_config || (NULL == p_config->p_url && NULL == p_config->p_product_key)) {
+        COAP_ERR("Invalid paramter p_config %p", p_config);
+        return NULL;
+    }
+
+    return (iotx_coap_engine_context_t *)iotx_coap_engine_new(p_config->p_url, p_config->p_product_key,
+            p_config->wait_time_ms,
+            0 == p_config->max_pending ? IOTX_ENGINE_MAX_ITEM : p_config->max_pending);
+}
+
+void IOT_CoAP_EngineDeinit(iotx_coap_engine_context_t **pp_engine)
+{
+    iotx_coap_t *p_iotx_coap = NULL, *next = NULL;
+    iotx_coap_engine_t *p_iotx_engine = NULL;
 
-        if (NULL != p_iotx_coap->p_coap_ctx) {
-            CoAPContext_free(p_iotx_coap->p_coap_ctx);
-            p_iotx_coap->p_coap_ctx = NULL;
+    if (NULL != pp_engine && NULL != *pp_engine) {
+        p_iotx_engine = (iotx_coap_engine_t *)*pp_engine;
+
+        list_for_each_entry_safe(p_iotx_coap, next, &p_iotx_engine->session_list, session_list) {
+            iotx_coap_session_free(p_iotx_coap);
         }
-        coap_free(p_iotx_coap);
-        *pp_context = NULL;
+        if (NULL != p_iotx_engine->p_coap_ctx) {
+            CoAPContext_free(p_iotx_engine->p_coap_ctx);
+            p_iotx_engine->p_coap_ctx = NULL;
+        }
+        coap_free(p_iotx_engine);
+        *pp_engine = NULL;
+    }
+}
+
+iotx_coap_context_t *IOT_CoAP_SessionOpen(iotx_coap_engine_context_t *p_engine,
+        iotx_deviceinfo_t *p_devinfo, iotx_event_handle_t event_handle)
+{
+    int          session_id = 0;
+    iotx_coap_t *p_iotx_coap = NULL;
+    iotx_coap_engine_t *p_iotx_engine = (iotx_coap_engine_t *)p_engine;
+
+    if (NULL == p_iotx_engine || NULL == p_devinfo) {
+        COAP_ERR("Invalid paramter p_engine %p, p_devinfo %p", p_engine, p_devinfo);
+        return NULL;
+    }
+
+    session_id = iotx_coap_engine_session_id(p_iotx_engine);
+    if (0 == session_id) {
+        COAP_ERR("No free session id on the engine");
+        return NULL;
     }
+
+    p_iotx_coap = iotx_coap_session_new(p_iotx_engine, p_devinfo, (unsigned short)session_id);
+    if (NULL == p_iotx_coap) {
+        return NULL;
+    }
+    p_iotx_coap->event_handle = event_handle;
+
+    return (iotx_coap_context_t *)p_iotx_coap;
 }
 
 int IOT_CoAP_Yield(iotx_coap_context_t *p_context)
@@ -564,3 +853,14 @@ int IOT_CoAP_Yield(iotx_coap_context_t *p_context)
     return CoAPMessage_cycle(p_iotx_coap->p_coap_ctx);
 }
 
+int IOT_CoAP_EngineYield(iotx_coap_engine_context_t *p_engine)
+{
+    iotx_coap_engine_t *p_iotx_engine = (iotx_coap_engine_t *)p_engine;
+
+    if (NULL == p_iotx_engine) {
+        COAP_ERR("Invalid paramter");
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    return CoAPMessage_cycle(p_iotx_engine->p_coap_ctx);
+}
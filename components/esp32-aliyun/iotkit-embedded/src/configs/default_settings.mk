@@ -11,6 +11,7 @@ FEATURE_MQTT_ID2_AUTH       ?= n
 FEATURE_MQTT_ID2_CRYPTO     ?= n
 FEATURE_OTA_FETCH_CHANNEL   ?= HTTP
 FEATURE_HTTP_COMM_ENABLED   ?= y
+FEATURE_HTTP_INFLATE        ?= y
 
 #env: daily, pre or online
 FEATURE_MQTT_ID2_ENV        ?= online
@@ -329,6 +329,17 @@ static char *guider_set_auth_req_str(char sign[], char ts[])
     return ret;
 }
 
+/* copy @value, a slice of the guider response, as a string of at most @max_len chars */
+static int guider_copy_value(const lite_json_slice_t *value, char *dest, int max_len)
+{
+    if (NULL == value->value || value->len > max_len) {
+        return -1;
+    }
+    memcpy(dest, value->value, value->len);
+    dest[value->len] = '\0';
+    return 0;
+}
+
 static int guider_get_iotId_iotToken(
             const char *guider_addr,
             const char *request_string,
@@ -337,12 +348,19 @@ static int guider_get_iotId_iotToken(
             char *host,
             uint16_t *pport)
 {
+#define GUIDER_RESP_KEY_NUM     (5)
+
     char                iotx_payload[1024] = {0};
     int                 iotx_port = 443;
     int                 ret = -1;
     iotx_conn_info_pt   usr = iotx_conn_info_get();
+    static const char  *resp_keys[GUIDER_RESP_KEY_NUM] = {
+        "code", "data.iotId", "data.iotToken", "data.resources.mqtt.host", "data.resources.mqtt.port"
+    };
     int                 ret_code = 0;
-    const char         *pvalue;
+    int                 i;
+    lite_json_path_t    paths[GUIDER_RESP_KEY_NUM];
+    lite_json_slice_t   values[GUIDER_RESP_KEY_NUM];
     char                port_str[6];
 
     LITE_ASSERT(usr);
@@ -390,15 +408,16 @@ static int guider_get_iotId_iotToken(
                   );
     log_debug("http response: \r\n\r\n%s\r\n", iotx_payload);
 
-    pvalue = LITE_json_value_of("code", iotx_payload);
-    if (!pvalue) {
+    /* every key in one pass, the payload may fill the buffer without a NUL */
+    for (i = 0; i < GUIDER_RESP_KEY_NUM; i++) {
+        LITE_json_path_compile(&paths[i], resp_keys[i]);
+    }
+    if (LITE_json_path_extract(iotx_payload, sizeof(iotx_payload), paths, GUIDER_RESP_KEY_NUM, values) <= 0
+        || NULL == values[0].value) {
         goto do_exit;
     }
 
-    ret_code = atoi(pvalue);
-    LITE_free(pvalue);
-    pvalue = NULL;
-
+    ret_code = atoi(values[0].value);
     if (200 != ret_code) {
         log_err("++++");
         log_err("ret_code = %d (!= 200), abort!", ret_code);
@@ -406,37 +425,12 @@ static int guider_get_iotId_iotToken(
         goto do_exit;
     }
 
-    pvalue = LITE_json_value_of("data.iotId", iotx_payload);
-    if (NULL == pvalue) {
+    if (0 != guider_copy_value(&values[1], iot_id, GUIDER_IOT_ID_LEN)
+        || 0 != guider_copy_value(&values[2], iot_token, GUIDER_IOT_TOKEN_LEN)
+        || 0 != guider_copy_value(&values[3], host, HOST_ADDRESS_LEN)
+        || 0 != guider_copy_value(&values[4], port_str, sizeof(port_str) - 1)) {
         goto do_exit;
     }
-    strcpy(iot_id, pvalue);
-    LITE_free(pvalue);
-    pvalue = NULL;
-
-    pvalue = LITE_json_value_of("data.iotToken", iotx_payload);
-    if (NULL == pvalue) {
-        goto do_exit;
-    }
-    strcpy(iot_token, pvalue);
-    LITE_free(pvalue);
-    pvalue = NULL;
-
-    pvalue = LITE_json_value_of("data.resources.mqtt.host", iotx_payload);
-    if (NULL == pvalue) {
-        goto do_exit;
-    }
-    strcpy(host, pvalue);
-    LITE_free(pvalue);
-    pvalue = NULL;
-
-    pvalue = LITE_json_value_of("data.resources.mqtt.port", iotx_payload);
-    if (NULL == pvalue) {
-        goto do_exit;
-    }
-    strcpy(port_str, pvalue);
-    LITE_free(pvalue);
-    pvalue = NULL;
     *pport = atoi(port_str);
 
     log_debug("%10s: %s", "iotId", iot_id);
@@ -447,12 +441,9 @@ static int guider_get_iotId_iotToken(
     ret = 0;
 
 do_exit:
-    if (pvalue) {
-        LITE_free(pvalue);
-        pvalue = NULL;
-    }
-
     return ret;
+
+#undef GUIDER_RESP_KEY_NUM
 }
 #endif  /* MQTT_DIRECT */
 
@@ -24,6 +24,7 @@
 #include "lite-utils.h"
 #include "utils_hmac.h"
 #include "utils_httpc.h"
+#include "utils_timer.h"
 #include "ca.h"
 #include "utils_epoch_time.h"
 #include "sdk-impl_internal.h"
@@ -38,26 +39,15 @@
 
 #ifdef IOTX_HTTP_TIMESTAMP_OPTIONAL_ENABLE
 #define IOTX_HTTP_SIGN_SRC_STR          "clientId%sdeviceName%sproductKey%stimestamp%s"
-#define IOTX_HTTP_AUTH_DEVICENAME_STR   \
-    "{" \
-    "\"version\":\"%s\", \"clientId\":\"%s\"," \
-    "\"signmethod\":\"%s\",\"sign\":\"%s\"," \
-    "\"productKey\":\"%s\",\"deviceName\":\"%s\"," \
-    "\"timestamp\":\"%s\"" \
-    "}"
 #else
 #define IOTX_HTTP_SIGN_SRC_STR          "clientId%sdeviceName%sproductKey%s"
-#define IOTX_HTTP_AUTH_DEVICENAME_STR   \
-    "{" \
-    "\"version\":\"%s\", \"clientId\":\"%s\"," \
-    "\"signmethod\":\"%s\",\"sign\":\"%s\"," \
-    "\"productKey\":\"%s\",\"deviceName\":\"%s\"" \
-    "}"
 #endif
 
 #define IOTX_HTTP_AUTH_STR "auth"
 
-#if defined(TEST_HTTP_DAILY)
+#if defined(IOTX_HTTP_ONLINE_SERVER_URL)
+    /* given by the build, as the server of a host test */
+#elif defined(TEST_HTTP_DAILY)
     #define IOTX_HTTP_ONLINE_SERVER_URL     "http://10.101.83.159"
     #define IOTX_HTTP_ONLINE_SERVER_PORT    80
     #define IOTX_HTTP_CA_GET                NULL
@@ -67,6 +57,13 @@
     #define IOTX_HTTP_CA_GET                iotx_ca_get()
 #endif
 
+#define IOTX_HTTP_CONN_MAX              (2)         /* hosts a connection is kept to */
+#define IOTX_HTTP_HOST_LEN_MAX          (64)
+#define IOTX_HTTP_KEEPALIVE_IDLE_MS     (15000)     /* below the idle timeout of common servers */
+#define IOTX_HTTP_PROBE_IDLE_MS         (1000)      /* idle time after which a kept connection is checked */
+#define IOTX_HTTP_PIPELINE_MAX          (8)         /* requests sent ahead of their responses */
+#define IOTX_HTTP_BATCH_BUF_LEN         (4096)      /* requests written at once */
+
 #define IOTX_SHA_METHOD                     "hmacsha1"
 #define IOTX_MD5_METHOD                     "hmacmd5"
 
@@ -86,6 +83,14 @@
 
 static iotx_http_t *p_iotx_http = NULL;
 
+/* A connection to a host, kept open between two requests */
+typedef struct {
+    char                host[IOTX_HTTP_HOST_LEN_MAX];
+    int                 port;
+    httpclient_t        httpc;
+    uint32_t            last_used_ms;
+} iotx_http_conn_t;
+
 /*
   Http server url: https://iot-as-http.cn-shanghai.aliyuncs.com
   Only https protocal is supported at present.
@@ -112,39 +117,172 @@ static int iotx_calc_sign(const char *p_device_secret, const char *p_msg, char *
     return IOTX_SUCCESS;
 }
 
-static int calc_snprintf_string_length(char *fmt, ...)
+#define IOTX_HTTP_AUTH_PUT_STR(writer, key, value) \
+    do { \
+        LITE_json_put_key(writer, key, strlen(key)); \
+        LITE_json_put_string(writer, value, strlen(value)); \
+    } while (0)
+
+/* write the /auth body, count its length only when @writer has no buffer */
+static void iotx_http_write_auth_body(lite_json_writer_t *writer,
+                                      iotx_device_info_t *p_devinfo,
+                                      const char *sign,
+                                      const char *timestamp)
 {
-    va_list args;
-    int     rc = 0;
-    char *p = NULL;
-    char *sval = NULL;
+    LITE_json_put_object(writer);
+    IOTX_HTTP_AUTH_PUT_STR(writer, "version", "default");
+    IOTX_HTTP_AUTH_PUT_STR(writer, "clientId", p_devinfo->device_id);
+#if USING_SHA1_IN_HMAC
+    IOTX_HTTP_AUTH_PUT_STR(writer, "signmethod", IOTX_SHA_METHOD);
+#else
+    IOTX_HTTP_AUTH_PUT_STR(writer, "signmethod", IOTX_MD5_METHOD);
+#endif
+    IOTX_HTTP_AUTH_PUT_STR(writer, "sign", sign);
+    IOTX_HTTP_AUTH_PUT_STR(writer, "productKey", p_devinfo->product_key);
+    IOTX_HTTP_AUTH_PUT_STR(writer, "deviceName", p_devinfo->device_name);
+#ifdef IOTX_HTTP_TIMESTAMP_OPTIONAL_ENABLE
+    IOTX_HTTP_AUTH_PUT_STR(writer, "timestamp", timestamp);
+#endif
+    LITE_json_put_object_end(writer);
+}
 
-    if (NULL == fmt) {
-        return -1;
+/* the connection to the host of @url, the kept one if it is still open */
+static iotx_http_conn_t *iotx_http_conn_get(iotx_http_t *p_iotx_http, const char *url, int port)
+{
+    iotx_http_conn_t   *conns = (iotx_http_conn_t *)p_iotx_http->p_conns;
+    iotx_http_conn_t   *conn = NULL;
+    const char         *host = strstr(url, "://");
+    uint32_t            i, host_len, idle;
+    uint32_t            now = HAL_UptimeMs();
+
+    host = (NULL == host) ? url : host + 3;
+    host_len = strcspn(host, ":/");
+    if (host_len >= IOTX_HTTP_HOST_LEN_MAX) {
+        log_err("host of %s is too long", url);
+        return NULL;
     }
 
-    va_start(args, fmt);
+    for (i = 0; i < IOTX_HTTP_CONN_MAX; ++i) {
+        if (conns[i].port == port && strlen(conns[i].host) == host_len
+            && 0 == strncmp(conns[i].host, host, host_len)) {
+            conn = &conns[i];
+            break;
+        }
+    }
 
-    for (p = fmt; *p; p++) {
-        if (*p != '%') {
-            rc++;
-            continue;
+    if (NULL == conn) {
+        /* a free one, or the one of the host used least recently */
+        conn = &conns[0];
+        for (i = 1; i < IOTX_HTTP_CONN_MAX && 0 != conn->httpc.net.handle; ++i) {
+            if (0 == conns[i].httpc.net.handle || now - conns[i].last_used_ms > now - conn->last_used_ms) {
+                conn = &conns[i];
+            }
         }
-        switch (*++p) {
-            case 's':
-                for (sval = va_arg(args, char *); *sval; sval++) {
-                    rc++;
-                }
-                break;
-            default:
-                rc++;
-                break;
+
+        httpclient_close(&conn->httpc);
+        memset(conn, 0, sizeof(iotx_http_conn_t));
+        memcpy(conn->host, host, host_len);
+        conn->port = port;
+        return conn;
+    }
+
+    if (0 != conn->httpc.net.handle) {
+        idle = now - conn->last_used_ms;
+        if (idle >= p_iotx_http->keepalive_idle_ms
+            || (idle >= IOTX_HTTP_PROBE_IDLE_MS && !httpclient_is_alive(&conn->httpc))) {
+            httpclient_close(&conn->httpc);
+            p_iotx_http->conn_stats.expired++;
         }
     }
 
-    va_end(args);
+    return conn;
+}
+
+/* open @conn if it is not */
+static int iotx_http_conn_open(iotx_http_t *p_iotx_http, iotx_http_conn_t *conn, const char *ca_crt)
+{
+    int ret;
+
+    if (0 != conn->httpc.net.handle) {
+        return 0;
+    }
+
+    iotx_net_init(&conn->httpc.net, conn->host, conn->port, ca_crt);
+    ret = httpclient_connect(&conn->httpc);
+    if (0 != ret) {
+        log_err("httpclient_connect is error,ret = %d", ret);
+        httpclient_close(&conn->httpc);
+        return ret;
+    }
+    p_iotx_http->conn_stats.connects++;
 
-    return rc;
+    return 0;
+}
+
+/* POST @httpc_data to @url on the kept connection to its host, opened if there is none */
+static int iotx_http_post(iotx_http_t *p_iotx_http,
+                          const char *url,
+                          int port,
+                          const char *ca_crt,
+                          char *header,
+                          uint32_t timeout_ms,
+                          httpclient_data_t *httpc_data)
+{
+    iotx_http_conn_t   *conn;
+    iotx_time_t         timer;
+    int                 ret, reused, sent, retried = 0;
+
+    conn = iotx_http_conn_get(p_iotx_http, url, port);
+    if (NULL == conn) {
+        return ERROR_HTTP_PARSE;
+    }
+
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, timeout_ms);
+
+    for (;;) {
+        reused = (0 != conn->httpc.net.handle);
+        if (reused) {
+            p_iotx_http->conn_stats.reuses++;
+        } else if (0 != (ret = iotx_http_conn_open(p_iotx_http, conn, ca_crt))) {
+            return ret;
+        }
+
+        conn->httpc.header = header;
+        conn->httpc.response_code = 0;
+        httpc_data->is_more = false;
+        ret = httpclient_send_request(&conn->httpc, url, HTTPCLIENT_POST, httpc_data);
+        sent = (0 == ret);
+        if (sent) {
+            ret = httpclient_recv_response(&conn->httpc, iotx_time_left(&timer), httpc_data);
+        }
+
+        /* the server closed the kept connection before it got the request or before it answered,
+         * which it does to idle connections only, so the request was not handled: send it again */
+        if (reused && !retried && 0 == conn->httpc.response_code && (!sent || ERROR_HTTP_CONN == ret)) {
+            httpclient_close(&conn->httpc);
+            p_iotx_http->conn_stats.retries++;
+            retried = 1;
+            continue;
+        }
+        break;
+    }
+
+    if (ret >= 0 && 0 == conn->httpc.response_code) {
+        log_err("no response in %u ms", timeout_ms);
+        ret = ERROR_HTTP_CONN;
+    }
+
+    if (ret < 0 || httpc_data->is_more || httpc_data->is_chunked || conn->httpc.is_closing
+        || 0 == p_iotx_http->keepalive_idle_ms) {
+        /* the rest of a response too long for the buffer is not read, and the chunked decoder does
+         * not read the end of the last chunk, the connection is dropped */
+        httpclient_close(&conn->httpc);
+    } else {
+        conn->last_used_ms = HAL_UptimeMs();
+    }
+
+    return (ret < 0) ? ret : 0;
 }
 
 static int construct_full_http_authenticate_url(char *buf)
@@ -192,6 +330,14 @@ void *IOT_HTTP_Init(iotx_device_info_t *p_devinfo)
     p_iotx_http->is_authed = 0;
     p_iotx_http->auth_token_len = IOTX_HTTP_AUTH_TOKEN_LEN;
 
+    p_iotx_http->p_conns = LITE_malloc(sizeof(iotx_http_conn_t) * IOTX_HTTP_CONN_MAX);
+    if (NULL == p_iotx_http->p_conns) {
+        log_err(" Allocate memory for connections failed\r\n");
+        goto err;
+    }
+    memset(p_iotx_http->p_conns, 0x00, sizeof(iotx_http_conn_t) * IOTX_HTTP_CONN_MAX);
+    p_iotx_http->keepalive_idle_ms = IOTX_HTTP_KEEPALIVE_IDLE_MS;
+
     /*Get deivce information*/
     p_iotx_http->p_devinfo = LITE_malloc(sizeof(iotx_device_info_t));
     if (NULL == p_iotx_http->p_devinfo) {
@@ -222,15 +368,21 @@ err:
         if (NULL != p_iotx_http->p_auth_token) {
             LITE_free(p_iotx_http->p_auth_token);
         }
+        if (NULL != p_iotx_http->p_conns) {
+            LITE_free(p_iotx_http->p_conns);
+        }
 
         p_iotx_http->auth_token_len = 0;
         LITE_free(p_iotx_http);
+        p_iotx_http = NULL;
     }
     return NULL;
 }
 
 void IOT_HTTP_DeInit()
 {
+    int i;
+
     if (NULL != p_iotx_http) {
         if (NULL != p_iotx_http->p_devinfo) {
             LITE_free(p_iotx_http->p_devinfo);
@@ -238,12 +390,41 @@ void IOT_HTTP_DeInit()
         if (NULL != p_iotx_http->p_auth_token) {
             LITE_free(p_iotx_http->p_auth_token);
         }
+        if (NULL != p_iotx_http->p_conns) {
+            for (i = 0; i < IOTX_HTTP_CONN_MAX; ++i) {
+                httpclient_close(&((iotx_http_conn_t *)p_iotx_http->p_conns)[i].httpc);
+            }
+            LITE_free(p_iotx_http->p_conns);
+        }
 
         p_iotx_http->auth_token_len = 0;
         LITE_free(p_iotx_http);
+        p_iotx_http = NULL;
     }
 }
 
+int IOT_HTTP_SetKeepAlive(void *p_context, uint32_t idle_ms)
+{
+    if (NULL == p_context) {
+        log_err("p_context parameter is Null,failed!");
+        return -1;
+    }
+
+    ((iotx_http_t *)p_context)->keepalive_idle_ms = idle_ms;
+    return 0;
+}
+
+int IOT_HTTP_GetConnStats(void *p_context, iotx_http_conn_stats_t *stats)
+{
+    if (NULL == p_context || NULL == stats) {
+        log_err("p_context or stats parameter is Null,failed!");
+        return -1;
+    }
+
+    memcpy(stats, &((iotx_http_t *)p_context)->conn_stats, sizeof(iotx_http_conn_stats_t));
+    return 0;
+}
+
 
 int IOT_HTTP_DeviceNameAuth(void *p_context)
 {
@@ -261,6 +442,7 @@ int IOT_HTTP_DeviceNameAuth(void *p_context)
     char               *resp_payload = NULL;
     int                 len = 0;
     char                p_msg_unsign[IOTX_HTTP_SIGN_SOURCE_LEN] = {0};
+    lite_json_writer_t  writer;
     /*
         //    body:
         //    {
@@ -305,44 +487,20 @@ int IOT_HTTP_DeviceNameAuth(void *p_context)
 
     iotx_calc_sign(p_iotx_http->p_devinfo->device_secret, p_msg_unsign, sign);
 
-    /* to save stack memory*/
-    len = calc_snprintf_string_length(IOTX_HTTP_AUTH_DEVICENAME_STR,
-                                      "default",
-                                      p_iotx_http->p_devinfo->device_id,
-#if USING_SHA1_IN_HMAC
-                                      IOTX_SHA_METHOD,
-#else
-                                      IOTX_MD5_METHOD,
-#endif
-                                      sign,
-                                      p_iotx_http->p_devinfo->product_key,
-                                      p_iotx_http->p_devinfo->device_name,
-                                      timestamp
-                                     );
+    /* to save stack memory, a dry run sizes the body */
+    LITE_json_writer_init(&writer, NULL, 0);
+    iotx_http_write_auth_body(&writer, p_iotx_http->p_devinfo, sign, timestamp);
+    len = LITE_json_writer_finish(&writer);
 
-    if (len < 0) {
+    requ_payload = (char *)LITE_malloc(len + 1);
+    if (NULL == requ_payload) {
+        log_err("Allocate HTTP requ_payload buf failed!");
         goto do_exit;
     }
 
-    requ_payload = (char *)LITE_malloc(len + 1);
-    memset(requ_payload, 0, len + 1);
-
-    log_debug("len = %d,requ_payload: \r\n%s\r\n", len, requ_payload);
-
-    len = LITE_snprintf(requ_payload, len + 1,
-                        IOTX_HTTP_AUTH_DEVICENAME_STR,
-                        "default",
-                        p_iotx_http->p_devinfo->device_id,
-#if USING_SHA1_IN_HMAC
-                        IOTX_SHA_METHOD,
-#else
-                        IOTX_MD5_METHOD,
-#endif
-                        sign,
-                        p_iotx_http->p_devinfo->product_key,
-                        p_iotx_http->p_devinfo->device_name,
-                        timestamp
-                       );
+    LITE_json_writer_init(&writer, requ_payload, len + 1);
+    iotx_http_write_auth_body(&writer, p_iotx_http->p_devinfo, sign, timestamp);
+    len = LITE_json_writer_finish(&writer);
     log_debug("len = %d,requ_payload: \r\n%s\r\n", len, requ_payload);
 
     /* Malloc Http Response Payload */
@@ -378,12 +536,13 @@ int IOT_HTTP_DeviceNameAuth(void *p_context)
     */
 
     /* Send Request and Get Response */
-    if (0 != iotx_post(&httpc,
-                       http_url,
-                       IOTX_HTTP_ONLINE_SERVER_PORT,
-                       IOTX_HTTP_CA_GET,
-                       5000,
-                       &httpc_data)) {
+    if (0 != iotx_http_post(p_iotx_http,
+                            http_url,
+                            IOTX_HTTP_ONLINE_SERVER_PORT,
+                            IOTX_HTTP_CA_GET,
+                            httpc.header,
+                            5000,
+                            &httpc_data)) {
         goto do_exit;
     }
 
@@ -537,12 +696,13 @@ int IOT_HTTP_SendMessage(void *p_context, iotx_http_message_param_t *msg_param)
     log_info("request_payload: \r\n\r\n%s\r\n", httpc_data.post_buf);
 
     /* Send Request and Get Response */
-    if (iotx_post(&httpc,
-                  http_url,
-                  IOTX_HTTP_ONLINE_SERVER_PORT,
-                  IOTX_HTTP_CA_GET,
-                  msg_param->timeout_ms,
-                  &httpc_data)) {
+    if (iotx_http_post(p_iotx_http,
+                       http_url,
+                       IOTX_HTTP_ONLINE_SERVER_PORT,
+                       IOTX_HTTP_CA_GET,
+                       httpc.header,
+                       msg_param->timeout_ms,
+                       &httpc_data)) {
         goto do_exit;
     }
 
@@ -640,4 +800,216 @@ do_exit:
     return ret;
 }
 
+/* fail the messages from @from to @to, which are not answered */
+static void iotx_http_batch_fail(iotx_http_message_result_t *results, int from, int to)
+{
+    for (; from < to; ++from) {
+        results[from].result = -1;
+        results[from].response_code = -1;
+        results[from].latency_ms = 0;
+    }
+}
+
+int IOT_HTTP_SendMessages(void *p_context,
+                          iotx_http_message_param_t *msg_params,
+                          iotx_http_message_result_t *results,
+                          int count,
+                          iotx_http_batch_stats_t *stats)
+{
+    iotx_http_t            *p_iotx_http = (iotx_http_t *)p_context;
+    iotx_http_conn_t       *conn;
+    iotx_http_batch_stats_t batch;
+    httpclient_data_t       httpc_data;
+    char                    http_url[IOTX_HTTP_URL_LEN_MAX] = {0};
+    char                   *header = NULL, *buf = NULL, *pvalue;
+    int                     i, len, buf_len, ret = -1;
+    int                     next_write = 0, next_read = 0;
+    int                     written = 0, answered = 0;     /* requests of the connection */
+    int                     retrying = 0;                  /* requests are sent again, one at a time */
+    uint32_t                start = HAL_UptimeMs();
+
+    memset(&batch, 0, sizeof(iotx_http_batch_stats_t));
+
+    if (NULL == p_context || NULL == msg_params || NULL == results || count <= 0) {
+        log_err("Invalid argument");
+        return -1;
+    }
+
+    if (0 == p_iotx_http->is_authed) {
+        log_err("Device is not authed");
+        return -1;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (NULL == msg_params[i].topic_path || NULL == msg_params[i].request_payload
+            || NULL == msg_params[i].response_payload) {
+            log_err("IOT_HTTP_SendMessages message %d NULL!", i);
+            return -1;
+        }
+    }
+
+    len = strlen(IOTX_HTTP_HEADER_PASSWORD_STR) + strlen(p_iotx_http->p_auth_token) + strlen(
+                      IOTX_HTTP_HEADER_KEEPALIVE_STR) + strlen(IOTX_HTTP_HEADER_END_STR);
+    header = LITE_malloc(len + 1);
+    buf = LITE_malloc(IOTX_HTTP_BATCH_BUF_LEN);
+    if (NULL == header || NULL == buf) {
+        log_err("Allocate HTTP batch buf failed!");
+        goto do_exit;
+    }
+    LITE_snprintf(header, len + 1, IOTX_HTTP_UPSTREAM_HEADER_STR, p_iotx_http->p_auth_token);
 
+    construct_full_http_upstream_url(http_url, msg_params[0].topic_path);
+    conn = iotx_http_conn_get(p_iotx_http, http_url, IOTX_HTTP_ONLINE_SERVER_PORT);
+    if (NULL == conn) {
+        goto do_exit;
+    }
+    if (0 != conn->httpc.net.handle) {
+        /* kept from a previous request, which it answered */
+        written = answered = 1;
+    }
+    conn->httpc.header = header;
+
+    while (next_read < count) {
+        ret = 0;
+        conn->httpc.response_code = 0;
+        if (0 == conn->httpc.net.handle) {
+            if (0 != iotx_http_conn_open(p_iotx_http, conn, IOTX_HTTP_CA_GET)) {
+                iotx_http_batch_fail(results, next_read, count);
+                break;
+            }
+            written = answered = 0;
+        }
+
+        /* the requests the window takes, in one write while they fit in the buffer. It is refilled
+         * once half empty, a request per response would cost a round trip each on a slow server.
+         * After a retry, the window is of one request until the new connection answers it and
+         * stays open, RFC 7230 6.3.2 */
+        buf_len = 0;
+        while (next_write < count && next_write - next_read < (retrying ? 1 : IOTX_HTTP_PIPELINE_MAX)
+               && (buf_len > 0 || next_write - next_read <= IOTX_HTTP_PIPELINE_MAX / 2)) {
+            construct_full_http_upstream_url(http_url, msg_params[next_write].topic_path);
+            memset(&httpc_data, 0, sizeof(httpclient_data_t));
+            httpc_data.post_content_type = "application/octet-stream";
+            httpc_data.post_buf = msg_params[next_write].request_payload;
+            httpc_data.post_buf_len = msg_params[next_write].request_payload_len;
+
+            len = httpclient_format_request(&conn->httpc, http_url, HTTPCLIENT_POST, &httpc_data,
+                                            buf + buf_len, IOTX_HTTP_BATCH_BUF_LEN - buf_len);
+            if (len < 0 && buf_len > 0) {
+                /* in the next write */
+                break;
+            }
+
+            if (len < 0) {
+                /* longer than the buffer, the header and the body are written apart */
+                ret = httpclient_send_request(&conn->httpc, http_url, HTTPCLIENT_POST, &httpc_data);
+                batch.writes += 2;
+                batch.bytes += msg_params[next_write].request_payload_len;
+            } else {
+                buf_len += len;
+                ret = 0;
+            }
+
+            results[next_write].latency_ms = HAL_UptimeMs();
+            p_iotx_http->conn_stats.reuses += (written++ > 0);
+            next_write++;
+            if (0 != ret || len < 0) {
+                break;
+            }
+        }
+
+        if (0 == ret && buf_len > 0) {
+            ret = httpclient_write(&conn->httpc, buf, buf_len);
+            batch.writes++;
+            batch.bytes += buf_len;
+        }
+
+        /* the response to the oldest request */
+        if (0 == ret) {
+            memset(&httpc_data, 0, sizeof(httpclient_data_t));
+            httpc_data.response_buf = msg_params[next_read].response_payload;
+            httpc_data.response_buf_len = msg_params[next_read].response_payload_len;
+            conn->httpc.response_code = 0;
+            ret = httpclient_recv_response(&conn->httpc, msg_params[next_read].timeout_ms, &httpc_data);
+        }
+
+        if (ret >= 0 && 0 != conn->httpc.response_code) {
+            i = next_read++;
+            answered++;
+            results[i].latency_ms = HAL_UptimeMs() - results[i].latency_ms;
+            results[i].response_code = -1;
+            pvalue = LITE_json_value_of("code", httpc_data.response_buf);
+            if (NULL != pvalue) {
+                results[i].response_code = atoi(pvalue);
+                LITE_free(pvalue);
+            }
+            results[i].result = (IOTX_HTTP_SUCCESS == results[i].response_code) ? 0 : -1;
+            batch.accepted += (0 == results[i].result);
+            if (IOTX_HTTP_TOKEN_EXPIRED_ERROR == results[i].response_code) {
+                p_iotx_http->is_authed = 0;
+            }
+
+            if (conn->httpc.is_closing) {
+                /* the server does not read the requests after this one */
+                httpclient_close(&conn->httpc);
+                p_iotx_http->conn_stats.retries += next_write - next_read;
+                retrying |= (next_write > next_read);
+                next_write = next_read;
+            } else if (ret > 0 || httpc_data.is_more || httpc_data.is_chunked) {
+                /* the end of this response is not read, nor the responses after it */
+                httpclient_close(&conn->httpc);
+                iotx_http_batch_fail(results, next_read, next_write);
+                next_read = next_write;
+            } else {
+                /* the connection is persistent, the window is refilled */
+                retrying = 0;
+            }
+            continue;
+        }
+
+        /* no response: the requests after the last answered one are sent again on a new connection
+         * if this one was closed between two responses, as the server does not read them then.
+         * A connection which never answered does not get them again, nor one which timed out.
+         * Without a "Connection: close", the server may have processed one before closing, so the
+         * message is delivered twice, RFC 7230 6.3.1 */
+        httpclient_close(&conn->httpc);
+        if (answered > 0 && 0 == conn->httpc.response_code && ERROR_HTTP_CONN == ret) {
+            p_iotx_http->conn_stats.retries += next_write - next_read;
+            retrying = 1;
+            next_write = next_read;
+        } else {
+            iotx_http_batch_fail(results, next_read, next_write);
+            next_read = next_write;
+        }
+    }
+
+    if (0 != conn->httpc.net.handle) {
+        if (0 == p_iotx_http->keepalive_idle_ms) {
+            httpclient_close(&conn->httpc);
+        } else {
+            conn->last_used_ms = HAL_UptimeMs();
+        }
+    }
+    conn->httpc.header = NULL;
+
+    if (0 == p_iotx_http->is_authed) {
+        IOT_HTTP_DeviceNameAuth(p_iotx_http);
+    }
+
+    ret = (batch.accepted == count) ? 0 : -1;
+
+do_exit:
+    if (NULL != header) {
+        LITE_free(header);
+    }
+    if (NULL != buf) {
+        LITE_free(buf);
+    }
+
+    batch.elapsed_ms = HAL_UptimeMs() - start;
+    if (NULL != stats) {
+        memcpy(stats, &batch, sizeof(iotx_http_batch_stats_t));
+    }
+
+    return ret;
+}
@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/*
+ * Messages per second of IOT_HTTP_SendMessage() against a local HTTPS server, with a connection
+ * per message and with the connection kept alive, and of IOT_HTTP_SendMessages() pipelining them.
+ * The server thread uses mbedTLS and its test certificate for "localhost", it answers the auth
+ * request with a token and every message with a messageId.
+ *
+ *   ./bench [-n messages] [-l payload bytes] [-d delay of the server in ms]
+ *
+ * Then the server closes the kept connection without a close notify, after an idle time or after
+ * a number of requests as a load balancer does, and every message must still be answered once.
+ * The exit code is the number of failed cases.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "mbedtls/ssl.h"
+#include "mbedtls/net.h"
+#include "mbedtls/certs.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+
+#define BENCH_SERVER_PORT       "18443"     /* the IOTX_HTTP_ONLINE_SERVER_PORT of the Makefile */
+#define BENCH_TOPIC             "/topic/bench/device/update"
+#define BENCH_REQUEST_MAX       (4096)
+
+/* what the server does, changed by the cases between two runs */
+static struct {
+    int idle_close_ms;      /* close a kept connection idle for this time, 0 never */
+    int close_after;        /* close a connection after this number of requests, 0 never */
+    int delay_ms;           /* wait after every read of requests, as a round trip would */
+    int requests;           /* requests answered */
+    int messages;           /* messages answered, the auth requests aside */
+    int connections;        /* connections accepted */
+} bench_server;
+
+static double bench_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* the CA of the test certificate of the server, in place of the one of system/ca.c */
+const char *iotx_ca_get(void)
+{
+    return mbedtls_test_cas_pem;
+}
+
+/* read a request into @buf, which holds @len bytes of the next one already */
+/* return its length, 0 if the connection is closed or idle for too long */
+static int bench_read_request(mbedtls_ssl_context *ssl, char *buf, int *len)
+{
+    char *end;
+    const char *field;
+    int ret, total;
+
+    for (;;) {
+        buf[*len] = '\0';
+        end = strstr(buf, "\r\n\r\n");
+        if (NULL != end) {
+            total = end + 4 - buf;
+            for (field = buf; NULL != (field = strstr(field, "\r\n")); ) {
+                field += 2;
+                if (0 == strncasecmp(field, "Content-Length:", 15)) {
+                    total += atoi(field + 15);
+                    break;
+                }
+            }
+            if (*len >= total) {
+                return total;
+            }
+        }
+
+        if (*len >= BENCH_REQUEST_MAX - 1) {
+            return 0;
+        }
+        ret = mbedtls_ssl_read(ssl, (unsigned char *)buf + *len, BENCH_REQUEST_MAX - 1 - *len);
+        if (ret <= 0) {
+            return 0;
+        }
+        *len += ret;
+        if (bench_server.delay_ms > 0) {
+            usleep(bench_server.delay_ms * 1000);
+        }
+    }
+}
+
+static int bench_write(mbedtls_ssl_context *ssl, const char *buf, int len)
+{
+    int ret, written = 0;
+
+    while (written < len) {
+        ret = mbedtls_ssl_write(ssl, (const unsigned char *)buf + written, len - written);
+        if (ret <= 0) {
+            return -1;
+        }
+        written += ret;
+    }
+    return 0;
+}
+
+static void bench_serve(mbedtls_ssl_config *conf, mbedtls_net_context *client)
+{
+    mbedtls_ssl_context ssl;
+    char request[BENCH_REQUEST_MAX], response[256], body[128];
+    int len = 0, request_len, served = 0;
+
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_conf_read_timeout(conf, bench_server.idle_close_ms);
+    if (0 != mbedtls_ssl_setup(&ssl, conf)) {
+        goto exit;
+    }
+    mbedtls_ssl_set_bio(&ssl, client, mbedtls_net_send, mbedtls_net_recv, mbedtls_net_recv_timeout);
+    if (0 != mbedtls_ssl_handshake(&ssl)) {
+        goto exit;
+    }
+
+    while (0 != (request_len = bench_read_request(&ssl, request, &len))) {
+        if (0 == strncmp(request, "POST /auth ", 11)) {
+            snprintf(body, sizeof(body), "{\"code\":0,\"message\":\"success\",\"info\":{\"token\":\"bench\"}}");
+        } else {
+            snprintf(body, sizeof(body), "{\"code\":0,\"message\":\"success\",\"info\":{\"messageId\":%d}}",
+                     ++bench_server.messages);
+        }
+        bench_server.requests++;
+
+        snprintf(response, sizeof(response),
+                 "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n%s",
+                 (int)strlen(body), body);
+        if (0 != bench_write(&ssl, response, strlen(response))) {
+            break;
+        }
+
+        /* keep what the client sent after this request */
+        len -= request_len;
+        memmove(request, request + request_len, len);
+
+        if (bench_server.close_after > 0 && ++served >= bench_server.close_after) {
+            /* as a HTTP server does, it reads and drops the requests pipelined after the last one
+             * until the client closes, a close with them unread would reset the connection and
+             * lose the responses the client did not read yet */
+            shutdown(client->fd, SHUT_WR);
+            while (mbedtls_net_recv_timeout(client, (unsigned char *)request, sizeof(request), 500) > 0);
+            break;
+        }
+    }
+
+exit:
+    /* the socket is closed without a close notify */
+    mbedtls_net_free(client);
+    mbedtls_ssl_free(&ssl);
+}
+
+static void *bench_server_thread(void *arg)
+{
+    mbedtls_net_context *listen_fd = (mbedtls_net_context *)arg;
+    mbedtls_net_context client;
+    mbedtls_ssl_config conf;
+    mbedtls_x509_crt cert;
+    mbedtls_pk_context key;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    int opt;
+
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_x509_crt_init(&cert);
+    mbedtls_pk_init(&key);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+
+    if (0 != mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, NULL, 0)
+        || 0 != mbedtls_x509_crt_parse(&cert, (const unsigned char *)mbedtls_test_srv_crt, mbedtls_test_srv_crt_len)
+        || 0 != mbedtls_pk_parse_key(&key, (const unsigned char *)mbedtls_test_srv_key, mbedtls_test_srv_key_len,
+                                     NULL, 0)
+        || 0 != mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                            MBEDTLS_SSL_PRESET_DEFAULT)
+        || 0 != mbedtls_ssl_conf_own_cert(&conf, &cert, &key)) {
+        printf("server setup failed\n");
+        return NULL;
+    }
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+
+    for (;;) {
+        mbedtls_net_init(&client);
+        if (0 != mbedtls_net_accept(listen_fd, &client, NULL, 0, NULL)) {
+            continue;
+        }
+        /* the responses to pipelined requests go out as they are written */
+        opt = 1;
+        setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        bench_server.connections++;
+        bench_serve(&conf, &client);
+    }
+
+    return NULL;
+}
+
+/* send @count messages of @payload_len bytes every @interval_ms with keep-alive @idle_ms, one by one
+ * with IOT_HTTP_SendMessage() if @batch is 0, else @batch at a time with IOT_HTTP_SendMessages() */
+/* return the number of messages not answered */
+static int bench_run(const char *name, int count, int batch, int payload_len, int interval_ms, uint32_t idle_ms)
+{
+    iotx_device_info_t devinfo;
+    iotx_http_message_param_t *msgs;
+    iotx_http_message_result_t *results;
+    iotx_http_batch_stats_t batch_stats;
+    iotx_http_conn_stats_t stats;
+    char *payload, *responses;
+    void *handle;
+    int i, k, n, failed = 0, messages = bench_server.messages, writes = 0;
+    double start, elapsed, sent, latency, latency_sum = 0, latency_max = 0;
+
+    memset(&devinfo, 0, sizeof(devinfo));
+    strcpy(devinfo.product_key, "bench");
+    strcpy(devinfo.device_name, "device");
+    strcpy(devinfo.device_secret, "secret");
+    strcpy(devinfo.device_id, "bench.device");
+
+    payload = malloc(payload_len + 1);
+    memset(payload, 'x', payload_len);
+    payload[payload_len] = '\0';
+    msgs = calloc(count, sizeof(iotx_http_message_param_t));
+    results = calloc(count, sizeof(iotx_http_message_result_t));
+    responses = calloc(count, 256);
+    for (i = 0; i < count; i++) {
+        msgs[i].topic_path = BENCH_TOPIC;
+        msgs[i].request_payload = payload;
+        msgs[i].request_payload_len = payload_len;
+        msgs[i].response_payload = responses + i * 256;
+        msgs[i].response_payload_len = 256;
+        msgs[i].timeout_ms = 5000;
+    }
+
+    handle = IOT_HTTP_Init(&devinfo);
+    if (NULL == handle) {
+        return count;
+    }
+    IOT_HTTP_SetKeepAlive(handle, idle_ms);
+
+    start = bench_now_ms();
+    if (0 != IOT_HTTP_DeviceNameAuth(handle)) {
+        failed = count;
+    }
+    for (i = 0; i < count && !failed; i += n) {
+        if (i > 0 && interval_ms > 0) {
+            usleep(interval_ms * 1000);
+        }
+
+        sent = bench_now_ms();
+        if (0 == batch) {
+            n = 1;
+            failed += (0 != IOT_HTTP_SendMessage(handle, &msgs[i]));
+            latency = bench_now_ms() - sent;
+            latency_sum += latency;
+            latency_max = latency > latency_max ? latency : latency_max;
+        } else {
+            n = count - i < batch ? count - i : batch;
+            IOT_HTTP_SendMessages(handle, &msgs[i], &results[i], n, &batch_stats);
+            writes += batch_stats.writes;
+            for (k = i; k < i + n; k++) {
+                failed += (0 != results[k].result);
+                latency_sum += results[k].latency_ms;
+                latency_max = results[k].latency_ms > latency_max ? results[k].latency_ms : latency_max;
+            }
+        }
+    }
+    elapsed = bench_now_ms() - start;
+
+    IOT_HTTP_GetConnStats(handle, &stats);
+    IOT_HTTP_DeInit();
+    free(responses);
+    free(results);
+    free(msgs);
+    free(payload);
+
+    /* every message must reach the server once, a retry of an answered one would be a duplicate */
+    if (bench_server.messages - messages != count - failed) {
+        failed = count;
+    }
+
+    printf("%-26s %5d %8.0f %8.2f %8.1f %7d | %8u %6u %7u %7u%s\n", name, count, count * 1000 / elapsed,
+           latency_sum / count, latency_max, batch ? writes : count,
+           stats.connects, stats.reuses, stats.retries, stats.expired, failed ? "  FAILED" : "");
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int opt, count = 200, payload_len = 64, failed = 0;
+    mbedtls_net_context listen_fd;
+    pthread_t server;
+
+    while ((opt = getopt(argc, argv, "n:l:d:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 'l':
+                payload_len = atoi(optarg);
+                break;
+            case 'd':
+                bench_server.delay_ms = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-n messages] [-l payload bytes] [-d delay of the server in ms]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (count <= 0 || payload_len <= 0 || bench_server.delay_ms < 0 || payload_len > BENCH_REQUEST_MAX / 2) {
+        return -1;
+    }
+
+    /* a write to a socket the server closed fails rather than killing the process */
+    signal(SIGPIPE, SIG_IGN);
+    LITE_openlog("bench");
+    LITE_set_loglevel(LOG_WARNING_LEVEL);
+
+    mbedtls_net_init(&listen_fd);
+    if (0 != mbedtls_net_bind(&listen_fd, "127.0.0.1", BENCH_SERVER_PORT, MBEDTLS_NET_PROTO_TCP)) {
+        printf("bind to port %s failed\n", BENCH_SERVER_PORT);
+        return -1;
+    }
+    pthread_create(&server, NULL, bench_server_thread, &listen_fd);
+
+    printf("%-26s %5s %8s %8s %8s %7s | %8s %6s %7s %7s\n",
+           "case", "msgs", "msgs/s", "avg ms", "max ms", "writes", "connects", "reuses", "retries", "expired");
+
+    failed += bench_run("connection per message", count, 0, payload_len, 0, 0);
+    failed += bench_run("keep-alive", count, 0, payload_len, 0, 15000);
+    failed += bench_run("batch of 8", count, 8, payload_len, 0, 15000);
+    failed += bench_run("batch of 32", count, 32, payload_len, 0, 15000);
+
+    /* the server closes connections idle for 200 ms, before the device does and before it probes */
+    bench_server.idle_close_ms = 200;
+    failed += bench_run("server idle close 200ms", 5, 0, payload_len, 300, 15000);
+    /* the device probes the kept connection after 1 s, it finds it closed */
+    failed += bench_run("idle 1.2s, probed", 3, 0, payload_len, 1200, 15000);
+    bench_server.idle_close_ms = 0;
+    /* the device closes connections idle for 1 s itself */
+    failed += bench_run("idle 1.2s, expired", 3, 0, payload_len, 1200, 1000);
+
+    /* the server closes every connection after 10 requests */
+    bench_server.close_after = 10;
+    failed += bench_run("server close after 10", 50, 0, payload_len, 0, 15000);
+    /* and the requests it did not read are sent again */
+    failed += bench_run("batch, close after 10", 50, 16, payload_len, 0, 15000);
+    bench_server.close_after = 0;
+
+    LITE_closelog();
+    return failed;
+}
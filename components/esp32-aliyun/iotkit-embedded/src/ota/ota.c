@@ -35,6 +35,87 @@
 #endif
 
 #include "ota_fetch.c"
+#include "ota_patch.c"
+
+/* consecutive fetch failures without any byte got before giving up */
+#define OTA_FETCH_RETRY_MAX         (5)
+/* the first retry is at once, as after a dropped connection; the next ones wait this long, doubled
+ * every time, so a server or link which is down is not hammered */
+#define OTA_FETCH_BACKOFF_MS        (500)
+
+/* a segmented download measures its rate over this time and takes one more connection while the
+ * rate grows by OTA_SEGMENT_GAIN percent, it tries again when the rate falls to OTA_SEGMENT_DROP */
+#define OTA_SEGMENT_PERIOD_MS       (500)
+#define OTA_SEGMENT_GAIN            (10)
+#define OTA_SEGMENT_DROP            (75)
+
+#define OTA_CHECKPOINT_KEY          "iotx_ota"
+#define OTA_CHECKPOINT_MAGIC        (0x4F544133)    /* "OTA3" */
+
+/* Progress of a download saved by HAL_Kv_Set(), valid for the file of the same size and digest only */
+typedef struct {
+    uint32_t magic;
+    uint16_t struct_len;        /* sizeof(OTA_Checkpoint_t) and sizeof(otalib_Hash_t) of the writer, */
+    uint16_t hash_len;          /* the hash state is a raw context of its build */
+    uint32_t size_file;
+    uint32_t size_fetched;
+    char digest[OTALIB_HASH_STR_LEN];
+    otalib_Hash_t hash;         /* hash state of the first @size_fetched bytes */
+} OTA_Checkpoint_t;
+
+/* Blocks of the file and their SHA-256 listed in a signed manifest */
+typedef struct {
+    unsigned char *hashes;      /* SHA-256 of every block */
+    uint32_t block_len;
+    uint32_t size_verified;     /* bytes of the file verified, the end of a block */
+    int retries;                /* failures of the current block */
+    iot_sha256_context sha256;  /* SHA-256 of the current block so far */
+} OTA_Manifest_t, *OTA_Manifest_pt;
+
+/* A buffer of the pipeline, filled by IOT_OTA_PipelineFetch() and emptied by IOT_OTA_PipelineFlush() */
+typedef struct {
+    char *buf;
+    uint32_t offset;            /* offset of @buf in the file */
+    uint32_t len;
+    uint32_t end;               /* where the segment fetched into @buf ends, with segments */
+} OTA_Slot_t;
+
+/* A connection of a segmented download, see IOT_OTA_PipelineSegments() */
+typedef struct {
+    void *channel;              /* fetch channel, ch_fetch of OTA_Struct_t for the first one */
+    int slot;                   /* slot of the segment being fetched, -1 if none */
+    int retries;                /* failures of the segment since the last byte got */
+    uint32_t retry_ms;          /* uptime of the next attempt after a failure */
+} OTA_Connection_t;
+
+typedef struct {
+    OTA_Connection_t *conns;
+    uint32_t max;               /* connections at most */
+    uint32_t parallel;          /* connections taking segments now */
+    uint32_t inflight;          /* slots from @head on which are fetched and not handed to the flush yet */
+    uint32_t next;              /* offset of the next segment */
+    uint32_t period_ms;         /* time and bytes of the fetch calls since the rate was measured */
+    uint32_t period_bytes;
+    uint32_t rate;              /* bytes per second of the last period */
+    uint32_t last_rate;         /* of the period before a connection was added */
+    uint32_t best_rate;         /* since the number of connections is settled */
+    bool probing;               /* whether a connection was added to see what it brings */
+} OTA_Segments_t;
+
+typedef struct {
+    IOT_OTA_Sink_t sink;
+    void *mutex;
+    void *filled;               /* posted when a slot is filled or the download ends */
+    void *flushed;              /* posted when a slot is flushed or the download ends */
+    OTA_Slot_t *slots;
+    uint32_t slot_count;
+    uint32_t slot_len;
+    uint32_t head;              /* next slot to fill */
+    uint32_t tail;              /* next slot to flush */
+    uint32_t count;             /* slots filled, under @mutex as @head and @tail */
+    IOT_OTA_PipelineStats_t stats;
+    OTA_Segments_t *segments;   /* NULL unless IOT_OTA_PipelineSegments() */
+} OTA_Pipeline_t, *OTA_Pipeline_pt;
 
 typedef struct  {
     const char *product_key;    /* point to product key */
@@ -48,8 +129,18 @@ typedef struct  {
     char *purl;                 /* point to URL */
     char *version;              /* point to string */
     char md5sum[33];            /* MD5 string */
-
-    void *md5;                  /* MD5 handle */
+    int sign_method;            /* OTALIB_HASH_MD5 or OTALIB_HASH_SHA256 */
+    char sign[OTALIB_HASH_STR_LEN]; /* SHA-256 string when @sign_method is OTALIB_HASH_SHA256 */
+    int is_diff;                /* the file is a patch, see IOT_OTA_PatchInit() */
+    uint32_t size_checkpoint;   /* size of downloaded at the last checkpoint */
+    uint32_t checkpoint_interval; /* bytes between two checkpoints, 0 if disabled */
+    int retries;                /* fetch failures since the last byte got */
+    uint32_t retry_ms;          /* uptime of the next attempt after a failure */
+    OTA_Pipeline_pt pipeline;   /* NULL unless IOT_OTA_PipelineInit() */
+    OTA_Manifest_pt manifest;   /* NULL unless IOT_OTA_SetManifest(), the file is not hashed then */
+    IOT_OTA_FetchConfig_t fetch_config; /* of IOT_OTA_SetFetchConfig(), all 0 for the defaults */
+
+    void *hash;                 /* hash handle of the whole file */
     void *ch_signal;            /* channel handle of signal exchanged with OTA server */
     void *ch_fetch;             /* channel handle of download */
 
@@ -67,10 +158,193 @@ static bool ota_check_progress(IOT_OTA_Progress_t progress)
 }
 
 
+/* the expected digest of the whole file */
+static const char *ota_digest(OTA_Struct_pt h_ota)
+{
+    return (OTALIB_HASH_SHA256 == h_ota->sign_method) ? h_ota->sign : h_ota->md5sum;
+}
+
+
+/* go on from the checkpoint of this file, if any */
+static void ota_checkpoint_restore(OTA_Struct_pt h_ota)
+{
+    int len = sizeof(OTA_Checkpoint_t);
+    OTA_Checkpoint_t checkpoint;
+
+    /* a patch is applied from byte 0, the patcher is not saved */
+    if (0 == h_ota->checkpoint_interval || h_ota->is_diff
+        || 0 != HAL_Kv_Get(OTA_CHECKPOINT_KEY, &checkpoint, &len)
+        || sizeof(OTA_Checkpoint_t) != len
+        || OTA_CHECKPOINT_MAGIC != checkpoint.magic
+        || sizeof(OTA_Checkpoint_t) != checkpoint.struct_len
+        || sizeof(otalib_Hash_t) != checkpoint.hash_len
+        || checkpoint.size_file != h_ota->size_file
+        || checkpoint.size_fetched >= h_ota->size_file
+        || 0 != strncmp(checkpoint.digest, ota_digest(h_ota), sizeof(checkpoint.digest))
+        || checkpoint.hash.method != h_ota->sign_method) {
+        return;
+    }
+
+    memcpy(h_ota->hash, &checkpoint.hash, sizeof(otalib_Hash_t));
+    h_ota->size_fetched = checkpoint.size_fetched;
+    h_ota->size_checkpoint = checkpoint.size_fetched;
+    OTA_LOG_INFO("resume download from %u bytes", (unsigned int)h_ota->size_fetched);
+}
+
+
+/* called when the first @size bytes are hashed and stored by the application */
+static void ota_checkpoint_save(OTA_Struct_pt h_ota, uint32_t size)
+{
+    OTA_Checkpoint_t checkpoint;
+
+    if (NULL != h_ota->manifest && size > h_ota->manifest->size_verified) {
+        /* the blocks verified only */
+        size = h_ota->manifest->size_verified;
+    }
+
+    if (0 == h_ota->checkpoint_interval || h_ota->is_diff
+        || size - h_ota->size_checkpoint < h_ota->checkpoint_interval) {
+        return;
+    }
+
+    memset(&checkpoint, 0, sizeof(OTA_Checkpoint_t));
+    checkpoint.magic = OTA_CHECKPOINT_MAGIC;
+    checkpoint.struct_len = sizeof(OTA_Checkpoint_t);
+    checkpoint.hash_len = sizeof(otalib_Hash_t);
+    checkpoint.size_file = h_ota->size_file;
+    checkpoint.size_fetched = size;
+    strncpy(checkpoint.digest, ota_digest(h_ota), sizeof(checkpoint.digest) - 1);
+    memcpy(&checkpoint.hash, h_ota->hash, sizeof(otalib_Hash_t));
+
+    if (0 != HAL_Kv_Set(OTA_CHECKPOINT_KEY, &checkpoint, sizeof(OTA_Checkpoint_t), 1)) {
+        OTA_LOG_ERROR("save checkpoint failed");
+        return;
+    }
+
+    h_ota->size_checkpoint = size;
+}
+
+
+/* end the download with @err, IOT_OTAE_NONE if it is done, the first stage to end it sets the error */
+/* with a pipeline, the other stage reads the state under the mutex and is woken up if it waits */
+static void ota_fetch_end(OTA_Struct_pt h_ota, int err)
+{
+    OTA_Pipeline_pt pipeline = h_ota->pipeline;
+
+    if (NULL != pipeline) {
+        HAL_MutexLock(pipeline->mutex);
+    }
+    if (IOT_OTAS_FETCHING == h_ota->state) {
+        h_ota->state = IOT_OTAS_FETCHED;
+        if (IOT_OTAE_NONE != err) {
+            h_ota->err = err;
+        }
+    }
+    if (NULL != pipeline) {
+        HAL_MutexUnlock(pipeline->mutex);
+        HAL_SemaphorePost(pipeline->filled);
+        HAL_SemaphorePost(pipeline->flushed);
+    }
+}
+
+
+/* the whole file is hashed and stored */
+static void ota_fetch_done(OTA_Struct_pt h_ota)
+{
+    ota_fetch_end(h_ota, IOT_OTAE_NONE);
+    if (0 != h_ota->size_checkpoint) {
+        HAL_Kv_Del(OTA_CHECKPOINT_KEY);
+    }
+}
+
+
+/* the state of the download, under the mutex of the pipeline */
+static IOT_OTA_State_t ota_pipeline_state(OTA_Struct_pt h_ota)
+{
+    IOT_OTA_State_t state;
+
+    HAL_MutexLock(h_ota->pipeline->mutex);
+    state = h_ota->state;
+    HAL_MutexUnlock(h_ota->pipeline->mutex);
+
+    return state;
+}
+
+
+static void ota_pipeline_release(OTA_Pipeline_pt pipeline)
+{
+    uint32_t i;
+
+    if (NULL != pipeline->segments) {
+        /* the first channel is ch_fetch of OTA_Struct_t */
+        for (i = 1; i < pipeline->segments->max; ++i) {
+            ofc_Deinit(pipeline->segments->conns[i].channel);
+        }
+        OTA_FREE(pipeline->segments->conns);
+        OTA_FREE(pipeline->segments);
+    }
+
+    if (NULL != pipeline->slots) {
+        for (i = 0; i < pipeline->slot_count; ++i) {
+            if (NULL != pipeline->slots[i].buf) {
+                OTA_FREE(pipeline->slots[i].buf);
+            }
+        }
+        OTA_FREE(pipeline->slots);
+    }
+
+    if (NULL != pipeline->flushed) {
+        HAL_SemaphoreDestroy(pipeline->flushed);
+    }
+    if (NULL != pipeline->filled) {
+        HAL_SemaphoreDestroy(pipeline->filled);
+    }
+    if (NULL != pipeline->mutex) {
+        HAL_MutexDestroy(pipeline->mutex);
+    }
+
+    OTA_FREE(pipeline);
+}
+
+
+/* wait up to @timeout_ms for a slot to fill, @full false, or to flush, @full true */
+/* return true if there is one, false on timeout or if the download ended, the wait is added to @stats */
+static bool ota_pipeline_wait(OTA_Struct_pt h_ota, bool full, uint32_t timeout_ms,
+                              IOT_OTA_StageStats_t *stats)
+{
+    OTA_Pipeline_pt pipeline = h_ota->pipeline;
+    uint32_t start = HAL_UptimeMs(), elapsed;
+    bool ready, ended, stalled = false;
+
+    for (;;) {
+        HAL_MutexLock(pipeline->mutex);
+        ready = full ? (pipeline->count > 0) : (pipeline->count < pipeline->slot_count);
+        ended = (IOT_OTAS_FETCHING != h_ota->state);
+        HAL_MutexUnlock(pipeline->mutex);
+
+        elapsed = HAL_UptimeMs() - start;
+        if (ready || ended || elapsed >= timeout_ms) {
+            break;
+        }
+
+        /* blocked until the other stage posts, the semaphore may hold posts already seen */
+        stalled = true;
+        HAL_SemaphoreWait(full ? pipeline->filled : pipeline->flushed, timeout_ms - elapsed);
+    }
+
+    if (stalled) {
+        stats->stalls++;
+        stats->stall_ms += HAL_UptimeMs() - start;
+    }
+
+    return ready;
+}
+
+
 static void ota_callback(void *pcontext, const char *msg, uint32_t msg_len)
 {
-    const char *pvalue;
-    uint32_t val_len;
+    static const char *keys[] = { "message", "data" };
+    lite_json_slice_t values[2];
 
     OTA_Struct_pt h_ota = (OTA_Struct_pt) pcontext;
 
@@ -79,36 +353,45 @@ static void ota_callback(void *pcontext, const char *msg, uint32_t msg_len)
         return;
     }
 
-    pvalue = otalib_JsonValueOf(msg, msg_len, "message", &val_len);
-    if (NULL == pvalue) {
+    if (otalib_JsonValuesOf(msg, msg_len, keys, 2, values) < 0 || NULL == values[0].value) {
         OTA_LOG_ERROR("invalid json doc of OTA ");
         return;
     }
 
     /* check whether is positive message */
-    if (!((strlen("success") == val_len) && (0 == strncmp(pvalue, "success", val_len)))) {
+    if (!((strlen("success") == values[0].len) && (0 == strncmp(values[0].value, "success", values[0].len)))) {
         OTA_LOG_ERROR("fail state of json doc of OTA");
         return ;
     }
 
-    /* get value of 'data' key */
-    pvalue = otalib_JsonValueOf(msg, msg_len, "data", &val_len);
-    if (NULL == pvalue) {
+    /* value of 'data' key */
+    if (NULL == values[1].value) {
         OTA_LOG_ERROR("Not 'data' key in json doc of OTA");
         return;
     }
 
-    if (0 != otalib_GetParams(pvalue, val_len, &h_ota->purl, &h_ota->version, h_ota->md5sum, &h_ota->size_file)) {
+    if (0 != otalib_GetParams(values[1].value, values[1].len, &h_ota->purl, &h_ota->version, h_ota->md5sum,
+                              &h_ota->sign_method, h_ota->sign, &h_ota->is_diff, &h_ota->size_file)) {
         OTA_LOG_ERROR("Get firmware parameter failed");
         return;
     }
+    otalib_HashStarts(h_ota->hash, h_ota->sign_method);
 
-    if (NULL == (h_ota->ch_fetch = ofc_Init(h_ota->purl))) {
+    ota_checkpoint_restore(h_ota);
+
+    if (NULL == (h_ota->ch_fetch = ofc_Init(h_ota->purl, h_ota->size_fetched, &h_ota->fetch_config))) {
         OTA_LOG_ERROR("Initialize fetch module failed");
         return ;
     }
 
-    h_ota->state = IOT_OTAS_FETCHING;
+    /* the flush stage of a pipeline may be running already */
+    if (NULL != h_ota->pipeline) {
+        HAL_MutexLock(h_ota->pipeline->mutex);
+        h_ota->state = IOT_OTAS_FETCHING;
+        HAL_MutexUnlock(h_ota->pipeline->mutex);
+    } else {
+        h_ota->state = IOT_OTAS_FETCHING;
+    }
 }
 
 
@@ -135,9 +418,9 @@ void *IOT_OTA_Init(const char *product_key, const char *device_name, void *ch_si
         goto do_exit;
     }
 
-    h_ota->md5 = otalib_MD5Init();
-    if (NULL == h_ota->md5) {
-        OTA_LOG_ERROR("initialize md5 failed");
+    h_ota->hash = otalib_HashInit();
+    if (NULL == h_ota->hash) {
+        OTA_LOG_ERROR("initialize hash failed");
         goto do_exit;
     }
 
@@ -152,8 +435,8 @@ do_exit:
         osc_Deinit(h_ota->ch_signal);
     }
 
-    if (NULL != h_ota->md5) {
-        otalib_MD5Deinit(h_ota->md5);
+    if (NULL != h_ota->hash) {
+        otalib_HashDeinit(h_ota->hash);
     }
 
     if (NULL != h_ota) {
@@ -184,7 +467,16 @@ int IOT_OTA_Deinit(void *handle)
 
     osc_Deinit(h_ota->ch_signal);
     ofc_Deinit(h_ota->ch_fetch);
-    otalib_MD5Deinit(h_ota->md5);
+    otalib_HashDeinit(h_ota->hash);
+
+    if (NULL != h_ota->manifest) {
+        OTA_FREE(h_ota->manifest->hashes);
+        OTA_FREE(h_ota->manifest);
+    }
+
+    if (NULL != h_ota->pipeline) {
+        ota_pipeline_release(h_ota->pipeline);
+    }
 
     if (NULL != h_ota->purl) {
         OTA_FREE(h_ota->purl);
@@ -354,11 +646,121 @@ bool IOT_OTA_IsFetchFinish(void *handle)
         return 0;
     }
 
-    return (IOT_OTAS_FETCHED == h_ota->state);
+    /* with a pipeline, the state may be set by the other stage */
+    return (IOT_OTAS_FETCHED == ((NULL != h_ota->pipeline) ? ota_pipeline_state(h_ota) : h_ota->state));
 }
 
 
-int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_ms)
+/* check the block ending at @size_fetched against the manifest */
+/* return 0 if it matches; otherwise, the download goes back to the start of the block */
+static int ota_manifest_check(OTA_Struct_pt h_ota)
+{
+    unsigned char digest[32];
+    OTA_Manifest_pt manifest = h_ota->manifest;
+    uint32_t block = manifest->size_verified / manifest->block_len;
+
+    utils_sha256_finish(&manifest->sha256, digest);
+    utils_sha256_starts(&manifest->sha256);
+
+    if (0 == memcmp(digest, manifest->hashes + block * 32, 32)) {
+        manifest->size_verified = h_ota->size_fetched;
+        manifest->retries = 0;
+        return 0;
+    }
+
+    OTA_LOG_ERROR("block %u does not match the manifest", (unsigned int)block);
+    if (++manifest->retries > OTA_FETCH_RETRY_MAX) {
+        ota_fetch_end(h_ota, IOT_OTAE_CHECK_FAILED);
+        return -1;
+    }
+
+    h_ota->size_fetched = manifest->size_verified;
+    ofc_Seek(h_ota->ch_fetch, manifest->size_verified, 0);
+    return -1;
+}
+
+
+/* the longest wait for data of a call given @timeout_ms */
+static uint32_t ota_read_timeout(OTA_Struct_pt h_ota, uint32_t timeout_ms)
+{
+    return (0 != h_ota->fetch_config.read_timeout_ms) ? h_ota->fetch_config.read_timeout_ms : timeout_ms;
+}
+
+
+/* uptime of the next attempt after failure @retries */
+static uint32_t ota_fetch_backoff(int retries)
+{
+    return HAL_UptimeMs() + ((retries > 1) ? (uint32_t)OTA_FETCH_BACKOFF_MS << (retries - 2) : 0);
+}
+
+
+/* fetch the next bytes of the file, hashing them is up to the caller */
+/* with a manifest, a fetch stops at the end of a block and returns 0 if the block is fetched again */
+static int ota_fetch(OTA_Struct_pt h_ota, char *buf, uint32_t buf_len, uint32_t timeout_ms)
+{
+    int ret;
+    int32_t backoff;
+    uint32_t block_end = 0;
+    OTA_Manifest_pt manifest = h_ota->manifest;
+
+    /* after a failure, wait for the time of the retry, as long as the call may wait */
+    backoff = (h_ota->retries > 0) ? (int32_t)(h_ota->retry_ms - HAL_UptimeMs()) : 0;
+    if (backoff > 0) {
+        HAL_SleepMs(((uint32_t)backoff < timeout_ms) ? (uint32_t)backoff : timeout_ms);
+        if ((int32_t)(h_ota->retry_ms - HAL_UptimeMs()) > 0) {
+            h_ota->size_last_fetched = 0;
+            return 0;
+        }
+    }
+
+    if (NULL != manifest) {
+        block_end = h_ota->size_file - manifest->size_verified > manifest->block_len ?
+                    manifest->size_verified + manifest->block_len : h_ota->size_file;
+        /* the HTTP client keeps a byte of @buf for the '\0' */
+        if (buf_len > block_end - h_ota->size_fetched + 1) {
+            buf_len = block_end - h_ota->size_fetched + 1;
+        }
+    }
+
+    ret = ofc_Fetch(h_ota->ch_fetch, buf, buf_len, ota_read_timeout(h_ota, timeout_ms));
+    if (ret < 0) {
+        if (++h_ota->retries <= OTA_FETCH_RETRY_MAX) {
+            /* a next call asks for the rest of the file on a new connection */
+            OTA_LOG_INFO("Fetch firmware failed, retry %d from %u bytes",
+                         h_ota->retries, (unsigned int)h_ota->size_fetched);
+            h_ota->retry_ms = ota_fetch_backoff(h_ota->retries);
+            h_ota->size_last_fetched = 0;
+            return 0;
+        }
+
+        OTA_LOG_ERROR("Fetch firmware failed");
+        ota_fetch_end(h_ota, IOT_OTAE_FETCH_FAILED);
+        return -1;
+    } else if (ret > 0) {
+        h_ota->retries = 0;
+    }
+
+    if (0 == h_ota->size_fetched) {
+        /* force report status in the first */
+        IOT_OTA_ReportProgress(h_ota, IOT_OTAP_FETCH_PERCENTAGE_MIN, "Enter in downloading state");
+    }
+
+    h_ota->size_last_fetched = ret;
+    h_ota->size_fetched += ret;
+
+    if (NULL != manifest && ret > 0) {
+        utils_sha256_update(&manifest->sha256, (unsigned char *)buf, ret);
+        if (h_ota->size_fetched == block_end && 0 != ota_manifest_check(h_ota)) {
+            h_ota->size_last_fetched = 0;
+            return (IOT_OTAS_FETCHED == h_ota->state) ? -1 : 0;
+        }
+    }
+
+    return ret;
+}
+
+
+int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_s)
 {
     int ret;
     OTA_Struct_pt h_ota = (OTA_Struct_pt) handle;
@@ -368,32 +770,537 @@ int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeo
         return IOT_OTAE_INVALID_PARAM;
     }
 
-    if (IOT_OTAS_FETCHING != h_ota->state) {
+    if (IOT_OTAS_FETCHING != h_ota->state || NULL != h_ota->pipeline) {
         h_ota->err = IOT_OTAE_INVALID_STATE;
         return IOT_OTAE_INVALID_STATE;
     }
 
-    ret = ofc_Fetch(h_ota->ch_fetch, buf, buf_len, timeout_ms);
-    if (ret < 0) {
-        OTA_LOG_ERROR("Fetch firmware failed");
-        h_ota->state = IOT_OTAS_FETCHED;
-        h_ota->err = IOT_OTAE_FETCH_FAILED;
+    ota_checkpoint_save(h_ota, h_ota->size_fetched);
+
+    ret = ota_fetch(h_ota, buf, buf_len, timeout_s * 1000);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    if (NULL == h_ota->manifest) {
+        otalib_HashUpdate(h_ota->hash, buf, ret);
+    }
+
+    if (h_ota->size_fetched >= h_ota->size_file) {
+        ota_fetch_done(h_ota);
+    }
+
+    return ret;
+}
+
+
+int IOT_OTA_PipelineInit(void *handle, const IOT_OTA_Sink_t *sink, uint32_t buf_count, uint32_t buf_len)
+{
+    uint32_t i;
+    OTA_Pipeline_pt pipeline;
+    OTA_Struct_pt h_ota = (OTA_Struct_pt) handle;
+
+    if ((NULL == handle) || (NULL == sink) || (NULL == sink->write) || (0 == buf_count) || (0 == buf_len)) {
+        OTA_LOG_ERROR("invalid parameter");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+
+    if (IOT_OTAS_INITED != h_ota->state || NULL != h_ota->pipeline) {
+        OTA_LOG_ERROR("pipeline must be set once before fetching");
+        h_ota->err = IOT_OTAE_INVALID_STATE;
         return -1;
-    } else if (0 == h_ota->size_fetched) {
-        /* force report status in the first */
-        IOT_OTA_ReportProgress(h_ota, IOT_OTAP_FETCH_PERCENTAGE_MIN, "Enter in downloading state");
     }
 
-    h_ota->size_last_fetched = ret;
-    h_ota->size_fetched += ret;
+    if (NULL == (pipeline = OTA_MALLOC(sizeof(OTA_Pipeline_t)))) {
+        OTA_LOG_ERROR("allocate for pipeline failed");
+        h_ota->err = IOT_OTAE_NOMEM;
+        return -1;
+    }
+    memset(pipeline, 0, sizeof(OTA_Pipeline_t));
+    pipeline->sink = *sink;
+    pipeline->slot_count = buf_count;
+    pipeline->slot_len = buf_len;
+
+    pipeline->mutex = HAL_MutexCreate();
+    pipeline->filled = HAL_SemaphoreCreate();
+    pipeline->flushed = HAL_SemaphoreCreate();
+    pipeline->slots = OTA_MALLOC(buf_count * sizeof(OTA_Slot_t));
+    if (NULL == pipeline->mutex || NULL == pipeline->filled || NULL == pipeline->flushed
+        || NULL == pipeline->slots) {
+        goto do_exit;
+    }
+    memset(pipeline->slots, 0, buf_count * sizeof(OTA_Slot_t));
+
+    for (i = 0; i < buf_count; ++i) {
+        /* the HTTP client keeps a byte for the '\0' after the data */
+        if (NULL == (pipeline->slots[i].buf = OTA_MALLOC(buf_len + 1))) {
+            goto do_exit;
+        }
+    }
+
+    h_ota->pipeline = pipeline;
+    return 0;
+
+do_exit:
+    OTA_LOG_ERROR("allocate for pipeline buffers failed");
+    ota_pipeline_release(pipeline);
+    h_ota->err = IOT_OTAE_NOMEM;
+    return -1;
+}
+
+
+int IOT_OTA_PipelineSegments(void *handle, uint32_t max_connections)
+{
+    uint32_t i;
+    OTA_Segments_t *segments;
+    OTA_Struct_pt h_ota = (OTA_Struct_pt) handle;
+
+    if ((NULL == handle) || (0 == max_connections)) {
+        OTA_LOG_ERROR("invalid parameter");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+
+    if (IOT_OTAS_INITED != h_ota->state || NULL == h_ota->pipeline || NULL != h_ota->pipeline->segments) {
+        OTA_LOG_ERROR("segments must be set once after the pipeline before fetching");
+        h_ota->err = IOT_OTAE_INVALID_STATE;
+        return -1;
+    }
+
+    /* a segment is fetched into a buffer */
+    if (max_connections > h_ota->pipeline->slot_count) {
+        max_connections = h_ota->pipeline->slot_count;
+    }
+
+    if (NULL == (segments = OTA_MALLOC(sizeof(OTA_Segments_t)))) {
+        OTA_LOG_ERROR("allocate for segments failed");
+        h_ota->err = IOT_OTAE_NOMEM;
+        return -1;
+    }
+    memset(segments, 0, sizeof(OTA_Segments_t));
+
+    if (NULL == (segments->conns = OTA_MALLOC(max_connections * sizeof(OTA_Connection_t)))) {
+        OTA_LOG_ERROR("allocate for segments failed");
+        OTA_FREE(segments);
+        h_ota->err = IOT_OTAE_NOMEM;
+        return -1;
+    }
+    memset(segments->conns, 0, max_connections * sizeof(OTA_Connection_t));
+    for (i = 0; i < max_connections; ++i) {
+        segments->conns[i].slot = -1;
+    }
+
+    /* from one connection, the first period tells what a second one brings */
+    segments->max = max_connections;
+    segments->parallel = 1;
+    segments->probing = true;
+
+    h_ota->pipeline->segments = segments;
+    return 0;
+}
+
+
+/* check the blocks of the complete segment in @slot against the manifest */
+/* return 0 if they match */
+static int ota_segment_check(OTA_Struct_pt h_ota, OTA_Slot_t *slot)
+{
+    unsigned char digest[32];
+    uint32_t pos, len, block;
+    OTA_Manifest_pt manifest = h_ota->manifest;
+
+    for (pos = 0; pos < slot->len; pos += len) {
+        len = (slot->len - pos > manifest->block_len) ? manifest->block_len : slot->len - pos;
+        block = (slot->offset + pos) / manifest->block_len;
+
+        utils_sha256((unsigned char *)slot->buf + pos, len, digest);
+        if (0 != memcmp(digest, manifest->hashes + block * 32, 32)) {
+            OTA_LOG_ERROR("block %u does not match the manifest", (unsigned int)block);
+            return -1;
+        }
+    }
+
+    manifest->retries = 0;
+    return 0;
+}
+
+
+/* count @bytes got by the connections in @elapsed_ms, and take a connection more or less */
+static void ota_segments_adapt(OTA_Segments_t *segments, uint32_t bytes, uint32_t elapsed_ms)
+{
+    uint32_t rate;
+
+    segments->period_bytes += bytes;
+    segments->period_ms += elapsed_ms;
+    if (segments->period_ms < OTA_SEGMENT_PERIOD_MS) {
+        return;
+    }
+
+    rate = segments->period_bytes / segments->period_ms * 1000
+           + segments->period_bytes % segments->period_ms * 1000 / segments->period_ms;
+    segments->period_bytes = 0;
+    segments->period_ms = 0;
+    if (0 == rate) {
+        /* the server stalls, that says nothing of the connections */
+        return;
+    }
+    segments->rate = rate;
+
+    if (segments->probing) {
+        if (rate > segments->last_rate
+            && rate - segments->last_rate >= segments->last_rate / 100 * OTA_SEGMENT_GAIN) {
+            /* the connection added brings enough, try one more */
+            if (segments->parallel < segments->max) {
+                segments->last_rate = rate;
+                segments->parallel++;
+                return;
+            }
+            segments->best_rate = rate;
+        } else {
+            /* it does not, back to the connections before */
+            segments->parallel--;
+            segments->best_rate = segments->last_rate;
+        }
+        segments->probing = false;
+        OTA_LOG_INFO("segments on %u connections, %u bytes/s",
+                     (unsigned int)segments->parallel, (unsigned int)segments->best_rate);
+        return;
+    }
+
+    if (rate > segments->best_rate) {
+        segments->best_rate = rate;
+    } else if (rate < segments->best_rate / 100 * OTA_SEGMENT_DROP && segments->parallel < segments->max) {
+        /* the link is not what it was, look for the connections again */
+        segments->last_rate = rate;
+        segments->parallel++;
+        segments->probing = true;
+    }
+}
+
+
+/* Fetch the segments in flight on their connections and hand the ones complete to the flush in the */
+/* order of the file, a free connection takes the next segment into the next free slot */
+/* return the bytes handed, or -1 */
+static int ota_segments_fetch(OTA_Struct_pt h_ota, uint32_t timeout_ms)
+{
+    int ret, done = 0, fetching;
+    int32_t backoff;
+    uint32_t i, count, len, start, now, wait, got = 0;
+    OTA_Slot_t *slot;
+    OTA_Connection_t *conn;
+    OTA_Pipeline_pt pipeline = h_ota->pipeline;
+    OTA_Segments_t *segments = pipeline->segments;
+    OTA_Manifest_pt manifest = h_ota->manifest;
+
+    segments->conns[0].channel = h_ota->ch_fetch;
+    if (0 == segments->inflight) {
+        /* a manifest may have taken the download back to the start of a block */
+        segments->next = h_ota->size_fetched;
+        if (!ota_pipeline_wait(h_ota, false, timeout_ms, &pipeline->stats.fetch)) {
+            return 0;
+        }
+    }
+
+    timeout_ms = ota_read_timeout(h_ota, timeout_ms);
+    start = HAL_UptimeMs();
+    do {
+        HAL_MutexLock(pipeline->mutex);
+        count = pipeline->count;
+        HAL_MutexUnlock(pipeline->mutex);
+
+        for (i = 0; i < segments->parallel && count + segments->inflight < pipeline->slot_count
+             && segments->next < h_ota->size_file; ++i) {
+            conn = &segments->conns[i];
+            if (conn->slot >= 0) {
+                continue;
+            }
+            if (NULL == conn->channel
+                && NULL == (conn->channel = ofc_Init(h_ota->purl, 0, &h_ota->fetch_config))) {
+                continue;
+            }
+
+            /* with a manifest, a segment is of whole blocks */
+            len = pipeline->slot_len;
+            if (NULL != manifest) {
+                len -= len % manifest->block_len;
+            }
+
+            conn->slot = (pipeline->head + segments->inflight) % pipeline->slot_count;
+            conn->retries = 0;
+            slot = &pipeline->slots[conn->slot];
+            slot->offset = segments->next;
+            slot->len = 0;
+            slot->end = (h_ota->size_file - slot->offset > len) ? slot->offset + len : h_ota->size_file;
+            ofc_Seek(conn->channel, slot->offset, slot->end);
+
+            segments->next = slot->end;
+            segments->inflight++;
+        }
+
+        fetching = 0;
+        backoff = 0;
+        for (i = 0; i < segments->max; ++i) {
+            conn = &segments->conns[i];
+            if (conn->slot < 0) {
+                if (i > 0 && i >= segments->parallel && NULL != conn->channel) {
+                    /* a connection given up by ota_segments_adapt() */
+                    ofc_Deinit(conn->channel);
+                    conn->channel = NULL;
+                }
+                continue;
+            }
+            slot = &pipeline->slots[conn->slot];
+
+            /* after a failure, a connection waits for the time of its retry */
+            now = HAL_UptimeMs();
+            if (conn->retries > 0 && (int32_t)(conn->retry_ms - now) > 0) {
+                if (0 == backoff || (int32_t)(conn->retry_ms - now) < backoff) {
+                    backoff = (int32_t)(conn->retry_ms - now);
+                }
+                continue;
+            }
+            ++fetching;
+
+            /* a connection alone waits for its data, several are read in turn */
+            wait = (segments->parallel > 1 || now - start >= timeout_ms) ? 1 : timeout_ms - (now - start);
+
+            ret = ofc_Fetch(conn->channel, slot->buf + slot->len, slot->end - slot->offset - slot->len + 1, wait);
+            if (ret < 0) {
+                if (++conn->retries > OTA_FETCH_RETRY_MAX) {
+                    OTA_LOG_ERROR("Fetch firmware failed");
+                    ota_fetch_end(h_ota, IOT_OTAE_FETCH_FAILED);
+                    return -1;
+                }
+                /* the retry asks for the rest of the segment on a new connection */
+                OTA_LOG_INFO("Fetch segment failed, retry %d from %u bytes",
+                             conn->retries, (unsigned int)(slot->offset + slot->len));
+                conn->retry_ms = ota_fetch_backoff(conn->retries);
+                continue;
+            } else if (ret > 0) {
+                conn->retries = 0;
+            }
+
+            slot->len += ret;
+            got += ret;
+            if (slot->offset + slot->len < slot->end) {
+                continue;
+            }
+
+            if (NULL != manifest && 0 != ota_segment_check(h_ota, slot)) {
+                if (++manifest->retries > OTA_FETCH_RETRY_MAX) {
+                    ota_fetch_end(h_ota, IOT_OTAE_CHECK_FAILED);
+                    return -1;
+                }
+                /* again on a new connection, which may reach another server */
+                slot->len = 0;
+                ofc_Close(conn->channel);
+                ofc_Seek(conn->channel, slot->offset, slot->end);
+                continue;
+            }
+
+            conn->slot = -1;
+        }
+
+        /* the complete slots from @head on go to the flush, a segment is complete once checked */
+        while (segments->inflight > 0) {
+            slot = &pipeline->slots[pipeline->head];
+            if (slot->offset + slot->len < slot->end) {
+                break;
+            }
+
+            if (0 == h_ota->size_fetched) {
+                /* force report status in the first */
+                IOT_OTA_ReportProgress(h_ota, IOT_OTAP_FETCH_PERCENTAGE_MIN, "Enter in downloading state");
+            }
+            h_ota->size_last_fetched = slot->len;
+            h_ota->size_fetched = slot->end;
+            if (NULL != manifest) {
+                manifest->size_verified = slot->end;
+            }
+            segments->inflight--;
+            done += slot->len;
+
+            HAL_MutexLock(pipeline->mutex);
+            pipeline->head = (pipeline->head + 1) % pipeline->slot_count;
+            pipeline->count++;
+            HAL_MutexUnlock(pipeline->mutex);
+            HAL_SemaphorePost(pipeline->filled);
+        }
+
+        /* every connection in use is backing off, sleep instead of spinning */
+        now = HAL_UptimeMs();
+        if (0 == done && 0 == fetching && backoff > 0 && now - start < timeout_ms) {
+            wait = timeout_ms - (now - start);
+            HAL_SleepMs(((uint32_t)backoff < wait) ? (uint32_t)backoff : wait);
+        }
+    } while (0 == done && HAL_UptimeMs() - start < timeout_ms);
+
+    now = HAL_UptimeMs();
+    pipeline->stats.fetch.busy_ms += now - start;
+    pipeline->stats.fetch.bytes += done;
+    ota_segments_adapt(segments, got, now - start);
+
+    return done;
+}
+
+
+int IOT_OTA_PipelineFetch(void *handle, uint32_t timeout_ms)
+{
+    int ret = 0;
+    uint32_t start;
+    OTA_Slot_t *slot;
+    OTA_Pipeline_pt pipeline;
+    IOT_OTA_State_t state;
+    OTA_Struct_pt h_ota = (OTA_Struct_pt) handle;
+
+    if ((NULL == handle) || (NULL == h_ota->pipeline)) {
+        OTA_LOG_ERROR("invalid parameter");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+    pipeline = h_ota->pipeline;
+
+    state = ota_pipeline_state(h_ota);
+    if (IOT_OTAS_FETCHING != state) {
+        /* the error of a download ended by the flush stage is kept */
+        if (IOT_OTAS_FETCHED != state) {
+            h_ota->err = IOT_OTAE_INVALID_STATE;
+        }
+        return IOT_OTAE_INVALID_STATE;
+    }
 
     if (h_ota->size_fetched >= h_ota->size_file) {
-        h_ota->state = IOT_OTAS_FETCHED;
+        return 0;
     }
 
-    otalib_MD5Update(h_ota->md5, buf, ret);
+    if (NULL != pipeline->segments) {
+        return ota_segments_fetch(h_ota, timeout_ms);
+    }
 
-    return ret;
+    if (!ota_pipeline_wait(h_ota, false, timeout_ms, &pipeline->stats.fetch)) {
+        return 0;
+    }
+
+    /* the slot at @head is not seen by the flush stage until @count covers it */
+    slot = &pipeline->slots[pipeline->head];
+    slot->offset = h_ota->size_fetched;
+    slot->len = 0;
+
+    start = HAL_UptimeMs();
+    while (slot->len < pipeline->slot_len && h_ota->size_fetched < h_ota->size_file) {
+        ret = ota_fetch(h_ota, slot->buf + slot->len, pipeline->slot_len - slot->len + 1, timeout_ms);
+        if (ret <= 0) {
+            break;
+        }
+        slot->len += ret;
+    }
+    pipeline->stats.fetch.busy_ms += HAL_UptimeMs() - start;
+    pipeline->stats.fetch.bytes += slot->len;
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    if (slot->len > 0) {
+        HAL_MutexLock(pipeline->mutex);
+        pipeline->head = (pipeline->head + 1) % pipeline->slot_count;
+        pipeline->count++;
+        HAL_MutexUnlock(pipeline->mutex);
+        HAL_SemaphorePost(pipeline->filled);
+    }
+
+    return slot->len;
+}
+
+
+int IOT_OTA_PipelineFlush(void *handle, uint32_t timeout_ms)
+{
+    uint32_t start, end;
+    OTA_Slot_t *slot;
+    OTA_Pipeline_pt pipeline;
+    IOT_OTA_State_t state;
+    OTA_Struct_pt h_ota = (OTA_Struct_pt) handle;
+
+    if ((NULL == handle) || (NULL == h_ota->pipeline)) {
+        OTA_LOG_ERROR("invalid parameter");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+    pipeline = h_ota->pipeline;
+
+    state = ota_pipeline_state(h_ota);
+    if (IOT_OTAS_FETCHING != state) {
+        /* done, or failed in the fetch stage, which set the error before the state */
+        return (IOT_OTAS_FETCHED == state && IOT_OTAE_NONE == h_ota->err) ? 0 : -1;
+    }
+
+    if (!ota_pipeline_wait(h_ota, true, timeout_ms, &pipeline->stats.sink)) {
+        return 0;
+    }
+
+    slot = &pipeline->slots[pipeline->tail];
+
+    start = HAL_UptimeMs();
+    if (NULL == h_ota->manifest) {
+        otalib_HashUpdate(h_ota->hash, slot->buf, slot->len);
+    }
+    end = HAL_UptimeMs();
+    pipeline->stats.hash.busy_ms += end - start;
+    pipeline->stats.hash.bytes += slot->len;
+
+    if (0 != pipeline->sink.write(pipeline->sink.ctx, slot->offset, slot->buf, slot->len)) {
+        OTA_LOG_ERROR("sink write failed");
+        ota_fetch_end(h_ota, IOT_OTAE_SINK_FAILED);
+        return -1;
+    }
+    pipeline->stats.sink.busy_ms += HAL_UptimeMs() - end;
+    pipeline->stats.sink.bytes += slot->len;
+
+    if (slot->offset + slot->len >= h_ota->size_file) {
+        ota_fetch_done(h_ota);
+    } else {
+        ota_checkpoint_save(h_ota, slot->offset + slot->len);
+    }
+
+    HAL_MutexLock(pipeline->mutex);
+    pipeline->tail = (pipeline->tail + 1) % pipeline->slot_count;
+    pipeline->count--;
+    HAL_MutexUnlock(pipeline->mutex);
+    HAL_SemaphorePost(pipeline->flushed);
+
+    return slot->len;
+}
+
+
+/* the stats of the fetch channel, summed over the connections of the segments */
+static void ota_fetch_stats(OTA_Struct_pt h_ota, IOT_OTA_FetchStats_t *stats)
+{
+    uint32_t i, rate;
+    const IOT_OTA_FetchStats_t *conn;
+    OTA_Segments_t *segments = (NULL != h_ota->pipeline) ? h_ota->pipeline->segments : NULL;
+
+    memcpy(stats, ofc_Stats(h_ota->ch_fetch), sizeof(IOT_OTA_FetchStats_t));
+    stats->rate = ofc_Rate(h_ota->ch_fetch);
+    if (NULL == segments) {
+        return;
+    }
+
+    rate = stats->rate;
+    for (i = 1; i < segments->max; ++i) {
+        if (NULL == segments->conns[i].channel) {
+            continue;
+        }
+        conn = ofc_Stats(segments->conns[i].channel);
+        stats->bytes += conn->bytes;
+        stats->busy_ms += conn->busy_ms;
+        stats->connections += conn->connections;
+        stats->requests += conn->requests;
+        stats->connect_ms += conn->connect_ms;
+        stats->timeouts += conn->timeouts;
+        stats->timeout_ms += conn->timeout_ms;
+        stats->stalls += conn->stalls;
+        stats->failures += conn->failures;
+        rate += ofc_Rate(segments->conns[i].channel);
+    }
+    /* the connections run side by side, until a period is measured their rates add up */
+    stats->rate = (0 != segments->rate) ? segments->rate : rate;
+    stats->parallel = segments->parallel;
 }
 
 
@@ -451,11 +1358,15 @@ int IOT_OTA_Ioctl(void *handle, IOT_OTA_CmdType_t type, void *buf, size_t buf_le
                 h_ota->err = IOT_OTAE_INVALID_STATE;
                 OTA_LOG_ERROR("Firmware can be checked in IOT_OTAS_FETCHED state only");
                 return -1;
+            } else if (NULL != h_ota->manifest) {
+                /* every block is checked as it is fetched */
+                *((uint32_t *)buf) = (h_ota->manifest->size_verified == h_ota->size_file) ? 1 : 0;
+                return 0;
             } else {
-                char md5_str[33];
-                otalib_MD5Finalize(h_ota->md5, md5_str);
-                OTA_LOG_DEBUG("origin=%s, now=%s", h_ota->md5sum, md5_str);
-                if (0 == strcmp(h_ota->md5sum, md5_str)) {
+                char digest_str[OTALIB_HASH_STR_LEN];
+                otalib_HashFinalize(h_ota->hash, digest_str);
+                OTA_LOG_DEBUG("origin=%s, now=%s", ota_digest(h_ota), digest_str);
+                if (0 == strcmp(ota_digest(h_ota), digest_str)) {
                     *((uint32_t *)buf) = 1;
                 } else {
                     *((uint32_t *)buf) = 0;
@@ -463,6 +1374,36 @@ int IOT_OTA_Ioctl(void *handle, IOT_OTA_CmdType_t type, void *buf, size_t buf_le
                 return 0;
             }
 
+        case IOT_OTAG_PIPELINE_STATS:
+            if ((sizeof(IOT_OTA_PipelineStats_t) != buf_len) || (NULL == h_ota->pipeline)) {
+                OTA_LOG_ERROR("Invalid parameter");
+                h_ota->err = IOT_OTAE_INVALID_PARAM;
+                return -1;
+            } else {
+                memcpy(buf, &h_ota->pipeline->stats, sizeof(IOT_OTA_PipelineStats_t));
+                return 0;
+            }
+
+        case IOT_OTAG_FETCH_STATS:
+            if (sizeof(IOT_OTA_FetchStats_t) != buf_len || NULL == h_ota->ch_fetch) {
+                OTA_LOG_ERROR("Invalid parameter");
+                h_ota->err = IOT_OTAE_INVALID_PARAM;
+                return -1;
+            } else {
+                ota_fetch_stats(h_ota, (IOT_OTA_FetchStats_t *)buf);
+                return 0;
+            }
+
+        case IOT_OTAG_IS_DIFF:
+            if ((4 != buf_len) || (0 != ((unsigned long)buf & 0x3))) {
+                OTA_LOG_ERROR("Invalid parameter");
+                h_ota->err = IOT_OTAE_INVALID_PARAM;
+                return -1;
+            } else {
+                *((uint32_t *)buf) = h_ota->is_diff ? 1 : 0;
+                return 0;
+            }
+
         default:
             OTA_LOG_ERROR("invalid cmd type");
             h_ota->err = IOT_OTAE_INVALID_PARAM;
@@ -473,6 +1414,121 @@ int IOT_OTA_Ioctl(void *handle, IOT_OTA_CmdType_t type, void *buf, size_t buf_le
 }
 
 
+int IOT_OTA_SetCheckpoint(void *handle, uint32_t interval)
+{
+    OTA_Struct_pt h_ota = (OTA_Struct_pt) handle;
+
+    if (NULL == handle) {
+        OTA_LOG_ERROR("handle is NULL");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+
+    if (IOT_OTAS_INITED != h_ota->state) {
+        OTA_LOG_ERROR("checkpoint must be set before fetching");
+        h_ota->err = IOT_OTAE_INVALID_STATE;
+        return -1;
+    }
+
+    h_ota->checkpoint_interval = interval;
+    return 0;
+}
+
+
+int IOT_OTA_SetFetchConfig(void *handle, const IOT_OTA_FetchConfig_t *config)
+{
+    uint32_t i;
+    OTA_Struct_pt h_ota = (OTA_Struct_pt) handle;
+
+    if ((NULL == handle) || (NULL == config)) {
+        OTA_LOG_ERROR("invalid parameter");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+
+    if (IOT_OTAS_UNINITED == h_ota->state) {
+        h_ota->err = IOT_OTAE_INVALID_STATE;
+        return IOT_OTAE_INVALID_STATE;
+    }
+
+    h_ota->fetch_config = *config;
+    if (NULL != h_ota->ch_fetch) {
+        ofc_Config(h_ota->ch_fetch, config);
+    }
+    if (NULL != h_ota->pipeline && NULL != h_ota->pipeline->segments) {
+        for (i = 1; i < h_ota->pipeline->segments->max; ++i) {
+            if (NULL != h_ota->pipeline->segments->conns[i].channel) {
+                ofc_Config(h_ota->pipeline->segments->conns[i].channel, config);
+            }
+        }
+    }
+    return 0;
+}
+
+
+int IOT_OTA_SetManifest(void *handle, const char *manifest, uint32_t manifest_len,
+                        const IOT_OTA_Verifier_t *verifier)
+{
+    uint32_t block_len, block_count;
+    OTA_Manifest_pt h_manifest;
+    OTA_Struct_pt h_ota = (OTA_Struct_pt) handle;
+
+    if ((NULL == handle) || (NULL == manifest) || (NULL == verifier) || (NULL == verifier->verify)) {
+        OTA_LOG_ERROR("invalid parameter");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+
+    if (IOT_OTAS_FETCHING != h_ota->state || NULL != h_ota->manifest
+        || (NULL != h_ota->pipeline && 0 != h_ota->pipeline->count)
+        || (NULL != h_ota->pipeline && NULL != h_ota->pipeline->segments
+            && 0 != h_ota->pipeline->segments->inflight)) {
+        OTA_LOG_ERROR("manifest must be set once before fetching");
+        h_ota->err = IOT_OTAE_INVALID_STATE;
+        return -1;
+    }
+
+    block_len = otalib_ManifestCheck(manifest, manifest_len, h_ota->size_file, verifier);
+    if (0 == block_len) {
+        h_ota->err = IOT_OTAE_CHECK_FAILED;
+        return -1;
+    }
+
+    if (NULL != h_ota->pipeline && NULL != h_ota->pipeline->segments
+        && block_len > h_ota->pipeline->slot_len) {
+        OTA_LOG_ERROR("a segment must hold a block of %u bytes", (unsigned int)block_len);
+        h_ota->err = IOT_OTAE_INVALID_PARAM;
+        return -1;
+    }
+    block_count = h_ota->size_file / block_len + (0 != h_ota->size_file % block_len);
+
+    if (NULL == (h_manifest = OTA_MALLOC(sizeof(OTA_Manifest_t)))) {
+        OTA_LOG_ERROR("allocate for manifest failed");
+        h_ota->err = IOT_OTAE_NOMEM;
+        return -1;
+    }
+    memset(h_manifest, 0, sizeof(OTA_Manifest_t));
+
+    if (NULL == (h_manifest->hashes = OTA_MALLOC(block_count * 32))) {
+        OTA_LOG_ERROR("allocate for manifest failed");
+        OTA_FREE(h_manifest);
+        h_ota->err = IOT_OTAE_NOMEM;
+        return -1;
+    }
+    memcpy(h_manifest->hashes, manifest + IOT_OTA_MANIFEST_HEADER_LEN, block_count * 32);
+    h_manifest->block_len = block_len;
+    utils_sha256_init(&h_manifest->sha256);
+    utils_sha256_starts(&h_manifest->sha256);
+
+    /* a checkpoint may be in the middle of a block, which is fetched again then */
+    h_manifest->size_verified = h_ota->size_fetched - h_ota->size_fetched % block_len;
+    if (h_ota->size_fetched != h_manifest->size_verified) {
+        h_ota->size_fetched = h_manifest->size_verified;
+        ofc_Seek(h_ota->ch_fetch, h_manifest->size_verified, 0);
+    }
+
+    h_ota->manifest = h_manifest;
+    return 0;
+}
+
+
 /* Get last error code */
 int IOT_OTA_GetLastError(void *handle)
 {
@@ -24,26 +24,109 @@
 
 /* ofc, OTA fetch channel */
 
+#define OFC_HTTP_PORT       (80)
+#define OFC_HTTPS_PORT      (443)
+#define OFC_HEADER_LEN      (160)
+#define OFC_HOST_LEN        (64)
+
+#define OFC_CONNECT_TIMEOUT_MS  (10 * 1000)
+#define OFC_IDLE_TIMEOUT_MS     (30 * 1000)
+#define OFC_READ_TIME_MS        (1000)
+#define OFC_RATE_PERIOD_MS      (500)           /* time of data the rate is measured over */
+#define OFC_READ_LEN_MIN        (1024)
+#define OFC_READ_LEN_MAX        (1024 * 1024)
+
+#define OFC_HEADER_ACCEPT   "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+
+/* a range is of the file as it is, not of a compressed body */
+#define OFC_HEADER_RANGE    "Accept-Encoding: identity\r\nRange: bytes=%u-\r\n"
+#define OFC_HEADER_SEGMENT  "Accept-Encoding: identity\r\nRange: bytes=%u-%u\r\n"
+
 typedef struct {
 
     const char *url;
+    int port;
+    const char *ca_crt;             /* NULL for a "http://" URL */
+    uint32_t offset;                /* bytes of the file got, where the next request starts */
+    uint32_t end;                   /* where the bytes asked for end, 0 at the end of the file */
+    uint32_t skip;                  /* bytes the server sent again because it ignored the range */
+    bool requested;                 /* whether a response is being read on the connection */
+    bool checked;                   /* whether the status of the current response is checked */
+    uint32_t opened_ms;             /* when the current request was sent */
+    uint32_t data_ms;               /* when data last came on it */
+    uint32_t period_bytes;          /* bytes and time of the calls since the rate was measured */
+    uint32_t period_ms;
+    uint32_t read_len;              /* bytes a call asks for from the rate, its buffer may hold less */
+    IOT_OTA_FetchConfig_t config;   /* with the defaults in place of the 0s */
+    IOT_OTA_FetchStats_t stats;
+    char host[OFC_HOST_LEN];
+    char header[OFC_HEADER_LEN];
     httpclient_t http;              /* http client */
     httpclient_data_t http_data;    /* http client data */
 
 }otahttp_Struct_t, *otahttp_Struct_pt;
 
-extern int httpclient_common(httpclient_t *client,
-                             const char *url,
-                             int port,
-                             const char *ca_crt,
-                             int method,
-                             uint32_t timeout_ms,
-                             httpclient_data_t *client_data);
-
 extern const char *iotx_ca_get(void);
 
 
-void *ofc_Init(const char *url)
+/* "http[s]://host[:port][/path]", the port defaults to the one of the scheme */
+/* 0, successful; -1, failed */
+static int ofc_ParseUrl(otahttp_Struct_pt h_odc, const char *url)
+{
+    const char *host, *port, *end;
+
+    if (0 == strncmp(url, "https://", strlen("https://"))) {
+        h_odc->port = OFC_HTTPS_PORT;
+        h_odc->ca_crt = iotx_ca_get();
+    } else if (0 == strncmp(url, "http://", strlen("http://"))) {
+        h_odc->port = OFC_HTTP_PORT;
+        h_odc->ca_crt = NULL;
+    } else {
+        OTA_LOG_ERROR("unsupported scheme of URL");
+        return -1;
+    }
+
+    host = strstr(url, "://") + 3;
+    end = strchr(host, '/');
+    if (NULL == end) {
+        end = host + strlen(host);
+    }
+    port = memchr(host, ':', end - host);
+    if (NULL != port) {
+        h_odc->port = atoi(port + 1);
+        end = port;
+    }
+
+    if (end == host || end - host >= OFC_HOST_LEN) {
+        OTA_LOG_ERROR("invalid host of URL");
+        return -1;
+    }
+    memcpy(h_odc->host, host, end - host);
+    h_odc->host[end - host] = '\0';
+
+    return 0;
+}
+
+
+/* take @config, its 0s for the defaults */
+void ofc_Config(void *handle, const IOT_OTA_FetchConfig_t *config)
+{
+    otahttp_Struct_pt h_odc = (otahttp_Struct_pt)handle;
+    IOT_OTA_FetchConfig_t *c = &h_odc->config;
+
+    memset(c, 0, sizeof(IOT_OTA_FetchConfig_t));
+    if (NULL != config) {
+        *c = *config;
+    }
+    c->connect_timeout_ms = c->connect_timeout_ms ? c->connect_timeout_ms : OFC_CONNECT_TIMEOUT_MS;
+    c->idle_timeout_ms = c->idle_timeout_ms ? c->idle_timeout_ms : OFC_IDLE_TIMEOUT_MS;
+    c->read_time_ms = c->read_time_ms ? c->read_time_ms : OFC_READ_TIME_MS;
+}
+
+
+/* start from @offset of the file when @offset is not 0, with the timeouts of @config, NULL for the
+ * defaults */
+void *ofc_Init(const char *url, uint32_t offset, const IOT_OTA_FetchConfig_t *config)
 {
     otahttp_Struct_pt h_odc;
 
@@ -54,38 +137,278 @@ void *ofc_Init(const char *url)
 
     memset(h_odc, 0, sizeof(otahttp_Struct_t));
 
-    /* set http request-header parameter */
-    h_odc->http.header = "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n" \
-                         "Accept-Encoding: gzip, deflate\r\n";
+    if (0 != ofc_ParseUrl(h_odc, url)) {
+        OTA_FREE(h_odc);
+        return NULL;
+    }
 
     h_odc->url = url;
+    h_odc->offset = offset;
+    h_odc->http.header = h_odc->header;
+    h_odc->read_len = OFC_READ_LEN_MIN;
+    h_odc->stats.parallel = 1;
+    ofc_Config(h_odc, config);
 
     return h_odc;
 }
 
 
-int32_t ofc_Fetch(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_s)
+const IOT_OTA_FetchStats_t *ofc_Stats(void *handle)
+{
+    return &((otahttp_Struct_pt)handle)->stats;
+}
+
+
+/* @bytes in @ms as bytes per second, without overflowing 32 bits */
+static uint32_t ofc_PerSecond(uint32_t bytes, uint32_t ms)
+{
+    return (0 == ms) ? 0 : bytes / ms * 1000 + bytes % ms * 1000 / ms;
+}
+
+
+/* the measured rate, or the average of the fetch calls until a period has completed */
+uint32_t ofc_Rate(void *handle)
+{
+    const IOT_OTA_FetchStats_t *stats = &((otahttp_Struct_pt)handle)->stats;
+
+    if (0 != stats->rate) {
+        return stats->rate;
+    }
+    /* calls quicker than the clock add no busy time, count them as one millisecond */
+    return ofc_PerSecond(stats->bytes, (0 == stats->busy_ms && 0 != stats->bytes) ? 1 : stats->busy_ms);
+}
+
+
+/* Ask for the rest of the file from @offset, or up to @end, with a Range header on the kept */
+/* connection or a new one, so that a fetch failure costs the bytes in flight only. The first one */
+/* takes the file compressed if the HTTP client decodes it, @offset counts the bytes of the file. */
+/* 0, successful; -1, failed */
+static int ofc_Request(otahttp_Struct_pt h_odc)
+{
+    memset(&h_odc->http_data, 0, sizeof(httpclient_data_t));
+    h_odc->http.response_code = 0;
+    h_odc->checked = false;
+    h_odc->skip = 0;
+
+    if (0 != h_odc->end) {
+        HAL_Snprintf(h_odc->header, OFC_HEADER_LEN, "%s" OFC_HEADER_SEGMENT, OFC_HEADER_ACCEPT,
+                     (unsigned int)h_odc->offset, (unsigned int)h_odc->end - 1);
+    } else if (0 != h_odc->offset) {
+        HAL_Snprintf(h_odc->header, OFC_HEADER_LEN, "%s" OFC_HEADER_RANGE, OFC_HEADER_ACCEPT,
+                     (unsigned int)h_odc->offset);
+    } else {
+        HAL_Snprintf(h_odc->header, OFC_HEADER_LEN, "%s", OFC_HEADER_ACCEPT);
+    }
+
+    h_odc->opened_ms = HAL_UptimeMs();
+    h_odc->data_ms = h_odc->opened_ms;
+    h_odc->stats.requests++;
+
+    if (0 == h_odc->http.net.handle) {
+        h_odc->stats.connections++;
+        iotx_net_init(&h_odc->http.net, h_odc->host, h_odc->port, h_odc->ca_crt);
+        if (0 != httpclient_connect(&h_odc->http)) {
+            OTA_LOG_ERROR("connect to %s:%d failed", h_odc->host, h_odc->port);
+            httpclient_close(&h_odc->http);
+            return -1;
+        }
+    }
+
+    if (0 != httpclient_send_request(&h_odc->http, h_odc->url, HTTPCLIENT_GET, &h_odc->http_data)) {
+        OTA_LOG_ERROR("send request failed");
+        httpclient_close(&h_odc->http);
+        return -1;
+    }
+
+    h_odc->requested = true;
+    return 0;
+}
+
+
+/* drop the connection and the response being read on it, the next request is on a new one */
+void ofc_Close(void *handle)
 {
-    int diff;
     otahttp_Struct_pt h_odc = (otahttp_Struct_pt)handle;
 
+    httpclient_close(&h_odc->http);
+    h_odc->requested = false;
+}
+
+
+/* count @len bytes got in @elapsed_ms, and size the next reads from the rate */
+static void ofc_Measure(otahttp_Struct_pt h_odc, uint32_t len, uint32_t elapsed_ms)
+{
+    uint32_t rate, read_len;
+    IOT_OTA_FetchStats_t *stats = &h_odc->stats;
+
+    stats->bytes += len;
+    stats->busy_ms += elapsed_ms;
+
+    h_odc->period_bytes += len;
+    h_odc->period_ms += elapsed_ms;
+    if (h_odc->period_ms < OFC_RATE_PERIOD_MS) {
+        if (0 == stats->rate && len >= h_odc->read_len && h_odc->read_len < OFC_READ_LEN_MAX) {
+            /* no rate yet, the reads grow as long as they are filled */
+            h_odc->read_len *= 2;
+        }
+        return;
+    }
+
+    rate = ofc_PerSecond(h_odc->period_bytes, h_odc->period_ms);
+    stats->rate = (0 == stats->rate) ? rate : (stats->rate + rate) / 2;
+    h_odc->period_bytes = 0;
+    h_odc->period_ms = 0;
+
+    if (stats->rate / 1000 >= OFC_READ_LEN_MAX / h_odc->config.read_time_ms) {
+        read_len = OFC_READ_LEN_MAX;
+    } else {
+        read_len = stats->rate / 1000 * h_odc->config.read_time_ms
+                   + stats->rate % 1000 * h_odc->config.read_time_ms / 1000;
+    }
+    h_odc->read_len = (read_len < OFC_READ_LEN_MIN) ? OFC_READ_LEN_MIN : read_len;
+}
+
+
+/* Fetch the next bytes of the file into @buf, waiting up to @timeout_ms for them. A call without */
+/* data returns 0 and keeps the connection, which is dropped when the head of its response takes */
+/* more than connect_timeout_ms or its body stalls for idle_timeout_ms. A connection is kept after */
+/* a range up to @end, for the next one. */
+int32_t ofc_Fetch(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_ms)
+{
+    int ret;
+    bool headed;
+    uint32_t len, diff;
+    uint32_t start, now, deadline;
+    otahttp_Struct_pt h_odc = (otahttp_Struct_pt)handle;
+
+    if (0 != h_odc->end && h_odc->offset >= h_odc->end) {
+        /* all of the range is got */
+        return 0;
+    }
+
+    if (!h_odc->requested && 0 != ofc_Request(h_odc)) {
+        h_odc->stats.failures++;
+        return -1;
+    }
+
+    start = HAL_UptimeMs();
+
+    /* the call does not wait past the time the connection is given */
+    headed = (0 != h_odc->http.response_code);
+    deadline = headed ? h_odc->data_ms + h_odc->config.idle_timeout_ms
+               : h_odc->opened_ms + h_odc->config.connect_timeout_ms;
+    if ((int32_t)(deadline - start) < (int32_t)timeout_ms) {
+        timeout_ms = ((int32_t)(deadline - start) > 0) ? deadline - start : 0;
+    }
+
+    /* the HTTP client keeps a byte of @buf for the '\0' */
+    if (buf_len > h_odc->read_len + 1) {
+        buf_len = h_odc->read_len + 1;
+    }
+    h_odc->stats.read_len = (buf_len > 0) ? buf_len - 1 : 0;
     h_odc->http_data.response_buf = buf;
     h_odc->http_data.response_buf_len = buf_len;
-    diff = h_odc->http_data.response_content_len - h_odc->http_data.retrieve_len;;
 
-    if (0 != httpclient_common(&h_odc->http, h_odc->url, 443, iotx_ca_get(), HTTPCLIENT_GET, timeout_s * 1000, &h_odc->http_data)){
+    ret = httpclient_recv_response(&h_odc->http, timeout_ms, &h_odc->http_data);
+    now = HAL_UptimeMs();
+    if (ret < 0 && ERROR_HTTP_TIMEOUT != ret) {
         OTA_LOG_ERROR("fetch firmware failed");
+        ofc_Close(h_odc);
+        h_odc->stats.failures++;
         return -1;
     }
 
-    return h_odc->http_data.response_content_len - h_odc->http_data.retrieve_len - diff;
+    len = (ret < 0) ? 0 : (uint32_t)h_odc->http_data.response_data_len;
+    if (!headed && 0 != h_odc->http.response_code) {
+        h_odc->stats.connect_ms += now - h_odc->opened_ms;
+        h_odc->data_ms = now;
+    }
+    if (len > 0) {
+        h_odc->data_ms = now;
+    } else {
+        h_odc->stats.timeouts++;
+        h_odc->stats.timeout_ms += now - start;
+    }
+    if (0 != h_odc->http.response_code) {
+        ofc_Measure(h_odc, len, now - start);
+    }
+
+    if (0 == h_odc->http.response_code && now - h_odc->opened_ms >= h_odc->config.connect_timeout_ms) {
+        OTA_LOG_ERROR("no response in %u ms", (unsigned int)h_odc->config.connect_timeout_ms);
+        ofc_Close(h_odc);
+        h_odc->stats.failures++;
+        return -1;
+    }
+    if (0 == len && now - h_odc->data_ms >= h_odc->config.idle_timeout_ms) {
+        OTA_LOG_ERROR("no data for %u ms", (unsigned int)h_odc->config.idle_timeout_ms);
+        ofc_Close(h_odc);
+        h_odc->stats.stalls++;
+        return -1;
+    }
+
+    if (!h_odc->checked && 0 != h_odc->http.response_code) {
+        h_odc->checked = true;
+
+        if (200 == h_odc->http.response_code) {
+            /* the whole file again, drop what was got already */
+            h_odc->skip = h_odc->offset;
+        } else if (206 != h_odc->http.response_code || (0 == h_odc->offset && 0 == h_odc->end)) {
+            OTA_LOG_ERROR("unexpected response code %d", h_odc->http.response_code);
+            ofc_Close(h_odc);
+            h_odc->stats.failures++;
+            return -1;
+        }
+    }
+
+    if (h_odc->skip > 0) {
+        diff = (h_odc->skip < len) ? h_odc->skip : len;
+        memmove(buf, buf + diff, len - diff);
+        h_odc->skip -= diff;
+        len -= diff;
+    }
+
+    if (0 != h_odc->end && len > h_odc->end - h_odc->offset) {
+        /* the server sent more than the range */
+        len = h_odc->end - h_odc->offset;
+    }
+    h_odc->offset += len;
+
+    if (!h_odc->http_data.is_more) {
+        /* the end of the response, the connection is kept for the next range */
+        h_odc->requested = false;
+        if (0 == h_odc->end || h_odc->http.is_closing) {
+            httpclient_close(&h_odc->http);
+        }
+    } else if (0 != h_odc->end && h_odc->offset >= h_odc->end) {
+        /* the rest of a response longer than the range is not wanted */
+        ofc_Close(h_odc);
+    }
+
+    return (int32_t)len;
+}
+
+
+/* the next request starts at @offset and ends at @end, 0 for the end of the file, the response */
+/* being read is dropped with its connection */
+void ofc_Seek(void *handle, uint32_t offset, uint32_t end)
+{
+    otahttp_Struct_pt h_odc = (otahttp_Struct_pt)handle;
+
+    if (h_odc->requested) {
+        ofc_Close(h_odc);
+    }
+    h_odc->offset = offset;
+    h_odc->end = end;
 }
 
 
 int ofc_Deinit(void *handle)
 {
-    if (NULL != handle) {
-        OTA_FREE(handle);
+    otahttp_Struct_pt h_odc = (otahttp_Struct_pt)handle;
+
+    if (NULL != h_odc) {
+        httpclient_close(&h_odc->http);
+        OTA_FREE(h_odc);
     }
 
     return 0;
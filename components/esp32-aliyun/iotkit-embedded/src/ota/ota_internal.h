@@ -23,4 +23,9 @@
 
 typedef void (*ota_cb_fpt)(void *pcontext, const char *msg, uint32_t msg_len);
 
+/* methods of the hash of the whole file, "signMethod" of the upgrade message */
+#define OTALIB_HASH_MD5         (0)
+#define OTALIB_HASH_SHA256      (1)
+#define OTALIB_HASH_STR_LEN     (65)    /* hex digest of SHA-256 and its '\0' */
+
 #endif /* _OTA_INTERNAL_H_ */
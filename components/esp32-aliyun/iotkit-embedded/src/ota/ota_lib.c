@@ -22,82 +22,134 @@
 #define _OTA_LIB_C_
 
 #include <stdio.h>
+#include <ctype.h>
 #include "iot_export_ota.h"
 #include "iot_import_ota.h"
 #include "ota_internal.h"
 
 
-static const char *otalib_JsonValueOf(const char *json, uint32_t json_len, const char *key, uint32_t *val_len)
+/* the most keys read from one message, the paths live on the stack of the MQTT callback */
+#define OTALIB_JSON_KEYS_MAX    (8)
+
+/* Resolve the dotted @keys in @json in one pass, see LITE_json_path_extract() */
+/* return the number of keys found, -1 if @json is not an object or @count is too large */
+static int otalib_JsonValuesOf(const char *json, uint32_t json_len, const char *keys[], int count,
+                               lite_json_slice_t *values)
 {
-    int length;
-    const char *val;
-    val = json_get_value_by_name((char *)json, json_len, (char *)key, &length, NULL);
-    if (NULL != val) {
-        *val_len = (uint32_t) length;
+    lite_json_path_t paths[OTALIB_JSON_KEYS_MAX];
+    int i, found;
+
+    if (count > OTALIB_JSON_KEYS_MAX) {
+        OTA_LOG_ERROR("%d keys, at most %d", count, OTALIB_JSON_KEYS_MAX);
+        return -1;
     }
-    return val;
+
+    for (i = 0; i < count; ++i) {
+        if (0 != LITE_json_path_compile(&paths[i], keys[i])) {
+            return -1;
+        }
+    }
+
+    found = LITE_json_path_extract(json, json_len, paths, count, values);
+    return (found < 0) ? -1 : found;
 }
 
-static void *otalib_MD5Init(void)
+/* Hash of the whole file, MD5 unless the upgrade message gives another sign method */
+typedef struct {
+    int method;                 /* OTALIB_HASH_MD5 or OTALIB_HASH_SHA256 */
+    union {
+        iot_md5_context md5;
+        iot_sha256_context sha256;
+    } ctx;
+} otalib_Hash_t;
+
+static void *otalib_HashInit(void)
 {
-    iot_md5_context *ctx = OTA_MALLOC(sizeof(iot_md5_context));
-    if (NULL == ctx) {
+    otalib_Hash_t *hash = OTA_MALLOC(sizeof(otalib_Hash_t));
+    if (NULL == hash) {
         return NULL;
     }
 
-    utils_md5_init(ctx);
-    utils_md5_starts(ctx);
+    hash->method = OTALIB_HASH_MD5;
+    utils_md5_init(&hash->ctx.md5);
+    utils_md5_starts(&hash->ctx.md5);
 
-    return ctx;
+    return hash;
 }
 
-static void otalib_MD5Update(void *md5, const char *buf, size_t buf_len)
+/* start again with @method */
+static void otalib_HashStarts(void *hash, int method)
 {
-    utils_md5_update(md5, (unsigned char *)buf, buf_len);
+    otalib_Hash_t *h = (otalib_Hash_t *)hash;
+
+    h->method = method;
+    if (OTALIB_HASH_SHA256 == method) {
+        utils_sha256_init(&h->ctx.sha256);
+        utils_sha256_starts(&h->ctx.sha256);
+    } else {
+        utils_md5_init(&h->ctx.md5);
+        utils_md5_starts(&h->ctx.md5);
+    }
 }
 
-static void otalib_MD5Finalize(void *md5, char *output_str)
+static void otalib_HashUpdate(void *hash, const char *buf, size_t buf_len)
 {
-    int i;
-    unsigned char buf_out[16];
-    utils_md5_finish(md5, buf_out);
+    otalib_Hash_t *h = (otalib_Hash_t *)hash;
 
-    for (i = 0; i < 16; ++i) {
+    if (OTALIB_HASH_SHA256 == h->method) {
+        utils_sha256_update(&h->ctx.sha256, (unsigned char *)buf, buf_len);
+    } else {
+        utils_md5_update(&h->ctx.md5, (unsigned char *)buf, buf_len);
+    }
+}
+
+/* @output_str gets the digest in lowercase hex, OTALIB_HASH_STR_LEN bytes at most */
+static void otalib_HashFinalize(void *hash, char *output_str)
+{
+    int i, len;
+    unsigned char buf_out[32];
+    otalib_Hash_t *h = (otalib_Hash_t *)hash;
+
+    if (OTALIB_HASH_SHA256 == h->method) {
+        utils_sha256_finish(&h->ctx.sha256, buf_out);
+        len = 32;
+    } else {
+        utils_md5_finish(&h->ctx.md5, buf_out);
+        len = 16;
+    }
+
+    for (i = 0; i < len; ++i) {
         output_str[i * 2] = utils_hb2hex(buf_out[i] >> 4);
         output_str[i * 2 + 1] = utils_hb2hex(buf_out[i]);
     }
-    output_str[32] = '\0';
+    output_str[len * 2] = '\0';
 }
 
-static void otalib_MD5Deinit(void *md5)
+static void otalib_HashDeinit(void *hash)
 {
-    if (NULL != md5) {
-        OTA_FREE(md5);
+    if (NULL != hash) {
+        OTA_FREE(hash);
     }
 }
 
-/* Get the specific @key value, and copy to @dest */
+/* Copy the specific @key value to @dest */
 /* 0, successful; -1, failed */
-static int otalib_GetFirmwareFixlenPara(const char *json_doc,
-                                        size_t json_doc_len,
+static int otalib_GetFirmwareFixlenPara(const lite_json_slice_t *value,
                                         const char *key,
                                         char *dest,
                                         size_t dest_len)
 {
-    const char *pvalue;
-    uint32_t val_len;
-
-    if (NULL == (pvalue = otalib_JsonValueOf(json_doc, json_doc_len, key, &val_len))) {
+    if (NULL == value->value) {
         OTA_LOG_ERROR("Not '%s' key in json doc of OTA", key);
         return -1;
     }
 
-    if (val_len > dest_len) {
+    if (value->len > dest_len) {
         OTA_LOG_ERROR("value length of the key is too long");
         return -1;
     }
 
-    memcpy(dest, pvalue, val_len);
+    memcpy(dest, value->value, value->len);
 
     return 0;
 }
@@ -105,83 +157,153 @@ static int otalib_GetFirmwareFixlenPara(const char *json_doc,
 
 /* Get variant length parameter of firmware, and copy to @dest */
 /* 0, successful; -1, failed */
-static int otalib_GetFirmwareVarlenPara(const char *json_doc,
-                                        size_t json_doc_len,
+static int otalib_GetFirmwareVarlenPara(const lite_json_slice_t *value,
                                         const char *key,
                                         char **dest)
 {
-    const char *pvalue;
-    uint32_t val_len;
-
-    if (NULL == (pvalue = otalib_JsonValueOf(json_doc, json_doc_len, key, &val_len))) {
+    if (NULL == value->value) {
         OTA_LOG_ERROR("Not %s key in json doc of OTA", key);
         return -1;
     }
 
-    if (NULL == (*dest = OTA_MALLOC(val_len + 1))) {
+    if (NULL == (*dest = OTA_MALLOC(value->len + 1))) {
         OTA_LOG_ERROR("allocate for dest failed");
         return -1;
     }
 
-    memcpy(*dest, pvalue, val_len);
-    (*dest)[val_len] = '\0';
+    memcpy(*dest, value->value, value->len);
+    (*dest)[value->len] = '\0';
 
     return 0;
 }
 
 
+/* @md5 is not required when "signMethod" is "SHA256", @sign gets the SHA-256 then */
 int otalib_GetParams(const char *json_doc, uint32_t json_len, char **url, char **version, char *md5,
-                     uint32_t *file_size)
+                     int *sign_method, char *sign, int *is_diff, uint32_t *file_size)
 {
 #define OTA_FILESIZE_STR_LEN    (16)
+    static const char *keys[] = { "version", "url", "md5", "size", "signMethod", "sign", "isDiff" };
+    lite_json_slice_t values[7];
     char file_size_str[OTA_FILESIZE_STR_LEN + 1];
+    int i;
+
+    if (otalib_JsonValuesOf(json_doc, json_len, keys, 7, values) < 0) {
+        OTA_LOG_ERROR("invalid json doc of firmware");
+        return -1;
+    }
 
     /* get version */
-    if (0 != otalib_GetFirmwareVarlenPara(json_doc, json_len, "version", version)) {
+    if (0 != otalib_GetFirmwareVarlenPara(&values[0], keys[0], version)) {
         OTA_LOG_ERROR("get value of version key failed");
         return -1;
     }
 
     /* get URL */
-    if (0 != otalib_GetFirmwareVarlenPara(json_doc, json_len, "url", url)) {
+    if (0 != otalib_GetFirmwareVarlenPara(&values[1], keys[1], url)) {
         OTA_LOG_ERROR("get value of url key failed");
         return -1;
     }
 
+    /* get sign method, MD5 if not given */
+    *sign_method = OTALIB_HASH_MD5;
+    if (NULL != values[4].value && strlen("SHA256") == values[4].len
+        && 0 == strncmp(values[4].value, "SHA256", values[4].len)) {
+        *sign_method = OTALIB_HASH_SHA256;
+
+        if (0 != otalib_GetFirmwareFixlenPara(&values[5], keys[5], sign, OTALIB_HASH_STR_LEN - 1)) {
+            OTA_LOG_ERROR("get value of sign key failed");
+            return -1;
+        }
+        for (i = 0; '\0' != sign[i]; ++i) {
+            sign[i] = tolower((unsigned char)sign[i]);
+        }
+    }
+
     /* get md5 */
-    if (0 != otalib_GetFirmwareFixlenPara(json_doc, json_len, "md5", md5, 32)) {
+    if ((OTALIB_HASH_MD5 == *sign_method || NULL != values[2].value)
+        && 0 != otalib_GetFirmwareFixlenPara(&values[2], keys[2], md5, 32)) {
         OTA_LOG_ERROR("get value of md5 key failed");
         return -1;
     }
 
     /* get file size */
-    if (0 != otalib_GetFirmwareFixlenPara(json_doc, json_len, "size", file_size_str, OTA_FILESIZE_STR_LEN)) {
+    memset(file_size_str, 0, sizeof(file_size_str));
+    if (0 != otalib_GetFirmwareFixlenPara(&values[3], keys[3], file_size_str, OTA_FILESIZE_STR_LEN)) {
         OTA_LOG_ERROR("get value of size key failed");
         return -1;
     }
     file_size_str[OTA_FILESIZE_STR_LEN] = '\0';
     *file_size = atoi(file_size_str);
 
+    /* a patch of the running firmware, the whole firmware if not given */
+    *is_diff = (NULL != values[6].value && 1 == values[6].len && '1' == values[6].value[0]);
+
     return 0;
 
 #undef OTA_FILESIZE_STR_LEN
 }
 
 
+/* Check the manifest of @file_size bytes of firmware, see IOT_OTA_SetManifest() */
+/* return the block length, 0 if it is invalid or its signature is not verified */
+static uint32_t otalib_ManifestCheck(const char *manifest, uint32_t manifest_len, uint32_t file_size,
+                                     const IOT_OTA_Verifier_t *verifier)
+{
+    const unsigned char *p = (const unsigned char *)manifest;
+    unsigned char digest[32];
+    uint32_t block_len, size, block_count, signed_len;
+
+    if (manifest_len < IOT_OTA_MANIFEST_HEADER_LEN
+        || 0 != memcmp(manifest, IOT_OTA_MANIFEST_MAGIC, strlen(IOT_OTA_MANIFEST_MAGIC))) {
+        OTA_LOG_ERROR("not a manifest");
+        return 0;
+    }
+
+    block_len = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+    size = ((uint32_t)p[8] << 24) | ((uint32_t)p[9] << 16) | ((uint32_t)p[10] << 8) | p[11];
+    if (0 == block_len || size != file_size) {
+        OTA_LOG_ERROR("manifest is not of this firmware");
+        return 0;
+    }
+
+    block_count = size / block_len + (0 != size % block_len);
+    if (block_count > (manifest_len - IOT_OTA_MANIFEST_HEADER_LEN) / 32) {
+        OTA_LOG_ERROR("manifest is truncated");
+        return 0;
+    }
+    signed_len = IOT_OTA_MANIFEST_HEADER_LEN + block_count * 32;
+
+    utils_sha256(p, signed_len, digest);
+    if (0 != verifier->verify(verifier->ctx, digest, manifest + signed_len, manifest_len - signed_len)) {
+        OTA_LOG_ERROR("signature of manifest is not verified");
+        return 0;
+    }
+
+    return block_len;
+}
+
+
 /* Generate firmware information according to @id, @version */
 /* and then copy to @buf. */
 /* 0, successful; -1, failed */
 int otalib_GenInfoMsg(char *buf, size_t buf_len, uint32_t id, const char *version)
 {
-    int ret;
-    ret = HAL_Snprintf(buf,
-                       buf_len,
-                       "{\"id\":%d,\"params\":{\"version\":\"%s\"}}",
-                       id,
-                       version);
-
-    if (ret < 0) {
-        OTA_LOG_ERROR("HAL_Snprintf failed");
+    lite_json_writer_t writer;
+
+    LITE_json_writer_init(&writer, buf, buf_len);
+    LITE_json_put_object(&writer);
+    LITE_json_put_key(&writer, "id", strlen("id"));
+    LITE_json_put_uint(&writer, id);
+    LITE_json_put_key(&writer, "params", strlen("params"));
+    LITE_json_put_object(&writer);
+    LITE_json_put_key(&writer, "version", strlen("version"));
+    LITE_json_put_string(&writer, version, strlen(version));
+    LITE_json_put_object_end(&writer);
+    LITE_json_put_object_end(&writer);
+
+    if ((LITE_json_writer_finish(&writer) < 0) || (writer.len >= buf_len)) {
+        OTA_LOG_ERROR("msg is too long");
         return -1;
     }
 
@@ -194,27 +316,26 @@ int otalib_GenInfoMsg(char *buf, size_t buf_len, uint32_t id, const char *versio
 /* 0, successful; -1, failed */
 int otalib_GenReportMsg(char *buf, size_t buf_len, uint32_t id, int progress, const char *msg_detail)
 {
-    int ret;
-    if (NULL == msg_detail) {
-        ret = HAL_Snprintf(buf,
-                           buf_len,
-                           "{\"id\":%d,\"params\": {\"step\": \"%d\"}}",
-                           id,
-                           progress);
-    } else {
-        ret = HAL_Snprintf(buf,
-                           buf_len,
-                           "{\"id\":%d,\"params\": {\"step\": \"%d\",\"desc\":\"%s\"}}",
-                           id,
-                           progress,
-                           msg_detail);
+    char step[LITE_JSON_INT_LEN];
+    lite_json_writer_t writer;
+
+    LITE_json_writer_init(&writer, buf, buf_len);
+    LITE_json_put_object(&writer);
+    LITE_json_put_key(&writer, "id", strlen("id"));
+    LITE_json_put_uint(&writer, id);
+    LITE_json_put_key(&writer, "params", strlen("params"));
+    LITE_json_put_object(&writer);
+    /* the step goes as a string */
+    LITE_json_put_key(&writer, "step", strlen("step"));
+    LITE_json_put_string(&writer, step, LITE_json_format_int(step, progress));
+    if (NULL != msg_detail) {
+        LITE_json_put_key(&writer, "desc", strlen("desc"));
+        LITE_json_put_string(&writer, msg_detail, strlen(msg_detail));
     }
+    LITE_json_put_object_end(&writer);
+    LITE_json_put_object_end(&writer);
 
-
-    if (ret < 0) {
-        OTA_LOG_ERROR("HAL_Snprintf failed");
-        return -1;
-    } else if (ret >= buf_len) {
+    if ((LITE_json_writer_finish(&writer) < 0) || (writer.len >= buf_len)) {
         OTA_LOG_ERROR("msg is too long");
         return IOT_OTAE_STR_TOO_LONG;
     }
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef __OTA_PATCH_C_H__
+#define __OTA_PATCH_C_H__
+
+#include <string.h>
+#include "iot_import_ota.h"
+#include "iot_export_ota.h"
+
+/* Streaming patcher of delta firmware, see IOT_OTA_PatchInit() for the format */
+
+#define OTA_PATCH_OP_END        (0)
+#define OTA_PATCH_OP_COPY       (1)
+#define OTA_PATCH_OP_INSERT     (2)
+#define OTA_PATCH_OP_LEN_MAX    (11)    /* an op and two varints of 5 bytes */
+
+typedef enum {
+    OTA_PATCH_HEADER,           /* getting the header */
+    OTA_PATCH_OP,               /* getting an op */
+    OTA_PATCH_INSERT,           /* getting the bytes of an insert */
+    OTA_PATCH_END,              /* the end op got */
+    OTA_PATCH_FAILED
+} OTA_PatchState_t;
+
+typedef struct {
+    IOT_OTA_Source_t source;
+    IOT_OTA_Sink_t sink;
+    char *buf;                  /* copies from the running firmware go through it */
+    uint32_t buf_len;
+    OTA_PatchState_t state;
+    unsigned char header[IOT_OTA_PATCH_HEADER_LEN];
+    unsigned char op[OTA_PATCH_OP_LEN_MAX];
+    uint32_t op_len;            /* bytes of @header or @op got */
+    uint32_t offset;            /* bytes of the patch got */
+    uint32_t size_old;
+    uint32_t size_new;
+    uint32_t size_written;      /* bytes of the new firmware written */
+    uint32_t pos_old;           /* end of the last copy in the running firmware */
+    uint32_t insert_len;        /* bytes of the current insert not got yet */
+    iot_sha256_context sha256;  /* SHA-256 of the new firmware so far */
+} OTA_Patch_t, *OTA_Patch_pt;
+
+
+static uint32_t ota_patch_uint32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+
+/* decode an unsigned LEB128 varint of 32 bits */
+/* return the bytes of it, 0 if more are needed, -1 if it is invalid */
+static int ota_patch_varint(const unsigned char *p, uint32_t len, uint32_t *value)
+{
+    uint32_t i;
+
+    *value = 0;
+    for (i = 0; i < len && i < 5; ++i) {
+        *value |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+        if (0 == (p[i] & 0x80)) {
+            return (4 == i && p[i] > 0x0F) ? -1 : (int)(i + 1);
+        }
+    }
+
+    return (i < 5) ? 0 : -1;
+}
+
+
+static int ota_patch_output(OTA_Patch_pt h_patch, const char *buf, uint32_t len)
+{
+    if (0 != h_patch->sink.write(h_patch->sink.ctx, h_patch->size_written, buf, len)) {
+        OTA_LOG_ERROR("write new firmware failed");
+        return IOT_OTAE_SINK_FAILED;
+    }
+
+    utils_sha256_update(&h_patch->sha256, (const unsigned char *)buf, len);
+    h_patch->size_written += len;
+    return 0;
+}
+
+
+/* the header is got, check that the running firmware is the one the patch is made from */
+static int ota_patch_start(OTA_Patch_pt h_patch)
+{
+    iot_sha256_context sha256;
+    unsigned char digest[32];
+    uint32_t pos, len;
+    int ret = 0;
+
+    if (0 != memcmp(h_patch->header, IOT_OTA_PATCH_MAGIC, strlen(IOT_OTA_PATCH_MAGIC))) {
+        OTA_LOG_ERROR("not a patch");
+        return IOT_OTAE_CHECK_FAILED;
+    }
+    h_patch->size_old = ota_patch_uint32(h_patch->header + 4);
+    h_patch->size_new = ota_patch_uint32(h_patch->header + 8);
+
+    utils_sha256_init(&sha256);
+    utils_sha256_starts(&sha256);
+    for (pos = 0; pos < h_patch->size_old; pos += len) {
+        len = h_patch->size_old - pos;
+        len = (len < h_patch->buf_len) ? len : h_patch->buf_len;
+        if (0 != h_patch->source.read(h_patch->source.ctx, pos, h_patch->buf, len)) {
+            OTA_LOG_ERROR("read running firmware failed");
+            ret = IOT_OTAE_GENERAL;
+            break;
+        }
+        utils_sha256_update(&sha256, (const unsigned char *)h_patch->buf, len);
+    }
+    utils_sha256_finish(&sha256, digest);
+    utils_sha256_free(&sha256);
+
+    if (0 == ret && 0 != memcmp(digest, h_patch->header + 12, 32)) {
+        OTA_LOG_ERROR("patch is not made from the running firmware");
+        ret = IOT_OTAE_CHECK_FAILED;
+    }
+
+    return ret;
+}
+
+
+/* copy @len bytes of the running firmware from @pos_old adjusted by the zigzag encoded @delta */
+static int ota_patch_copy(OTA_Patch_pt h_patch, uint32_t delta, uint32_t len)
+{
+    uint32_t pos, n;
+    int ret;
+
+    pos = h_patch->pos_old + ((delta >> 1) ^ (0 - (delta & 1)));
+    if (pos > h_patch->size_old || len > h_patch->size_old - pos
+        || len > h_patch->size_new - h_patch->size_written) {
+        OTA_LOG_ERROR("copy out of range");
+        return IOT_OTAE_CHECK_FAILED;
+    }
+
+    h_patch->pos_old = pos + len;
+    for (; len > 0; pos += n, len -= n) {
+        n = (len < h_patch->buf_len) ? len : h_patch->buf_len;
+        if (0 != h_patch->source.read(h_patch->source.ctx, pos, h_patch->buf, n)) {
+            OTA_LOG_ERROR("read running firmware failed");
+            return IOT_OTAE_GENERAL;
+        }
+        if (0 != (ret = ota_patch_output(h_patch, h_patch->buf, n))) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+
+/* an op byte is got, run the op once its arguments are all got */
+static int ota_patch_op(OTA_Patch_pt h_patch)
+{
+    uint32_t args[2];
+    int i, n, len = 1;
+    int arg_count = (OTA_PATCH_OP_COPY == h_patch->op[0]) ? 2 : (OTA_PATCH_OP_INSERT == h_patch->op[0]);
+
+    if (h_patch->op[0] > OTA_PATCH_OP_INSERT) {
+        OTA_LOG_ERROR("invalid op %u of patch", (unsigned int)h_patch->op[0]);
+        return IOT_OTAE_CHECK_FAILED;
+    }
+
+    for (i = 0; i < arg_count; ++i, len += n) {
+        n = ota_patch_varint(h_patch->op + len, h_patch->op_len - len, &args[i]);
+        if (n < 0) {
+            OTA_LOG_ERROR("invalid varint of patch");
+            return IOT_OTAE_CHECK_FAILED;
+        } else if (0 == n) {
+            return 0;
+        }
+    }
+    h_patch->op_len = 0;
+
+    switch (h_patch->op[0]) {
+        case OTA_PATCH_OP_COPY:
+            return ota_patch_copy(h_patch, args[0], args[1]);
+
+        case OTA_PATCH_OP_INSERT:
+            if (args[0] > h_patch->size_new - h_patch->size_written) {
+                OTA_LOG_ERROR("insert out of range");
+                return IOT_OTAE_CHECK_FAILED;
+            }
+            h_patch->insert_len = args[0];
+            h_patch->state = (args[0] > 0) ? OTA_PATCH_INSERT : OTA_PATCH_OP;
+            return 0;
+
+        default:
+            h_patch->state = OTA_PATCH_END;
+            return 0;
+    }
+}
+
+
+void *IOT_OTA_PatchInit(const IOT_OTA_Source_t *source, const IOT_OTA_Sink_t *sink, uint32_t buf_len)
+{
+    OTA_Patch_pt h_patch;
+
+    if ((NULL == source) || (NULL == source->read) || (NULL == sink) || (NULL == sink->write)
+        || (0 == buf_len)) {
+        OTA_LOG_ERROR("invalid parameter");
+        return NULL;
+    }
+
+    if (NULL == (h_patch = OTA_MALLOC(sizeof(OTA_Patch_t)))) {
+        OTA_LOG_ERROR("allocate for patch failed");
+        return NULL;
+    }
+    memset(h_patch, 0, sizeof(OTA_Patch_t));
+
+    if (NULL == (h_patch->buf = OTA_MALLOC(buf_len))) {
+        OTA_LOG_ERROR("allocate for patch failed");
+        OTA_FREE(h_patch);
+        return NULL;
+    }
+
+    h_patch->source = *source;
+    h_patch->sink = *sink;
+    h_patch->buf_len = buf_len;
+    h_patch->state = OTA_PATCH_HEADER;
+    utils_sha256_init(&h_patch->sha256);
+    utils_sha256_starts(&h_patch->sha256);
+
+    return h_patch;
+}
+
+
+int IOT_OTA_PatchWrite(void *handle, uint32_t offset, const char *buf, uint32_t len)
+{
+    OTA_Patch_pt h_patch = (OTA_Patch_pt) handle;
+    uint32_t n;
+    int ret = 0;
+
+    if ((NULL == handle) || ((NULL == buf) && (0 != len))) {
+        OTA_LOG_ERROR("invalid parameter");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+
+    if (OTA_PATCH_FAILED == h_patch->state) {
+        return IOT_OTAE_INVALID_STATE;
+    }
+
+    if (offset != h_patch->offset) {
+        OTA_LOG_ERROR("patch must be written in order");
+        h_patch->state = OTA_PATCH_FAILED;
+        return IOT_OTAE_INVALID_PARAM;
+    }
+    h_patch->offset += len;
+
+    while (len > 0 && 0 == ret) {
+        switch (h_patch->state) {
+            case OTA_PATCH_HEADER:
+                n = IOT_OTA_PATCH_HEADER_LEN - h_patch->op_len;
+                n = (len < n) ? len : n;
+                memcpy(h_patch->header + h_patch->op_len, buf, n);
+                h_patch->op_len += n;
+                if (IOT_OTA_PATCH_HEADER_LEN == h_patch->op_len) {
+                    h_patch->op_len = 0;
+                    h_patch->state = OTA_PATCH_OP;
+                    ret = ota_patch_start(h_patch);
+                }
+                break;
+
+            case OTA_PATCH_OP:
+                n = 1;
+                h_patch->op[h_patch->op_len++] = (unsigned char)buf[0];
+                ret = ota_patch_op(h_patch);
+                break;
+
+            case OTA_PATCH_INSERT:
+                n = (len < h_patch->insert_len) ? len : h_patch->insert_len;
+                h_patch->insert_len -= n;
+                if (0 == h_patch->insert_len) {
+                    h_patch->state = OTA_PATCH_OP;
+                }
+                ret = ota_patch_output(h_patch, buf, n);
+                break;
+
+            default:
+                OTA_LOG_ERROR("data after the end of patch");
+                n = len;
+                ret = IOT_OTAE_CHECK_FAILED;
+                break;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    if (0 != ret) {
+        h_patch->state = OTA_PATCH_FAILED;
+    }
+
+    return ret;
+}
+
+
+int IOT_OTA_PatchFinish(void *handle)
+{
+    OTA_Patch_pt h_patch = (OTA_Patch_pt) handle;
+    unsigned char digest[32];
+
+    if (NULL == handle) {
+        OTA_LOG_ERROR("handle is NULL");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+
+    if (OTA_PATCH_END != h_patch->state || h_patch->size_written != h_patch->size_new) {
+        OTA_LOG_ERROR("patch is not complete");
+        return IOT_OTAE_CHECK_FAILED;
+    }
+
+    utils_sha256_finish(&h_patch->sha256, digest);
+    h_patch->state = OTA_PATCH_FAILED;
+    if (0 != memcmp(digest, h_patch->header + 44, 32)) {
+        OTA_LOG_ERROR("new firmware does not match the patch");
+        return IOT_OTAE_CHECK_FAILED;
+    }
+
+    return 0;
+}
+
+
+int IOT_OTA_PatchDeinit(void *handle)
+{
+    OTA_Patch_pt h_patch = (OTA_Patch_pt) handle;
+
+    if (NULL == handle) {
+        OTA_LOG_ERROR("handle is NULL");
+        return IOT_OTAE_INVALID_PARAM;
+    }
+
+    utils_sha256_free(&h_patch->sha256);
+    OTA_FREE(h_patch->buf);
+    OTA_FREE(h_patch);
+
+    return 0;
+}
+
+#endif
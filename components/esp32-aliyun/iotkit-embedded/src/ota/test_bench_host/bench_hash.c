@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Cost of hashing a firmware of N MB in chunks of 4KB, as the OTA module does with every chunk it
+ * fetches, with the digests of the SDK and the software ones of mbedTLS:
+ *
+ *   md5       : the whole file, IOT_OTAG_CHECK_FIRMWARE by default
+ *   sha256    : the whole file, "signMethod" SHA256
+ *   manifest  : SHA-256 of every block of B KB as IOT_OTA_SetManifest() checks them
+ *
+ *   ./bench_hash [-s MB] [-b block KB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "utils_md5.h"
+#include "utils_sha1.h"
+#include "utils_sha256.h"
+#include "mbedtls/md5.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+
+#define BENCH_CHUNK_LEN     (4096)
+
+static double bench_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void bench_md5(const unsigned char *buf, uint32_t len, uint32_t block_len, unsigned char *out)
+{
+    uint32_t i;
+    iot_md5_context ctx;
+
+    utils_md5_init(&ctx);
+    utils_md5_starts(&ctx);
+    for (i = 0; i < len; i += BENCH_CHUNK_LEN) {
+        utils_md5_update(&ctx, buf + i, BENCH_CHUNK_LEN);
+    }
+    utils_md5_finish(&ctx, out);
+}
+
+static void bench_sha1(const unsigned char *buf, uint32_t len, uint32_t block_len, unsigned char *out)
+{
+    uint32_t i;
+    iot_sha1_context ctx;
+
+    utils_sha1_init(&ctx);
+    utils_sha1_starts(&ctx);
+    for (i = 0; i < len; i += BENCH_CHUNK_LEN) {
+        utils_sha1_update(&ctx, buf + i, BENCH_CHUNK_LEN);
+    }
+    utils_sha1_finish(&ctx, out);
+}
+
+static void bench_sha256(const unsigned char *buf, uint32_t len, uint32_t block_len, unsigned char *out)
+{
+    uint32_t i;
+    iot_sha256_context ctx;
+
+    utils_sha256_init(&ctx);
+    utils_sha256_starts(&ctx);
+    for (i = 0; i < len; i += BENCH_CHUNK_LEN) {
+        utils_sha256_update(&ctx, buf + i, BENCH_CHUNK_LEN);
+    }
+    utils_sha256_finish(&ctx, out);
+}
+
+static void bench_manifest(const unsigned char *buf, uint32_t len, uint32_t block_len, unsigned char *out)
+{
+    uint32_t i;
+    iot_sha256_context ctx;
+
+    utils_sha256_init(&ctx);
+    utils_sha256_starts(&ctx);
+    for (i = 0; i < len; i += BENCH_CHUNK_LEN) {
+        utils_sha256_update(&ctx, buf + i, BENCH_CHUNK_LEN);
+        if (0 == (i + BENCH_CHUNK_LEN) % block_len) {
+            utils_sha256_finish(&ctx, out);
+            utils_sha256_starts(&ctx);
+        }
+    }
+}
+
+static void bench_mbedtls_md5(const unsigned char *buf, uint32_t len, uint32_t block_len, unsigned char *out)
+{
+    uint32_t i;
+    mbedtls_md5_context ctx;
+
+    mbedtls_md5_init(&ctx);
+    mbedtls_md5_starts(&ctx);
+    for (i = 0; i < len; i += BENCH_CHUNK_LEN) {
+        mbedtls_md5_update(&ctx, buf + i, BENCH_CHUNK_LEN);
+    }
+    mbedtls_md5_finish(&ctx, out);
+    mbedtls_md5_free(&ctx);
+}
+
+static void bench_mbedtls_sha1(const unsigned char *buf, uint32_t len, uint32_t block_len, unsigned char *out)
+{
+    uint32_t i;
+    mbedtls_sha1_context ctx;
+
+    mbedtls_sha1_init(&ctx);
+    mbedtls_sha1_starts(&ctx);
+    for (i = 0; i < len; i += BENCH_CHUNK_LEN) {
+        mbedtls_sha1_update(&ctx, buf + i, BENCH_CHUNK_LEN);
+    }
+    mbedtls_sha1_finish(&ctx, out);
+    mbedtls_sha1_free(&ctx);
+}
+
+static void bench_mbedtls_sha256(const unsigned char *buf, uint32_t len, uint32_t block_len, unsigned char *out)
+{
+    uint32_t i;
+    mbedtls_sha256_context ctx;
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    for (i = 0; i < len; i += BENCH_CHUNK_LEN) {
+        mbedtls_sha256_update(&ctx, buf + i, BENCH_CHUNK_LEN);
+    }
+    mbedtls_sha256_finish(&ctx, out);
+    mbedtls_sha256_free(&ctx);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        const char *impl;
+        void (*hash)(const unsigned char *buf, uint32_t len, uint32_t block_len, unsigned char *out);
+        int out_len;
+        int reference;      /* index of the case of the same digest, -1 for none */
+    } cases[] = {
+        {"md5", "utils", bench_md5, 16, 3},
+        {"sha1", "utils", bench_sha1, 20, 4},
+        {"sha256", "utils", bench_sha256, 32, 5},
+        {"md5", "mbedtls", bench_mbedtls_md5, 16, 0},
+        {"sha1", "mbedtls", bench_mbedtls_sha1, 20, 1},
+        {"sha256", "mbedtls", bench_mbedtls_sha256, 32, 2},
+        {"manifest", "utils", bench_manifest, 32, -1},
+    };
+    int opt, i, r, rounds = 5;
+    uint32_t mb = 8, block_len = 4096, len;
+    unsigned char *buf, out[sizeof(cases) / sizeof(cases[0])][32];
+    double start, best;
+
+    while ((opt = getopt(argc, argv, "s:b:h")) != -1) {
+        switch (opt) {
+            case 's':
+                mb = atoi(optarg);
+                break;
+            case 'b':
+                block_len = atoi(optarg) * 1024;
+                break;
+            default:
+                printf("usage: %s [-s MB] [-b block KB]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (0 == mb || 0 == block_len || 0 != block_len % BENCH_CHUNK_LEN) {
+        return -1;
+    }
+
+    len = mb * 1024 * 1024;
+    buf = malloc(len);
+    srand(1);
+    for (i = 0; i < len; i++) {
+        buf[i] = rand();
+    }
+
+    printf("%u MB in chunks of %u bytes, manifest blocks of %u KB\n", mb, BENCH_CHUNK_LEN, block_len / 1024);
+    printf("%-10s %-8s %10s %10s\n", "digest", "impl", "ms / MB", "MB/s");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        for (r = 0, best = 0; r < rounds; r++) {
+            start = bench_now_ms();
+            cases[i].hash(buf, len, block_len, out[i]);
+            start = bench_now_ms() - start;
+            best = (0 == r || start < best) ? start : best;
+        }
+
+        printf("%-10s %-8s %10.2f %10.1f%s\n", cases[i].name, cases[i].impl, best / mb, mb * 1e3 / best,
+               (cases[i].reference < 0 || cases[i].reference > i
+                || 0 == memcmp(out[i], out[cases[i].reference], cases[i].out_len)) ? "" : "  MISMATCH");
+    }
+
+    free(buf);
+
+    return 0;
+}
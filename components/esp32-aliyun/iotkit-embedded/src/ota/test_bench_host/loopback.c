@@ -0,0 +1,499 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include "loopback.h"
+#include "utils_md5.h"
+#include "utils_sha256.h"
+
+#define LOOPBACK_REQUEST_LEN    (1024)
+#define LOOPBACK_PACE_LEN       (1024)
+
+loopback_server_t loopback;
+
+static iotx_mqtt_event_handle_func_fpt upgrade_handle;
+static void *upgrade_context;
+
+/* The signal channel is not under test, the upgrade message is given to the OTA module directly */
+int IOT_MQTT_Subscribe(void *handle,
+                       const char *topic_filter,
+                       iotx_mqtt_qos_t qos,
+                       iotx_mqtt_event_handle_func_fpt topic_handle_func,
+                       void *pcontext)
+{
+    upgrade_handle = topic_handle_func;
+    upgrade_context = pcontext;
+    return 0;
+}
+
+int IOT_MQTT_Publish(void *handle, const char *topic_name, iotx_mqtt_topic_info_pt topic_msg)
+{
+    return 0;
+}
+
+/* No TLS on the loopback, the URL is "http://" */
+const char *iotx_ca_get(void)
+{
+    return NULL;
+}
+
+uintptr_t HAL_SSL_Establish(const char *host, uint16_t port, const char *ca_crt, size_t ca_crt_len)
+{
+    return 0;
+}
+
+int32_t HAL_SSL_Destroy(uintptr_t handle)
+{
+    return 0;
+}
+
+int32_t HAL_SSL_Write(uintptr_t handle, const char *buf, int len, int timeout_ms)
+{
+    return -1;
+}
+
+int32_t HAL_SSL_Read(uintptr_t handle, char *buf, int len, int timeout_ms)
+{
+    return -1;
+}
+
+/* The TCP HALs of the device side, quiet and counting what is received */
+uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
+{
+    int fd;
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && loopback.window > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &loopback.window, sizeof(loopback.window));
+    }
+    if (fd < 0 || 0 != connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        perror("connect");
+        return 0;
+    }
+
+    return fd;
+}
+
+int32_t HAL_TCP_Destroy(uintptr_t fd)
+{
+    return close(fd);
+}
+
+int32_t HAL_TCP_Write(uintptr_t fd, const char *buf, uint32_t len, uint32_t timeout_ms)
+{
+    return send(fd, buf, len, MSG_NOSIGNAL);
+}
+
+/* one recv() is enough for the HTTP client, which asks again for the rest */
+int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
+{
+    int ret;
+    fd_set sets;
+    struct timeval timeout;
+
+    FD_ZERO(&sets);
+    FD_SET(fd, &sets);
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    ret = select(fd + 1, &sets, NULL, NULL, &timeout);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    ret = recv(fd, buf, len, 0);
+    if (ret <= 0) {
+        /* closed */
+        return -1;
+    }
+
+    __sync_fetch_and_add(&loopback.received, ret);
+    return ret;
+}
+
+/* whether the Accept-Encoding of @request lists @coding */
+static int loopback_accepts(const char *request, const char *coding)
+{
+    const char *accept = strstr(request, "Accept-Encoding:"), *found;
+
+    if (NULL == accept) {
+        return 0;
+    }
+    found = strstr(accept, coding);
+    return NULL != found && found < strchr(accept, '\n');
+}
+
+/* send @len bytes of body, framed as a chunk if the body is chunked */
+static int loopback_send(int fd, int chunked, const char *buf, uint32_t len)
+{
+    char size[16];
+    int n;
+
+    if (chunked) {
+        n = sprintf(size, "%x\r\n", (unsigned int)len);
+        if (n != send(fd, size, n, MSG_NOSIGNAL)) {
+            return -1;
+        }
+    }
+    n = send(fd, buf, len, MSG_NOSIGNAL);
+    if (chunked && n == len && 2 != send(fd, "\r\n", 2, MSG_NOSIGNAL)) {
+        return -1;
+    }
+    return n;
+}
+
+/* wait @ms or until the device closes the connection, 0 if it did not */
+static int loopback_pause(int fd, uint32_t ms)
+{
+    fd_set sets;
+    struct timeval timeout;
+
+    FD_ZERO(&sets);
+    FD_SET(fd, &sets);
+    timeout.tv_sec = ms / 1000;
+    timeout.tv_usec = (ms % 1000) * 1000;
+
+    /* the request is read, the device sends nothing more but the end of the connection */
+    return select(fd + 1, &sets, NULL, NULL, &timeout);
+}
+
+/* hold a send of @len bytes to the rate of the link the connections share */
+static void loopback_link(uint32_t len)
+{
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    int ahead;
+
+    pthread_mutex_lock(&mutex);
+    ahead = loopback.link_sent / loopback.link_rate - (HAL_UptimeMs() - loopback.link_start);
+    if (ahead < 0) {
+        /* the link was idle, that time is lost */
+        loopback.link_start = HAL_UptimeMs() - loopback.link_sent / loopback.link_rate;
+        ahead = 0;
+    }
+    loopback.link_sent += len;
+    pthread_mutex_unlock(&mutex);
+
+    if (ahead > 0) {
+        HAL_SleepMs(ahead);
+    }
+}
+
+/* answer the @request on the @index th connection, which sent @sent bytes of body before */
+/* return 0 to read the next request on the connection, -1 to close it */
+static int loopback_respond(int fd, int index, const char *request, uint32_t *sent)
+{
+    char header[256];
+    const char *range, *body = loopback.image;
+    char *dash;
+    uint32_t offset = 0, len, drop, delay, start = HAL_UptimeMs(), size = loopback.size, paced = 0;
+    int n, corrupt, chunked = 0;
+    char wrong;
+
+    range = strstr(request, "Range: bytes=");
+    if (NULL != loopback.encoding && NULL == range && loopback_accepts(request, loopback.encoding)) {
+        body = loopback.encoded;
+        size = loopback.encoded_size;
+        chunked = loopback.chunked;
+        __sync_fetch_and_add(&loopback.encoded_responses, 1);
+        if (chunked) {
+            n = sprintf(header, "HTTP/1.1 200 OK\r\nContent-Encoding: %s\r\nTransfer-Encoding: chunked\r\n\r\n",
+                        loopback.encoding);
+        } else {
+            n = sprintf(header, "HTTP/1.1 200 OK\r\nContent-Encoding: %s\r\nContent-Length: %u\r\n\r\n",
+                        loopback.encoding, size);
+        }
+    } else if (NULL != range && !loopback.ignore_range) {
+        /* "bytes=<first>-" or "bytes=<first>-<last>" */
+        offset = strtoul(range + strlen("Range: bytes="), &dash, 10);
+        if ('-' == *dash && dash[1] >= '0' && dash[1] <= '9' && strtoul(dash + 1, NULL, 10) < size) {
+            size = strtoul(dash + 1, NULL, 10) + 1;
+        }
+        n = sprintf(header, "HTTP/1.1 206 Partial Content\r\nContent-Length: %u\r\n"
+                    "Content-Range: bytes %u-%u/%u\r\n\r\n",
+                    size - offset, offset, size - 1, loopback.size);
+    } else {
+        n = sprintf(header, "HTTP/1.1 200 OK\r\nContent-Length: %u\r\n\r\n", loopback.size);
+    }
+
+    /* the request goes up and the head comes down in a round trip, a new connection takes one more */
+    delay = (1 == index) ? loopback.head_delay : 0;
+    if (loopback.rtt > 0) {
+        delay += (0 == *sent) ? 2 * loopback.rtt : loopback.rtt;
+    }
+    if (delay > 0 && 0 != loopback_pause(fd, delay)) {
+        return -1;
+    }
+    if (n != send(fd, header, n, MSG_NOSIGNAL)) {
+        return -1;
+    }
+
+    drop = (0 == loopback.drops || index <= loopback.drops) ? loopback.drop : 0;
+    corrupt = loopback.corrupt > 0 && (0 == loopback.corrupts || index <= loopback.corrupts);
+    while (offset < size) {
+        len = size - offset;
+        if (drop > 0 && len > drop - *sent) {
+            len = drop - *sent;
+        }
+        if (0 == len) {
+            return -1;
+        }
+        if (loopback.stall > 0 && 1 == index) {
+            if (*sent == loopback.stall && 0 != loopback_pause(fd, loopback.stall_ms)) {
+                return -1;
+            }
+            if (*sent < loopback.stall && len > loopback.stall - *sent) {
+                len = loopback.stall - *sent;
+            }
+        }
+
+        if (loopback.rate > 0) {
+            /* no faster than @rate, time the device did not read is lost as on a real link */
+            int ahead = paced / loopback.rate - (HAL_UptimeMs() - start);
+            if (ahead > 0) {
+                HAL_SleepMs(ahead);
+            } else {
+                start = HAL_UptimeMs() - paced / loopback.rate;
+            }
+        }
+        if (loopback.rate > 0 || loopback.link_rate > 0) {
+            len = (len < LOOPBACK_PACE_LEN) ? len : LOOPBACK_PACE_LEN;
+        }
+        if (loopback.link_rate > 0) {
+            loopback_link(len);
+        }
+
+        if (corrupt && offset <= loopback.corrupt && loopback.corrupt - offset < len) {
+            if (offset < loopback.corrupt) {
+                /* up to the byte sent wrong */
+                len = loopback.corrupt - offset;
+                n = loopback_send(fd, chunked, body + offset, len);
+            } else {
+                wrong = ~body[offset];
+                n = loopback_send(fd, chunked, &wrong, 1);
+            }
+        } else {
+            n = loopback_send(fd, chunked, body + offset, len);
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        offset += n;
+        *sent += n;
+        paced += n;
+    }
+
+    if (chunked) {
+        send(fd, "0\r\n\r\n", 5, MSG_NOSIGNAL);
+    }
+    return 0;
+}
+
+/* the requests of a connection one after the other, till the device closes it */
+static void *loopback_serve(void *arg)
+{
+    char request[LOOPBACK_REQUEST_LEN + 1];
+    int fd = ((int *)arg)[0], index = ((int *)arg)[1];
+    int n, got;
+    uint32_t sent = 0;
+
+    free(arg);
+    if (loopback.window > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &loopback.window, sizeof(loopback.window));
+    }
+
+    do {
+        got = 0;
+        do {
+            n = recv(fd, request + got, LOOPBACK_REQUEST_LEN - got, 0);
+            if (n <= 0) {
+                got = 0;
+                break;
+            }
+            got += n;
+            request[got] = '\0';
+        } while (NULL == strstr(request, "\r\n\r\n") && got < LOOPBACK_REQUEST_LEN);
+    } while (got > 0 && 0 == loopback_respond(fd, index, request, &sent));
+
+    close(fd);
+    __sync_fetch_and_sub(&loopback.busy, 1);
+    return NULL;
+}
+
+static void *loopback_routine(void *arg)
+{
+    int fd, *conn;
+    pthread_t thread;
+
+    while ((fd = accept(loopback.listen_fd, NULL, NULL)) >= 0) {
+        __sync_fetch_and_add(&loopback.busy, 1);
+        conn = malloc(2 * sizeof(int));
+        conn[0] = fd;
+        conn[1] = ++loopback.connections;
+        if (0 != pthread_create(&thread, NULL, loopback_serve, conn)) {
+            loopback_serve(conn);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    return NULL;
+}
+
+static void loopback_digests(void)
+{
+    uint32_t i;
+    unsigned char digest[32];
+
+    utils_md5((unsigned char *)loopback.image, loopback.size, digest);
+    for (i = 0; i < 16; ++i) {
+        loopback.md5sum[i * 2] = utils_hb2hex(digest[i] >> 4);
+        loopback.md5sum[i * 2 + 1] = utils_hb2hex(digest[i]);
+    }
+    loopback.md5sum[32] = '\0';
+    utils_sha256((unsigned char *)loopback.image, loopback.size, digest);
+    for (i = 0; i < 32; ++i) {
+        loopback.sha256sum[i * 2] = utils_hb2hex(digest[i] >> 4);
+        loopback.sha256sum[i * 2 + 1] = utils_hb2hex(digest[i]);
+    }
+    loopback.sha256sum[64] = '\0';
+}
+
+int loopback_start(uint32_t size)
+{
+    uint32_t i;
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    pthread_t thread;
+
+    memset(&loopback, 0, sizeof(loopback));
+    if (NULL == (loopback.image = malloc(size))) {
+        return -1;
+    }
+    loopback.size = size;
+
+    srand(1);
+    for (i = 0; i < size; i++) {
+        loopback.image[i] = rand();
+    }
+    loopback_digests();
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    loopback.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (loopback.listen_fd < 0
+        || 0 != bind(loopback.listen_fd, (struct sockaddr *)&addr, sizeof(addr))
+        || 0 != listen(loopback.listen_fd, 16)
+        || 0 != getsockname(loopback.listen_fd, (struct sockaddr *)&addr, &addr_len)) {
+        perror("loopback server");
+        return -1;
+    }
+    loopback.port = ntohs(addr.sin_port);
+
+    return pthread_create(&thread, NULL, loopback_routine, NULL);
+}
+
+int loopback_load(const char *image, uint32_t size)
+{
+    char *copy;
+
+    if (NULL == (copy = malloc(size))) {
+        return -1;
+    }
+    memcpy(copy, image, size);
+
+    loopback_wait();
+    free(loopback.image);
+    loopback.image = copy;
+    loopback.size = size;
+    loopback_digests();
+
+    return 0;
+}
+
+void loopback_upgrade(void)
+{
+    char msg[512], sign[128] = "";
+    iotx_mqtt_topic_info_t topic_info;
+    iotx_mqtt_event_msg_t event;
+
+    memset(&topic_info, 0, sizeof(topic_info));
+    topic_info.payload = msg;
+    if (loopback.sha256) {
+        sprintf(sign, ",\"signMethod\":\"SHA256\",\"sign\":\"%s\"", loopback.sha256sum);
+    }
+    if (loopback.is_diff) {
+        strcat(sign, ",\"isDiff\":1");
+    }
+    topic_info.payload_len = sprintf(msg, "{\"code\":\"1000\",\"data\":{\"size\":%u,\"url\":"
+                                     "\"http://127.0.0.1:%d/image.bin\",\"md5\":\"%s\",\"version\":\"2.0\"%s},"
+                                     "\"id\":1,\"message\":\"success\"}",
+                                     loopback.size, loopback.port, loopback.md5sum, sign);
+    event.event_type = IOTX_MQTT_EVENT_PUBLISH_RECVEIVED;
+    event.msg = &topic_info;
+
+    upgrade_handle(upgrade_context, NULL, &event);
+}
+
+void loopback_wait(void)
+{
+    while (loopback.busy) {
+        usleep(1000);
+    }
+}
+
+void loopback_reset(void)
+{
+    loopback.rate = 0;
+    loopback.window = 0;
+    loopback.drop = 0;
+    loopback.drops = 0;
+    loopback.ignore_range = 0;
+    loopback.encoding = NULL;
+    loopback.chunked = 0;
+    loopback.encoded_responses = 0;
+    loopback.sha256 = 0;
+    loopback.is_diff = 0;
+    loopback.head_delay = 0;
+    loopback.stall = 0;
+    loopback.stall_ms = 0;
+    loopback.corrupt = 0;
+    loopback.corrupts = 0;
+    loopback.rtt = 0;
+    loopback.link_rate = 0;
+    loopback.link_sent = 0;
+    loopback.received = 0;
+    loopback.connections = 0;
+}
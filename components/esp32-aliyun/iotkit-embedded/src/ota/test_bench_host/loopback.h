@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _OTA_TEST_LOOPBACK_H_
+#define _OTA_TEST_LOOPBACK_H_
+
+#include "iot_import.h"
+#include "iot_export.h"
+
+#define LOOPBACK_PRODUCT_KEY    "test_pk"
+#define LOOPBACK_DEVICE_NAME    "test_dn"
+
+/* A HTTP server on 127.0.0.1 serving the image of the OTA tests, a thread per connection */
+typedef struct {
+    int listen_fd;
+    int port;
+    char *image;
+    uint32_t size;
+    char md5sum[33];
+    char sha256sum[65];
+    int sha256;             /* give "signMethod":"SHA256" and the SHA-256 as "sign" in the upgrade message */
+    int is_diff;            /* give "isDiff":1 in the upgrade message */
+    uint32_t rate;          /* bytes of body sent per millisecond, 0 as fast as possible */
+    int window;             /* socket buffer bytes on both ends as a small TCP stack has, 0 default */
+    uint32_t drop;          /* bytes of body sent by a connection before closing it, 0 never */
+    int drops;              /* connections to close early, 0 all of them */
+    int ignore_range;       /* answer 200 and the whole image to a Range request */
+    const char *encoding;   /* Content-Encoding of @encoded, sent to a request accepting it without a Range */
+    char *encoded;          /* the image in that coding */
+    uint32_t encoded_size;
+    int chunked;            /* send the encoded image in chunks, as a server compressing on the fly */
+    int encoded_responses;  /* responses sent with the encoded image */
+    uint32_t head_delay;    /* milliseconds the first connection waits before the head of its response */
+    uint32_t stall;         /* bytes of body the first connection sends before waiting @stall_ms */
+    uint32_t stall_ms;
+    uint32_t corrupt;       /* offset of a byte of the image sent wrong, 0 never */
+    int corrupts;           /* connections sending it wrong, 0 all of them */
+    uint32_t rtt;           /* round trip in milliseconds before the head of a response, two on a new
+                             * connection for its handshake */
+    uint32_t link_rate;     /* bytes per millisecond of all the connections together, 0 no limit */
+    uint32_t link_sent;     /* bytes the link has taken since @link_start */
+    uint32_t link_start;
+    uint32_t received;      /* bytes read by the device */
+    int connections;
+    volatile int busy;      /* connections being served, each by a thread */
+} loopback_server_t;
+
+extern loopback_server_t loopback;
+
+/* make a random image of @size bytes and start serving it, 0 if successful */
+int loopback_start(uint32_t size);
+
+/* serve a copy of the @size bytes of @image instead, 0 if successful */
+int loopback_load(const char *image, uint32_t size);
+
+/* give the upgrade message the OTA server would publish to the last OTA module initialized */
+void loopback_upgrade(void);
+
+/* wait for the server to be done with the connections of the device */
+void loopback_wait(void);
+
+/* clear the settings and the counters of the server */
+void loopback_reset(void);
+
+#endif /* _OTA_TEST_LOOPBACK_H_ */
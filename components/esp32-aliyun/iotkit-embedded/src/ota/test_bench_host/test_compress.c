@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Loopback test of compressed OTA downloads. The image looks like a firmware: code of a few
+ * instruction patterns, strings and the padding between sections. The server of loopback.c sends
+ * it compressed with zlib of the host to a request accepting gzip or deflate, and as it is to the
+ * Range requests after a broken connection. Every case downloads it with IOT_OTA_FetchYield() as
+ * an application does and checks it against its MD5.
+ *
+ *   ./test_compress [-s image bytes] [-b buffer bytes] [-r bytes per ms]
+ *
+ * The cases at a rate time the download over a link of that rate, compressed and not. Before them
+ * utils_inflate.c decodes, in slices of random lengths, streams of every format, level and window
+ * made by zlib, and the same streams with a bit flipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_inflate.h"
+#include "loopback.h"
+
+#define TEST_STREAMS        (300)
+#define TEST_STREAM_LEN     (96 * 1024)
+
+/* an image which compresses about as a firmware does */
+static void test_image(char *image, uint32_t size)
+{
+    static const char *strings[] = {
+        "wifi connect failed, retry in %d ms\n", "mqtt_client.c", "topic /%s/%s/update", "OTA_", "E (%d) %s: ",
+        "heap", "timeout", "\0\0\0", "certificate verify error", "productKey"
+    };
+    static const uint32_t opcodes[16] = {
+        0x004136, 0x0020c0, 0xa0a0b0, 0x00a092, 0x0c0581, 0x21e001, 0x03ad11, 0x0000f0,
+        0x206220, 0x1d0000, 0x22a000, 0x0c1c00, 0x00f01d, 0x90e9a0, 0x2802b0, 0x3c0000
+    };
+    uint32_t i = 0, n, op;
+    const char *s;
+
+    srand(2);
+    while (i < size) {
+        n = 256 + rand() % 4096;
+        switch (rand() % 10) {
+            case 0:
+                /* strings */
+                while (n > 0 && i < size) {
+                    s = strings[rand() % (sizeof(strings) / sizeof(strings[0]))];
+                    for (; '\0' != *s && n > 0 && i < size; n--) {
+                        image[i++] = *s++;
+                    }
+                }
+                break;
+            case 1:
+                /* padding */
+                for (; n > 0 && i < size; n--) {
+                    image[i++] = (char)0xff;
+                }
+                break;
+            default:
+                /* 24-bit instructions with random registers and operands */
+                for (; n >= 3 && i < size; n -= 3) {
+                    op = opcodes[rand() % 16] ^ ((rand() & 0x0f) << 4) ^ ((rand() % 4 == 0) ? rand() << 12 : 0);
+                    image[i++] = op;
+                    if (i < size) {
+                        image[i++] = op >> 8;
+                    }
+                    if (i < size) {
+                        image[i++] = op >> 16;
+                    }
+                }
+                break;
+        }
+    }
+}
+
+/* compress @len bytes of @data in @format into a new buffer, its length in *@p_len */
+static char *test_compress(const char *data, uint32_t len, int format, int level, int window_bits, int strategy,
+                           uint32_t *p_len)
+{
+    z_stream z;
+    char *out;
+    uint32_t out_len = len + len / 8 + 1024;
+
+    memset(&z, 0, sizeof(z));
+    if (UTILS_INFLATE_RAW == format) {
+        window_bits = -window_bits;
+    } else if (UTILS_INFLATE_GZIP == format) {
+        window_bits += 16;
+    }
+    if (NULL == (out = malloc(out_len))
+        || Z_OK != deflateInit2(&z, level, Z_DEFLATED, window_bits, 8, strategy)) {
+        free(out);
+        return NULL;
+    }
+    z.next_in = (unsigned char *)data;
+    z.avail_in = len;
+    z.next_out = (unsigned char *)out;
+    z.avail_out = out_len;
+    deflate(&z, Z_FINISH);
+    *p_len = out_len - z.avail_out;
+    deflateEnd(&z);
+
+    return out;
+}
+
+/* decode @len bytes of @in in slices of up to @in_slice and @out_slice bytes, return the bytes of
+ * data, or -1 if the stream is refused */
+static int test_inflate(const char *in, uint32_t len, int format, char *out, uint32_t out_len,
+                        int in_slice, int out_slice)
+{
+    static uint8_t window[1 << UTILS_INFLATE_MAX_WINDOW_BITS];
+    utils_inflate_t s;
+    uint32_t pos = 0, count = 0;
+    int n, used, in_n, out_n;
+
+    utils_inflate_init(&s, format, window, UTILS_INFLATE_MAX_WINDOW_BITS);
+    while (!utils_inflate_is_done(&s)) {
+        in_n = 1 + rand() % in_slice;
+        in_n = (in_n < len - pos) ? in_n : len - pos;
+        out_n = 1 + rand() % out_slice;
+        out_n = (out_n < out_len - count) ? out_n : out_len - count;
+        n = utils_inflate(&s, (const uint8_t *)in + pos, in_n, &used, (uint8_t *)out + count, out_n);
+        if (n < 0) {
+            return -1;
+        }
+        if (0 == n && 0 == used && !utils_inflate_is_done(&s) && (pos == len || count == out_len)) {
+            /* cut short, or longer than it should */
+            return -1;
+        }
+        pos += used;
+        count += n;
+    }
+
+    return (pos == len) ? (int)count : -1;
+}
+
+/* streams of zlib decoded by utils_inflate.c, 0 if all are right and the corrupt ones do no harm */
+static int test_streams(const char *image, uint32_t size, int *p_refused)
+{
+    static const int strategies[] = {Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED};
+    int i, format, n, failed = 0;
+    uint32_t len, comp_len;
+    char *data = malloc(TEST_STREAM_LEN), *out = malloc(TEST_STREAM_LEN + 1), *comp;
+
+    *p_refused = 0;
+    for (i = 0; i < TEST_STREAMS; i++) {
+        len = rand() % TEST_STREAM_LEN;
+        if (i % 3) {
+            memcpy(data, image + rand() % (size - len + 1), len);
+        } else {
+            for (n = 0; n < len; n++) {
+                data[n] = rand();
+            }
+        }
+        format = i % 3;
+        comp = test_compress(data, len, format, rand() % 10, 9 + rand() % 7,
+                             strategies[rand() % (sizeof(strategies) / sizeof(strategies[0]))], &comp_len);
+        if (NULL == comp) {
+            return -1;
+        }
+
+        n = test_inflate(comp, comp_len, format, out, TEST_STREAM_LEN + 1, i % 2 ? 7 : 4096, i % 4 ? 4096 : 7);
+        if (n != len || 0 != memcmp(out, data, len)) {
+            printf("stream %d of %u bytes, format %d: %d bytes decoded\n", i, len, format, n);
+            failed++;
+        }
+
+        /* a bit flipped: refused, or else wrong data in a raw stream which has no check */
+        comp[rand() % comp_len] ^= 1 << (rand() % 8);
+        n = test_inflate(comp, comp_len, format, out, TEST_STREAM_LEN + 1, 4096, 4096);
+        if (n < 0) {
+            (*p_refused)++;
+        } else if (UTILS_INFLATE_RAW != format && n == len && 0 == memcmp(out, data, len)) {
+            /* the bit was one the format does not read */
+            (*p_refused)++;
+        } else if (UTILS_INFLATE_RAW != format) {
+            printf("stream %d of %u bytes, format %d: corruption not found\n", i, len, format);
+            failed++;
+        }
+        free(comp);
+    }
+
+    free(out);
+    free(data);
+    return failed;
+}
+
+/* download the image into @out, the milliseconds it took in *@p_ms. return 0 if it is right */
+static int test_download(char *out, char *buf, uint32_t buf_len, uint32_t *p_ms)
+{
+    int len, mqtt = 0;
+    uint32_t offset, valid = 0, start;
+    void *h_ota;
+
+    h_ota = IOT_OTA_Init(LOOPBACK_PRODUCT_KEY, LOOPBACK_DEVICE_NAME, &mqtt);
+    if (NULL == h_ota) {
+        return -1;
+    }
+    loopback_upgrade();
+
+    start = HAL_UptimeMs();
+    do {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &offset, 4);
+        len = IOT_OTA_FetchYield(h_ota, buf, buf_len, 5);
+        if (len > 0 && offset + len <= loopback.size) {
+            memcpy(out + offset, buf, len);
+        }
+    } while (!IOT_OTA_IsFetchFinish(h_ota));
+    *p_ms = HAL_UptimeMs() - start;
+
+    if (IOT_OTAE_NONE == IOT_OTA_GetLastError(h_ota)) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &valid, 4);
+    }
+    IOT_OTA_Deinit(h_ota);
+
+    return (1 == valid && 0 == memcmp(out, loopback.image, loopback.size)) ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct {
+        const char *name;
+        const char *encoding;
+        int chunked;
+        uint32_t drop;
+        int throttled;
+    } cases[] = {
+        {"identity", NULL, 0, 0, 0},
+        {"gzip", "gzip", 0, 0, 0},
+        {"gzip, chunked", "gzip", 1, 0, 0},
+        {"deflate", "deflate", 0, 0, 0},
+        {"gzip, drop / 64KB", "gzip", 0, 64 * 1024, 0},
+        {"identity, link", NULL, 0, 0, 1},
+        {"gzip, link", "gzip", 1, 0, 1},
+        {"deflate, link", "deflate", 0, 0, 1},
+    };
+    int opt, i, ret, refused, failed = 0;
+    uint32_t size = 1024 * 1024, buf_len = 4096, rate = 256, ms, gzip_len, zlib_len;
+    char *image, *out, *buf, *gzip, *zlib;
+
+    while ((opt = getopt(argc, argv, "s:b:r:h")) != -1) {
+        switch (opt) {
+            case 's':
+                size = atoi(optarg);
+                break;
+            case 'b':
+                buf_len = atoi(optarg);
+                break;
+            case 'r':
+                rate = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-s image bytes] [-b buffer bytes] [-r bytes per ms]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (size < TEST_STREAM_LEN || 0 == buf_len || 0 == rate) {
+        return -1;
+    }
+
+    LITE_openlog("ota");
+    LITE_set_loglevel(LOG_CRIT_LEVEL);
+    HAL_Kv_Del("iotx_ota");
+
+    image = malloc(size);
+    out = malloc(size);
+    buf = malloc(buf_len);
+    test_image(image, size);
+
+    ret = test_streams(image, size, &refused);
+    failed += (0 != ret);
+    printf("%d zlib streams decoded, %d corrupted ones refused: %s\n\n", TEST_STREAMS, refused,
+           0 == ret ? "ok" : "FAILED");
+
+    gzip = test_compress(image, size, UTILS_INFLATE_GZIP, 6, 15, Z_DEFAULT_STRATEGY, &gzip_len);
+    zlib = test_compress(image, size, UTILS_INFLATE_ZLIB, 6, 15, Z_DEFAULT_STRATEGY, &zlib_len);
+    if (NULL == gzip || NULL == zlib || 0 != loopback_start(size) || 0 != loopback_load(image, size)) {
+        return -1;
+    }
+    printf("image of %u bytes, %u gzip, %u deflate, link of %u bytes/ms\n", size, gzip_len, zlib_len, rate);
+
+    printf("%-20s %14s %12s %10s %8s  %s\n", "case", "received bytes", "connections", "compressed", "ms",
+           "result");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        loopback_reset();
+        loopback.encoding = cases[i].encoding;
+        loopback.encoded = (NULL != cases[i].encoding && 0 == strcmp(cases[i].encoding, "gzip")) ? gzip : zlib;
+        loopback.encoded_size = (loopback.encoded == gzip) ? gzip_len : zlib_len;
+        loopback.chunked = cases[i].chunked;
+        loopback.drop = cases[i].drop;
+        loopback.rate = cases[i].throttled ? rate : 0;
+        memset(out, 0, size);
+
+        ret = test_download(out, buf, buf_len, &ms);
+        if (0 == ret && NULL != cases[i].encoding && 0 == loopback.encoded_responses) {
+            /* not sent compressed */
+            ret = -1;
+        }
+        failed += (0 != ret);
+        loopback_wait();
+
+        printf("%-20s %14u %12d %10d %8u  %s\n", cases[i].name, loopback.received, loopback.connections,
+               loopback.encoded_responses, ms, 0 == ret ? "ok" : "FAILED");
+    }
+
+    free(zlib);
+    free(gzip);
+    free(buf);
+    free(out);
+    free(image);
+    LITE_closelog();
+
+    return failed;
+}
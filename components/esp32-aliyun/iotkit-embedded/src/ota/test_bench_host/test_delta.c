@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/*
+ * Loopback test of the delta firmware. A patch of a new image against the running one is made here
+ * with a greedy matcher, the server of loopback.c serves it with "isDiff":1 and the device side
+ * applies it with IOT_OTA_PatchWrite() as it is downloaded, reading the running firmware from a
+ * file and writing the new one to another, as two partitions of a flash.
+ *
+ *   ./test_delta [-s image bytes] [-b buffer bytes] [old.bin new.bin]
+ *
+ * The new images of the test are the running one with N% of its bytes changed in runs of 1 to 8
+ * bytes, as the addresses moved by a patch release, plus 2 KB inserted and 1 KB removed. Every case
+ * prints the size of the patch against the new image and the bytes saved. Given two files, it makes
+ * and applies the patch of them instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_sha256.h"
+#include "loopback.h"
+
+#define TEST_OLD_FILE       "test_delta_old.bin"
+#define TEST_NEW_FILE       "test_delta_new.bin"
+
+#define DELTA_WINDOW        (16)    /* bytes hashed to find a match in the old image */
+#define DELTA_HASH_BITS     (20)
+#define DELTA_CHAIN_MAX     (32)    /* candidates tried per position */
+#define DELTA_COPY_MIN      (DELTA_WINDOW)
+#define DELTA_RESUME_MIN    (8)     /* bytes to go on with the shift of the last copy */
+
+static double test_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint32_t delta_hash(const unsigned char *p)
+{
+    uint32_t i, h = 0;
+
+    for (i = 0; i < DELTA_WINDOW; ++i) {
+        h = (h ^ p[i]) * 16777619;
+    }
+    return h >> (32 - DELTA_HASH_BITS);
+}
+
+static unsigned char *delta_varint(unsigned char *p, uint32_t value)
+{
+    while (value >= 0x80) {
+        *p++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+static uint32_t delta_match(const unsigned char *a, const unsigned char *b, uint32_t max)
+{
+    uint32_t n = 0;
+
+    while (n < max && a[n] == b[n]) {
+        n++;
+    }
+    return n;
+}
+
+static unsigned char *delta_insert(unsigned char *p, const unsigned char *bytes, uint32_t len)
+{
+    if (len > 0) {
+        *p++ = 2;
+        p = delta_varint(p, len);
+        memcpy(p, bytes, len);
+        p += len;
+    }
+    return p;
+}
+
+/* make the patch of @new against @old, see IOT_OTA_PatchInit(), its length in @patch_len */
+static char *delta_make(const char *old_image, uint32_t old_len, const char *new_image, uint32_t new_len,
+                        uint32_t *patch_len)
+{
+    const unsigned char *old = (const unsigned char *)old_image, *new = (const unsigned char *)new_image;
+    int32_t *head, *chain, cand;
+    uint32_t i, j, k, literal = 0, pos_old = 0, shift_pos = 0, best_len, best_pos, len, delta;
+    unsigned char *patch, *p;
+
+    /* a copy op is no longer than the bytes it replaces, an insert op adds 6 bytes at most */
+    patch = malloc(IOT_OTA_PATCH_HEADER_LEN + new_len + new_len / DELTA_RESUME_MIN * 6 + 16);
+    head = malloc(sizeof(int32_t) << DELTA_HASH_BITS);
+    chain = malloc(sizeof(int32_t) * (old_len + 1));
+    memset(head, 0xFF, sizeof(int32_t) << DELTA_HASH_BITS);
+    for (i = 0; i + DELTA_WINDOW <= old_len; ++i) {
+        k = delta_hash(old + i);
+        chain[i] = head[k];
+        head[k] = i;
+    }
+
+    memcpy(patch, IOT_OTA_PATCH_MAGIC, 4);
+    for (i = 0; i < 4; ++i) {
+        patch[4 + i] = old_len >> (24 - 8 * i);
+        patch[8 + i] = new_len >> (24 - 8 * i);
+    }
+    utils_sha256(old, old_len, patch + 12);
+    utils_sha256(new, new_len, patch + 44);
+    p = patch + IOT_OTA_PATCH_HEADER_LEN;
+
+    for (j = 0; j < new_len;) {
+        best_len = 0;
+        best_pos = 0;
+
+        /* the old image shifted as by the last copy, a few bytes changed in between */
+        if (shift_pos < old_len) {
+            k = shift_pos;
+            best_len = delta_match(old + k, new + j, (old_len - k < new_len - j) ? old_len - k : new_len - j);
+            best_pos = k;
+            if (best_len < DELTA_RESUME_MIN) {
+                best_len = 0;
+            }
+        }
+
+        if (0 == best_len && j + DELTA_WINDOW <= new_len) {
+            for (cand = head[delta_hash(new + j)], k = 0; cand >= 0 && k < DELTA_CHAIN_MAX; cand = chain[cand], ++k) {
+                len = delta_match(old + cand, new + j, (old_len - cand < new_len - j) ? old_len - cand : new_len - j);
+                if (len > best_len) {
+                    best_len = len;
+                    best_pos = cand;
+                }
+            }
+            if (best_len < DELTA_COPY_MIN) {
+                best_len = 0;
+            }
+        }
+
+        if (0 == best_len) {
+            j++;
+            shift_pos++;
+            continue;
+        }
+
+        p = delta_insert(p, new + literal, j - literal);
+        delta = best_pos - pos_old;
+        *p++ = 1;
+        p = delta_varint(p, (delta << 1) ^ (0 - (delta >> 31)));
+        p = delta_varint(p, best_len);
+
+        j += best_len;
+        literal = j;
+        pos_old = best_pos + best_len;
+        shift_pos = pos_old;
+    }
+    p = delta_insert(p, new + literal, j - literal);
+    *p++ = 0;
+
+    free(chain);
+    free(head);
+    *patch_len = p - patch;
+    return (char *)patch;
+}
+
+static int test_read(void *ctx, uint32_t offset, char *buf, uint32_t len)
+{
+    return (pread(*(int *)ctx, buf, len, offset) == (ssize_t)len) ? 0 : -1;
+}
+
+static int test_write(void *ctx, uint32_t offset, const char *buf, uint32_t len)
+{
+    return (pwrite(*(int *)ctx, buf, len, offset) == (ssize_t)len) ? 0 : -1;
+}
+
+static int test_write_file(const char *path, const char *image, uint32_t len)
+{
+    int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+
+    if (fd < 0 || write(fd, image, len) != (ssize_t)len) {
+        perror(path);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+static char *test_read_file(const char *path, uint32_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    char *image;
+    long size;
+
+    if (NULL == fp) {
+        perror(path);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    image = malloc(size > 0 ? size : 1);
+    *len = fread(image, 1, size, fp);
+    fclose(fp);
+
+    return image;
+}
+
+/* download the patch served and apply it to the running firmware in TEST_OLD_FILE */
+/* return 1 if the new firmware is valid, 0 if not, -1 if the patch is refused */
+static int test_apply(char *buf, uint32_t buf_len, int pipeline)
+{
+    int len, ret, mqtt = 0, fd_old, fd_new;
+    uint32_t offset, valid = 0, is_diff = 0;
+    void *h_ota, *h_patch;
+    IOT_OTA_Source_t source = {test_read, NULL};
+    IOT_OTA_Sink_t sink = {test_write, NULL}, patch_sink = {IOT_OTA_PatchWrite, NULL};
+
+    fd_old = open(TEST_OLD_FILE, O_RDONLY);
+    fd_new = open(TEST_NEW_FILE, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    source.ctx = &fd_old;
+    sink.ctx = &fd_new;
+
+    h_patch = IOT_OTA_PatchInit(&source, &sink, buf_len);
+    h_ota = IOT_OTA_Init(LOOPBACK_PRODUCT_KEY, LOOPBACK_DEVICE_NAME, &mqtt);
+    if (NULL == h_patch || NULL == h_ota) {
+        return -1;
+    }
+    patch_sink.ctx = h_patch;
+    if (pipeline) {
+        IOT_OTA_PipelineInit(h_ota, &patch_sink, 4, buf_len);
+    }
+    loopback_upgrade();
+
+    ret = IOT_OTA_Ioctl(h_ota, IOT_OTAG_IS_DIFF, &is_diff, 4);
+    while (0 == ret && 1 == is_diff && !IOT_OTA_IsFetchFinish(h_ota)) {
+        if (pipeline) {
+            IOT_OTA_PipelineFetch(h_ota, 5000);
+            len = IOT_OTA_PipelineFlush(h_ota, 0);
+            ret = (len < 0) ? len : 0;
+        } else {
+            IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &offset, 4);
+            len = IOT_OTA_FetchYield(h_ota, buf, buf_len, 5);
+            ret = (len > 0) ? IOT_OTA_PatchWrite(h_patch, offset, buf, len) : 0;
+        }
+    }
+
+    if (0 == ret && IOT_OTAE_NONE == IOT_OTA_GetLastError(h_ota)) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &valid, 4);
+        ret = (1 == valid && 0 == IOT_OTA_PatchFinish(h_patch)) ? 1 : 0;
+    } else {
+        ret = (IOT_OTAE_CHECK_FAILED == ret) ? -1 : 0;
+    }
+
+    IOT_OTA_Deinit(h_ota);
+    IOT_OTA_PatchDeinit(h_patch);
+    close(fd_new);
+    close(fd_old);
+
+    return ret;
+}
+
+/* the new image: @percent of the bytes of @old changed in runs of 1 to 8, 2 KB inserted, 1 KB removed */
+static char *test_new_image(const char *old, uint32_t old_len, int percent, uint32_t *new_len)
+{
+    uint32_t i, pos, len, changed = 0, a = old_len / 3, b = old_len * 2 / 3;
+    char *edited = malloc(old_len), *new;
+
+    memcpy(edited, old, old_len);
+    srand(percent + 2);
+    while (changed * 100 < (uint64_t)old_len * percent) {
+        pos = rand() % old_len;
+        len = 1 + rand() % 8;
+        for (i = 0; i < len && pos + i < old_len; ++i, ++changed) {
+            edited[pos + i] = ~old[pos + i];
+        }
+    }
+
+    *new_len = old_len + 2048 - 1024;
+    new = malloc(*new_len);
+    memcpy(new, edited, a);
+    for (i = 0; i < 2048; ++i) {
+        new[a + i] = rand();
+    }
+    memcpy(new + a + 2048, edited + a, b - a);
+    memcpy(new + b + 2048, edited + b + 1024, old_len - b - 1024);
+
+    free(edited);
+    return new;
+}
+
+/* make the patch of @new against @old, serve it and apply it, 1 if the result is @new */
+static int test_case(const char *name, const char *old, uint32_t old_len, const char *new, uint32_t new_len,
+                     char *buf, uint32_t buf_len, int pipeline, int wrong_base, int expected)
+{
+    static const char *results[] = {"refused", "invalid", "valid"};
+    uint32_t patch_len, result_len;
+    char *patch, *result;
+    double make_ms, apply_ms;
+    int ret;
+
+    make_ms = test_now_ms();
+    patch = delta_make(old, old_len, new, new_len, &patch_len);
+    make_ms = test_now_ms() - make_ms;
+
+    if (0 != test_write_file(TEST_OLD_FILE, old, old_len) || 0 != loopback_load(patch, patch_len)) {
+        free(patch);
+        return 0;
+    }
+    if (wrong_base) {
+        /* another running firmware than the one of the patch */
+        int fd = open(TEST_OLD_FILE, O_WRONLY);
+        pwrite(fd, "?", 1, old_len / 2);
+        close(fd);
+    }
+
+    loopback_reset();
+    loopback.is_diff = 1;
+    apply_ms = test_now_ms();
+    ret = test_apply(buf, buf_len, pipeline);
+    apply_ms = test_now_ms() - apply_ms;
+    loopback_wait();
+
+    if (1 == ret) {
+        result = test_read_file(TEST_NEW_FILE, &result_len);
+        if (NULL == result || result_len != new_len || 0 != memcmp(result, new, new_len)) {
+            ret = 0;
+        }
+        free(result);
+    }
+
+    printf("%-22s %10u %10u %7.1f%% %10u %9.1f %9.1f  %s%s\n", name, new_len, patch_len,
+           new_len ? 100.0 * ((double)new_len - patch_len) / new_len : 0.0, loopback.received, make_ms, apply_ms,
+           results[ret + 1], ret == expected ? "" : " FAILED");
+
+    free(patch);
+    return ret == expected;
+}
+
+int main(int argc, char **argv)
+{
+    struct {
+        const char *name;
+        int percent;
+        int pipeline;
+        int wrong_base;
+        int expected;
+    } cases[] = {
+        {"0% changed", 0, 0, 0, 1},
+        {"1% changed", 1, 0, 0, 1},
+        {"5% changed", 5, 0, 0, 1},
+        {"10% changed", 10, 0, 0, 1},
+        {"10%, pipeline", 10, 1, 0, 1},
+        {"30% changed", 30, 0, 0, 1},
+        {"wrong running image", 5, 0, 1, -1},
+    };
+    int opt, i, failed = 0;
+    uint32_t size = 1024 * 1024, buf_len = 4096, new_len, old_len;
+    char *old, *new, *buf, name[32];
+
+    while ((opt = getopt(argc, argv, "s:b:h")) != -1) {
+        switch (opt) {
+            case 's':
+                size = atoi(optarg);
+                break;
+            case 'b':
+                buf_len = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-s image bytes] [-b buffer bytes] [old.bin new.bin]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (size < 4096 || buf_len < 2) {
+        return -1;
+    }
+
+    LITE_openlog("ota");
+    LITE_set_loglevel(LOG_CRIT_LEVEL);
+
+    if (0 != loopback_start(size)) {
+        return -1;
+    }
+    buf = malloc(buf_len);
+
+    printf("%-22s %10s %10s %8s %10s %9s %9s  %s\n", "case", "new bytes", "patch", "saved", "received",
+           "make ms", "apply ms", "result");
+    if (optind + 2 == argc) {
+        old = test_read_file(argv[optind], &old_len);
+        new = test_read_file(argv[optind + 1], &new_len);
+        if (NULL == old || NULL == new) {
+            return -1;
+        }
+        snprintf(name, sizeof(name), "%s", argv[optind + 1]);
+        failed += !test_case(name, old, old_len, new, new_len, buf, buf_len, 0, 0, 1);
+        free(new);
+        free(old);
+    } else {
+        old = malloc(size);
+        memcpy(old, loopback.image, size);
+        for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+            new = test_new_image(old, size, cases[i].percent, &new_len);
+            failed += !test_case(cases[i].name, old, size, new, new_len, buf, buf_len, cases[i].pipeline,
+                                 cases[i].wrong_base, cases[i].expected);
+            free(new);
+        }
+        free(old);
+    }
+
+    printf("patcher RAM: %u bytes of buffer besides its state\n", buf_len);
+    free(buf);
+    LITE_closelog();
+
+    return failed;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Loopback test of the timeouts of the OTA download. The server of loopback.c serves an image of
+ * N bytes, holds the head of the first response back or stops the first body for a while, and the
+ * device side downloads it with IOT_OTA_FetchYield() and the IOT_OTA_FetchConfig_t of every case.
+ *
+ *   ./test_fetch [-s image bytes] [-b buffer bytes] [-r bytes/ms of the link cases]
+ *
+ * Every case prints the IOT_OTAG_FETCH_STATS of the download and the milliseconds a call took on
+ * average. A call without data keeps the connection until the idle timeout, and on a slow link a
+ * call returns once it has the bytes of read_time_ms instead of waiting to fill the buffer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "loopback.h"
+
+/* download the image with @config, @calls and its time in @p_calls and @p_ms */
+/* return 0 if the image and its MD5 are right */
+static int test_download(char *out, char *buf, uint32_t buf_len, const IOT_OTA_FetchConfig_t *config,
+                         IOT_OTA_FetchStats_t *stats, uint32_t *p_calls, uint32_t *p_ms)
+{
+    int len, mqtt = 0;
+    uint32_t offset, valid = 0, start;
+    void *h_ota;
+
+    h_ota = IOT_OTA_Init(LOOPBACK_PRODUCT_KEY, LOOPBACK_DEVICE_NAME, &mqtt);
+    if (NULL == h_ota) {
+        return -1;
+    }
+    IOT_OTA_SetFetchConfig(h_ota, config);
+    loopback_upgrade();
+
+    *p_calls = 0;
+    start = HAL_UptimeMs();
+    do {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &offset, 4);
+        len = IOT_OTA_FetchYield(h_ota, buf, buf_len, 5);
+        if (len > 0) {
+            memcpy(out + offset, buf, len);
+        }
+        (*p_calls)++;
+    } while (!IOT_OTA_IsFetchFinish(h_ota));
+    *p_ms = HAL_UptimeMs() - start;
+
+    IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCH_STATS, stats, sizeof(IOT_OTA_FetchStats_t));
+    if (IOT_OTAE_NONE == IOT_OTA_GetLastError(h_ota)) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &valid, 4);
+    }
+    IOT_OTA_Deinit(h_ota);
+
+    return (1 == valid && 0 == memcmp(out, loopback.image, loopback.size)) ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct {
+        const char *name;
+        int link;                   /* at the rate of -r */
+        uint32_t head_delay;
+        uint32_t stall_ms;          /* at half of the image */
+        IOT_OTA_FetchConfig_t config;
+        uint32_t connections;       /* expected */
+        uint32_t stalls;
+        uint32_t failures;
+    } cases[] = {
+        {"defaults", 0, 0, 0, {0, 0, 0, 0}, 1, 0, 0},
+        {"stall 1s, kept", 0, 0, 1000, {0, 100, 0, 0}, 1, 0, 0},
+        {"stall 1s, idle 300ms", 0, 0, 1000, {0, 100, 300, 0}, 2, 1, 0},
+        {"stall 1s, idle 300ms, 5s", 0, 0, 1000, {0, 0, 300, 0}, 2, 1, 0},
+        {"head 1s, connect 300ms", 0, 1000, 0, {300, 0, 0, 0}, 2, 0, 1},
+        {"link, fill buffer", 1, 0, 0, {0, 0, 0, 60000}, 1, 0, 0},
+        {"link, read 50ms", 1, 0, 0, {0, 0, 0, 50}, 1, 0, 0},
+    };
+    int opt, i, ret, failed = 0;
+    uint32_t size = 1024 * 1024, buf_len = 128 * 1024, rate = 512, calls, ms;
+    char *out, *buf;
+    IOT_OTA_FetchStats_t stats;
+
+    while ((opt = getopt(argc, argv, "s:b:r:h")) != -1) {
+        switch (opt) {
+            case 's':
+                size = atoi(optarg);
+                break;
+            case 'b':
+                buf_len = atoi(optarg);
+                break;
+            case 'r':
+                rate = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-s image bytes] [-b buffer bytes] [-r bytes/ms of the link cases]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (0 == size || 0 == buf_len || 0 == rate) {
+        return -1;
+    }
+
+    LITE_openlog("ota");
+    LITE_set_loglevel(LOG_CRIT_LEVEL);
+    HAL_Kv_Del("iotx_ota");
+
+    if (0 != loopback_start(size)) {
+        return -1;
+    }
+    out = malloc(size);
+    buf = malloc(buf_len);
+
+    printf("image of %u bytes, buffer of %u bytes, link of %u bytes/ms\n", size, buf_len, rate);
+    printf("%-26s %5s %6s %8s %8s %9s %9s %7s %7s %8s  %s\n", "case", "conns", "stalls", "failures", "timeouts",
+           "KB/s", "read len", "calls", "ms/call", "ms", "result");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        loopback_reset();
+        loopback.rate = cases[i].link ? rate : 0;
+        loopback.head_delay = cases[i].head_delay;
+        loopback.stall = cases[i].stall_ms ? size / 2 : 0;
+        loopback.stall_ms = cases[i].stall_ms;
+        memset(out, 0, size);
+        memset(&stats, 0, sizeof(stats));
+
+        ret = test_download(out, buf, buf_len, &cases[i].config, &stats, &calls, &ms);
+        loopback_wait();
+        if (0 == ret && (stats.connections != cases[i].connections || stats.stalls != cases[i].stalls
+                         || stats.failures != cases[i].failures)) {
+            ret = -1;
+        }
+        if (0 == ret && cases[i].link) {
+            /* the rate is the one of the link, and a call waits about read_time_ms for it */
+            if (stats.rate < rate * 1000 * 3 / 4 || stats.rate > rate * 1000 * 5 / 4
+                || (cases[i].config.read_time_ms < 1000 && ms / calls > 2 * cases[i].config.read_time_ms)) {
+                ret = -1;
+            }
+        }
+        failed += (0 != ret);
+
+        printf("%-26s %5u %6u %8u %8u %9u %9u %7u %7u %8u  %s\n", cases[i].name, stats.connections,
+               stats.stalls, stats.failures, stats.timeouts, stats.rate / 1024, stats.read_len, calls,
+               ms / calls, ms, 0 == ret ? "ok" : "FAILED");
+    }
+
+    free(buf);
+    free(out);
+    LITE_closelog();
+
+    return failed;
+}
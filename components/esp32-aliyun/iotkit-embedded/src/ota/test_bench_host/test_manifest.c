@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Loopback test of the checks of the firmware. The server of loopback.c serves an image of N bytes
+ * and may send one byte of it wrong, the device side downloads it with IOT_OTA_FetchYield() or
+ * through the pipeline and checks it with the MD5 or the SHA-256 of the upgrade message, or block
+ * by block with a signed manifest.
+ *
+ *   ./test_manifest [-s image bytes]
+ *
+ * Every case prints the bytes the device received against the image size. Checked as a whole, a
+ * wrong byte is found once the whole image is downloaded; checked against the manifest, it is found
+ * at the end of its block, which is the only one fetched again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_sha256.h"
+#include "loopback.h"
+
+/* The manifest is signed with SHA-256(digest || TEST_KEY) here, a device would check a public key
+ * signature, e.g. with mbedtls_pk_verify() */
+#define TEST_KEY            "test key"
+
+static void test_sign(const unsigned char digest[32], unsigned char sign[32])
+{
+    unsigned char data[32 + sizeof(TEST_KEY) - 1];
+
+    memcpy(data, digest, 32);
+    memcpy(data + 32, TEST_KEY, sizeof(TEST_KEY) - 1);
+    utils_sha256(data, sizeof(data), sign);
+}
+
+static int test_verify(void *ctx, const unsigned char digest[32], const char *sign, uint32_t sign_len)
+{
+    unsigned char expected[32];
+
+    test_sign(digest, expected);
+    return (32 == sign_len && 0 == memcmp(sign, expected, 32)) ? 0 : -1;
+}
+
+/* the manifest of the image with blocks of @block_len bytes, its length in @len */
+static char *test_manifest(uint32_t block_len, uint32_t *len)
+{
+    uint32_t i, count = (loopback.size + block_len - 1) / block_len;
+    unsigned char *manifest, *p, digest[32];
+
+    *len = IOT_OTA_MANIFEST_HEADER_LEN + count * 32 + 32;
+    manifest = malloc(*len);
+
+    memcpy(manifest, IOT_OTA_MANIFEST_MAGIC, 4);
+    for (i = 0; i < 4; ++i) {
+        manifest[4 + i] = block_len >> (24 - 8 * i);
+        manifest[8 + i] = loopback.size >> (24 - 8 * i);
+    }
+    for (i = 0, p = manifest + IOT_OTA_MANIFEST_HEADER_LEN; i < count; ++i, p += 32) {
+        uint32_t n = (loopback.size - i * block_len < block_len) ? loopback.size - i * block_len : block_len;
+        utils_sha256((unsigned char *)loopback.image + i * block_len, n, p);
+    }
+
+    utils_sha256(manifest, p - manifest, digest);
+    test_sign(digest, p);
+
+    return (char *)manifest;
+}
+
+static int test_write(void *ctx, uint32_t offset, const char *buf, uint32_t len)
+{
+    memcpy((char *)ctx + offset, buf, len);
+    return 0;
+}
+
+/* download the image into @out with a manifest of @block_len bytes if not 0 */
+/* return 1 if the firmware is valid, 0 if not, -1 if the manifest is refused */
+static int test_download(char *out, char *buf, uint32_t buf_len, uint32_t block_len, int pipeline, int bad_sign)
+{
+    int len, mqtt = 0;
+    uint32_t offset, valid = 0, manifest_len;
+    char *manifest;
+    void *h_ota;
+    IOT_OTA_Sink_t sink = {test_write, NULL};
+    IOT_OTA_Verifier_t verifier = {test_verify, NULL};
+
+    sink.ctx = out;
+
+    h_ota = IOT_OTA_Init(LOOPBACK_PRODUCT_KEY, LOOPBACK_DEVICE_NAME, &mqtt);
+    if (NULL == h_ota) {
+        return -1;
+    }
+    if (pipeline) {
+        IOT_OTA_PipelineInit(h_ota, &sink, 4, buf_len);
+    }
+    loopback_upgrade();
+
+    if (block_len > 0) {
+        manifest = test_manifest(block_len, &manifest_len);
+        if (bad_sign) {
+            manifest[manifest_len - 1] ^= 1;
+        }
+        len = IOT_OTA_SetManifest(h_ota, manifest, manifest_len, &verifier);
+        free(manifest);
+        if (0 != len) {
+            IOT_OTA_Deinit(h_ota);
+            return -1;
+        }
+    }
+
+    do {
+        if (pipeline) {
+            IOT_OTA_PipelineFetch(h_ota, 5000);
+            IOT_OTA_PipelineFlush(h_ota, 0);
+        } else {
+            IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &offset, 4);
+            len = IOT_OTA_FetchYield(h_ota, buf, buf_len, 5);
+            if (len > 0) {
+                memcpy(out + offset, buf, len);
+            }
+        }
+    } while (!IOT_OTA_IsFetchFinish(h_ota));
+
+    if (IOT_OTAE_NONE == IOT_OTA_GetLastError(h_ota)) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &valid, 4);
+    }
+    IOT_OTA_Deinit(h_ota);
+
+    return (1 == valid && 0 == memcmp(out, loopback.image, loopback.size)) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *results[] = {"refused", "invalid", "valid"};
+    struct {
+        const char *name;
+        int sha256;
+        uint32_t block_len;
+        int corrupts;
+        int pipeline;
+        int bad_sign;
+        int expected;
+    } cases[] = {
+        {"md5", 0, 0, -1, 0, 0, 1},
+        {"md5, corrupt", 0, 0, 1, 0, 0, 0},
+        {"sha256", 1, 0, -1, 0, 0, 1},
+        {"sha256, corrupt", 1, 0, 1, 0, 0, 0},
+        {"manifest 64KB", 0, 64 * 1024, -1, 0, 0, 1},
+        {"manifest 64KB, corrupt", 0, 64 * 1024, 1, 0, 0, 1},
+        {"manifest 4KB, corrupt", 0, 4 * 1024, 1, 0, 0, 1},
+        {"manifest 4KB, pipeline", 0, 4 * 1024, 1, 1, 0, 1},
+        {"manifest, corrupt all", 0, 4 * 1024, 0, 0, 0, 0},
+        {"manifest, bad sign", 0, 4 * 1024, -1, 0, 1, -1},
+    };
+    int opt, i, ret, failed = 0;
+    uint32_t size = 1024 * 1024, buf_len = 4096;
+    char *out, *buf;
+
+    while ((opt = getopt(argc, argv, "s:h")) != -1) {
+        switch (opt) {
+            case 's':
+                size = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-s image bytes]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (size < 2) {
+        return -1;
+    }
+
+    LITE_openlog("ota");
+    LITE_set_loglevel(LOG_CRIT_LEVEL);
+
+    if (0 != loopback_start(size)) {
+        return -1;
+    }
+    out = malloc(size);
+    buf = malloc(buf_len);
+
+    printf("%-24s %12s %14s %12s %10s  %s\n", "case", "image bytes", "received bytes", "connections", "overhead",
+           "result");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        loopback_reset();
+        loopback.sha256 = cases[i].sha256;
+        if (cases[i].corrupts >= 0) {
+            /* the last byte of the 2nd KB of the 2nd quarter */
+            loopback.corrupt = size / 4 + 2047;
+            loopback.corrupts = cases[i].corrupts;
+        }
+        memset(out, 0, size);
+
+        ret = test_download(out, buf, buf_len, cases[i].block_len, cases[i].pipeline, cases[i].bad_sign);
+        failed += (ret != cases[i].expected);
+        loopback_wait();
+
+        printf("%-24s %12u %14u %12d %9.1f%%  %s%s\n", cases[i].name, size, loopback.received,
+               loopback.connections, 100.0 * ((double)loopback.received - size) / size, results[ret + 1],
+               ret == cases[i].expected ? "" : " FAILED");
+    }
+
+    free(buf);
+    free(out);
+    LITE_closelog();
+
+    return failed;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Loopback test of the OTA pipeline with a file-backed sink. The server of loopback.c sends the
+ * image at N bytes per millisecond over sockets with the few KB of buffer a device has, the sink
+ * writes it at F bytes per millisecond after E milliseconds to erase every 64KB, as a link and a
+ * flash would. The device downloads it
+ *
+ *   FetchYield : with IOT_OTA_FetchYield(), writing every chunk before fetching the next one
+ *   one task   : with IOT_OTA_PipelineFetch() and IOT_OTA_PipelineFlush() one after the other
+ *   two tasks  : with IOT_OTA_PipelineFlush() on a thread of its own
+ *
+ * and checks the file and its MD5.
+ *
+ *   ./test_pipeline [-s image bytes] [-n network bytes/ms] [-f flash bytes/ms] [-e erase ms]
+ *                   [-c buffers] [-b buffer bytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "loopback.h"
+
+#define TEST_FILE           "test_pipeline.bin"
+#define TEST_WINDOW         (8 * 1024)
+
+#define TEST_BLOCK_LEN      (64 * 1024)
+
+typedef struct {
+    int fd;
+    uint32_t rate;          /* bytes written per millisecond */
+    uint32_t erase_ms;      /* milliseconds to erase a block of TEST_BLOCK_LEN bytes before writing it */
+} test_sink_t;
+
+static int test_sink_write(void *ctx, uint32_t offset, const char *buf, uint32_t len)
+{
+    test_sink_t *sink = (test_sink_t *)ctx;
+
+    /* the time a flash takes to erase the blocks @len bytes start and program them */
+    if (0 == offset % TEST_BLOCK_LEN || offset / TEST_BLOCK_LEN != (offset + len - 1) / TEST_BLOCK_LEN) {
+        usleep(1000ULL * sink->erase_ms);
+    }
+    usleep(1000ULL * len / sink->rate);
+
+    return (len == pwrite(sink->fd, buf, len, offset)) ? 0 : -1;
+}
+
+static void *test_flush_routine(void *h_ota)
+{
+    while (!IOT_OTA_IsFetchFinish(h_ota)) {
+        if (IOT_OTA_PipelineFlush(h_ota, 100) < 0) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* 0, FetchYield; 1, one task; 2, two tasks */
+/* return 0 if the file and its MD5 are right */
+static int test_download(int mode, test_sink_t *sink, uint32_t buf_count, uint32_t buf_len,
+                         IOT_OTA_PipelineStats_t *stats)
+{
+    int len, ret = 0, mqtt = 0;
+    uint32_t offset, valid = 0;
+    void *h_ota;
+    char *buf = NULL, *out;
+    pthread_t thread;
+    IOT_OTA_Sink_t ota_sink = {test_sink_write, NULL};
+
+    memset(stats, 0, sizeof(IOT_OTA_PipelineStats_t));
+    ota_sink.ctx = sink;
+
+    h_ota = IOT_OTA_Init(LOOPBACK_PRODUCT_KEY, LOOPBACK_DEVICE_NAME, &mqtt);
+    if (NULL == h_ota) {
+        return -1;
+    }
+
+    if (0 == mode) {
+        buf = malloc(buf_len);
+    } else if (0 != IOT_OTA_PipelineInit(h_ota, &ota_sink, buf_count, buf_len)) {
+        IOT_OTA_Deinit(h_ota);
+        return -1;
+    }
+    loopback_upgrade();
+
+    if (2 == mode) {
+        pthread_create(&thread, NULL, test_flush_routine, h_ota);
+    }
+
+    do {
+        if (0 == mode) {
+            IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &offset, 4);
+            len = IOT_OTA_FetchYield(h_ota, buf, buf_len, 5);
+            if (len > 0) {
+                ret = test_sink_write(sink, offset, buf, len);
+            }
+        } else {
+            len = IOT_OTA_PipelineFetch(h_ota, 100);
+            if (1 == mode && len >= 0) {
+                len = IOT_OTA_PipelineFlush(h_ota, 100);
+            }
+        }
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &offset, 4);
+    } while (len >= 0 && 0 == ret && offset < loopback.size);
+
+    if (2 == mode) {
+        pthread_join(thread, NULL);
+    } else if (1 == mode) {
+        while (!IOT_OTA_IsFetchFinish(h_ota) && IOT_OTA_PipelineFlush(h_ota, 100) >= 0);
+    }
+
+    if (IOT_OTA_IsFetchFinish(h_ota) && IOT_OTAE_NONE == IOT_OTA_GetLastError(h_ota)) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &valid, 4);
+    }
+    if (0 != mode) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_PIPELINE_STATS, stats, sizeof(IOT_OTA_PipelineStats_t));
+    }
+    IOT_OTA_Deinit(h_ota);
+    free(buf);
+
+    out = malloc(loopback.size);
+    ret = (loopback.size == pread(sink->fd, out, loopback.size, 0)) ? 0 : -1;
+    ret = (0 == ret && 1 == valid && 0 == memcmp(out, loopback.image, loopback.size)) ? 0 : -1;
+    free(out);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *modes[] = {"FetchYield", "one task", "two tasks"};
+    int opt, i, ret, failed = 0;
+    uint32_t size = 1024 * 1024, net_rate = 1024, buf_count = 8, buf_len = 4096, start, elapsed;
+    test_sink_t sink;
+    IOT_OTA_PipelineStats_t stats;
+
+    sink.rate = 4096;
+    sink.erase_ms = 32;
+    while ((opt = getopt(argc, argv, "s:n:f:e:c:b:h")) != -1) {
+        switch (opt) {
+            case 's':
+                size = atoi(optarg);
+                break;
+            case 'n':
+                net_rate = atoi(optarg);
+                break;
+            case 'f':
+                sink.rate = atoi(optarg);
+                break;
+            case 'e':
+                sink.erase_ms = atoi(optarg);
+                break;
+            case 'c':
+                buf_count = atoi(optarg);
+                break;
+            case 'b':
+                buf_len = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-s image bytes] [-n network bytes/ms] [-f flash bytes/ms] [-e erase ms] "
+                       "[-c buffers] [-b buffer bytes]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (0 == size || 0 == sink.rate || 0 == buf_count || 0 == buf_len) {
+        return -1;
+    }
+
+    LITE_openlog("ota");
+    LITE_set_loglevel(LOG_CRIT_LEVEL);
+
+    if (0 != loopback_start(size)) {
+        return -1;
+    }
+
+    printf("%u bytes, network %u bytes/ms, flash %u bytes/ms and %u ms per 64KB, %u buffers of %u bytes\n",
+           size, net_rate, sink.rate, sink.erase_ms, buf_count, buf_len);
+    printf("%-12s %8s %8s | %17s | %8s | %17s | %s\n", "", "ms", "KB/s", "fetch busy/stall", "hash",
+           "sink busy/stall", "result");
+
+    for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        loopback_reset();
+        loopback.rate = net_rate;
+        loopback.window = TEST_WINDOW;
+
+        sink.fd = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (sink.fd < 0) {
+            return -1;
+        }
+
+        start = HAL_UptimeMs();
+        ret = test_download(i, &sink, buf_count, buf_len, &stats);
+        elapsed = HAL_UptimeMs() - start;
+        failed += (0 != ret);
+        loopback_wait();
+
+        close(sink.fd);
+        unlink(TEST_FILE);
+
+        printf("%-12s %8u %8.0f | %8u %8u | %8u | %8u %8u | %s\n", modes[i], elapsed,
+               elapsed ? size * 1000.0 / 1024 / elapsed : 0.0,
+               stats.fetch.busy_ms, stats.fetch.stall_ms, stats.hash.busy_ms,
+               stats.sink.busy_ms, stats.sink.stall_ms, 0 == ret ? "ok" : "FAILED");
+    }
+
+    LITE_closelog();
+
+    return failed;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Loopback test of the resumable OTA download. The server of loopback.c serves an image of N bytes
+ * and closes the connection after every D bytes of body, the device side downloads it with
+ * IOT_OTA_FetchYield() as an application does and checks the image and its MD5.
+ *
+ *   ./test_resume [-s image bytes] [-b buffer bytes]
+ *
+ * Every case prints the bytes the device received against the image size. Without Range requests
+ * a download would start from byte 0 on every connection, and never finish when D < N.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "loopback.h"
+
+/* download the image into @out, the OTA module is deinitialized once at @reboot_at bytes if not 0 */
+/* return 0 if the image and its MD5 are right */
+static int test_download(char *out, char *buf, uint32_t buf_len, uint32_t checkpoint, uint32_t reboot_at)
+{
+    int len, rebooted = 0, mqtt = 0;
+    uint32_t offset, valid = 0;
+    void *h_ota = NULL;
+
+    do {
+        if (NULL == h_ota) {
+            h_ota = IOT_OTA_Init(LOOPBACK_PRODUCT_KEY, LOOPBACK_DEVICE_NAME, &mqtt);
+            if (NULL == h_ota) {
+                return -1;
+            }
+            IOT_OTA_SetCheckpoint(h_ota, checkpoint);
+            loopback_upgrade();
+        }
+
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &offset, 4);
+        len = IOT_OTA_FetchYield(h_ota, buf, buf_len, 5);
+        if (len > 0) {
+            memcpy(out + offset, buf, len);
+        }
+
+        if (!rebooted && reboot_at > 0 && offset + len >= reboot_at) {
+            /* power loss: the bytes since the last checkpoint are gone with it */
+            IOT_OTA_Deinit(h_ota);
+            h_ota = NULL;
+            rebooted = 1;
+        }
+    } while (NULL == h_ota || !IOT_OTA_IsFetchFinish(h_ota));
+
+    if (IOT_OTAE_NONE == IOT_OTA_GetLastError(h_ota)) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &valid, 4);
+    }
+    IOT_OTA_Deinit(h_ota);
+
+    return (1 == valid && 0 == memcmp(out, loopback.image, loopback.size)) ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct {
+        const char *name;
+        uint32_t drop;
+        int drops;
+        int ignore_range;
+        uint32_t checkpoint;
+        uint32_t reboot_at;
+    } cases[] = {
+        {"one connection", 0, 0, 0, 0, 0},
+        {"drop / 256KB", 256 * 1024, 0, 0, 0, 0},
+        {"drop / 64KB", 64 * 1024, 0, 0, 0, 0},
+        {"drop / 16KB", 16 * 1024, 0, 0, 0, 0},
+        {"drop, range ignored", 512 * 1024, 1, 1, 0, 0},
+        {"reboot, ckpt 64KB", 0, 0, 0, 64 * 1024, 1},
+        {"reboot, no ckpt", 0, 0, 0, 0, 1},
+    };
+    int opt, i, failed = 0;
+    uint32_t size = 1024 * 1024, buf_len = 4096;
+    char *out, *buf;
+
+    while ((opt = getopt(argc, argv, "s:b:h")) != -1) {
+        switch (opt) {
+            case 's':
+                size = atoi(optarg);
+                break;
+            case 'b':
+                buf_len = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-s image bytes] [-b buffer bytes]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (0 == size || 0 == buf_len) {
+        return -1;
+    }
+
+    LITE_openlog("ota");
+    LITE_set_loglevel(LOG_CRIT_LEVEL);
+    HAL_Kv_Del("iotx_ota");
+
+    if (0 != loopback_start(size)) {
+        return -1;
+    }
+    out = malloc(size);
+    buf = malloc(buf_len);
+
+    printf("%-20s %12s %14s %12s %10s  %s\n", "case", "image bytes", "received bytes", "connections", "overhead",
+           "result");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int ret;
+
+        loopback_reset();
+        loopback.drop = cases[i].drop;
+        loopback.drops = cases[i].drops;
+        loopback.ignore_range = cases[i].ignore_range;
+        memset(out, 0, size);
+
+        ret = test_download(out, buf, buf_len, cases[i].checkpoint, cases[i].reboot_at ? size / 2 : 0);
+        failed += (0 != ret);
+        loopback_wait();
+
+        printf("%-20s %12u %14u %12d %9.1f%%  %s\n", cases[i].name, size, loopback.received,
+               loopback.connections, 100.0 * (loopback.received - size) / size, 0 == ret ? "ok" : "FAILED");
+    }
+
+    free(buf);
+    free(out);
+    LITE_closelog();
+
+    return failed;
+}
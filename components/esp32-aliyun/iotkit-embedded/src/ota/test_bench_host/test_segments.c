@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Loopback benchmark of the segmented download. The server of loopback.c answers every request
+ * after a round trip of R milliseconds, two on a new connection, and sends a response no faster
+ * than a TCP window of W bytes a round trip, as a connection to a distant server would; all the
+ * connections together share a link of L bytes per millisecond. The device downloads the image
+ * through the pipeline, flushed by a thread of its own into memory, on one connection and with
+ * IOT_OTA_PipelineSegments(), and checks the image and its MD5, or every block against a manifest.
+ *
+ *   ./test_segments [-s image bytes] [-r round trip ms] [-w window bytes] [-l link bytes/ms]
+ *                   [-c buffers] [-b buffer bytes]
+ *
+ * Every case prints the rate of the download, the connections it was on at the end, the requests
+ * and the connections opened. The segments take connections while the rate grows and stop at the
+ * ones the link carries, about L * R / W of them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-log.h"
+#include "utils_sha256.h"
+#include "loopback.h"
+
+/* the manifest is signed with a plain SHA-256 of its digest here, see test_manifest.c */
+static int test_verify(void *ctx, const unsigned char digest[32], const char *sign, uint32_t sign_len)
+{
+    unsigned char expected[32];
+
+    utils_sha256(digest, 32, expected);
+    return (32 == sign_len && 0 == memcmp(sign, expected, 32)) ? 0 : -1;
+}
+
+/* the manifest of the image with blocks of @block_len bytes, its length in @len */
+static char *test_manifest(uint32_t block_len, uint32_t *len)
+{
+    uint32_t i, n, count = (loopback.size + block_len - 1) / block_len;
+    unsigned char *manifest, *p, digest[32];
+
+    *len = IOT_OTA_MANIFEST_HEADER_LEN + count * 32 + 32;
+    manifest = malloc(*len);
+
+    memcpy(manifest, IOT_OTA_MANIFEST_MAGIC, 4);
+    for (i = 0; i < 4; ++i) {
+        manifest[4 + i] = block_len >> (24 - 8 * i);
+        manifest[8 + i] = loopback.size >> (24 - 8 * i);
+    }
+    for (i = 0, p = manifest + IOT_OTA_MANIFEST_HEADER_LEN; i < count; ++i, p += 32) {
+        n = (loopback.size - i * block_len < block_len) ? loopback.size - i * block_len : block_len;
+        utils_sha256((unsigned char *)loopback.image + i * block_len, n, p);
+    }
+
+    utils_sha256(manifest, p - manifest, digest);
+    utils_sha256(digest, 32, p);
+
+    return (char *)manifest;
+}
+
+static int test_write(void *ctx, uint32_t offset, const char *buf, uint32_t len)
+{
+    memcpy((char *)ctx + offset, buf, len);
+    return 0;
+}
+
+static void *test_flush_routine(void *h_ota)
+{
+    while (!IOT_OTA_IsFetchFinish(h_ota)) {
+        if (IOT_OTA_PipelineFlush(h_ota, 100) < 0) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* download the image into @out on up to @connections connections, 0 without segments, and with a */
+/* manifest of @block_len bytes if not 0; the time in @p_ms */
+/* return 0 if the image and its check are right */
+static int test_download(char *out, uint32_t buf_count, uint32_t buf_len, uint32_t connections,
+                         uint32_t block_len, IOT_OTA_FetchStats_t *stats, uint32_t *p_ms)
+{
+    int len, mqtt = 0;
+    uint32_t offset, valid = 0, manifest_len, start;
+    char *manifest;
+    void *h_ota;
+    pthread_t thread;
+    IOT_OTA_Sink_t sink = {test_write, NULL};
+    IOT_OTA_Verifier_t verifier = {test_verify, NULL};
+
+    sink.ctx = out;
+
+    h_ota = IOT_OTA_Init(LOOPBACK_PRODUCT_KEY, LOOPBACK_DEVICE_NAME, &mqtt);
+    if (NULL == h_ota) {
+        return -1;
+    }
+    if (0 != IOT_OTA_PipelineInit(h_ota, &sink, buf_count, buf_len)
+        || (connections > 0 && 0 != IOT_OTA_PipelineSegments(h_ota, connections))) {
+        IOT_OTA_Deinit(h_ota);
+        return -1;
+    }
+    loopback_upgrade();
+
+    if (block_len > 0) {
+        manifest = test_manifest(block_len, &manifest_len);
+        len = IOT_OTA_SetManifest(h_ota, manifest, manifest_len, &verifier);
+        free(manifest);
+        if (0 != len) {
+            IOT_OTA_Deinit(h_ota);
+            return -1;
+        }
+    }
+
+    start = HAL_UptimeMs();
+    pthread_create(&thread, NULL, test_flush_routine, h_ota);
+    do {
+        len = IOT_OTA_PipelineFetch(h_ota, 100);
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &offset, 4);
+    } while (len >= 0 && offset < loopback.size);
+    pthread_join(thread, NULL);
+    *p_ms = HAL_UptimeMs() - start;
+
+    IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCH_STATS, stats, sizeof(IOT_OTA_FetchStats_t));
+    if (IOT_OTA_IsFetchFinish(h_ota) && IOT_OTAE_NONE == IOT_OTA_GetLastError(h_ota)) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &valid, 4);
+    }
+    IOT_OTA_Deinit(h_ota);
+
+    return (1 == valid && 0 == memcmp(out, loopback.image, loopback.size)) ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct {
+        const char *name;
+        uint32_t connections;       /* most, 0 without segments */
+        int link;                   /* limited to -l */
+        int manifest;               /* blocks of a quarter of a buffer */
+        uint32_t drop;              /* bytes the first connections send before closing */
+        uint32_t corrupt;           /* offset of a byte the first connection sends wrong, its segment is
+                                     * fetched again */
+        uint32_t parallel_min;      /* connections expected at the end */
+        uint32_t parallel_max;
+        uint32_t speedup;           /* in tenths, at least, over the first case */
+    } cases[] = {
+        {"one connection", 0, 1, 0, 0, 0, 1, 1, 0},
+        {"segments, 1", 1, 1, 0, 0, 0, 1, 1, 7},
+        {"segments, up to 8", 8, 1, 0, 0, 0, 3, 6, 20},
+        {"segments, no link limit", 8, 0, 0, 0, 0, 6, 8, 23},
+        {"segments, manifest", 8, 1, 1, 0, 0, 3, 6, 20},
+        {"manifest, corrupt", 8, 1, 1, 0, 1000, 1, 8, 0},
+        {"segments, dropped", 8, 1, 0, 100000, 0, 1, 8, 0},
+    };
+    int opt, i, ret, failed = 0;
+    uint32_t size = 4 * 1024 * 1024, rtt = 40, window = 16 * 1024, link = 1600;
+    uint32_t buf_count = 16, buf_len = 64 * 1024, ms, base_ms = 0;
+    char *out;
+    IOT_OTA_FetchStats_t stats;
+
+    while ((opt = getopt(argc, argv, "s:r:w:l:c:b:h")) != -1) {
+        switch (opt) {
+            case 's':
+                size = atoi(optarg);
+                break;
+            case 'r':
+                rtt = atoi(optarg);
+                break;
+            case 'w':
+                window = atoi(optarg);
+                break;
+            case 'l':
+                link = atoi(optarg);
+                break;
+            case 'c':
+                buf_count = atoi(optarg);
+                break;
+            case 'b':
+                buf_len = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-s image bytes] [-r round trip ms] [-w window bytes] [-l link bytes/ms]"
+                       " [-c buffers] [-b buffer bytes]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (0 == size || 0 == rtt || window < rtt || 0 == link || 0 == buf_count || 0 == buf_len) {
+        return -1;
+    }
+
+    LITE_openlog("ota");
+    LITE_set_loglevel(LOG_CRIT_LEVEL);
+    HAL_Kv_Del("iotx_ota");
+
+    if (0 != loopback_start(size)) {
+        return -1;
+    }
+    out = malloc(size);
+
+    printf("image of %u bytes, round trip of %u ms, window of %u bytes, link of %u bytes/ms, "
+           "%u buffers of %u bytes\n", size, rtt, window, link, buf_count, buf_len);
+    printf("%-24s %9s %8s %8s %6s %8s %8s  %s\n", "case", "KB/s", "parallel", "requests", "conns",
+           "received", "ms", "result");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        loopback_reset();
+        loopback.rtt = rtt;
+        loopback.rate = window / rtt;
+        loopback.link_rate = cases[i].link ? link : 0;
+        loopback.drop = cases[i].drop;
+        loopback.drops = cases[i].drop ? 2 : 0;
+        loopback.corrupt = cases[i].corrupt;
+        loopback.corrupts = 1;
+        memset(out, 0, size);
+        memset(&stats, 0, sizeof(stats));
+
+        ret = test_download(out, buf_count, buf_len, cases[i].connections,
+                            cases[i].manifest ? buf_len / 4 : 0, &stats, &ms);
+        loopback_wait();
+        if (0 == ret && (stats.parallel < cases[i].parallel_min || stats.parallel > cases[i].parallel_max
+                         || (cases[i].corrupt && loopback.received < size + buf_len))) {
+            ret = -1;
+        }
+        if (0 == i) {
+            base_ms = ms;
+        } else if (0 == ret && ms * cases[i].speedup > base_ms * 10) {
+            ret = -1;
+        }
+        failed += (0 != ret);
+
+        printf("%-24s %9u %8u %8u %6u %8u %8u  %s\n", cases[i].name, (uint32_t)(1000ULL * size / ms / 1024),
+               stats.parallel, stats.requests, stats.connections, loopback.received, ms,
+               0 == ret ? "ok" : "FAILED");
+    }
+
+    free(out);
+    LITE_closelog();
+
+    return failed;
+}
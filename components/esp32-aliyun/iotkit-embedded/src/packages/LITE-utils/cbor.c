@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <math.h>
+
+#include "lite-utils_internal.h"
+
+#define LITE_CBOR_MAX_DEPTH         (16)
+
+#define LITE_CBOR_MAJOR_UINT        (0)
+#define LITE_CBOR_MAJOR_NEGINT      (1)
+#define LITE_CBOR_MAJOR_BYTES       (2)
+#define LITE_CBOR_MAJOR_TEXT        (3)
+#define LITE_CBOR_MAJOR_ARRAY       (4)
+#define LITE_CBOR_MAJOR_MAP         (5)
+#define LITE_CBOR_MAJOR_TAG         (6)
+#define LITE_CBOR_MAJOR_SIMPLE      (7)
+
+static void _cbor_put_raw(lite_cbor_writer_t *writer, const uint8_t *data, uint32_t len)
+{
+    if (writer->overflow || writer->offset + len > writer->size) {
+        writer->overflow = 1;
+    } else if (len > 0) {
+        memcpy(writer->buf + writer->offset, data, len);
+    }
+    writer->offset += len;
+}
+
+static void _cbor_put_head(lite_cbor_writer_t *writer, int major, uint64_t value)
+{
+    uint8_t     head[9];
+    uint32_t    len, i;
+
+    if (value < 24) {
+        head[0] = (uint8_t)((major << 5) | value);
+        len = 1;
+    } else if (value <= 0xFF) {
+        head[0] = (uint8_t)((major << 5) | 24);
+        len = 2;
+    } else if (value <= 0xFFFF) {
+        head[0] = (uint8_t)((major << 5) | 25);
+        len = 3;
+    } else if (value <= 0xFFFFFFFFULL) {
+        head[0] = (uint8_t)((major << 5) | 26);
+        len = 5;
+    } else {
+        head[0] = (uint8_t)((major << 5) | 27);
+        len = 9;
+    }
+
+    /* the argument in network byte order */
+    for (i = len - 1; i > 0; --i) {
+        head[i] = (uint8_t)(value & 0xFF);
+        value >>= 8;
+    }
+
+    _cbor_put_raw(writer, head, len);
+}
+
+void LITE_cbor_writer_init(lite_cbor_writer_t *writer, uint8_t *buf, uint32_t size)
+{
+    writer->buf = buf;
+    writer->size = (NULL == buf) ? 0 : size;
+    writer->offset = 0;
+    writer->overflow = 0;
+}
+
+void LITE_cbor_put_uint(lite_cbor_writer_t *writer, uint64_t value)
+{
+    _cbor_put_head(writer, LITE_CBOR_MAJOR_UINT, value);
+}
+
+void LITE_cbor_put_int(lite_cbor_writer_t *writer, int64_t value)
+{
+    if (value < 0) {
+        /* -1 - value, without overflow at INT64_MIN */
+        _cbor_put_head(writer, LITE_CBOR_MAJOR_NEGINT, (uint64_t)(-(value + 1)));
+    } else {
+        _cbor_put_head(writer, LITE_CBOR_MAJOR_UINT, (uint64_t)value);
+    }
+}
+
+void LITE_cbor_put_double(lite_cbor_writer_t *writer, double value)
+{
+    uint8_t     buf[9];
+    uint64_t    bits;
+    uint32_t    bits32;
+    float       single = (float)value;
+    int         i;
+
+    /* single precision when nothing is lost */
+    if ((double)single == value) {
+        memcpy(&bits32, &single, sizeof(bits32));
+        buf[0] = (LITE_CBOR_MAJOR_SIMPLE << 5) | 26;
+        for (i = 4; i > 0; --i) {
+            buf[i] = (uint8_t)(bits32 & 0xFF);
+            bits32 >>= 8;
+        }
+        _cbor_put_raw(writer, buf, 5);
+        return;
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+    buf[0] = (LITE_CBOR_MAJOR_SIMPLE << 5) | 27;
+    for (i = 8; i > 0; --i) {
+        buf[i] = (uint8_t)(bits & 0xFF);
+        bits >>= 8;
+    }
+    _cbor_put_raw(writer, buf, 9);
+}
+
+void LITE_cbor_put_bool(lite_cbor_writer_t *writer, int value)
+{
+    uint8_t     simple = (LITE_CBOR_MAJOR_SIMPLE << 5) | (value ? 21 : 20);
+
+    _cbor_put_raw(writer, &simple, 1);
+}
+
+void LITE_cbor_put_null(lite_cbor_writer_t *writer)
+{
+    uint8_t     simple = (LITE_CBOR_MAJOR_SIMPLE << 5) | 22;
+
+    _cbor_put_raw(writer, &simple, 1);
+}
+
+void LITE_cbor_put_text(lite_cbor_writer_t *writer, const char *text, uint32_t len)
+{
+    _cbor_put_head(writer, LITE_CBOR_MAJOR_TEXT, len);
+    _cbor_put_raw(writer, (const uint8_t *)text, len);
+}
+
+void LITE_cbor_put_bytes(lite_cbor_writer_t *writer, const uint8_t *data, uint32_t len)
+{
+    _cbor_put_head(writer, LITE_CBOR_MAJOR_BYTES, len);
+    _cbor_put_raw(writer, data, len);
+}
+
+void LITE_cbor_put_array(lite_cbor_writer_t *writer, uint32_t items)
+{
+    _cbor_put_head(writer, LITE_CBOR_MAJOR_ARRAY, items);
+}
+
+void LITE_cbor_put_map(lite_cbor_writer_t *writer, uint32_t pairs)
+{
+    _cbor_put_head(writer, LITE_CBOR_MAJOR_MAP, pairs);
+}
+
+void LITE_cbor_reader_init(lite_cbor_reader_t *reader, const uint8_t *buf, uint32_t len)
+{
+    reader->buf = buf;
+    reader->len = len;
+    reader->offset = 0;
+}
+
+static int _cbor_get_bytes(lite_cbor_reader_t *reader, uint32_t len, uint64_t *value)
+{
+    uint32_t    i;
+
+    if (reader->len - reader->offset < len) {
+        return -1;
+    }
+
+    for (*value = 0, i = 0; i < len; ++i) {
+        *value = (*value << 8) | reader->buf[reader->offset++];
+    }
+
+    return 0;
+}
+
+/* IEEE 754 half precision, as RFC 7049 appendix D */
+static double _cbor_half_to_double(uint32_t half)
+{
+    int         exponent = (half >> 10) & 0x1F;
+    double      mantissa = half & 0x3FF, value;
+
+    if (0 == exponent) {
+        value = mantissa / (1 << 24);
+    } else if (31 == exponent) {
+        value = (0 == mantissa) ? HUGE_VAL : (HUGE_VAL - HUGE_VAL);
+    } else {
+        value = (mantissa + 1024) * ((exponent >= 25) ? (double)(1 << (exponent - 25)) : 1.0 / (1 << (25 - exponent)));
+    }
+
+    return (half & 0x8000) ? -value : value;
+}
+
+/* read the head of the next item, and the payload of BYTES and TEXT; 0 on success, -1 if malformed */
+int LITE_cbor_get(lite_cbor_reader_t *reader, lite_cbor_item_t *item)
+{
+    uint8_t     initial;
+    int         major, info;
+    uint64_t    value;
+    uint32_t    bits32;
+    float       single;
+
+    do {
+        if (reader->offset >= reader->len) {
+            return -1;
+        }
+        initial = reader->buf[reader->offset++];
+        major = initial >> 5;
+        info = initial & 0x1F;
+
+        if (info < 24) {
+            value = info;
+        } else if (info <= 27) {
+            if (0 != _cbor_get_bytes(reader, 1 << (info - 24), &value)) {
+                return -1;
+            }
+        } else {
+            /* reserved, or indefinite length which is not supported */
+            return -1;
+        }
+        /* tags carry no meaning here, the tagged item follows */
+    } while (LITE_CBOR_MAJOR_TAG == major);
+
+    item->value = value;
+    item->data = NULL;
+    item->real = 0;
+
+    switch (major) {
+        case LITE_CBOR_MAJOR_UINT:
+            item->type = LITE_CBOR_UINT;
+            break;
+        case LITE_CBOR_MAJOR_NEGINT:
+            item->type = LITE_CBOR_NEGINT;
+            break;
+        case LITE_CBOR_MAJOR_BYTES:
+        case LITE_CBOR_MAJOR_TEXT:
+            if (value > reader->len - reader->offset) {
+                return -1;
+            }
+            item->type = (LITE_CBOR_MAJOR_BYTES == major) ? LITE_CBOR_BYTES : LITE_CBOR_TEXT;
+            item->data = reader->buf + reader->offset;
+            reader->offset += (uint32_t)value;
+            break;
+        case LITE_CBOR_MAJOR_ARRAY:
+            item->type = LITE_CBOR_ARRAY;
+            break;
+        case LITE_CBOR_MAJOR_MAP:
+            item->type = LITE_CBOR_MAP;
+            break;
+        default:
+            if (20 == info) {
+                item->type = LITE_CBOR_FALSE;
+            } else if (21 == info) {
+                item->type = LITE_CBOR_TRUE;
+            } else if ((22 == info) || (23 == info)) {
+                item->type = LITE_CBOR_NULL;
+            } else if (25 == info) {
+                item->type = LITE_CBOR_FLOAT;
+                item->real = _cbor_half_to_double((uint32_t)value);
+                item->value = 2;
+            } else if (26 == info) {
+                bits32 = (uint32_t)value;
+                memcpy(&single, &bits32, sizeof(single));
+                item->type = LITE_CBOR_FLOAT;
+                item->real = single;
+                item->value = 4;
+            } else if (27 == info) {
+                memcpy(&item->real, &value, sizeof(item->real));
+                item->type = LITE_CBOR_FLOAT;
+                item->value = 8;
+            } else {
+                return -1;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+/* skip the next item and everything it contains */
+int LITE_cbor_skip(lite_cbor_reader_t *reader)
+{
+    uint64_t            pending = 1;
+    lite_cbor_item_t    item;
+
+    while (pending > 0) {
+        if (0 != LITE_cbor_get(reader, &item)) {
+            return -1;
+        }
+        --pending;
+
+        if (LITE_CBOR_ARRAY == item.type) {
+            pending += item.value;
+        } else if (LITE_CBOR_MAP == item.type) {
+            pending += item.value * 2;
+        }
+
+        /* every item takes one byte at least, a larger count is a lie */
+        if (pending > reader->len - reader->offset) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Convert the CBOR document @cbor to JSON text in @json of @size bytes, NUL-terminated when it fits.
+ * Return the length of the JSON text, which is >= @size if it does not fit, or -1 if @cbor is
+ * malformed or nested deeper than LITE_CBOR_MAX_DEPTH. Pass a NULL @json to get the length only.
+ */
+int LITE_cbor_to_json(const uint8_t *cbor, uint32_t len, char *json, uint32_t size)
+{
+    struct {
+        uint64_t    items;
+        uint64_t    index;
+        int         is_map;
+    }                   stack[LITE_CBOR_MAX_DEPTH];
+    int                 depth = 0, is_key, key_len;
+    char                key[LITE_JSON_INT_LEN + 1];
+    lite_cbor_reader_t  reader;
+    lite_cbor_item_t    item;
+    lite_json_writer_t  writer;
+
+    LITE_cbor_reader_init(&reader, cbor, len);
+    LITE_json_writer_init(&writer, json, size);
+
+    do {
+        is_key = 0;
+        if (depth > 0) {
+            if (stack[depth - 1].index == stack[depth - 1].items) {
+                if (stack[depth - 1].is_map) {
+                    LITE_json_put_object_end(&writer);
+                } else {
+                    LITE_json_put_array_end(&writer);
+                }
+                --depth;
+                continue;
+            }
+
+            is_key = stack[depth - 1].is_map && !(stack[depth - 1].index & 1);
+            ++stack[depth - 1].index;
+        }
+
+        if (0 != LITE_cbor_get(&reader, &item)) {
+            return -1;
+        }
+
+        /* JSON keys are strings, integer keys are quoted */
+        if (is_key) {
+            if (LITE_CBOR_TEXT == item.type) {
+                LITE_json_put_key(&writer, (const char *)item.data, (uint32_t)item.value);
+                continue;
+            }
+            if (LITE_CBOR_UINT == item.type) {
+                key_len = LITE_json_format_uint(key, item.value);
+            } else if ((LITE_CBOR_NEGINT == item.type) && (0xFFFFFFFFFFFFFFFFULL != item.value)) {
+                key[0] = '-';
+                key_len = 1 + LITE_json_format_uint(key + 1, item.value + 1);
+            } else if (LITE_CBOR_NEGINT == item.type) {
+                memcpy(key, "-18446744073709551616", 21);
+                key_len = 21;
+            } else {
+                return -1;
+            }
+            LITE_json_put_key(&writer, key, key_len);
+            continue;
+        }
+
+        switch (item.type) {
+            case LITE_CBOR_UINT:
+                LITE_json_put_uint(&writer, item.value);
+                break;
+            case LITE_CBOR_NEGINT:
+                if (0xFFFFFFFFFFFFFFFFULL == item.value) {
+                    LITE_json_put_number(&writer, "-18446744073709551616", 21);
+                } else {
+                    key[0] = '-';
+                    key_len = 1 + LITE_json_format_uint(key + 1, item.value + 1);
+                    LITE_json_put_number(&writer, key, key_len);
+                }
+                break;
+            case LITE_CBOR_TEXT:
+                LITE_json_put_string(&writer, (const char *)item.data, (uint32_t)item.value);
+                break;
+            case LITE_CBOR_BYTES:
+                LITE_json_put_base64(&writer, item.data, (uint32_t)item.value);
+                break;
+            case LITE_CBOR_ARRAY:
+            case LITE_CBOR_MAP:
+                if (depth >= LITE_CBOR_MAX_DEPTH) {
+                    return -1;
+                }
+                stack[depth].is_map = (LITE_CBOR_MAP == item.type);
+                stack[depth].items = stack[depth].is_map ? item.value * 2 : item.value;
+                stack[depth].index = 0;
+                if ((item.value > len) || (stack[depth].items > reader.len - reader.offset)) {
+                    return -1;
+                }
+                if (stack[depth].is_map) {
+                    LITE_json_put_object(&writer);
+                } else {
+                    LITE_json_put_array(&writer);
+                }
+                ++depth;
+                break;
+            case LITE_CBOR_FALSE:
+                LITE_json_put_bool(&writer, 0);
+                break;
+            case LITE_CBOR_TRUE:
+                LITE_json_put_bool(&writer, 1);
+                break;
+            case LITE_CBOR_FLOAT:
+                if (8 == item.value) {
+                    LITE_json_put_double(&writer, item.real);
+                } else {
+                    LITE_json_put_float(&writer, (float)item.real);
+                }
+                break;
+            default:
+                LITE_json_put_null(&writer);
+                break;
+        }
+    } while (depth > 0);
+
+    if (reader.offset != len) {
+        return -1;
+    }
+
+    /* an overflowed writer still counts, the length tells the size needed */
+    LITE_json_writer_finish(&writer);
+
+    return (int)writer.len;
+}
@@ -35,136 +35,142 @@ typedef struct JSON_NV {
     char       *pV;
 } JSON_NV;
 
+/* json_get_next_object() is bounded by the NUL only */
+#define JSON_UNBOUNDED_LEN      (0x7FFFFFFF)
+
+#define json_is_blank(c)        ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
 char *json_get_object(int type, char *str)
 {
-    char *pos = 0;
     char ch = (type == JOBJECT) ? '{' : '[';
-    while (str != 0 && *str != 0) {
-        if (*str == ' ') {
-            str++;
-            continue;
-        }
-        pos = (*str == ch) ? str : 0;
-        break;
+
+    if (str == 0) {
+        return 0;
+    }
+    while (json_is_blank(*str)) {
+        str++;
     }
-    return pos;
+    return (*str == ch) ? str : 0;
 }
 
-char *json_get_next_object(int type, char *str, char **key, int *key_len,
-                           char **val, int *val_len, int *val_type)
+char *json_get_next_object_bounded(int type, char *str, int len, char **key, int *key_len,
+                                   char **val, int *val_len, int *val_type)
 {
-    char    JsonMark[JTYPEMAX][2] = { { '\"', '\"' }, { '{', '}' }, { '[', ']' }, { '0', ' ' } };
-    int     iMarkDepth = 0, iValueType = JNONE, iNameLen = 0, iValueLen = 0;
-    char   *p_cName = 0, *p_cValue = 0, *p_cPos = str;
+    int     iValueType = JNONE, pos = 0, end = 0;
+
+    while (pos < len && json_is_blank(str[pos])) {
+        pos++;
+    }
+    /* step over the opening mark or the separator */
+    if (pos < len && (str[pos] == (type == JOBJECT ? '{' : '[') || str[pos] == ',')) {
+        pos++;
+        while (pos < len && json_is_blank(str[pos])) {
+            pos++;
+        }
+    }
+    if (pos >= len) {
+        return 0;
+    }
 
     if (type == JOBJECT) {
         /* Get Key */
-        p_cPos = strchr(p_cPos, '"');
-        if (!p_cPos) {
+        if (str[pos] != '"') {
             return 0;
         }
-        p_cName = ++p_cPos;
-        p_cPos = strchr(p_cPos, '"');
-        if (!p_cPos) {
+        end = json_lex_string(str, len, pos);
+        if (end < 0) {
             return 0;
         }
-        iNameLen = p_cPos - p_cName;
+        *key = str + pos + 1;
+        *key_len = end - pos - 2;
 
-        /* Get Value */
-        p_cPos = strchr(p_cPos, ':');
+        pos = end;
+        while (pos < len && json_is_blank(str[pos])) {
+            pos++;
+        }
+        if (pos >= len || str[pos] != ':') {
+            return 0;
+        }
+        pos++;
+        while (pos < len && json_is_blank(str[pos])) {
+            pos++;
+        }
+        if (pos >= len) {
+            return 0;
+        }
     }
-    while (p_cPos && *p_cPos) {
-        if (*p_cPos == '"') {
+
+    /* Get Value */
+    switch (str[pos]) {
+        case '"':
             iValueType = JSTRING;
-            p_cValue = ++p_cPos;
+            end = json_lex_string(str, len, pos);
             break;
-        } else if (*p_cPos == '{') {
+        case '{':
             iValueType = JOBJECT;
-            p_cValue = p_cPos++;
+            end = json_lex_container(str, len, pos);
             break;
-        } else if (*p_cPos == '[') {
+        case '[':
             iValueType = JARRAY;
-            p_cValue = p_cPos++;
+            end = json_lex_container(str, len, pos);
             break;
-        } else if (*p_cPos >= '0' && *p_cPos <= '9') {
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
             iValueType = JNUMBER;
-            p_cValue = p_cPos++;
+            end = json_lex_number(str, len, pos);
             break;
-        } else if (*p_cPos == 't' || *p_cPos == 'T' || *p_cPos == 'f' || *p_cPos == 'F') {
-            iValueType = JBOOLEAN;
-            p_cValue = p_cPos;
+        default:
+            end = json_lex_literal(str, len, pos, &iValueType);
             break;
-        }
-        p_cPos++;
     }
-    while (p_cPos && *p_cPos && iValueType > JNONE) {
-        if (iValueType == JBOOLEAN) {
-            int     len = strlen(p_cValue);
-
-            if ((*p_cValue == 't' || *p_cValue == 'T') && len >= 4
-                && (!strncmp(p_cValue, "true", 4)
-                    || !strncmp(p_cValue, "TRUE", 4))) {
-                iValueLen = 4;
-                p_cPos = p_cValue + iValueLen;
-                break;
-            } else if ((*p_cValue == 'f' || *p_cValue == 'F') && len >= 5
-                       && (!strncmp(p_cValue, "false", 5)
-                           || !strncmp(p_cValue, "FALSE", 5))) {
-                iValueLen = 5;
-                p_cPos = p_cValue + iValueLen;
-                break;
-            }
-        } else if (iValueType == JNUMBER) {
-            if (*p_cPos < '0' || *p_cPos > '9') {
-                iValueLen = p_cPos - p_cValue;
-                break;
-            }
-        } else if (*p_cPos == JsonMark[iValueType][1]) {
-            if (iMarkDepth == 0) {
-                iValueLen = p_cPos - p_cValue + (iValueType == JSTRING ? 0 : 1);
-                p_cPos++;
-                break;
-            } else {
-                iMarkDepth--;
-            }
-        } else if (*p_cPos == JsonMark[iValueType][0]) {
-            iMarkDepth++;
-        }
-        p_cPos++;
+    if (end < 0) {
+        return 0;
     }
 
-    if (type == JOBJECT) {
-        *key = p_cName;
-        *key_len = iNameLen;
-    }
-
-    *val = p_cValue;
-    *val_len = iValueLen;
-    *val_type = iValueType;
     if (iValueType == JSTRING) {
-        return p_cValue + iValueLen + 1;
+        *val = str + pos + 1;
+        *val_len = end - pos - 2;
     } else {
-        return p_cValue + iValueLen;
+        *val = str + pos;
+        *val_len = end - pos;
     }
+    *val_type = iValueType;
+
+    return str + end;
+}
+
+char *json_get_next_object(int type, char *str, char **key, int *key_len,
+                           char **val, int *val_len, int *val_type)
+{
+    return json_get_next_object_bounded(type, str, JSON_UNBOUNDED_LEN, key, key_len, val, val_len, val_type);
 }
 
 int json_parse_name_value(char *p_cJsonStr, int iStrLen, json_parse_cb pfnCB, void *p_CBData)
 {
     char    *pos = 0, *key = 0, *val = 0;
     int     klen = 0, vlen = 0, vtype = 0;
-    char    last_char = 0;
     int     ret = JSON_RESULT_ERR;
 
-    if (p_cJsonStr == NULL || iStrLen == 0 || pfnCB == NULL) {
+    if (p_cJsonStr == NULL || iStrLen <= 0 || pfnCB == NULL) {
         return ret;
     }
 
-    if (iStrLen != strlen(p_cJsonStr)) {
-        log_warning("Backup last_char since %d != %d", iStrLen, (int)strlen(p_cJsonStr));
-        backup_json_str_last_char(p_cJsonStr, iStrLen, last_char);
+    for (pos = p_cJsonStr; pos < p_cJsonStr + iStrLen && json_is_blank(*pos); pos++);
+    if (pos >= p_cJsonStr + iStrLen || *pos != '{') {
+        return ret;
     }
 
-    json_object_for_each_kv(p_cJsonStr, pos, key, klen, val, vlen, vtype) {
+    while ((pos = json_get_next_object_bounded(JOBJECT, pos, p_cJsonStr + iStrLen - pos,
+                  &key, &klen, &val, &vlen, &vtype)) != 0) {
         if (key && klen && val && vlen) {
             ret = JSON_RESULT_OK;
             if (JSON_PARSE_FINISH == pfnCB(key, klen, val, vlen, vtype, p_CBData)) {
@@ -173,10 +179,6 @@ int json_parse_name_value(char *p_cJsonStr, int iStrLen, json_parse_cb pfnCB, vo
         }
     }
 
-    if (iStrLen != strlen(p_cJsonStr)) {
-        restore_json_str_last_char(p_cJsonStr, iStrLen, last_char);
-    }
-
     return ret;
 }
 
@@ -203,7 +205,7 @@ int json_get_value_by_name_cb(char *p_cName, int iNameLen, char *p_cValue, int i
 
     JSON_NV     *p_stNameValue = (JSON_NV *)p_CBData;
 
-    if (!strncmp(p_cName, p_stNameValue->pN, p_stNameValue->nLen)) {
+    if (iNameLen == p_stNameValue->nLen && !strncmp(p_cName, p_stNameValue->pN, iNameLen)) {
         p_stNameValue->pV = p_cValue;
         p_stNameValue->vLen = iValueLen;
         p_stNameValue->vType = iValueType;
@@ -27,11 +27,12 @@ The descriptions of the json value node type
 **/
 enum JSONTYPE {
     JNONE = -1,
-    JSTRING = 0,
-    JOBJECT,
-    JARRAY,
-    JNUMBER,
-    JBOOLEAN,
+    JSTRING = LITE_JSON_STRING,
+    JOBJECT = LITE_JSON_OBJECT,
+    JARRAY = LITE_JSON_ARRAY,
+    JNUMBER = LITE_JSON_NUMBER,
+    JBOOLEAN = LITE_JSON_BOOLEAN,
+    JNULL = LITE_JSON_NULL,
     JTYPEMAX
 };
 
@@ -83,6 +84,21 @@ int json_parse_name_value(char *p_cJsonStr, int iStrLen, json_parse_cb pfnCB, vo
 **/
 char *json_get_value_by_name(char *p_cJsonStr, int iStrLen, char *p_cName, int *p_iValueLen, int *p_iValueType);
 
+/**
+ * @brief Lexers shared by the tokenizer and the parsers above, the data ends at @len or at a NUL.
+ *
+ * @param[in] js  @n The JSON text
+ * @param[in] len @n The JSON text length
+ * @param[in] pos @n Offset of the first byte of the value
+ * @returns Offset past the value, LITE_JSON_ERROR_INVAL or LITE_JSON_ERROR_PART if it is cut short.
+ * @see None.
+ * @note json_lex_container() skips a whole object or array without checking its members.
+ */
+int json_lex_string(const char *js, int len, int pos);
+int json_lex_number(const char *js, int len, int pos);
+int json_lex_literal(const char *js, int len, int pos, int *type);
+int json_lex_container(const char *js, int len, int pos);
+
 /**
  * @brief Get the JSON object point associate with a given type.
  *
@@ -95,6 +111,10 @@ char *json_get_value_by_name(char *p_cJsonStr, int iStrLen, char *p_cName, int *
 char *json_get_object(int type, char *str);
 char *json_get_next_object(int type, char *str, char **key, int *key_len, char **val, int *val_len, int *val_type);
 
+/* same as json_get_next_object(), no further than @len bytes from @str */
+char *json_get_next_object_bounded(int type, char *str, int len, char **key, int *key_len,
+                                   char **val, int *val_len, int *val_type);
+
 /**
  * @brief retrieve each key&value pair from the json string
  *
@@ -125,7 +145,7 @@ char *json_get_next_object(int type, char *str, char **key, int *key_len, char *
  */
 #define json_array_for_each_entry(str, pos, entry, len, type) \
     for (pos = json_get_object(JARRAY, str); \
-         pos!=0 && *pos!=0 && (pos=json_get_next_object(JARRAY, ++pos, 0, 0, &entry, &len, &type))!=0; )
+         pos!=0 && *pos!=0 && (pos=json_get_next_object(JARRAY, pos, 0, 0, &entry, &len, &type))!=0; )
 
 
 /**
@@ -20,109 +20,219 @@
 #include "lite-utils_internal.h"
 #include "json_parser.h"
 
-char *LITE_json_value_of(char *key, char *src)
+/* FNV-1a */
+static uint32_t _json_path_hash(const char *key, int len)
 {
-    char       *value = NULL;
-    int         value_len = -1;
-    char       *ret = NULL;
-
-    char       *delim = NULL;
-    char       *key_iter;
-    char       *key_next;
-    int         key_len;
-    char       *src_iter;
-
-    src_iter = src;
-    key_iter = key;
-
-    do {
-        if ((delim = strchr(key_iter, '.')) != NULL) {
-            key_len = delim - key_iter;
-            key_next = LITE_malloc(key_len + 1);
-            strncpy(key_next, key_iter, key_len);
-            key_next[key_len] = '\0';
-            value = json_get_value_by_name(src_iter, strlen(src_iter), key_next, &value_len, 0);
-
-            if (value == NULL) {
-                LITE_free(key_next);
-                return NULL;
-            }
+    uint32_t    hash = 2166136261U;
 
-            src_iter = value;
-            key_iter = delim + 1;
-            LITE_free(key_next);
-        }
-    } while (delim);
+    while (len-- > 0) {
+        hash = (hash ^ (uint8_t)*key++) * 16777619U;
+    }
 
-    value = json_get_value_by_name(src_iter, strlen(src_iter), key_iter, &value_len, 0);
-    if (NULL == value) {
-        return NULL;
+    return hash;
+}
+
+int LITE_json_path_compile(lite_json_path_t *path, const char *dotted)
+{
+    const char     *segment, *delim;
+
+    if (NULL == path || NULL == dotted) {
+        return -1;
     }
-    ret = LITE_malloc((value_len + 1) * sizeof(char));
-    if (NULL == ret) {
-        return NULL;
+
+    memset(path, 0, sizeof(lite_json_path_t));
+    path->path = dotted;
+
+    for (segment = dotted; ; segment = delim + 1) {
+        delim = strchr(segment, '.');
+        if (NULL == delim) {
+            delim = segment + strlen(segment);
+        }
+        if (delim == segment || path->depth >= LITE_JSON_PATH_MAX_DEPTH || delim - dotted > 0xFFFF) {
+            return -1;
+        }
+
+        path->offset[path->depth] = (uint16_t)(segment - dotted);
+        path->len[path->depth] = (uint16_t)(delim - segment);
+        path->hash[path->depth] = _json_path_hash(segment, delim - segment);
+        path->depth++;
+
+        if ('\0' == *delim) {
+            return 0;
+        }
     }
-    LITE_snprintf(ret, value_len + 1, "%s", value);
-    return ret;
 }
 
-void LITE_json_keys_release(list_head_t *keylist)
+/* the members of the object @json at @depth the paths of @mask go through, which are pending */
+static void _json_path_walk(char *json, int len, int depth, uint32_t mask, const lite_json_path_t *paths,
+                            int count, lite_json_slice_t *slices, uint32_t *pending)
 {
-    json_key_t         *pos, *tmp;
+    char       *pos = json, *key, *val;
+    int         klen, vlen, vtype, i;
+    uint32_t    hash, next;
+
+    while (0 != (*pending & mask)
+           && NULL != (pos = json_get_next_object_bounded(JOBJECT, pos, json + len - pos,
+                             &key, &klen, &val, &vlen, &vtype))) {
+        hash = _json_path_hash(key, klen);
+        next = 0;
+
+        for (i = 0; i < count; i++) {
+            if (0 == (*pending & mask & (1U << i))
+                || paths[i].len[depth] != klen || paths[i].hash[depth] != hash
+                || 0 != memcmp(paths[i].path + paths[i].offset[depth], key, klen)) {
+                continue;
+            }
 
-    list_for_each_entry_safe(pos, tmp, keylist, list) {
-        if (pos->key) {
-            LITE_free(pos->key);
+            if (depth == paths[i].depth - 1) {
+                slices[i].value = val;
+                slices[i].len = vlen;
+                slices[i].type = vtype;
+                *pending &= ~(1U << i);
+            } else if (JOBJECT == vtype) {
+                next |= 1U << i;
+            }
+        }
+
+        if (0 != next) {
+            _json_path_walk(val, vlen, depth + 1, next, paths, count, slices, pending);
         }
-        list_del(&pos->list);
-        LITE_free(pos);
     }
 }
 
-list_head_t *LITE_json_keys_of(char *src, char *prefix)
+int LITE_json_path_extract(const char *json, uint32_t len,
+                           const lite_json_path_t *paths, int count, lite_json_slice_t *slices)
 {
-    static              LIST_HEAD(keylist);
+    uint32_t    all, pending, i;
+    int         found = 0;
 
-    char    *pos = 0, *key = 0, *val = 0;
-    int     klen = 0, vlen = 0, vtype = 0;
+    if (NULL == json || NULL == paths || NULL == slices || count <= 0 || count > LITE_JSON_PATH_MAX_COUNT) {
+        return LITE_JSON_ERROR_INVAL;
+    }
+
+    memset(slices, 0, count * sizeof(lite_json_slice_t));
 
-    if (src == NULL || prefix == NULL) {
+    for (i = 0; i < len && (json[i] == ' ' || json[i] == '\t' || json[i] == '\r' || json[i] == '\n'); i++);
+    if (i >= len || json[i] != '{') {
+        return LITE_JSON_ERROR_INVAL;
+    }
+
+    all = (count == 32) ? 0xFFFFFFFFU : ((1U << count) - 1);
+    pending = all;
+    _json_path_walk((char *)json, (len > 0x7FFFFFFF) ? 0x7FFFFFFF : (int)len, 0, all, paths, count, slices, &pending);
+
+    for (i = 0; i < (uint32_t)count; i++) {
+        found += (NULL != slices[i].value);
+    }
+
+    return found;
+}
+
+char *LITE_json_value_of(char *key, char *src)
+{
+    lite_json_path_t    path;
+    lite_json_slice_t   slice;
+    char               *ret = NULL;
+
+    if (NULL == src || 0 != LITE_json_path_compile(&path, key)
+        || 1 != LITE_json_path_extract(src, strlen(src), &path, 1, &slice)) {
         return NULL;
     }
 
-    if (!strcmp("", prefix)) {
-        INIT_LIST_HEAD(&keylist);
+    ret = LITE_malloc((slice.len + 1) * sizeof(char));
+    if (NULL == ret) {
+        return NULL;
     }
+    memcpy(ret, slice.value, slice.len);
+    ret[slice.len] = '\0';
+    return ret;
+}
 
-    json_object_for_each_kv(src, pos, key, klen, val, vlen, vtype) {
-        if (key && klen && val && vlen) {
+int LITE_json_keys_init(lite_json_keys_t *keys, const char *json,
+                        const lite_json_token_t *tokens, int count, char *path, uint32_t path_size)
+{
+    if (NULL == keys || NULL == json || NULL == tokens || NULL == path || 0 == path_size
+        || count <= 0 || LITE_JSON_OBJECT != tokens[0].type) {
+        return LITE_JSON_ERROR_INVAL;
+    }
 
-            json_key_t     *entry = NULL;
+    memset(keys, 0, sizeof(lite_json_keys_t));
+    keys->json = json;
+    keys->tokens = tokens;
+    keys->count = count;
+    keys->index = 1;
+    keys->path = path;
+    keys->path_size = path_size;
+    keys->path[0] = '\0';
+
+    /* members of the root take no prefix */
+    keys->stack[0].object = 0;
+    keys->stack[0].path_len = 0;
+    keys->depth = 1;
+
+    return 0;
+}
 
-            entry = LITE_malloc(sizeof(json_key_t));
-            memset(entry, 0, sizeof(json_key_t));
-            entry->key = LITE_format_string("%s%.*s", prefix, klen, key);
-            list_add_tail(&entry->list, &keylist);
+int LITE_json_keys_next(lite_json_keys_t *keys, lite_json_slice_t *value)
+{
+    const lite_json_token_t    *key, *val;
+    uint32_t                    base, len;
+    int                         next;
+
+    while (keys->index + 1 < keys->count) {
+        key = &keys->tokens[keys->index];
+
+        /* the walk stops on keys only */
+        if (LITE_JSON_STRING != key->type || 1 != key->size
+            || LITE_JSON_OBJECT != keys->tokens[key->parent].type) {
+            ++keys->index;
+            continue;
+        }
 
-            if (JOBJECT == vtype) {
-                char *iter_val = LITE_format_string("%.*s", vlen, val);
-                char *iter_pre = LITE_format_string("%s%.*s.", prefix, klen, key);
-                LITE_json_keys_of(iter_val, iter_pre);
-                LITE_free(iter_val);
-                LITE_free(iter_pre);
-            }
+        /* back to the object of this key */
+        while (keys->depth > 1 && keys->stack[keys->depth - 1].object != key->parent) {
+            --keys->depth;
         }
-    }
 
-    if (!strcmp("", prefix)) {
-        json_key_t     *entry = NULL;
+        base = keys->stack[keys->depth - 1].path_len;
+        len = key->end - key->start;
+        if (base + len + 1 > keys->path_size) {
+            keys->index = keys->count;
+            return LITE_JSON_ERROR_NOMEM;
+        }
+        if (base > 0) {
+            keys->path[base - 1] = '.';
+        }
+        memcpy(keys->path + base, keys->json + key->start, len);
+        keys->path[base + len] = '\0';
+
+        next = keys->index + 1;
+        val = &keys->tokens[next];
+        if (LITE_JSON_OBJECT == val->type) {
+            if (keys->depth >= LITE_JSON_KEYS_MAX_DEPTH) {
+                keys->index = keys->count;
+                return LITE_JSON_ERROR_NOMEM;
+            }
+            keys->stack[keys->depth].object = next;
+            keys->stack[keys->depth].path_len = base + len + 1;
+            ++keys->depth;
+            ++next;
+        } else if (LITE_JSON_ARRAY == val->type) {
+            /* keys in arrays have no path */
+            for (++next; next < keys->count && keys->tokens[next].start < val->end; ++next);
+        } else {
+            ++next;
+        }
+        keys->index = next;
 
-        entry = LITE_malloc(sizeof(json_key_t));
-        memset(entry, 0, sizeof(json_key_t));
-        list_add_tail(&entry->list, &keylist);
+        if (NULL != value) {
+            value->value = keys->json + val->start;
+            value->len = val->end - val->start;
+            value->type = val->type;
+        }
 
-        return &keylist;
+        return (int)(base + len);
     }
 
-    return NULL;
+    return 0;
 }
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "lite-utils_internal.h"
+#include "json_parser.h"
+
+/* what the grammar allows at the next non-blank byte */
+enum {
+    _JSON_EXPECT_VALUE,
+    _JSON_EXPECT_VALUE_OR_CLOSE,
+    _JSON_EXPECT_KEY,
+    _JSON_EXPECT_KEY_OR_CLOSE,
+    _JSON_EXPECT_COLON,
+    _JSON_EXPECT_COMMA_OR_CLOSE,
+    _JSON_EXPECT_END
+};
+
+#define _json_is_blank(c)   ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+#define _json_is_hex(c)     (LITE_isdigit(c) || ((c) >= 'a' && (c) <= 'f') || ((c) >= 'A' && (c) <= 'F'))
+
+/* the data ends at @len or at the first NUL, whichever comes first */
+#define _json_more(js, len, pos)    ((pos) < (len) && '\0' != (js)[pos])
+
+int json_lex_string(const char *js, int len, int pos)
+{
+    int     i;
+
+    for (++pos; _json_more(js, len, pos); ++pos) {
+        unsigned char c = (unsigned char)js[pos];
+
+        if (c == '"') {
+            return pos + 1;
+        }
+        if (c < 0x20) {
+            return LITE_JSON_ERROR_INVAL;
+        }
+        if (c != '\\') {
+            continue;
+        }
+
+        if (!_json_more(js, len, pos + 1)) {
+            break;
+        }
+        switch (js[++pos]) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                break;
+            case 'u':
+                for (i = 1; i <= 4; i++) {
+                    if (!_json_more(js, len, pos + i)) {
+                        return LITE_JSON_ERROR_PART;
+                    }
+                    if (!_json_is_hex(js[pos + i])) {
+                        return LITE_JSON_ERROR_INVAL;
+                    }
+                }
+                pos += 4;
+                break;
+            default:
+                return LITE_JSON_ERROR_INVAL;
+        }
+    }
+
+    return LITE_JSON_ERROR_PART;
+}
+
+int json_lex_number(const char *js, int len, int pos)
+{
+    int     digits;
+
+    if (js[pos] == '-') {
+        ++pos;
+    }
+
+    /* int part, no leading zeros: "0123" ends after the 0 */
+    if (!_json_more(js, len, pos)) {
+        return LITE_JSON_ERROR_PART;
+    }
+    if (js[pos] == '0') {
+        ++pos;
+    } else if (LITE_isdigit(js[pos])) {
+        while (_json_more(js, len, pos) && LITE_isdigit(js[pos])) {
+            ++pos;
+        }
+    } else {
+        return LITE_JSON_ERROR_INVAL;
+    }
+
+    if (_json_more(js, len, pos) && js[pos] == '.') {
+        for (++pos, digits = 0; _json_more(js, len, pos) && LITE_isdigit(js[pos]); ++pos, ++digits);
+        if (0 == digits) {
+            return _json_more(js, len, pos) ? LITE_JSON_ERROR_INVAL : LITE_JSON_ERROR_PART;
+        }
+    }
+
+    if (_json_more(js, len, pos) && (js[pos] == 'e' || js[pos] == 'E')) {
+        ++pos;
+        if (_json_more(js, len, pos) && (js[pos] == '+' || js[pos] == '-')) {
+            ++pos;
+        }
+        for (digits = 0; _json_more(js, len, pos) && LITE_isdigit(js[pos]); ++pos, ++digits);
+        if (0 == digits) {
+            return _json_more(js, len, pos) ? LITE_JSON_ERROR_INVAL : LITE_JSON_ERROR_PART;
+        }
+    }
+
+    return pos;
+}
+
+int json_lex_literal(const char *js, int len, int pos, int *type)
+{
+    const char *literal;
+    int         i;
+
+    switch (js[pos]) {
+        case 't':
+            literal = "true";
+            *type = LITE_JSON_BOOLEAN;
+            break;
+        case 'f':
+            literal = "false";
+            *type = LITE_JSON_BOOLEAN;
+            break;
+        case 'n':
+            literal = "null";
+            *type = LITE_JSON_NULL;
+            break;
+        default:
+            return LITE_JSON_ERROR_INVAL;
+    }
+
+    for (i = 0; literal[i]; i++) {
+        if (!_json_more(js, len, pos + i)) {
+            return LITE_JSON_ERROR_PART;
+        }
+        if (js[pos + i] != literal[i]) {
+            return LITE_JSON_ERROR_INVAL;
+        }
+    }
+
+    return pos + i;
+}
+
+int json_lex_container(const char *js, int len, int pos)
+{
+    int     depth = 0;
+
+    for (; _json_more(js, len, pos); ++pos) {
+        switch (js[pos]) {
+            case '"':
+                pos = json_lex_string(js, len, pos);
+                if (pos < 0) {
+                    return pos;
+                }
+                --pos;
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0) {
+                    return pos + 1;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return LITE_JSON_ERROR_PART;
+}
+
+static lite_json_token_t *_json_alloc_token(lite_json_tokenizer_t *tokenizer,
+        lite_json_token_t *tokens, uint32_t num_tokens, int type, int start, int end)
+{
+    lite_json_token_t  *token;
+
+    if (tokenizer->toknext >= num_tokens) {
+        return NULL;
+    }
+
+    token = &tokens[tokenizer->toknext++];
+    token->type = type;
+    token->start = start;
+    token->end = end;
+    token->size = 0;
+    token->parent = tokenizer->toksuper;
+
+    /* object members are counted by their keys */
+    if (tokenizer->toksuper >= 0 && tokens[tokenizer->toksuper].type == LITE_JSON_ARRAY) {
+        tokens[tokenizer->toksuper].size++;
+    }
+
+    return token;
+}
+
+/* a value is complete, step out of its key */
+static void _json_value_done(lite_json_tokenizer_t *tokenizer, lite_json_token_t *tokens)
+{
+    if (tokenizer->toksuper >= 0 && tokens[tokenizer->toksuper].type == LITE_JSON_STRING) {
+        tokenizer->toksuper = tokens[tokenizer->toksuper].parent;
+    }
+    tokenizer->expect = (tokenizer->toksuper < 0) ? _JSON_EXPECT_END : _JSON_EXPECT_COMMA_OR_CLOSE;
+}
+
+void LITE_json_tokenizer_init(lite_json_tokenizer_t *tokenizer)
+{
+    tokenizer->pos = 0;
+    tokenizer->toknext = 0;
+    tokenizer->toksuper = -1;
+    tokenizer->expect = _JSON_EXPECT_VALUE;
+}
+
+int LITE_json_tokenize(lite_json_tokenizer_t *tokenizer, const char *json, uint32_t len,
+                       lite_json_token_t *tokens, uint32_t num_tokens)
+{
+    lite_json_token_t  *token;
+    int                 pos, end, type, slen;
+    char                c;
+
+    if (NULL == tokenizer || NULL == json || (NULL == tokens && num_tokens > 0)) {
+        return LITE_JSON_ERROR_INVAL;
+    }
+
+    /* token offsets are int */
+    slen = (len > 0x7FFFFFFF) ? 0x7FFFFFFF : (int)len;
+
+    for (pos = (int)tokenizer->pos; _json_more(json, slen, pos); tokenizer->pos = (uint32_t)pos) {
+        c = json[pos];
+
+        if (_json_is_blank(c)) {
+            ++pos;
+            continue;
+        }
+
+        switch (c) {
+            case '{':
+            case '[':
+                if (tokenizer->expect != _JSON_EXPECT_VALUE && tokenizer->expect != _JSON_EXPECT_VALUE_OR_CLOSE) {
+                    return LITE_JSON_ERROR_INVAL;
+                }
+                token = _json_alloc_token(tokenizer, tokens, num_tokens,
+                                          c == '{' ? LITE_JSON_OBJECT : LITE_JSON_ARRAY, pos, -1);
+                if (NULL == token) {
+                    return LITE_JSON_ERROR_NOMEM;
+                }
+                tokenizer->toksuper = tokenizer->toknext - 1;
+                tokenizer->expect = (c == '{') ? _JSON_EXPECT_KEY_OR_CLOSE : _JSON_EXPECT_VALUE_OR_CLOSE;
+                ++pos;
+                break;
+
+            case '}':
+            case ']':
+                if (tokenizer->expect != _JSON_EXPECT_COMMA_OR_CLOSE
+                    && !(c == '}' && tokenizer->expect == _JSON_EXPECT_KEY_OR_CLOSE)
+                    && !(c == ']' && tokenizer->expect == _JSON_EXPECT_VALUE_OR_CLOSE)) {
+                    return LITE_JSON_ERROR_INVAL;
+                }
+                token = &tokens[tokenizer->toksuper];
+                if (token->type != (c == '}' ? LITE_JSON_OBJECT : LITE_JSON_ARRAY)) {
+                    return LITE_JSON_ERROR_INVAL;
+                }
+                token->end = ++pos;
+                tokenizer->toksuper = token->parent;
+                _json_value_done(tokenizer, tokens);
+                break;
+
+            case ':':
+                if (tokenizer->expect != _JSON_EXPECT_COLON) {
+                    return LITE_JSON_ERROR_INVAL;
+                }
+                tokenizer->expect = _JSON_EXPECT_VALUE;
+                ++pos;
+                break;
+
+            case ',':
+                if (tokenizer->expect != _JSON_EXPECT_COMMA_OR_CLOSE) {
+                    return LITE_JSON_ERROR_INVAL;
+                }
+                tokenizer->expect = (tokens[tokenizer->toksuper].type == LITE_JSON_OBJECT)
+                                    ? _JSON_EXPECT_KEY : _JSON_EXPECT_VALUE;
+                ++pos;
+                break;
+
+            case '"':
+                if (tokenizer->expect == _JSON_EXPECT_KEY || tokenizer->expect == _JSON_EXPECT_KEY_OR_CLOSE) {
+                    end = json_lex_string(json, slen, pos);
+                    if (end < 0) {
+                        return end;
+                    }
+                    token = _json_alloc_token(tokenizer, tokens, num_tokens, LITE_JSON_STRING, pos + 1, end - 1);
+                    if (NULL == token) {
+                        return LITE_JSON_ERROR_NOMEM;
+                    }
+                    token->size = 1;
+                    tokens[tokenizer->toksuper].size++;
+                    tokenizer->toksuper = tokenizer->toknext - 1;
+                    tokenizer->expect = _JSON_EXPECT_COLON;
+                    pos = end;
+                    break;
+                }
+                if (tokenizer->expect != _JSON_EXPECT_VALUE && tokenizer->expect != _JSON_EXPECT_VALUE_OR_CLOSE) {
+                    return LITE_JSON_ERROR_INVAL;
+                }
+                end = json_lex_string(json, slen, pos);
+                if (end < 0) {
+                    return end;
+                }
+                if (NULL == _json_alloc_token(tokenizer, tokens, num_tokens, LITE_JSON_STRING, pos + 1, end - 1)) {
+                    return LITE_JSON_ERROR_NOMEM;
+                }
+                _json_value_done(tokenizer, tokens);
+                pos = end;
+                break;
+
+            default:
+                if (tokenizer->expect != _JSON_EXPECT_VALUE && tokenizer->expect != _JSON_EXPECT_VALUE_OR_CLOSE) {
+                    return LITE_JSON_ERROR_INVAL;
+                }
+                if (c == '-' || LITE_isdigit(c)) {
+                    type = LITE_JSON_NUMBER;
+                    end = json_lex_number(json, slen, pos);
+                    /* a number can only be told complete by what follows it, unless it is the whole document */
+                    if (end >= 0 && !_json_more(json, slen, end) && tokenizer->toksuper >= 0) {
+                        end = LITE_JSON_ERROR_PART;
+                    }
+                } else {
+                    end = json_lex_literal(json, slen, pos, &type);
+                }
+                if (end < 0) {
+                    return end;
+                }
+                if (NULL == _json_alloc_token(tokenizer, tokens, num_tokens, type, pos, end)) {
+                    return LITE_JSON_ERROR_NOMEM;
+                }
+                _json_value_done(tokenizer, tokens);
+                pos = end;
+                break;
+        }
+    }
+
+    if (tokenizer->expect != _JSON_EXPECT_END) {
+        return LITE_JSON_ERROR_PART;
+    }
+
+    return (int)tokenizer->toknext;
+}
@@ -0,0 +1,627 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include "lite-utils_internal.h"
+
+static const char _json_digits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static void _json_write(lite_json_writer_t *writer, const char *data, uint32_t len)
+{
+    writer->len += len;
+    if ((NULL == writer->buf) || writer->overflow || (0 == len)) {
+        return;
+    }
+
+    if (writer->offset + len <= writer->size) {
+        /* mostly a bracket or a comma */
+        if (1 == len) {
+            writer->buf[writer->offset++] = data[0];
+        } else {
+            memcpy(writer->buf + writer->offset, data, len);
+            writer->offset += len;
+        }
+        return;
+    }
+
+    if (NULL == writer->sink) {
+        writer->overflow = 1;
+        return;
+    }
+
+    if ((writer->offset > 0) && (0 != writer->sink(writer->ctx, writer->buf, writer->offset))) {
+        writer->overflow = 1;
+        return;
+    }
+    writer->offset = 0;
+
+    /* larger than a chunk, no point in copying it */
+    if (len > writer->size) {
+        if (0 != writer->sink(writer->ctx, data, len)) {
+            writer->overflow = 1;
+        }
+        return;
+    }
+
+    memcpy(writer->buf, data, len);
+    writer->offset = len;
+}
+
+/* the comma in front of a value, if it needs one */
+static void _json_separate(lite_json_writer_t *writer)
+{
+    uint32_t    bit;
+
+    if (writer->after_key) {
+        writer->after_key = 0;
+        return;
+    }
+
+    if (0 == writer->depth) {
+        return;
+    }
+
+    bit = 1U << (writer->depth - 1);
+    if (writer->members & bit) {
+        _json_write(writer, ",", 1);
+    } else {
+        writer->members |= bit;
+    }
+}
+
+static void _json_open(lite_json_writer_t *writer, const char *bracket)
+{
+    _json_separate(writer);
+    if (writer->depth >= LITE_JSON_WRITER_MAX_DEPTH) {
+        writer->overflow = 1;
+        return;
+    }
+
+    _json_write(writer, bracket, 1);
+    ++writer->depth;
+    writer->members &= ~(1U << (writer->depth - 1));
+}
+
+static void _json_close(lite_json_writer_t *writer, const char *bracket)
+{
+    if (0 == writer->depth) {
+        writer->overflow = 1;
+        return;
+    }
+
+    _json_write(writer, bracket, 1);
+    --writer->depth;
+    writer->after_key = 0;
+}
+
+/* 1 for the bytes a JSON string cannot hold as they are */
+static const uint8_t _json_escaped[256] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0
+};
+
+static void _json_write_escaped(lite_json_writer_t *writer, const char *text, uint32_t len)
+{
+    static const char   hex[] = "0123456789abcdef";
+    char                escaped[6];
+    uint32_t            i, start;
+    uint8_t             c;
+
+    for (i = 0, start = 0; i < len; ++i) {
+        c = (uint8_t)text[i];
+        if (!_json_escaped[c]) {
+            continue;
+        }
+
+        _json_write(writer, text + start, i - start);
+        start = i + 1;
+
+        escaped[0] = '\\';
+        if (('"' == c) || ('\\' == c)) {
+            escaped[1] = (char)c;
+            _json_write(writer, escaped, 2);
+        } else if ('\n' == c) {
+            _json_write(writer, "\\n", 2);
+        } else if ('\r' == c) {
+            _json_write(writer, "\\r", 2);
+        } else if ('\t' == c) {
+            _json_write(writer, "\\t", 2);
+        } else {
+            escaped[1] = 'u';
+            escaped[2] = '0';
+            escaped[3] = '0';
+            escaped[4] = hex[c >> 4];
+            escaped[5] = hex[c & 0x0F];
+            _json_write(writer, escaped, 6);
+        }
+    }
+    _json_write(writer, text + start, len - start);
+}
+
+#define _JSON_ONES      (0x0101010101010101ULL)
+#define _JSON_HIGHS     (0x8080808080808080ULL)
+
+/* length of the prefix of @text with nothing to escape, eight bytes at a time */
+static uint32_t _json_clean_len(const char *text, uint32_t len)
+{
+    uint32_t    i;
+    uint64_t    word, quote, slash;
+
+    for (i = 0; i + 8 <= len; i += 8) {
+        memcpy(&word, text + i, 8);
+        quote = word ^ (_JSON_ONES * '"');
+        slash = word ^ (_JSON_ONES * '\\');
+        /* a byte below 0x20, a zero byte after the xor with a quote or a backslash */
+        if ((((word - _JSON_ONES * 0x20) & ~word) | ((quote - _JSON_ONES) & ~quote)
+             | ((slash - _JSON_ONES) & ~slash)) & _JSON_HIGHS) {
+            break;
+        }
+    }
+    for (; (i < len) && !_json_escaped[(uint8_t)text[i]]; ++i);
+
+    return i;
+}
+
+/* @text in quotes, followed by @suffix of one byte if it is not NUL */
+static void _json_write_string(lite_json_writer_t *writer, const char *text, uint32_t len, char suffix)
+{
+    uint32_t    i, need = len + 2 + ('\0' != suffix);
+    char       *out;
+
+    i = _json_clean_len(text, len);
+    if ((i == len) && (NULL == writer->buf)) {
+        writer->len += need;
+        return;
+    }
+
+    /* nothing to escape and room in the buffer, the common case, in one copy */
+    if ((i == len) && !writer->overflow && (writer->offset + need <= writer->size)) {
+        out = writer->buf + writer->offset;
+        out[0] = '"';
+        memcpy(out + 1, text, len);
+        out[len + 1] = '"';
+        if ('\0' != suffix) {
+            out[len + 2] = suffix;
+        }
+        writer->offset += need;
+        writer->len += need;
+        return;
+    }
+
+    _json_write(writer, "\"", 1);
+    _json_write_escaped(writer, text, len);
+    _json_write(writer, "\"", 1);
+    if ('\0' != suffix) {
+        _json_write(writer, &suffix, 1);
+    }
+}
+
+int LITE_json_format_uint(char *buf, uint64_t value)
+{
+    char        digits[LITE_JSON_INT_LEN];
+    int         pos = sizeof(digits);
+    uint32_t    small;
+
+    /* two digits per division, in 32 bits as soon as the value fits */
+    while (value > 0xFFFFFFFFULL) {
+        pos -= 2;
+        memcpy(digits + pos, _json_digits + (value % 100) * 2, 2);
+        value /= 100;
+    }
+    for (small = (uint32_t)value; small >= 100; small /= 100) {
+        pos -= 2;
+        memcpy(digits + pos, _json_digits + (small % 100) * 2, 2);
+    }
+    if (small >= 10) {
+        pos -= 2;
+        memcpy(digits + pos, _json_digits + small * 2, 2);
+    } else {
+        digits[--pos] = '0' + (char)small;
+    }
+
+    memcpy(buf, digits + pos, sizeof(digits) - pos);
+    return sizeof(digits) - pos;
+}
+
+int LITE_json_format_int(char *buf, int64_t value)
+{
+    if (value < 0) {
+        buf[0] = '-';
+        return 1 + LITE_json_format_uint(buf + 1, (uint64_t)0 - (uint64_t)value);
+    }
+
+    return LITE_json_format_uint(buf, (uint64_t)value);
+}
+
+/* a whole number below this is exact and needs all its digits, it prints the same as an integer */
+#define _JSON_REAL_INT_MAX      (9007199254740992.0)    /* 2^53 */
+#define _JSON_FLOAT_INT_MAX     (16777216.0)            /* 2^24 */
+
+/* digits which any decimal of the type has, FLT_DIG and DBL_DIG, and enough to read back any value */
+#define _JSON_FLOAT_DIGITS      (6)
+#define _JSON_FLOAT_DIGITS_MAX  (9)
+#define _JSON_REAL_DIGITS       (15)
+#define _JSON_REAL_DIGITS_MAX   (17)
+#define _JSON_FLOAT_NORMAL_MIN  (1.17549435082228750797e-38)     /* FLT_MIN and DBL_MIN */
+#define _JSON_REAL_NORMAL_MIN   (2.22507385850720138309e-308)
+
+static const double _json_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* @value * 10^@exp, exact up to 10^22 and rounded at every step of 10^22 beyond */
+static double _json_scale(double value, int exp)
+{
+    for (; exp > 22; exp -= 22) {
+        value *= 1e22;
+    }
+    for (; exp < -22; exp += 22) {
+        value /= 1e22;
+    }
+
+    return (exp >= 0) ? value * _json_pow10[exp] : value / _json_pow10[-exp];
+}
+
+/* round half to even as printf() does, @value is below 2^63 */
+static uint64_t _json_round(double value)
+{
+    uint64_t    integer = (uint64_t)value;
+    double      rest = value - (double)integer;
+
+    if ((rest > 0.5) || ((0.5 == rest) && (integer & 1))) {
+        ++integer;
+    }
+
+    return integer;
+}
+
+/* the @digits first digits of positive @value in @p_mant, up to 10^15, and the exponent of the first */
+/* return 1 if they are scaled in one rounding, 0 if in several which may have moved the last digit */
+static int _json_real_digits(double value, int digits, uint64_t bits, uint64_t *p_mant, int *p_exp)
+{
+    uint64_t    low = (uint64_t)_json_pow10[digits - 1], high = (uint64_t)_json_pow10[digits];
+    int         exp2 = (int)((bits >> 52) & 0x7FF) - 1023, exp, i;
+    double      guess = exp2 * 0.30102999566398119521;  /* log10(2) */
+
+    exp = (int)guess;
+    exp -= (guess < exp);
+
+    /* the guess is one below at most, but for subnormal values */
+    for (i = 0; i < 400; ++i) {
+        *p_mant = _json_round(_json_scale(value, digits - 1 - exp));
+        if (*p_mant >= high) {
+            ++exp;
+        } else if ((*p_mant < low) && (exp > -324)) {
+            --exp;
+        } else {
+            break;
+        }
+    }
+    *p_exp = exp;
+
+    return (digits - 1 - exp >= -22) && (digits - 1 - exp <= 22);
+}
+
+/* the same from the libc, for the digits a double does not hold */
+static void _json_real_digits_libc(double value, int digits, uint64_t *p_mant, int *p_exp)
+{
+    char        text[LITE_JSON_REAL_LEN];
+    const char *pos;
+
+    LITE_snprintf(text, sizeof(text), "%.*e", digits - 1, value);
+
+    *p_mant = 0;
+    for (pos = text; ('e' != *pos) && ('\0' != *pos); ++pos) {
+        if (('0' <= *pos) && ('9' >= *pos)) {
+            *p_mant = *p_mant * 10 + (*pos - '0');
+        }
+    }
+    *p_exp = ('e' == *pos) ? atoi(pos + 1) : 0;
+}
+
+/* write @mant times 10^@exp, @exp the exponent of its first digit, as "%g" with the precision of the type */
+static int _json_real_write(char *buf, int negative, uint64_t mant, int exp, int is_float)
+{
+    char        digits[LITE_JSON_INT_LEN];
+    int         len = 0, count, point;
+
+    while ((mant >= 10) && (0 == mant % 10)) {
+        mant /= 10;
+    }
+    count = LITE_json_format_uint(digits, mant);
+
+    if (negative) {
+        buf[len++] = '-';
+    }
+
+    if ((exp < -4) || (exp >= (is_float ? _JSON_FLOAT_DIGITS_MAX : _JSON_REAL_DIGITS_MAX))) {
+        buf[len++] = digits[0];
+        if (count > 1) {
+            buf[len++] = '.';
+            memcpy(buf + len, digits + 1, count - 1);
+            len += count - 1;
+        }
+        buf[len++] = 'e';
+        buf[len++] = (exp < 0) ? '-' : '+';
+        return len + LITE_json_format_uint(buf + len, (exp < 0) ? -exp : exp);
+    }
+
+    if (exp < 0) {
+        /* 0.000ddd */
+        buf[len++] = '0';
+        buf[len++] = '.';
+        memset(buf + len, '0', -exp - 1);
+        len += -exp - 1;
+        memcpy(buf + len, digits, count);
+        return len + count;
+    }
+
+    point = exp + 1;
+    if (count <= point) {
+        memcpy(buf + len, digits, count);
+        memset(buf + len + count, '0', point - count);
+        return len + point;
+    }
+    memcpy(buf + len, digits, point);
+    buf[len + point] = '.';
+    memcpy(buf + len + point + 1, digits + point, count - point);
+    return len + count + 1;
+}
+
+/* whether @buf of @len, @mant times 10^@exp of its last digit, reads back to @value */
+static int _json_real_check(char *buf, int len, uint64_t mant, int exp, double value, int is_float)
+{
+    double      back;
+
+    if ((mant <= (1ULL << 53)) && (exp >= -22) && (exp <= 22)) {
+        /* both exact, so the product is rounded once as strtod() does */
+        back = (exp >= 0) ? (double)mant * _json_pow10[exp] : (double)mant / _json_pow10[-exp];
+    } else {
+        buf[len] = '\0';
+        back = strtod(buf + ('-' == buf[0]), NULL);
+    }
+
+    return is_float ? ((float)back == (float)value) : (back == value);
+}
+
+int LITE_json_format_real(char *buf, double value, int is_float)
+{
+    double      limit = is_float ? _JSON_FLOAT_INT_MAX : _JSON_REAL_INT_MAX;
+    uint64_t    bits, mant, last;
+    int         negative, digits, max, exp, len = 0, shift, exact = 1, libc;
+
+    if ((value != value) || (value - value != 0)) {
+        /* NaN or infinity, JSON has neither */
+        memcpy(buf, "null", 4);
+        return 4;
+    }
+
+    /* counters and settings are mostly whole, skip the libc for them but not for -0 */
+    memcpy(&bits, &value, sizeof(bits));
+    if ((value > -limit) && (value < limit) && (value == (double)(int64_t)value)
+        && ((0 != value) || (0 == (bits >> 63)))) {
+        return LITE_json_format_int(buf, (int64_t)value);
+    }
+
+    negative = (int)(bits >> 63);
+    if (0 == value) {
+        memcpy(buf, "-0", 2);
+        return 2;
+    }
+    value = negative ? -value : value;
+    bits &= ~(1ULL << 63);
+
+    /*
+     * Any decimal of up to FLT_DIG / DBL_DIG digits reads back as the value nearest to it, so the
+     * value rounded to that many digits is its shortest text whenever one that short exists. Else a
+     * digit more is tried, up to the count which reads back any value. The digits are scaled by hand
+     * up to 15 of them, the libc gives the 16th and 17th of a double.
+     */
+    digits = is_float ? _JSON_FLOAT_DIGITS : _JSON_REAL_DIGITS;
+    max = is_float ? _JSON_FLOAT_DIGITS_MAX : _JSON_REAL_DIGITS_MAX;
+    if (value < (is_float ? _JSON_FLOAT_NORMAL_MIN : _JSON_REAL_NORMAL_MIN)) {
+        /* a subnormal value has fewer digits, its shortest text is searched from one */
+        digits = 1;
+    }
+    for (; digits <= max; ++digits) {
+        libc = (digits > _JSON_REAL_DIGITS);
+        if (libc) {
+            _json_real_digits_libc(value, digits, &mant, &exp);
+        } else {
+            exact = _json_real_digits(value, digits, bits, &mant, &exp);
+        }
+
+        for (;;) {
+            len = _json_real_write(buf, negative, mant, exp, is_float);
+            for (last = mant, shift = 0; (last >= 10) && (0 == last % 10); last /= 10, ++shift);
+            if (_json_real_check(buf, len, last, exp - (digits - 1) + shift, value, is_float)) {
+                return len;
+            }
+            if (libc || (exact && (digits < max))) {
+                break;
+            }
+            /* the scaling in steps may have moved the last digit, which the libc does not */
+            _json_real_digits_libc(value, digits, &mant, &exp);
+            libc = 1;
+        }
+    }
+
+    return len;
+}
+
+static void _json_write_real(lite_json_writer_t *writer, double value, int is_float)
+{
+    char        number[LITE_JSON_REAL_LEN];
+
+    _json_write(writer, number, LITE_json_format_real(number, value, is_float));
+}
+
+void LITE_json_writer_init(lite_json_writer_t *writer, char *buf, uint32_t size)
+{
+    memset(writer, 0, sizeof(lite_json_writer_t));
+    writer->buf = buf;
+    writer->size = (NULL == buf) ? 0 : size;
+}
+
+void LITE_json_writer_set_sink(lite_json_writer_t *writer, lite_json_sink_fpt sink, void *ctx)
+{
+    writer->sink = sink;
+    writer->ctx = ctx;
+}
+
+int LITE_json_writer_finish(lite_json_writer_t *writer)
+{
+    if (writer->overflow) {
+        return -1;
+    }
+
+    if ((NULL != writer->sink) && (writer->offset > 0)) {
+        if (0 != writer->sink(writer->ctx, writer->buf, writer->offset)) {
+            writer->overflow = 1;
+            return -1;
+        }
+        writer->offset = 0;
+    }
+
+    if (writer->offset < writer->size) {
+        writer->buf[writer->offset] = '\0';
+    }
+
+    return (int)writer->len;
+}
+
+void LITE_json_put_object(lite_json_writer_t *writer)
+{
+    _json_open(writer, "{");
+}
+
+void LITE_json_put_object_end(lite_json_writer_t *writer)
+{
+    _json_close(writer, "}");
+}
+
+void LITE_json_put_array(lite_json_writer_t *writer)
+{
+    _json_open(writer, "[");
+}
+
+void LITE_json_put_array_end(lite_json_writer_t *writer)
+{
+    _json_close(writer, "]");
+}
+
+void LITE_json_put_key(lite_json_writer_t *writer, const char *key, uint32_t len)
+{
+    _json_separate(writer);
+    _json_write_string(writer, key, len, ':');
+    writer->after_key = 1;
+}
+
+void LITE_json_put_string(lite_json_writer_t *writer, const char *text, uint32_t len)
+{
+    _json_separate(writer);
+    _json_write_string(writer, text, len, '\0');
+}
+
+/* byte strings become base64 strings */
+void LITE_json_put_base64(lite_json_writer_t *writer, const uint8_t *data, uint32_t len)
+{
+    static const char   table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char                quad[4];
+    uint32_t            i, triple;
+
+    _json_separate(writer);
+    _json_write(writer, "\"", 1);
+    for (i = 0; i < len; i += 3) {
+        triple = (uint32_t)data[i] << 16;
+        if (i + 1 < len) {
+            triple |= (uint32_t)data[i + 1] << 8;
+        }
+        if (i + 2 < len) {
+            triple |= data[i + 2];
+        }
+        quad[0] = table[(triple >> 18) & 0x3F];
+        quad[1] = table[(triple >> 12) & 0x3F];
+        quad[2] = (i + 1 < len) ? table[(triple >> 6) & 0x3F] : '=';
+        quad[3] = (i + 2 < len) ? table[triple & 0x3F] : '=';
+        _json_write(writer, quad, 4);
+    }
+    _json_write(writer, "\"", 1);
+}
+
+void LITE_json_put_int(lite_json_writer_t *writer, int64_t value)
+{
+    char        number[LITE_JSON_INT_LEN];
+
+    _json_separate(writer);
+    _json_write(writer, number, LITE_json_format_int(number, value));
+}
+
+void LITE_json_put_uint(lite_json_writer_t *writer, uint64_t value)
+{
+    char        number[LITE_JSON_INT_LEN];
+
+    _json_separate(writer);
+    _json_write(writer, number, LITE_json_format_uint(number, value));
+}
+
+void LITE_json_put_double(lite_json_writer_t *writer, double value)
+{
+    _json_separate(writer);
+    _json_write_real(writer, value, 0);
+}
+
+void LITE_json_put_float(lite_json_writer_t *writer, float value)
+{
+    _json_separate(writer);
+    _json_write_real(writer, value, 1);
+}
+
+void LITE_json_put_bool(lite_json_writer_t *writer, int value)
+{
+    _json_separate(writer);
+    if (value) {
+        _json_write(writer, "true", 4);
+    } else {
+        _json_write(writer, "false", 5);
+    }
+}
+
+void LITE_json_put_null(lite_json_writer_t *writer)
+{
+    _json_separate(writer);
+    _json_write(writer, "null", 4);
+}
+
+void LITE_json_put_number(lite_json_writer_t *writer, const char *text, uint32_t len)
+{
+    _json_separate(writer);
+    _json_write(writer, text, len);
+}
+
+void LITE_json_put_raw(lite_json_writer_t *writer, const char *json, uint32_t len)
+{
+    writer->after_key = 0;
+    _json_write(writer, json, len);
+}
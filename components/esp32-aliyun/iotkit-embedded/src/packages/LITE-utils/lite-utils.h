@@ -88,23 +88,216 @@ void        LITE_dump_malloc_free_stats(int level);
 void        LITE_track_malloc_callstack(int state);
 
 char           *LITE_json_value_of(char *key, char *src);
-list_head_t    *LITE_json_keys_of(char *src, char *prefix);
-void            LITE_json_keys_release(list_head_t *keylist);
 
-typedef struct _json_key_t {
-    char           *key;
-    list_head_t     list;
-} json_key_t;
+/* CBOR (RFC 7049) items of definite length. The writer counts on after the buffer is full,
+ * so @offset of an overflowed writer is the size the encoding needs. */
+typedef struct {
+    uint8_t        *buf;
+    uint32_t        size;
+    uint32_t        offset;
+    int             overflow;
+} lite_cbor_writer_t;
 
-#define foreach_json_keys_in(src, iter_key, keylist, pos)   \
-    for(keylist = (void *)LITE_json_keys_of((char *)src, ""), \
-        pos = (void *)list_first_entry((list_head_t *)keylist, json_key_t, list), \
-        iter_key = ((json_key_t *)pos)->key; \
-            (iter_key = ((json_key_t *)pos)->key); \
-                pos = list_next_entry((json_key_t *)pos, list))
+enum LITE_CBOR_TYPE {
+    LITE_CBOR_UINT,
+    LITE_CBOR_NEGINT,
+    LITE_CBOR_BYTES,
+    LITE_CBOR_TEXT,
+    LITE_CBOR_ARRAY,
+    LITE_CBOR_MAP,
+    LITE_CBOR_FALSE,
+    LITE_CBOR_TRUE,
+    LITE_CBOR_NULL,
+    LITE_CBOR_FLOAT
+};
+
+typedef struct {
+    int             type;   /* LITE_CBOR_TYPE */
+    uint64_t        value;  /* UINT, -1 - value of NEGINT, length of BYTES/TEXT, items of ARRAY/MAP */
+    double          real;   /* FLOAT, with its width in bytes in @value */
+    const uint8_t  *data;   /* BYTES/TEXT, NOT a string */
+} lite_cbor_item_t;
+
+typedef struct {
+    const uint8_t  *buf;
+    uint32_t        len;
+    uint32_t        offset;
+} lite_cbor_reader_t;
+
+void            LITE_cbor_writer_init(lite_cbor_writer_t *writer, uint8_t *buf, uint32_t size);
+void            LITE_cbor_put_uint(lite_cbor_writer_t *writer, uint64_t value);
+void            LITE_cbor_put_int(lite_cbor_writer_t *writer, int64_t value);
+void            LITE_cbor_put_double(lite_cbor_writer_t *writer, double value);
+void            LITE_cbor_put_bool(lite_cbor_writer_t *writer, int value);
+void            LITE_cbor_put_null(lite_cbor_writer_t *writer);
+void            LITE_cbor_put_text(lite_cbor_writer_t *writer, const char *text, uint32_t len);
+void            LITE_cbor_put_bytes(lite_cbor_writer_t *writer, const uint8_t *data, uint32_t len);
+void            LITE_cbor_put_array(lite_cbor_writer_t *writer, uint32_t items);
+void            LITE_cbor_put_map(lite_cbor_writer_t *writer, uint32_t pairs);
+
+void            LITE_cbor_reader_init(lite_cbor_reader_t *reader, const uint8_t *buf, uint32_t len);
+int             LITE_cbor_get(lite_cbor_reader_t *reader, lite_cbor_item_t *item);
+int             LITE_cbor_skip(lite_cbor_reader_t *reader);
+int             LITE_cbor_to_json(const uint8_t *cbor, uint32_t len, char *json, uint32_t size);
+
+/* JSON tokens in the jsmn style: offsets into the caller's buffer, nothing is copied or allocated.
+ * A key is a STRING token of size 1 followed by its value, a container comes before its members. */
+enum LITE_JSON_TYPE {
+    LITE_JSON_STRING,
+    LITE_JSON_OBJECT,
+    LITE_JSON_ARRAY,
+    LITE_JSON_NUMBER,
+    LITE_JSON_BOOLEAN,
+    LITE_JSON_NULL
+};
+
+enum LITE_JSON_ERROR {
+    LITE_JSON_ERROR_NOMEM = -1,     /* out of tokens, call again with a larger copy of the array */
+    LITE_JSON_ERROR_INVAL = -2,     /* not JSON */
+    LITE_JSON_ERROR_PART = -3       /* the document goes on, call again once more data is appended */
+};
+
+typedef struct {
+    int             type;   /* LITE_JSON_TYPE */
+    int             start;  /* first byte, after the opening quote of a string */
+    int             end;    /* one past the last byte, at the closing quote of a string */
+    int             size;   /* members of an object, entries of an array, 1 for a key */
+    int             parent; /* index of the container or key, -1 for the root */
+} lite_json_token_t;
+
+typedef struct {
+    uint32_t        pos;        /* bytes consumed */
+    uint32_t        toknext;    /* tokens used */
+    int             toksuper;   /* open container or key, -1 at top level */
+    int             expect;
+} lite_json_tokenizer_t;
+
+/* Tokenize the first @len bytes of @json, or up to a NUL before that. Return the number of tokens
+ * once the document is complete, LITE_JSON_ERROR_* otherwise. After NOMEM or PART, call again with
+ * the same tokenizer, the buffer with more data appended and the tokens found so far: scanning
+ * goes on from where it stopped. A bare number is complete when the data ends. */
+void            LITE_json_tokenizer_init(lite_json_tokenizer_t *tokenizer);
+int             LITE_json_tokenize(lite_json_tokenizer_t *tokenizer, const char *json, uint32_t len,
+                                   lite_json_token_t *tokens, uint32_t num_tokens);
+
+#define LITE_JSON_PATH_MAX_DEPTH    (8)
+#define LITE_JSON_PATH_MAX_COUNT    (32)
+
+/* A dotted path like "data.resources.mqtt.host", split and hashed once. @path is kept by reference. */
+typedef struct {
+    const char     *path;
+    int             depth;
+    uint16_t        offset[LITE_JSON_PATH_MAX_DEPTH];
+    uint16_t        len[LITE_JSON_PATH_MAX_DEPTH];
+    uint32_t        hash[LITE_JSON_PATH_MAX_DEPTH];
+} lite_json_path_t;
+
+/* Where a path was found in the document, @value is NULL if it was not */
+typedef struct {
+    const char     *value;  /* NOT a string, inside the quotes of a string */
+    int             len;
+    int             type;   /* LITE_JSON_TYPE */
+} lite_json_slice_t;
+
+/* return 0, or -1 if @dotted has an empty segment or more than LITE_JSON_PATH_MAX_DEPTH ones */
+int             LITE_json_path_compile(lite_json_path_t *path, const char *dotted);
+/* Resolve @count compiled @paths in one walk over the object @json, no further than @len bytes,
+ * and only into the members some path goes through. Fill @slices in the order of @paths, nothing
+ * is allocated. Return the number of paths found, LITE_JSON_ERROR_INVAL if @json is not an object. */
+int             LITE_json_path_extract(const char *json, uint32_t len,
+                                       const lite_json_path_t *paths, int count, lite_json_slice_t *slices);
+
+#define LITE_JSON_KEYS_MAX_DEPTH    (16)
+
+/* Depth-first walk over the keys of a tokenized object, nested objects included, arrays skipped.
+ * Keys come as full dotted paths like "data.resources.mqtt.host" in a buffer of the caller,
+ * nothing is allocated and several walks may run at once. */
+typedef struct {
+    const char                 *json;
+    const lite_json_token_t    *tokens;
+    int                         count;
+    int                         index;      /* next token to visit */
+    char                       *path;
+    uint32_t                    path_size;
+    int                         depth;
+    struct {
+        int                     object;     /* token of an open object */
+        uint32_t                path_len;   /* length of the path of its members, with the dot */
+    }                           stack[LITE_JSON_KEYS_MAX_DEPTH];
+} lite_json_keys_t;
+
+/* @tokens are the @count ones LITE_json_tokenize() found in @json, the root must be an object.
+ * Return 0, LITE_JSON_ERROR_INVAL if it is not. */
+int             LITE_json_keys_init(lite_json_keys_t *keys, const char *json,
+                                    const lite_json_token_t *tokens, int count, char *path, uint32_t path_size);
+/* Put the path of the next key in @path, NUL-terminated, and its value in @value if not NULL.
+ * Return the length of the path, 0 at the end, LITE_JSON_ERROR_NOMEM if the path does not fit
+ * in @path_size bytes or objects nest deeper than LITE_JSON_KEYS_MAX_DEPTH, which ends the walk. */
+int             LITE_json_keys_next(lite_json_keys_t *keys, lite_json_slice_t *value);
+
+/* Streaming JSON writer, nothing is allocated. Separators are written by the writer: a value
+ * after a key takes none, a member or an item after the first one of its container takes a comma,
+ * a value at top level takes none, which builds fragments of a larger document as well.
+ * Without a buffer it is a dry run which only counts the length. With a sink, a full buffer is
+ * handed to the sink and reused, so @buf is a chunk of the document, not all of it. */
+#define LITE_JSON_WRITER_MAX_DEPTH  (32)
+#define LITE_JSON_INT_LEN           (21)  /* digits of INT64_MIN with its sign */
+#define LITE_JSON_REAL_LEN          (25)  /* "-2.2250738585072014e-308", the longest real, with a NUL */
+
+/* take @len bytes of the document, return 0, or -1 to stop the writer */
+typedef int (*lite_json_sink_fpt)(void *ctx, const char *data, uint32_t len);
+
+typedef struct {
+    char               *buf;
+    uint32_t            size;
+    uint32_t            offset;     /* bytes in @buf */
+    uint32_t            len;        /* length of the document, counted on after an overflow */
+    int                 overflow;   /* set when @buf is full without sink, the sink failed or too deep */
+    lite_json_sink_fpt  sink;
+    void               *ctx;
+    int                 depth;
+    uint32_t            members;    /* bit N - 1: the container at depth N has a member already */
+    int                 after_key;
+} lite_json_writer_t;
+
+void            LITE_json_writer_init(lite_json_writer_t *writer, char *buf, uint32_t size);
+void            LITE_json_writer_set_sink(lite_json_writer_t *writer, lite_json_sink_fpt sink, void *ctx);
+/* Flush the sink, NUL-terminate @buf when there is room. Return the length of the document,
+ * or -1 if it overflowed. */
+int             LITE_json_writer_finish(lite_json_writer_t *writer);
+void            LITE_json_put_object(lite_json_writer_t *writer);
+void            LITE_json_put_object_end(lite_json_writer_t *writer);
+void            LITE_json_put_array(lite_json_writer_t *writer);
+void            LITE_json_put_array_end(lite_json_writer_t *writer);
+void            LITE_json_put_key(lite_json_writer_t *writer, const char *key, uint32_t len);
+void            LITE_json_put_string(lite_json_writer_t *writer, const char *text, uint32_t len);
+void            LITE_json_put_base64(lite_json_writer_t *writer, const uint8_t *data, uint32_t len);
+void            LITE_json_put_int(lite_json_writer_t *writer, int64_t value);
+void            LITE_json_put_uint(lite_json_writer_t *writer, uint64_t value);
+/* as LITE_json_format_real(): text which reads back to @value, null for NaN and infinity */
+void            LITE_json_put_double(lite_json_writer_t *writer, double value);
+void            LITE_json_put_float(lite_json_writer_t *writer, float value);
+void            LITE_json_put_bool(lite_json_writer_t *writer, int value);
+void            LITE_json_put_null(lite_json_writer_t *writer);
+/* @text is a number formatted by the caller */
+void            LITE_json_put_number(lite_json_writer_t *writer, const char *text, uint32_t len);
+/* @json is copied as it is, without separator: it is the value of a pending key, or a fragment */
+void            LITE_json_put_raw(lite_json_writer_t *writer, const char *json, uint32_t len);
+/* write decimal @value to @buf of LITE_JSON_INT_LEN bytes, NOT NUL-terminated, return its length */
+int             LITE_json_format_int(char *buf, int64_t value);
+int             LITE_json_format_uint(char *buf, uint64_t value);
+/* write @value to @buf of LITE_JSON_REAL_LEN bytes as "%g" does, with the fewest digits which read
+ * back to the same double, or float if @is_float: 17 / 9 at most, 0.1 and not 0.10000000000000001.
+ * "null" for NaN and infinity, NOT NUL-terminated. Return its length */
+int             LITE_json_format_real(char *buf, double value, int is_float);
 
 int unittest_string_utils(void);
 int unittest_json_parser(void);
 int unittest_json_token(void);
+int unittest_cbor(void);
+int unittest_json_tokenizer(void);
+int unittest_json_path(void);
+int unittest_json_writer(void);
+int unittest_json_keys(void);
 
 #endif  /* __LITE_UTILS_H__ */
@@ -24,6 +24,11 @@ int main(void)
     unittest_string_utils();
     unittest_json_token();
     unittest_json_parser();
+    unittest_cbor();
+    unittest_json_tokenizer();
+    unittest_json_path();
+    unittest_json_writer();
+    unittest_json_keys();
 
     return 0;
 }
@@ -18,6 +18,7 @@
 
 
 #include "lite-utils_internal.h"
+#include "json_parser.h"
 
 int unittest_string_utils(void)
 {
@@ -104,45 +105,44 @@ int unittest_string_utils(void)
     "\"message\":\"success\"" \
 "}"
 #define UNITTEST_JSON_SUBKEY    "data.resources"
+#define UNITTEST_JSON_SAMPLE_TOKENS (48)
 
 int unittest_json_token(void)
 {
-    list_head_t    *key_list = NULL;
-    json_key_t     *pos;
-
-    key_list = LITE_json_keys_of(UNITTEST_JSON_SAMPLE, "");
-
-    list_for_each_entry(pos, key_list, list) {
-        if (pos->key) {
-            char           *val = NULL;
-
-            val = LITE_json_value_of(pos->key, UNITTEST_JSON_SAMPLE);
-            log_info("%-28s: %.48s", pos->key, val);
-            LITE_free(val);
-        }
+    lite_json_tokenizer_t   tokenizer;
+    lite_json_token_t       tokens[UNITTEST_JSON_SAMPLE_TOKENS];
+    lite_json_keys_t        keys;
+    lite_json_slice_t       value;
+    char                    path[64];
+    char                   *sub_objc;
+    int                     count;
+
+    LITE_json_tokenizer_init(&tokenizer);
+    count = LITE_json_tokenize(&tokenizer, UNITTEST_JSON_SAMPLE, strlen(UNITTEST_JSON_SAMPLE), tokens,
+                               UNITTEST_JSON_SAMPLE_TOKENS);
+    if (0 != LITE_json_keys_init(&keys, UNITTEST_JSON_SAMPLE, tokens, count, path, sizeof(path))) {
+        return -1;
     }
-    LITE_json_keys_release(key_list);
+    while (LITE_json_keys_next(&keys, &value) > 0) {
+        char           *val = NULL;
 
-#if defined(__GLIBC__)
-    /* Demo usage without awareness of json_key_t{} and returned list */
-
-    char           *sub_objc;
-    void           *ret_list;
-    void           *temp;
-    char           *token;
+        val = LITE_json_value_of(path, UNITTEST_JSON_SAMPLE);
+        log_info("%-28s: %.48s", path, val);
+        LITE_free(val);
+    }
 
+    /* the walk of a member */
     sub_objc = LITE_json_value_of(UNITTEST_JSON_SUBKEY, UNITTEST_JSON_SAMPLE);
-
-    foreach_json_keys_in(sub_objc, token, ret_list, temp) {
-        char       *val;
-
-        val = LITE_json_value_of(token, sub_objc);
-        log_info("%s|%-18s: %.48s", UNITTEST_JSON_SUBKEY, token, val);
-        LITE_free(val);
+    LITE_json_tokenizer_init(&tokenizer);
+    count = LITE_json_tokenize(&tokenizer, sub_objc, strlen(sub_objc), tokens, UNITTEST_JSON_SAMPLE_TOKENS);
+    if (0 != LITE_json_keys_init(&keys, sub_objc, tokens, count, path, sizeof(path))) {
+        LITE_free(sub_objc);
+        return -1;
+    }
+    while (LITE_json_keys_next(&keys, &value) > 0) {
+        log_info("%s|%-18s: %.*s", UNITTEST_JSON_SUBKEY, path, value.len > 48 ? 48 : value.len, value.value);
     }
-    LITE_json_keys_release(ret_list);
     LITE_free(sub_objc);
-#endif  /* #if defined(__GLIBC__) */
 
     return 0;
 }
@@ -178,3 +178,421 @@ int unittest_json_parser(void)
     return 0;
 }
 
+int unittest_cbor(void)
+{
+    uint8_t             cbor[128];
+    char                json[256];
+    int                 len;
+    lite_cbor_writer_t  writer;
+    lite_cbor_reader_t  reader;
+    const char         *expected = "{\"method\":\"update\",\"state\":{\"reported\":"
+                                   "{\"temp\":23.5,\"ts\":1500000000123,\"on\":true,\"err\":-1,"
+                                   "\"pi\":3.141592653589793,\"raw\":\"AQI=\",\"tag\":\"a\\\"b\"}},"
+                                   "\"list\":[1,null,false]}";
+    const uint8_t       raw[] = { 0x01, 0x02 };
+    const uint8_t       truncated[] = { 0xA1, 0x61, 0x61, 0x1A, 0x00 };
+    const uint8_t       lying[] = { 0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+    LITE_cbor_writer_init(&writer, cbor, sizeof(cbor));
+    LITE_cbor_put_map(&writer, 3);
+    LITE_cbor_put_text(&writer, "method", 6);
+    LITE_cbor_put_text(&writer, "update", 6);
+    LITE_cbor_put_text(&writer, "state", 5);
+    LITE_cbor_put_map(&writer, 1);
+    LITE_cbor_put_text(&writer, "reported", 8);
+    LITE_cbor_put_map(&writer, 7);
+    LITE_cbor_put_text(&writer, "temp", 4);
+    LITE_cbor_put_double(&writer, 23.5);
+    LITE_cbor_put_text(&writer, "ts", 2);
+    LITE_cbor_put_int(&writer, 1500000000123LL);
+    LITE_cbor_put_text(&writer, "on", 2);
+    LITE_cbor_put_bool(&writer, 1);
+    LITE_cbor_put_text(&writer, "err", 3);
+    LITE_cbor_put_int(&writer, -1);
+    LITE_cbor_put_text(&writer, "pi", 2);
+    LITE_cbor_put_double(&writer, 3.141592653589793);
+    LITE_cbor_put_text(&writer, "raw", 3);
+    LITE_cbor_put_bytes(&writer, raw, sizeof(raw));
+    LITE_cbor_put_text(&writer, "tag", 3);
+    LITE_cbor_put_text(&writer, "a\"b", 3);
+    LITE_cbor_put_text(&writer, "list", 4);
+    LITE_cbor_put_array(&writer, 3);
+    LITE_cbor_put_uint(&writer, 1);
+    LITE_cbor_put_null(&writer);
+    LITE_cbor_put_bool(&writer, 0);
+    if (writer.overflow) {
+        log_err("cbor writer overflow, %u bytes needed", writer.offset);
+        return -1;
+    }
+
+    len = LITE_cbor_to_json(cbor, writer.offset, NULL, 0);
+    if (len != strlen(expected) || LITE_cbor_to_json(cbor, writer.offset, json, sizeof(json)) != len
+        || 0 != strcmp(json, expected)) {
+        log_err("cbor to json(%d): '%s'", len, json);
+        return -1;
+    }
+    log_info("CBOR: %u bytes, JSON: %d bytes", writer.offset, len);
+
+    LITE_cbor_reader_init(&reader, cbor, writer.offset);
+    if (0 != LITE_cbor_skip(&reader) || reader.offset != writer.offset) {
+        log_err("cbor skip failed");
+        return -1;
+    }
+
+    if (-1 != LITE_cbor_to_json(truncated, sizeof(truncated), json, sizeof(json))
+        || -1 != LITE_cbor_to_json(lying, sizeof(lying), json, sizeof(json))
+        || -1 != LITE_cbor_to_json(cbor, writer.offset - 1, json, sizeof(json))) {
+        log_err("malformed cbor accepted");
+        return -1;
+    }
+
+    return 0;
+}
+
+#define UNITTEST_JSON_TOKENS    (24)
+
+int unittest_json_tokenizer(void)
+{
+    const char             *doc = " {\"method\":\"control\",\"t\":-12.5e+2,\"s\":\"a\\\"b\\u00e9\\\\\","
+                                  "\"list\":[0,-1,true,null,{}],\"n\":{\"x\":[[]],\"y\":false}} ";
+    const char             *bad[] = {
+        "{\"a\":01}", "{\"a\":-}", "{\"a\":1.}", "{\"a\":tru}", "{\"a\" 1}", "{\"a\":1,}", "[1,]",
+        "{\"a\":\"\\x\"}", "{\"a\":\"\\u12G4\"}", "{1:2}", "[1}", "{\"a\":[1]]", "{} {}", "\"a\tb\"", 0
+    };
+    /* not NUL terminated, the name must not match "version" as a prefix */
+    char                    legacy[] = "{\"versionX\":1,\"s\":\"x\\\"y\",\"version\":-3}garbage";
+    lite_json_tokenizer_t   tokenizer;
+    lite_json_token_t       tokens[UNITTEST_JSON_TOKENS], grown[UNITTEST_JSON_TOKENS];
+    int                     count, ret, i, len = strlen(doc);
+    char                   *val;
+
+    LITE_json_tokenizer_init(&tokenizer);
+    count = LITE_json_tokenize(&tokenizer, doc, len, tokens, UNITTEST_JSON_TOKENS);
+    if (count != 21 || tokens[0].type != LITE_JSON_OBJECT || tokens[0].size != 5
+        || tokens[4].type != LITE_JSON_NUMBER || strncmp(doc + tokens[4].start, "-12.5e+2", tokens[4].end - tokens[4].start)
+        || tokens[6].end - tokens[6].start != 12 || tokens[8].type != LITE_JSON_ARRAY || tokens[8].size != 5
+        || tokens[12].type != LITE_JSON_NULL || tokens[12].parent != 8 || tokens[14].parent != 0 || tokens[15].parent != 14) {
+        log_err("json tokenize: %d", count);
+        return -1;
+    }
+
+    /* the same document one byte at a time */
+    LITE_json_tokenizer_init(&tokenizer);
+    for (i = 1; i <= len; i++) {
+        ret = LITE_json_tokenize(&tokenizer, doc, i, grown, UNITTEST_JSON_TOKENS);
+        if (ret != (i < len - 1 ? LITE_JSON_ERROR_PART : count)) {
+            log_err("json tokenize %d/%d bytes: %d", i, len, ret);
+            return -1;
+        }
+    }
+    if (0 != memcmp(tokens, grown, count * sizeof(lite_json_token_t))) {
+        log_err("json tokenize in chunks differs");
+        return -1;
+    }
+
+    /* out of tokens, then resumed on a larger array */
+    LITE_json_tokenizer_init(&tokenizer);
+    if (LITE_JSON_ERROR_NOMEM != LITE_json_tokenize(&tokenizer, doc, len, grown, 4)
+        || count != LITE_json_tokenize(&tokenizer, doc, len, grown, UNITTEST_JSON_TOKENS)
+        || 0 != memcmp(tokens, grown, count * sizeof(lite_json_token_t))) {
+        log_err("json tokenize resume failed");
+        return -1;
+    }
+
+    for (i = 0; bad[i]; i++) {
+        LITE_json_tokenizer_init(&tokenizer);
+        ret = LITE_json_tokenize(&tokenizer, bad[i], strlen(bad[i]), tokens, UNITTEST_JSON_TOKENS);
+        if (LITE_JSON_ERROR_INVAL != ret) {
+            log_err("json tokenize accepted '%s': %d", bad[i], ret);
+            return -1;
+        }
+    }
+
+    val = json_get_value_by_name(legacy, strlen(legacy) - 7, "version", &len, &ret);
+    if (NULL == val || len != 2 || ret != JNUMBER || strncmp(val, "-3", 2)) {
+        log_err("json value by name: %.*s", len, val ? val : "");
+        return -1;
+    }
+    val = json_get_value_by_name(legacy, strlen(legacy) - 7, "s", &len, &ret);
+    if (NULL == val || len != 4 || ret != JSTRING) {
+        log_err("json value by name: %.*s", len, val ? val : "");
+        return -1;
+    }
+
+    return 0;
+}
+
+int unittest_json_path(void)
+{
+    /* not NUL terminated, "message" is in the bytes past the end */
+    const char         *doc = "{\"code\":200,\"data\":{\"iotId\":\"42Ze\",\"empty\":\"\",\"resources\":"
+                              "{\"mqtt\":{\"host\":\"10.10.10.10\",\"port\":-9},\"list\":[{\"a\":1}]}},"
+                              "\"version\":\"1\"},\"message\":\"success\"}";
+    const char         *dotted[] = {
+        "data.resources.mqtt.port", "code", "data.iotId", "data.resources.mqtt.host", "data.empty",
+        "data.resources.list", "data.resources.list.a", "data.none", "version", "message"
+    };
+    lite_json_path_t    paths[10];
+    lite_json_slice_t   slices[10];
+    int                 i, found;
+
+    for (i = 0; i < 10; i++) {
+        if (0 != LITE_json_path_compile(&paths[i], dotted[i])) {
+            log_err("json path compile: '%s'", dotted[i]);
+            return -1;
+        }
+    }
+    if (0 == LITE_json_path_compile(&paths[0], "a..b") || 0 == LITE_json_path_compile(&paths[0], "a.b.c.d.e.f.g.h.i")) {
+        log_err("json path compile accepted a bad path");
+        return -1;
+    }
+    LITE_json_path_compile(&paths[0], dotted[0]);
+
+    found = LITE_json_path_extract(doc, strlen(doc) - 21, paths, 10, slices);
+    if (found != 7
+        || slices[0].len != 2 || strncmp(slices[0].value, "-9", 2) || slices[0].type != LITE_JSON_NUMBER
+        || slices[1].len != 3 || strncmp(slices[1].value, "200", 3)
+        || slices[2].len != 4 || strncmp(slices[2].value, "42Ze", 4) || slices[2].type != LITE_JSON_STRING
+        || slices[3].len != 11 || strncmp(slices[3].value, "10.10.10.10", 11)
+        || NULL == slices[4].value || slices[4].len != 0
+        || slices[5].type != LITE_JSON_ARRAY || slices[5].len != 9
+        || NULL != slices[6].value || NULL != slices[7].value || slices[8].len != 1 || NULL != slices[9].value) {
+        log_err("json path extract: %d", found);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int _unittest_json_sink(void *ctx, const char *data, uint32_t len)
+{
+    char       *out = (char *)ctx;
+    uint32_t    used = strlen(out);
+
+    if (used + len >= 128) {
+        return -1;
+    }
+    memcpy(out + used, data, len);
+    out[used + len] = '\0';
+
+    return 0;
+}
+
+int unittest_json_writer(void)
+{
+    const char         *expect = "{\"id\":-12,\"s\":\"a\\\"b\\\\\\n\\u0001\",\"list\":[1,2.5,true,null,{}],"
+                                 "\"bin\":\"AQID\",\"big\":18446744073709551615}";
+    const struct {
+        double      value;
+        int         is_float;
+        const char *expect;
+    } reals[] = {
+        {0.1, 0, "0.1"},
+        {21.3f, 1, "21.3"},
+        {21.3f, 0, "21.299999237060547"},
+        {-0.1f, 1, "-0.1"},
+        {1e-7, 0, "1e-7"},
+        {1e300, 0, "1e+300"},
+        {3.141592653589793, 0, "3.141592653589793"},
+        {0.1 + 0.2, 0, "0.30000000000000004"},
+        {1.5e-5, 1, "1.5e-5"},
+        {123456.789, 0, "123456.789"},
+        {3e9f, 1, "3e+9"},
+        {5e-324, 0, "5e-324"},
+        {1.7976931348623157e308, 0, "1.7976931348623157e+308"},
+        {-2.2250738585072014e-308, 0, "-2.2250738585072014e-308"},
+        {-0.00012345678901234567, 0, "-0.00012345678901234567"},
+    };
+    char                buf[128], chunk[8], sunk[128];
+    lite_json_writer_t  writer;
+    int                 i, len;
+
+    for (i = 0; i < 3; i++) {
+        /* a dry run, a buffer, and a small chunk handed to a sink */
+        if (0 == i) {
+            LITE_json_writer_init(&writer, NULL, 0);
+        } else if (1 == i) {
+            LITE_json_writer_init(&writer, buf, sizeof(buf));
+        } else {
+            sunk[0] = '\0';
+            LITE_json_writer_init(&writer, chunk, sizeof(chunk));
+            LITE_json_writer_set_sink(&writer, _unittest_json_sink, sunk);
+        }
+
+        LITE_json_put_object(&writer);
+        LITE_json_put_key(&writer, "id", 2);
+        LITE_json_put_int(&writer, -12);
+        LITE_json_put_key(&writer, "s", 1);
+        LITE_json_put_string(&writer, "a\"b\\\n\001", 6);
+        LITE_json_put_key(&writer, "list", 4);
+        LITE_json_put_array(&writer);
+        LITE_json_put_uint(&writer, 1);
+        LITE_json_put_double(&writer, 2.5);
+        LITE_json_put_bool(&writer, 1);
+        LITE_json_put_null(&writer);
+        LITE_json_put_object(&writer);
+        LITE_json_put_object_end(&writer);
+        LITE_json_put_array_end(&writer);
+        LITE_json_put_key(&writer, "bin", 3);
+        LITE_json_put_base64(&writer, (const uint8_t *)"\001\002\003", 3);
+        LITE_json_put_key(&writer, "big", 3);
+        LITE_json_put_uint(&writer, 0xFFFFFFFFFFFFFFFFULL);
+        LITE_json_put_object_end(&writer);
+
+        len = LITE_json_writer_finish(&writer);
+        if ((len != strlen(expect)) || ((1 == i) && strcmp(buf, expect)) || ((2 == i) && strcmp(sunk, expect))) {
+            log_err("json writer %d: %d", i, len);
+            return -1;
+        }
+    }
+
+    /* a fragment, then a buffer too small by the NUL */
+    LITE_json_writer_init(&writer, buf, 8);
+    LITE_json_put_raw(&writer, ",", 1);
+    LITE_json_put_key(&writer, "k", 1);
+    LITE_json_put_int(&writer, 7);
+    if (6 != LITE_json_writer_finish(&writer) || strcmp(buf, ",\"k\":7")) {
+        log_err("json writer fragment: %s", buf);
+        return -1;
+    }
+    LITE_json_put_string(&writer, "xy", 2);
+    if (-1 != LITE_json_writer_finish(&writer)) {
+        log_err("json writer overflow");
+        return -1;
+    }
+
+    /* the shortest text which reads back */
+    for (i = 0; i < sizeof(reals) / sizeof(reals[0]); i++) {
+        len = LITE_json_format_real(buf, reals[i].value, reals[i].is_float);
+        if ((len != strlen(reals[i].expect)) || (0 != memcmp(buf, reals[i].expect, len))) {
+            buf[len] = '\0';
+            log_err("json real %s: %s", reals[i].expect, buf);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* walk @doc with @count tokens, check every value against LITE_json_value_of(), return the keys */
+static int _unittest_json_keys_walk(char *doc, lite_json_token_t *tokens, int count, uint32_t path_size)
+{
+    lite_json_keys_t    keys;
+    lite_json_slice_t   value;
+    char                path[256], *val;
+    int                 found = 0, len, dots, i;
+
+    if (0 != LITE_json_keys_init(&keys, doc, tokens, count, path, path_size)) {
+        return -1;
+    }
+    while ((len = LITE_json_keys_next(&keys, &value)) > 0) {
+        if (len != strlen(path)) {
+            return -1;
+        }
+        ++found;
+        for (dots = 0, i = 0; i < len; i++) {
+            dots += ('.' == path[i]);
+        }
+        /* LITE_json_value_of() goes no deeper than this */
+        if (dots >= LITE_JSON_PATH_MAX_DEPTH) {
+            continue;
+        }
+        val = LITE_json_value_of(path, doc);
+        if (NULL == val || strlen(val) != value.len || strncmp(val, value.value, value.len)) {
+            log_err("json keys: %s", path);
+            if (NULL != val) {
+                LITE_free(val);
+            }
+            return -1;
+        }
+        LITE_free(val);
+    }
+
+    return (len < 0) ? len : found;
+}
+
+#define UNITTEST_JSON_KEYS_DOC_LEN      (4096)
+#define UNITTEST_JSON_KEYS_TOKENS       (1024)
+
+int unittest_json_keys(void)
+{
+    char                   *doc;
+    lite_json_token_t      *tokens;
+    lite_json_tokenizer_t   tokenizer;
+    lite_json_keys_t        one, two;
+    lite_json_slice_t       value;
+    char                    path_one[64], path_two[64];
+    int                     depth, i, off, count, ret = -1;
+
+    doc = LITE_malloc(UNITTEST_JSON_KEYS_DOC_LEN);
+    tokens = LITE_malloc(UNITTEST_JSON_KEYS_TOKENS * sizeof(lite_json_token_t));
+    if (NULL == doc || NULL == tokens) {
+        goto exit;
+    }
+
+    /* objects as deep as the walk goes, and one more: {"k0":{"v":0,"a":[{"x":1}],"k1":{...}}} */
+    for (depth = LITE_JSON_KEYS_MAX_DEPTH - 1; depth <= LITE_JSON_KEYS_MAX_DEPTH; depth++) {
+        for (i = 0, off = 1, doc[0] = '{'; i < depth; i++) {
+            off += LITE_snprintf(doc + off, UNITTEST_JSON_KEYS_DOC_LEN - off, "%s\"k%d\":{\"v\":%d,\"a\":[{\"x\":1}]",
+                                 i ? "," : "", i, i);
+        }
+        for (i = 0; i <= depth; i++) {
+            doc[off++] = '}';
+        }
+        doc[off] = '\0';
+
+        LITE_json_tokenizer_init(&tokenizer);
+        count = LITE_json_tokenize(&tokenizer, doc, off, tokens, UNITTEST_JSON_KEYS_TOKENS);
+        i = _unittest_json_keys_walk(doc, tokens, count, 256);
+        if ((depth < LITE_JSON_KEYS_MAX_DEPTH && i != 3 * depth)
+            || (depth == LITE_JSON_KEYS_MAX_DEPTH && i != LITE_JSON_ERROR_NOMEM)) {
+            log_err("json keys, depth %d: %d", depth, i);
+            goto exit;
+        }
+
+        /* "k0.k1.k2.k3.k4.k5.k6.k7.k8.k9.k10" and longer ones do not fit */
+        if (LITE_JSON_ERROR_NOMEM != _unittest_json_keys_walk(doc, tokens, count, 32)) {
+            log_err("json keys, short path");
+            goto exit;
+        }
+    }
+
+    /* wide: 300 members, the one in the middle an object of 10 */
+    for (i = 0, off = 1, doc[0] = '{'; i < 300; i++) {
+        off += LITE_snprintf(doc + off, UNITTEST_JSON_KEYS_DOC_LEN - off, "%s\"m%d\":%s", i ? "," : "", i,
+                             150 == i ? "{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8,\"i\":9,\"j\":0}"
+                             : "\"s\"");
+    }
+    doc[off++] = '}';
+    doc[off] = '\0';
+
+    LITE_json_tokenizer_init(&tokenizer);
+    count = LITE_json_tokenize(&tokenizer, doc, off, tokens, UNITTEST_JSON_KEYS_TOKENS);
+    if (310 != _unittest_json_keys_walk(doc, tokens, count, 64)) {
+        log_err("json keys, wide");
+        goto exit;
+    }
+
+    /* two walks at once over the same tokens */
+    LITE_json_keys_init(&one, doc, tokens, count, path_one, sizeof(path_one));
+    LITE_json_keys_init(&two, doc, tokens, count, path_two, sizeof(path_two));
+    do {
+        i = LITE_json_keys_next(&one, &value);
+        if (i != LITE_json_keys_next(&two, NULL) || strcmp(path_one, path_two)) {
+            log_err("json keys, two walks: %s %s", path_one, path_two);
+            goto exit;
+        }
+    } while (i > 0);
+
+    ret = 0;
+
+exit:
+    if (NULL != doc) {
+        LITE_free(doc);
+    }
+    if (NULL != tokens) {
+        LITE_free(tokens);
+    }
+
+    return ret;
+}
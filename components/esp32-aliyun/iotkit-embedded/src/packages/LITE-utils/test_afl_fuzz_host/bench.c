@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Cost of a document of N members, half of them booleans, the rest negative numbers and
+ * strings with escaped quotes:
+ *
+ *   tokenize : LITE_json_tokenize() over the whole document
+ *   chunked  : the same, resumed on every 64 bytes as they would arrive from the network
+ *   by name  : json_get_value_by_name() of every member, one walk per member
+ *   paths    : LITE_json_path_extract() of every member compiled once, one walk per 32 members
+ *
+ *   ./bench [-n rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "lite-utils.h"
+#include "json_parser.h"
+
+#define BENCH_CHUNK_LEN     (64)
+#define BENCH_MAX_MEMBERS   (1000)
+
+static double bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static char *bench_document(int members)
+{
+    int i, off = 0;
+    char *doc = malloc(64 + members * 48);
+
+    off += sprintf(doc + off, "{");
+    for (i = 0; i < members; i++) {
+        switch (i % 4) {
+            case 0:
+            case 2:
+                off += sprintf(doc + off, "%s\"key%d\":%s", i ? "," : "", i, i % 8 ? "false" : "true");
+                break;
+            case 1:
+                off += sprintf(doc + off, "%s\"key%d\":%d.%d", i ? "," : "", i, -i * 7, i % 10);
+                break;
+            default:
+                off += sprintf(doc + off, "%s\"key%d\":\"v\\\"%d\\\"\"", i ? "," : "", i, i);
+                break;
+        }
+    }
+    sprintf(doc + off, "}");
+
+    return doc;
+}
+
+int main(int argc, char **argv)
+{
+    static const int        member_counts[] = {10, 100, 1000};
+    int                     opt, rounds = 200, i, r, k, members, len, count = 0, vlen, found, extracted;
+    double                  start, whole_us, chunked_us, name_us, paths_us;
+    char                   *doc, name[16];
+    static char             names[BENCH_MAX_MEMBERS][16];
+    static lite_json_path_t paths[BENCH_MAX_MEMBERS];
+    lite_json_slice_t       slices[LITE_JSON_PATH_MAX_COUNT];
+    lite_json_token_t      *tokens;
+    lite_json_tokenizer_t   tokenizer;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-n rounds]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (rounds <= 0) {
+        return -1;
+    }
+
+    printf("%8s %8s | %12s %8s | %12s %8s | %12s | %12s\n",
+           "members", "bytes", "tokenize us", "MB/s", "chunked us", "MB/s", "by name us", "paths us");
+
+    for (k = 0; k < BENCH_MAX_MEMBERS; k++) {
+        sprintf(names[k], "key%d", k);
+        LITE_json_path_compile(&paths[k], names[k]);
+    }
+
+    for (i = 0; i < sizeof(member_counts) / sizeof(member_counts[0]); i++) {
+        members = member_counts[i];
+        doc = bench_document(members);
+        len = strlen(doc);
+        tokens = malloc((2 * members + 1) * sizeof(lite_json_token_t));
+
+        start = bench_now_us();
+        for (r = 0; r < rounds; r++) {
+            LITE_json_tokenizer_init(&tokenizer);
+            count = LITE_json_tokenize(&tokenizer, doc, len, tokens, 2 * members + 1);
+        }
+        whole_us = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0; r < rounds; r++) {
+            LITE_json_tokenizer_init(&tokenizer);
+            for (k = BENCH_CHUNK_LEN; k < len + BENCH_CHUNK_LEN; k += BENCH_CHUNK_LEN) {
+                count = LITE_json_tokenize(&tokenizer, doc, k < len ? k : len, tokens, 2 * members + 1);
+            }
+        }
+        chunked_us = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0, found = 0; r < rounds; r++) {
+            for (k = 0; k < members; k++) {
+                sprintf(name, "key%d", k);
+                found += (NULL != json_get_value_by_name(doc, len, name, &vlen, NULL));
+            }
+        }
+        name_us = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0, extracted = 0; r < rounds; r++) {
+            for (k = 0; k < members; k += LITE_JSON_PATH_MAX_COUNT) {
+                extracted += LITE_json_path_extract(doc, len, &paths[k],
+                                                    LITE_MINIMUM(LITE_JSON_PATH_MAX_COUNT, members - k), slices);
+            }
+        }
+        paths_us = (bench_now_us() - start) / rounds;
+
+        printf("%8d %8d | %12.1f %8.1f | %12.1f %8.1f | %12.1f | %12.1f%s\n", members, len,
+               whole_us, len / whole_us, chunked_us, len / chunked_us, name_us, paths_us,
+               count == 2 * members + 1 && found == rounds * members && extracted == found ? "" : "  MISMATCH");
+
+        free(tokens);
+        free(doc);
+    }
+
+    return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/*
+ * Uplink documents as the SDK builds them, formatted with snprintf() as before and with the
+ * streaming writer of json_writer.c:
+ *
+ *   shadow : an update of N attributes, integers, floats and strings, one snprintf() per piece
+ *   ota    : the progress report of otalib_GenReportMsg()
+ *   auth   : the /auth body of the HTTP client, sized first by formatting it twice before,
+ *            by a dry run of the writer now
+ *
+ *   ./bench_writer [-n rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "lite-utils.h"
+
+#define BENCH_BUF_LEN       (8192)
+#define BENCH_DEVICE_ID     "yfTuLfBJTiL.TestDeviceForDemo"
+#define BENCH_SIGN          "2d4c4b4b8a3ab4b0b2f5b8c4bda3d5c0d1a2b3c4"
+
+static double bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int bench_shadow_snprintf(char *buf, int attrs)
+{
+    int i, off;
+
+    off = snprintf(buf, BENCH_BUF_LEN, "{\"%s\":\"%s\"", "method", "update");
+    off += snprintf(buf + off, BENCH_BUF_LEN - off, ",%s", "\"state\":{\"reported\":{");
+    for (i = 0; i < attrs; i++) {
+        off += snprintf(buf + off, BENCH_BUF_LEN - off, "%s\"attr%d\":", i ? "," : "", i);
+        switch (i % 3) {
+            case 0:
+                off += snprintf(buf + off, BENCH_BUF_LEN - off, "%d", i * 1237);
+                break;
+            case 1:
+                off += snprintf(buf + off, BENCH_BUF_LEN - off, "%g", i * 0.25);
+                break;
+            default:
+                off += snprintf(buf + off, BENCH_BUF_LEN - off, "\"%s\"", "on");
+                break;
+        }
+    }
+    off += snprintf(buf + off, BENCH_BUF_LEN - off, "%s", "}}");
+    off += snprintf(buf + off, BENCH_BUF_LEN - off, ",\"clientToken\":\"%s-%d\",\"version\":%d}",
+                    BENCH_DEVICE_ID, 17, 42);
+
+    return off;
+}
+
+static int bench_shadow_writer(char *buf, int attrs)
+{
+    int i, len;
+    char name[16], token[64];
+    lite_json_writer_t writer;
+
+    LITE_json_writer_init(&writer, buf, BENCH_BUF_LEN);
+    LITE_json_put_object(&writer);
+    LITE_json_put_key(&writer, "method", 6);
+    LITE_json_put_string(&writer, "update", 6);
+    LITE_json_put_key(&writer, "state", 5);
+    LITE_json_put_object(&writer);
+    LITE_json_put_key(&writer, "reported", 8);
+    LITE_json_put_object(&writer);
+    for (i = 0; i < attrs; i++) {
+        memcpy(name, "attr", 4);
+        len = 4 + LITE_json_format_uint(name + 4, i);
+        LITE_json_put_key(&writer, name, len);
+        switch (i % 3) {
+            case 0:
+                LITE_json_put_int(&writer, i * 1237);
+                break;
+            case 1:
+                LITE_json_put_double(&writer, i * 0.25);
+                break;
+            default:
+                LITE_json_put_string(&writer, "on", 2);
+                break;
+        }
+    }
+    LITE_json_put_object_end(&writer);
+    LITE_json_put_object_end(&writer);
+    len = strlen(BENCH_DEVICE_ID);
+    memcpy(token, BENCH_DEVICE_ID, len);
+    token[len++] = '-';
+    len += LITE_json_format_uint(token + len, 17);
+    LITE_json_put_key(&writer, "clientToken", 11);
+    LITE_json_put_string(&writer, token, len);
+    LITE_json_put_key(&writer, "version", 7);
+    LITE_json_put_uint(&writer, 42);
+    LITE_json_put_object_end(&writer);
+
+    return LITE_json_writer_finish(&writer);
+}
+
+static int bench_ota_snprintf(char *buf, int progress)
+{
+    return snprintf(buf, BENCH_BUF_LEN, "{\"id\":%d,\"params\": {\"step\": \"%d\",\"desc\":\"%s\"}}",
+                    7, progress, "Enter in downloading state");
+}
+
+static int bench_ota_writer(char *buf, int progress)
+{
+    char step[LITE_JSON_INT_LEN];
+    lite_json_writer_t writer;
+
+    LITE_json_writer_init(&writer, buf, BENCH_BUF_LEN);
+    LITE_json_put_object(&writer);
+    LITE_json_put_key(&writer, "id", 2);
+    LITE_json_put_uint(&writer, 7);
+    LITE_json_put_key(&writer, "params", 6);
+    LITE_json_put_object(&writer);
+    LITE_json_put_key(&writer, "step", 4);
+    LITE_json_put_string(&writer, step, LITE_json_format_int(step, progress));
+    LITE_json_put_key(&writer, "desc", 4);
+    LITE_json_put_string(&writer, "Enter in downloading state", 26);
+    LITE_json_put_object_end(&writer);
+    LITE_json_put_object_end(&writer);
+
+    return LITE_json_writer_finish(&writer);
+}
+
+#define BENCH_AUTH_FMT  "{\"version\":\"%s\", \"clientId\":\"%s\",\"signmethod\":\"%s\",\"sign\":\"%s\"," \
+                        "\"productKey\":\"%s\",\"deviceName\":\"%s\"}"
+
+/* as the HTTP client sized its body before */
+static int bench_calc_length(const char *fmt, ...)
+{
+    va_list args;
+    int rc = 0;
+    const char *p, *sval;
+
+    va_start(args, fmt);
+    for (p = fmt; *p; p++) {
+        if (*p != '%') {
+            rc++;
+            continue;
+        }
+        if ('s' == *++p) {
+            for (sval = va_arg(args, const char *); *sval; sval++) {
+                rc++;
+            }
+        } else {
+            rc++;
+        }
+    }
+    va_end(args);
+
+    return rc;
+}
+
+static int bench_auth_snprintf(char *buf)
+{
+    int len = bench_calc_length(BENCH_AUTH_FMT, "default", BENCH_DEVICE_ID, "hmacsha1", BENCH_SIGN,
+                                "yfTuLfBJTiL", "TestDeviceForDemo");
+
+    snprintf(buf, len + 1, BENCH_AUTH_FMT, "default", BENCH_DEVICE_ID, "hmacsha1", BENCH_SIGN,
+             "yfTuLfBJTiL", "TestDeviceForDemo");
+
+    return len;
+}
+
+static void bench_auth_body(lite_json_writer_t *writer)
+{
+    LITE_json_put_object(writer);
+    LITE_json_put_key(writer, "version", 7);
+    LITE_json_put_string(writer, "default", 7);
+    LITE_json_put_key(writer, "clientId", 8);
+    LITE_json_put_string(writer, BENCH_DEVICE_ID, strlen(BENCH_DEVICE_ID));
+    LITE_json_put_key(writer, "signmethod", 10);
+    LITE_json_put_string(writer, "hmacsha1", 8);
+    LITE_json_put_key(writer, "sign", 4);
+    LITE_json_put_string(writer, BENCH_SIGN, strlen(BENCH_SIGN));
+    LITE_json_put_key(writer, "productKey", 10);
+    LITE_json_put_string(writer, "yfTuLfBJTiL", 11);
+    LITE_json_put_key(writer, "deviceName", 10);
+    LITE_json_put_string(writer, "TestDeviceForDemo", 17);
+    LITE_json_put_object_end(writer);
+}
+
+static int bench_auth_writer(char *buf)
+{
+    int len;
+    lite_json_writer_t writer;
+
+    LITE_json_writer_init(&writer, NULL, 0);
+    bench_auth_body(&writer);
+    len = LITE_json_writer_finish(&writer);
+
+    LITE_json_writer_init(&writer, buf, len + 1);
+    bench_auth_body(&writer);
+
+    return LITE_json_writer_finish(&writer);
+}
+
+int main(int argc, char **argv)
+{
+    static const int attr_counts[] = {4, 32, 128};
+    int opt, rounds = 20000, i, r;
+    unsigned long bytes_old, bytes_new;
+    double start, old_us, new_us;
+    char *buf = malloc(BENCH_BUF_LEN);
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-n rounds]\n", argv[0]);
+                free(buf);
+                return 0;
+        }
+    }
+    if (rounds <= 0) {
+        free(buf);
+        return -1;
+    }
+
+    printf("%-12s | %12s | %12s | %8s\n", "document", "snprintf us", "writer us", "speedup");
+
+    for (i = 0; i < sizeof(attr_counts) / sizeof(attr_counts[0]); i++) {
+        start = bench_now_us();
+        for (r = 0, bytes_old = 0; r < rounds; r++) {
+            bytes_old += bench_shadow_snprintf(buf, attr_counts[i]);
+        }
+        old_us = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0, bytes_new = 0; r < rounds; r++) {
+            bytes_new += bench_shadow_writer(buf, attr_counts[i]);
+        }
+        new_us = (bench_now_us() - start) / rounds;
+
+        printf("shadow %-5d | %12.3f | %12.3f | %7.1fx%s\n", attr_counts[i], old_us, new_us, old_us / new_us,
+               bytes_old == bytes_new ? "" : "  MISMATCH");
+    }
+
+    start = bench_now_us();
+    for (r = 0, bytes_old = 0; r < rounds; r++) {
+        bytes_old += bench_ota_snprintf(buf, r % 100);
+    }
+    old_us = (bench_now_us() - start) / rounds;
+    start = bench_now_us();
+    for (r = 0, bytes_new = 0; r < rounds; r++) {
+        bytes_new += bench_ota_writer(buf, r % 100);
+    }
+    new_us = (bench_now_us() - start) / rounds;
+    /* the writer drops the spaces of the old format */
+    printf("%-12s | %12.3f | %12.3f | %7.1fx%s\n", "ota report", old_us, new_us, old_us / new_us,
+           bytes_old == bytes_new + 2UL * rounds ? "" : "  MISMATCH");
+
+    start = bench_now_us();
+    for (r = 0, bytes_old = 0; r < rounds; r++) {
+        bytes_old += bench_auth_snprintf(buf);
+    }
+    old_us = (bench_now_us() - start) / rounds;
+    start = bench_now_us();
+    for (r = 0, bytes_new = 0; r < rounds; r++) {
+        bytes_new += bench_auth_writer(buf);
+    }
+    new_us = (bench_now_us() - start) / rounds;
+    /* and the space after "version" */
+    printf("%-12s | %12.3f | %12.3f | %7.1fx%s\n", "http auth", old_us, new_us, old_us / new_us,
+           bytes_old == bytes_new + (unsigned long)rounds ? "" : "  MISMATCH");
+
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lite-utils.h"
+#include "json_parser.h"
+
+#define JSON_FUZZ_MAX_LEN       (4096)
+#define JSON_FUZZ_MAX_TOKENS    (512)
+
+static lite_json_token_t    whole[JSON_FUZZ_MAX_TOKENS];
+static lite_json_token_t    parts[JSON_FUZZ_MAX_TOKENS];
+
+static int json_fuzz_sum(char *key, int klen, char *val, int vlen, int vtype, void *sum)
+{
+    *(unsigned int *)sum += klen + vlen + vtype;
+    return JSON_PARSE_OK;
+}
+
+/* Tokenize @buf at once and again in two chunks, both must agree and every token must lie in @buf.
+ * The legacy name/value walk runs over the same bytes for ASan to watch. */
+static int json_fuzz_check(char *buf, int len)
+{
+    lite_json_tokenizer_t   tokenizer;
+    unsigned int            sum = 0;
+    int                     count, ret, i, split = len / 2;
+
+    LITE_json_tokenizer_init(&tokenizer);
+    count = LITE_json_tokenize(&tokenizer, buf, len, whole, JSON_FUZZ_MAX_TOKENS);
+    for (i = 0; i < count; i++) {
+        if (whole[i].start < 0 || whole[i].start > whole[i].end || whole[i].end > len || whole[i].parent >= i) {
+            abort();
+        }
+    }
+
+    /* a bare number is complete whenever the data ends, so it may be cut */
+    if (count >= 0 && whole[0].type != LITE_JSON_NUMBER) {
+        LITE_json_tokenizer_init(&tokenizer);
+        ret = LITE_json_tokenize(&tokenizer, buf, split, parts, JSON_FUZZ_MAX_TOKENS);
+        if (ret == LITE_JSON_ERROR_PART) {
+            ret = LITE_json_tokenize(&tokenizer, buf, len, parts, JSON_FUZZ_MAX_TOKENS);
+        }
+        if (ret != count || 0 != memcmp(whole, parts, count * sizeof(lite_json_token_t))) {
+            abort();
+        }
+    }
+
+    json_parse_name_value(buf, len, json_fuzz_sum, &sum);
+
+    return (int)(sum & 0);
+}
+
+#if defined(JSON_FUZZ_LIBFUZZER)
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+    char   *buf;
+
+    if (size > JSON_FUZZ_MAX_LEN) {
+        return 0;
+    }
+    /* an exact copy, not NUL terminated, so ASan sees any over-read */
+    buf = malloc(size + 1);
+    memcpy(buf, data, size);
+    json_fuzz_check(buf, (int)size);
+    free(buf);
+    return 0;
+}
+
+#else
+
+#ifndef __AFL_LOOP
+#define __AFL_LOOP(n)   (0 == afl_loop_once++)
+static int afl_loop_once = 0;
+#endif
+
+static void dump_document(const char *name)
+{
+    FILE                   *fp = NULL;
+    static char             buf[JSON_FUZZ_MAX_LEN];
+    lite_json_tokenizer_t   tokenizer;
+    int                     len = 0, count = 0, i = 0;
+
+    fp = fopen(name, "rb");
+    if (NULL == fp) {
+        abort();
+    }
+    len = (int)fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+
+    printf("Input: %s\n", name);
+    LITE_json_tokenizer_init(&tokenizer);
+    count = LITE_json_tokenize(&tokenizer, buf, len, whole, JSON_FUZZ_MAX_TOKENS);
+    printf("Result: %d\n", count);
+    for (i = 0; i < count; i++) {
+        printf("  T: %d, parent %d, size %d: %.*s\n", whole[i].type, whole[i].parent, whole[i].size,
+               whole[i].end - whole[i].start > 32 ? 32 : whole[i].end - whole[i].start, buf + whole[i].start);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    static char     buf[JSON_FUZZ_MAX_LEN];
+    ssize_t         len = 0;
+    int             i = 0;
+
+    /* ./test in/*.json prints the tokens of each document */
+    if (argc > 1) {
+        for (i = 1; i < argc; i++) {
+            dump_document(argv[i]);
+        }
+        return 0;
+    }
+
+    while (__AFL_LOOP(1000)) {
+        memset(buf, 0, sizeof(buf));
+        len = read(0, buf, sizeof(buf));
+        if (len < 0) {
+            len = 0;
+        }
+        json_fuzz_check(buf, (int)len);
+    }
+    return 0;
+}
+
+#endif
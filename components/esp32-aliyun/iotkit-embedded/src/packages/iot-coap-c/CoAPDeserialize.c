@@ -19,8 +19,12 @@
 
 #include <stdio.h>
 #include "CoAPExport.h"
+#include "CoAPDeserialize.h"
 
-int CoAPDeserialize_Header(CoAPMessage *msg, unsigned char *buf)
+/* RFC 7252, 3: token lengths 9-15 are reserved */
+#define COAP_MSG_TOKEN_LEN_LIMIT    8
+
+static int CoAPDeserialize_Header(CoAPMessage *msg, unsigned char *buf)
 {
     msg->header.version   = ((buf[0] >> 6) & 0x03);
     msg->header.type      = ((buf[0] >> 4) & 0x03);
@@ -32,92 +36,119 @@ int CoAPDeserialize_Header(CoAPMessage *msg, unsigned char *buf)
     return 4;
 }
 
-int CoAPDeserialize_Token(CoAPMessage *msg, unsigned char * buf)
+static int CoAPDeserialize_Token(CoAPMessage *msg, unsigned char *buf, int buflen)
 {
+    if (COAP_MSG_TOKEN_LEN_LIMIT < msg->header.tokenlen || buflen < msg->header.tokenlen) {
+        return -1;
+    }
     memcpy(msg->token, buf, msg->header.tokenlen);
     return msg->header.tokenlen;
 }
 
-static int CoAPDeserialize_Option(CoAPMsgOption *option, unsigned char *buf, unsigned short *predeltas)
+/*
+ * Decode the extended delta/length field selected by a 4-bit nibble.
+ * Returns the number of extension bytes consumed, or -1 when the nibble
+ * is the reserved value 15 or the extension runs past @end.
+ */
+static int CoAPDeserialize_OptionExt(unsigned int nibble, unsigned char *ptr,
+                                     unsigned char *end, unsigned int *value)
 {
-    unsigned char  *ptr      = buf;
-    unsigned short optdelta  = 0;
-    unsigned short optlen    = 0;
-    unsigned short predelta  = 0;
+    if (13 == nibble) {
+        if (end - ptr < 1) {
+            return -1;
+        }
+        *value = 13 + ptr[0];
+        return 1;
+    } else if (14 == nibble) {
+        if (end - ptr < 2) {
+            return -1;
+        }
+        *value = 269 + ((ptr[0] << 8) | ptr[1]);
+        return 2;
+    } else if (15 == nibble) {
+        return -1;
+    }
 
-    optdelta  = (*ptr & 0xF0) >> 4;
-    optlen    = (*ptr & 0x0F);
-    ptr++;
+    *value = nibble;
+    return 0;
+}
 
-    predelta = *predeltas;
-    if (13 == optdelta){
-        predelta += 13 + *ptr;
-        ptr ++;
+static int CoAPDeserialize_Option(CoAPMsgOption *option, unsigned char *buf,
+                                  unsigned char *end, unsigned short *predeltas)
+{
+    unsigned char  *ptr      = buf;
+    unsigned int    optdelta = 0;
+    unsigned int    optlen   = 0;
+    int             count    = 0;
 
+    count = CoAPDeserialize_OptionExt((*buf & 0xF0) >> 4, ptr + 1, end, &optdelta);
+    if (count < 0) {
+        return -1;
     }
-    else if (14 == optdelta){
-        predelta += 269;
-        predelta += (*ptr << 8);
-        predelta +=  *(ptr+1);
-        ptr += 2;
-    }
-    else{
-        predelta += optdelta;
-    }
-    option->num = predelta;
+    ptr += 1 + count;
 
-    if (13 == optlen){
-        optlen = 13 + *ptr;
-        ptr ++;
+    count = CoAPDeserialize_OptionExt(*buf & 0x0F, ptr, end, &optlen);
+    if (count < 0) {
+        return -1;
     }
-    else if (14 == optlen)
-    {
-        optlen = 269;
-        optlen += (*ptr << 8);
-        optlen += *(ptr+1);
-        ptr += 2;
+    ptr += count;
+
+    optdelta += *predeltas;
+    if (0xFFFF < optdelta || (unsigned int)(end - ptr) < optlen) {
+        return -1;
     }
-    option->len = optlen;
 
+    option->num = (unsigned short)optdelta;
+    option->len = (unsigned short)optlen;
     option->val = ptr;
-    *predeltas = option->num;
+    *predeltas  = option->num;
 
-    return (ptr-buf+option->len);
+    return (int)(ptr - buf + optlen);
 }
 
-int CoAPDeserialize_Options(CoAPMessage *msg, unsigned char *buf, int buflen)
+/*
+ * Validate every option once and remember where they live; the option
+ * values are handed out later by CoAPOption_iter_next() without copying.
+ */
+static int CoAPDeserialize_Options(CoAPMessage *msg, unsigned char *buf, int buflen)
 {
-    int  index = 0;
-    int  count = 0;
-    unsigned char  *ptr      = buf;
-    unsigned short len       = 0;
-    unsigned short optdeltas = 0;
-
-    msg->optnum = 0;
-    while ((count < buflen) && (0xFF != *ptr))
-    {
-        len = CoAPDeserialize_Option(&msg->options[index], ptr, &optdeltas);
-        msg->optnum += 1;
+    unsigned char  *ptr       = buf;
+    unsigned char  *end       = buf + buflen;
+    unsigned short  optdeltas = 0;
+    unsigned int    count     = 0;
+    int             len       = 0;
+    CoAPMsgOption   option;
+
+    while ((ptr < end) && (0xFF != *ptr)) {
+        len = CoAPDeserialize_Option(&option, ptr, end, &optdeltas);
+        if (len < 0) {
+            return -1;
+        }
         ptr += len;
-        index ++;
-        count += len;
+        count ++;
     }
 
+    msg->optbuf    = buf;
+    msg->optbuflen = (unsigned short)(ptr - buf);
+    msg->optnum    = (0xFF < count) ? 0xFF : (unsigned char)count;
+
     return (int)(ptr - buf);
 }
 
-int CoAPDeserialize_Payload(CoAPMessage *msg, unsigned char *buf, int buflen)
+static int CoAPDeserialize_Payload(CoAPMessage *msg, unsigned char *buf, int buflen)
 {
-    unsigned char *ptr = buf;
-
-    if(0xFF == *ptr){
-        ptr ++;
-    }
-    else{
+    if (0 == buflen) {
+        msg->payload    = NULL;
+        msg->payloadlen = 0;
         return 0;
     }
-    msg->payloadlen = buflen;
-    msg->payload = (unsigned char *)ptr;
+
+    /* RFC 7252, 3: a payload marker followed by a zero-length payload is a format error */
+    if (0xFF != *buf || 1 == buflen) {
+        return -1;
+    }
+    msg->payload    = buf + 1;
+    msg->payloadlen = (unsigned short)(buflen - 1);
 
     return buflen;
 }
@@ -128,11 +159,11 @@ int CoAPDeserialize_Message(CoAPMessage *msg, unsigned char *buf, int buflen)
     int remlen = buflen;
     unsigned char *ptr = buf;
 
-    if(NULL == buf || NULL == msg){
+    if (NULL == buf || NULL == msg) {
         return COAP_ERROR_INVALID_PARAM;
     }
 
-    if (buflen < 4){
+    if (buflen < 4 || COAP_MSG_MAX_PDU_LEN < buflen) {
         return COAP_ERROR_INVALID_LENGTH;
     }
 
@@ -141,16 +172,90 @@ int CoAPDeserialize_Message(CoAPMessage *msg, unsigned char *buf, int buflen)
     ptr += count;
     remlen -= count;
 
+    if (1 != msg->header.version) {
+        return COAP_ERROR_INVALID_MESSAGE;
+    }
+
+    /* An empty message is only the 4-byte header. */
+    if (COAP_MSG_CODE_EMPTY_MESSAGE == msg->header.code
+        && (0 != msg->header.tokenlen || 0 != remlen)) {
+        return COAP_ERROR_INVALID_MESSAGE;
+    }
+
     /* Deserialize the token, if any. */
-    count = CoAPDeserialize_Token(msg, ptr);
+    count = CoAPDeserialize_Token(msg, ptr, remlen);
+    if (count < 0) {
+        return COAP_ERROR_INVALID_MESSAGE;
+    }
     ptr += count;
     remlen -= count;
 
     count = CoAPDeserialize_Options(msg, ptr, remlen);
+    if (count < 0) {
+        return COAP_ERROR_INVALID_MESSAGE;
+    }
     ptr += count;
     remlen -= count;
 
-    CoAPDeserialize_Payload(msg, ptr, remlen);
+    if (CoAPDeserialize_Payload(msg, ptr, remlen) < 0) {
+        return COAP_ERROR_INVALID_MESSAGE;
+    }
 
     return COAP_SUCCESS;
 }
+
+void CoAPOption_iter_init(CoAPMessage *msg, CoAPOptionIter *iter)
+{
+    iter->ptr = msg->optbuf;
+    iter->end = msg->optbuf + msg->optbuflen;
+    iter->num = 0;
+}
+
+int CoAPOption_iter_next(CoAPOptionIter *iter, CoAPMsgOption *option)
+{
+    int len = 0;
+
+    if (NULL == iter->ptr || iter->ptr >= iter->end) {
+        return 0;
+    }
+
+    len = CoAPDeserialize_Option(option, iter->ptr, iter->end, &iter->num);
+    if (len < 0) {
+        iter->ptr = iter->end;
+        return 0;
+    }
+    iter->ptr += len;
+
+    return 1;
+}
+
+int CoAPOption_find(CoAPMessage *msg, unsigned short num, CoAPMsgOption *option)
+{
+    CoAPOptionIter iter;
+
+    CoAPOption_iter_init(msg, &iter);
+    while (CoAPOption_iter_next(&iter, option)) {
+        if (num == option->num) {
+            return COAP_SUCCESS;
+        }
+        /* options are sorted by number */
+        if (num < option->num) {
+            break;
+        }
+    }
+
+    return COAP_ERROR_NOT_FOUND;
+}
+
+unsigned int CoAPOption_getUint(CoAPMsgOption *option)
+{
+    unsigned int value = 0;
+    int i = 0;
+
+    /* uint options are big-endian with leading zero bytes dropped, at most 4 bytes */
+    for (i = 0; i < option->len && i < 4; i++) {
+        value = (value << 8) | option->val[i];
+    }
+
+    return value;
+}
@@ -25,4 +25,12 @@
 
 int CoAPDeserialize_Message(CoAPMessage *msg, unsigned char *buf, int buflen);
 
+void CoAPOption_iter_init(CoAPMessage *msg, CoAPOptionIter *iter);
+
+int CoAPOption_iter_next(CoAPOptionIter *iter, CoAPMsgOption *option);
+
+int CoAPOption_find(CoAPMessage *msg, unsigned short num, CoAPMsgOption *option);
+
+unsigned int CoAPOption_getUint(CoAPMsgOption *option);
+
 #endif
@@ -25,6 +25,7 @@
 
 #include "CoAPNetwork.h"
 #include "CoAPExport.h"
+#include "CoAPObserve.h"
 
 #define COAP_DEFAULT_PORT        5683 /* CoAP default UDP port */
 #define COAPS_DEFAULT_PORT       5684 /* CoAP default UDP port for secure transmission */
@@ -119,6 +120,46 @@ unsigned int CoAPUri_parse(char *p_uri, coap_endpoint_type *p_endpoint_type,
     return COAP_SUCCESS;
 }
 
+static void CoAPContext_freeBuffers(CoAPContext *p_ctx)
+{
+    if (NULL != p_ctx->recvpool) {
+        coap_free(p_ctx->recvpool);
+        p_ctx->recvpool = NULL;
+    }
+    if (NULL != p_ctx->recvbuf) {
+        coap_free(p_ctx->recvbuf);
+        p_ctx->recvbuf = NULL;
+    }
+    if (NULL != p_ctx->sendbuf) {
+        coap_free(p_ctx->sendbuf);
+        p_ctx->sendbuf = NULL;
+    }
+}
+
+static int CoAPContext_allocBuffers(CoAPContext *p_ctx, unsigned char recvbatch)
+{
+    int i = 0;
+
+    p_ctx->recvbatch = (0 == recvbatch) ? COAP_MSG_RECV_BATCH : recvbatch;
+    p_ctx->recvnum   = 0;
+    p_ctx->recvpos   = 0;
+
+    p_ctx->sendbuf  = coap_malloc(COAP_MSG_MAX_PDU_LEN);
+    p_ctx->recvbuf  = coap_malloc(p_ctx->recvbatch * (COAP_MSG_MAX_PDU_LEN + 1));
+    p_ctx->recvpool = coap_malloc(p_ctx->recvbatch * sizeof(udp_datagram_t));
+    if (NULL == p_ctx->sendbuf || NULL == p_ctx->recvbuf || NULL == p_ctx->recvpool) {
+        return COAP_ERROR_NULL;
+    }
+
+    /* the extra byte of each slot holds the NUL after the datagram */
+    for (i = 0; i < p_ctx->recvbatch; i++) {
+        p_ctx->recvpool[i].p_data  = p_ctx->recvbuf + i * (COAP_MSG_MAX_PDU_LEN + 1);
+        p_ctx->recvpool[i].datalen = COAP_MSG_MAX_PDU_LEN;
+        p_ctx->recvpool[i].len     = 0;
+    }
+
+    return COAP_SUCCESS;
+}
 
 CoAPContext *CoAPContext_create(CoAPInitParam *param)
 {
@@ -134,10 +175,15 @@ CoAPContext *CoAPContext_create(CoAPInitParam *param)
         return NULL;
     }
 
+    memset(p_ctx, 0x00, sizeof(CoAPContext));
     p_ctx->message_id = 1;
     p_ctx->notifier = param->notifier;
-    p_ctx->sendbuf = coap_malloc(COAP_MSG_MAX_PDU_LEN);
-    p_ctx->recvbuf = coap_malloc(COAP_MSG_MAX_PDU_LEN);
+    if (COAP_SUCCESS != CoAPContext_allocBuffers(p_ctx, param->recvbatch)) {
+        COAP_ERR("Allocate coap context buffers failed");
+        CoAPContext_freeBuffers(p_ctx);
+        coap_free(p_ctx);
+        return NULL;
+    }
 
     if(0 == param->waittime){
         p_ctx->waittime = COAP_DEFAULT_WAIT_TIME_MS;
@@ -151,6 +197,9 @@ CoAPContext *CoAPContext_create(CoAPInitParam *param)
     p_ctx->list.count = 0;
     p_ctx->list.maxcount = param->maxcount;
 
+    /*CoAP observe relations*/
+    INIT_LIST_HEAD(&p_ctx->observelist);
+
     /*set the endpoint type by uri schema*/
     if (NULL != param->url) {
         ret = CoAPUri_parse(param->url, &network_param.ep_type, host, &network_param.port);
@@ -158,14 +207,7 @@ CoAPContext *CoAPContext_create(CoAPInitParam *param)
 
     if (COAP_SUCCESS != ret) {
         if (NULL != p_ctx) {
-            if (NULL != p_ctx->recvbuf) {
-                coap_free(p_ctx->recvbuf);
-                p_ctx->recvbuf = NULL;
-            }
-            if (NULL != p_ctx->sendbuf) {
-                coap_free(p_ctx->sendbuf);
-                p_ctx->sendbuf = NULL;
-            }
+            CoAPContext_freeBuffers(p_ctx);
             coap_free(p_ctx);
             p_ctx    =  NULL;
             return NULL;
@@ -189,14 +231,7 @@ CoAPContext *CoAPContext_create(CoAPInitParam *param)
     if (COAP_SUCCESS != ret) {
         if (NULL != p_ctx) {
 
-            if (NULL != p_ctx->recvbuf) {
-                coap_free(p_ctx->recvbuf);
-                p_ctx->recvbuf = NULL;
-            }
-            if (NULL != p_ctx->sendbuf) {
-                coap_free(p_ctx->sendbuf);
-                p_ctx->sendbuf = NULL;
-            }
+            CoAPContext_freeBuffers(p_ctx);
             coap_free(p_ctx);
             p_ctx    =  NULL;
         }
@@ -215,6 +250,7 @@ void CoAPContext_free(CoAPContext *p_ctx)
     CoAPSendNode *cur, *next;
 
     CoAPNetwork_deinit(&p_ctx->network);
+    CoAPObserve_free(p_ctx);
 
     list_for_each_entry_safe(cur, next, &p_ctx->list.sendlist, sendlist) {
         if (NULL != cur) {
@@ -227,15 +263,7 @@ void CoAPContext_free(CoAPContext *p_ctx)
         }
     }
 
-    if (NULL != p_ctx->recvbuf) {
-        coap_free(p_ctx->recvbuf);
-        p_ctx->recvbuf = NULL;
-    }
-
-    if (NULL != p_ctx->sendbuf) {
-        coap_free(p_ctx->sendbuf);
-        p_ctx->sendbuf = NULL;
-    }
+    CoAPContext_freeBuffers(p_ctx);
 
 
     if (NULL != p_ctx) {
@@ -30,6 +30,15 @@
 #define COAP_MSG_MAX_PATH_LEN     32
 #define COAP_MSG_MAX_PDU_LEN      1280
 
+/* Datagrams taken per receive wakeup, each costs a COAP_MSG_MAX_PDU_LEN buffer */
+#ifndef COAP_MSG_RECV_BATCH
+#ifdef _PLATFORM_IS_LINUX_
+#define COAP_MSG_RECV_BATCH       8
+#else
+#define COAP_MSG_RECV_BATCH       1
+#endif
+#endif
+
 /*CoAP Content Type*/
 #define COAP_CT_TEXT_PLAIN                 0   /* text/plain (UTF-8) */
 #define COAP_CT_APP_LINK_FORMAT           40   /* application/link-format */
@@ -45,6 +54,7 @@
 #define COAP_OPTION_URI_HOST        3   /* C, String,  1-255 B, destination address */
 #define COAP_OPTION_ETAG            4   /* E, opaque,  1-8 B, (none) */
 #define COAP_OPTION_IF_NONE_MATCH   5   /* empty,      0 B, (none) */
+#define COAP_OPTION_OBSERVE         6   /* E, uint,    0-3 B, (none), RFC 7641 */
 #define COAP_OPTION_URI_PORT        7   /* C, uint,    0-2 B, destination port */
 #define COAP_OPTION_LOCATION_PATH   8   /* E, String,  0-255 B, - */
 #define COAP_OPTION_URI_PATH       11   /* C, String,  0-255 B, (none) */
@@ -83,6 +93,8 @@
 #define COAP_ERROR_INTERNAL                    (COAP_ERROR_BASE | 8)  /* Internal Error */
 #define COAP_ERROR_WRITE_FAILED                (COAP_ERROR_BASE | 9)
 #define COAP_ERROR_READ_FAILED                 (COAP_ERROR_BASE | 10)
+#define COAP_ERROR_INVALID_MESSAGE             (COAP_ERROR_BASE | 11) /* Message format error */
+#define COAP_ERROR_LIST_FULL                   (COAP_ERROR_BASE | 12) /* Too many messages await a response */
 
 #define COAP_MSG_CODE_DEF(N) (((N)/100 << 5) | (N)%100)
 
@@ -174,6 +186,21 @@ typedef struct
     struct list_head         sendlist;
 }CoAPSendList;
 
+typedef struct
+{
+    void                    *user;
+    unsigned char            tokenlen;
+    unsigned char            token[8];
+    char                     registered;   /* a notification has been accepted */
+    unsigned int             seq;          /* last accepted Observe sequence number */
+    unsigned int             seq_time;     /* uptime of the last accepted notification */
+    unsigned int             expire;       /* uptime when Max-Age runs out and we re-register */
+    unsigned char           *request;      /* serialized registration request */
+    unsigned int             reqlen;
+    CoAPRespMsgHandler       handler;
+    struct list_head         observelist;
+} CoAPObserveNode;
+
 
 typedef struct
 {
@@ -184,15 +211,25 @@ typedef struct
     unsigned char   optdelta;
     unsigned char  *payload;
     unsigned short  payloadlen;
+    unsigned char  *optbuf;     /* received options, walked by CoAPOption_iter_next() */
+    unsigned short  optbuflen;
     CoAPRespMsgHandler handler;
     void           *user;
 }CoAPMessage;
 
+typedef struct
+{
+    unsigned char  *ptr;
+    unsigned char  *end;
+    unsigned short  num;
+}CoAPOptionIter;
+
 typedef struct
 {
              char       *url;
     unsigned char        maxcount;  /*list maximal count*/
     unsigned int         waittime;
+    unsigned char        recvbatch; /*datagrams per receive, 0 is COAP_MSG_RECV_BATCH*/
     CoAPEventNotifier    notifier;
 }CoAPInitParam;
 
@@ -202,8 +239,13 @@ typedef struct
     coap_network_t           network;
     CoAPEventNotifier        notifier;
     unsigned char            *sendbuf;
-    unsigned char            *recvbuf;
+    unsigned char            *recvbuf;     /* recvbatch buffers of COAP_MSG_MAX_PDU_LEN + 1 */
+    udp_datagram_t           *recvpool;
+    unsigned char            recvbatch;
+    unsigned char            recvnum;      /* datagrams in the pool */
+    unsigned char            recvpos;      /* next datagram to handle */
     CoAPSendList             list;
+    struct list_head         observelist;
     unsigned int             waittime;
 }CoAPContext;
 
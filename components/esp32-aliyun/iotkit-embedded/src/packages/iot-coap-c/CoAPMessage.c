@@ -22,6 +22,7 @@
 #include "CoAPExport.h"
 #include "CoAPSerialize.h"
 #include "CoAPDeserialize.h"
+#include "CoAPObserve.h"
 #include "iot_import.h"
 
 
@@ -86,7 +87,7 @@ int CoAPUintOption_add(CoAPMessage *message, unsigned short  optnum, unsigned in
 
     if (0 == data) {
         message->options[message->optnum].len = 0;
-    } else if (256 >= data) {
+    } else if (255 >= data) {
         message->options[message->optnum].len = 1;
         ptr = (unsigned char *)coap_malloc(1);
         if (NULL != ptr) {
@@ -228,7 +229,7 @@ int CoAPMessage_destory(CoAPMessage *message)
         return COAP_ERROR_NULL;
     }
 
-    for (count = 0; count < COAP_MSG_MAX_TOKEN_LEN; count++) {
+    for (count = 0; count < COAP_MSG_MAX_OPTION_NUM; count++) {
         if (NULL != message->options[count].val) {
             coap_free(message->options[count].val);
             message->options[count].val = NULL;
@@ -265,7 +266,10 @@ static int CoAPMessageList_add(CoAPContext *context, CoAPMessage *message, int l
             memcpy(node->message, context->sendbuf, len);
         }
 
-        if (&context->list.count >= &context->list.maxcount) {
+        if (context->list.count >= context->list.maxcount) {
+            if (NULL != node->message) {
+                coap_free(node->message);
+            }
             coap_free(node);
             return -1;
         } else {
@@ -287,6 +291,13 @@ int CoAPMessage_send(CoAPContext *context, CoAPMessage *message)
         return (COAP_ERROR_INVALID_PARAM);
     }
 
+    /* refuse before writing, a request whose response can't be matched is lost */
+    if ((CoAPReqMsg(message->header) || CoAPCONRespMsg(message->header))
+        && context->list.count >= context->list.maxcount) {
+        COAP_INFO("The send list is full, count %d", context->list.count);
+        return COAP_ERROR_LIST_FULL;
+    }
+
     /* TODO: get the message length */
     msglen = CoAPSerialize_MessageLength(message);
     if (COAP_MSG_MAX_PDU_LEN < msglen) {
@@ -315,6 +326,30 @@ int CoAPMessage_send(CoAPContext *context, CoAPMessage *message)
     return ret;
 }
 
+int CoAPMessage_resend(CoAPContext *context, CoAPMessage *message,
+                       unsigned char *data, unsigned int datalen)
+{
+    unsigned int ret = COAP_SUCCESS;
+
+    if (NULL == context || NULL == message || NULL == data
+        || 4 > datalen || COAP_MSG_MAX_PDU_LEN < datalen) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    /* same bytes under the message id of @message */
+    memcpy(context->sendbuf, data, datalen);
+    context->sendbuf[2] = (message->header.msgid & 0xFF00) >> 8;
+    context->sendbuf[3] = (message->header.msgid & 0x00FF);
+
+    ret = CoAPNetwork_write(&context->network, context->sendbuf, datalen);
+    if (COAP_SUCCESS == ret) {
+        CoAPMessageList_add(context, message, datalen);
+    } else {
+        COAP_ERR("CoAP transoprt write failed, return %d", ret);
+    }
+
+    return ret;
+}
 
 static int CoAPAckMessage_handle(CoAPContext *context, CoAPMessage *message)
 {
@@ -338,41 +373,91 @@ static int CoAPAckMessage_send(CoAPContext *context, unsigned short msgid)
     return CoAPMessage_send(context, &message);
 }
 
-static int CoAPRespMessage_handle(CoAPContext *context, CoAPMessage *message)
+static int CoAPRstMessage_send(CoAPContext *context, unsigned short msgid)
 {
-    CoAPSendNode *node = NULL;
+    CoAPMessage message;
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_RST);
+    CoAPMessageId_set(&message, msgid);
+    return CoAPMessage_send(context, &message);
+}
 
-    if (COAP_MESSAGE_TYPE_CON == message->header.type) {
-        CoAPAckMessage_send(context, message->header.msgid);
+static void CoAPSendNode_free(CoAPContext *context, CoAPSendNode *node)
+{
+    COAP_DEBUG("Remove the message id %d from list", node->msgid);
+    list_del_init(&node->sendlist);
+    context->list.count--;
+    if (NULL != node->message) {
+        coap_free(node->message);
+    }
+    coap_free(node);
+}
+
+void CoAPMessage_purge(CoAPContext *context, void *user)
+{
+    CoAPSendNode *node = NULL, *next = NULL;
+
+    list_for_each_entry_safe(node, next, &context->list.sendlist, sendlist) {
+        if (node->user == user) {
+            CoAPSendNode_free(context, node);
+        }
     }
+    CoAPObserve_purge(context, user);
+}
 
+static int CoAPRespMessage_handle(CoAPContext *context, CoAPMessage *message)
+{
+    CoAPSendNode   *node = NULL;
+    CoAPSendNode   *found = NULL;
+    CoAPMsgOption   option;
+    int             observed = 0;
 
     list_for_each_entry(node, &context->list.sendlist, sendlist) {
         if (0 != node->tokenlen && node->tokenlen == message->header.tokenlen
             && 0 == memcmp(node->token, message->token, message->header.tokenlen)) {
+            found = node;
+            break;
+        }
+    }
+    observed = (NULL != CoAPObserve_find(context, message->token, message->header.tokenlen));
+
+    if (NULL == found && !observed
+        && COAP_SUCCESS == CoAPOption_find(message, COAP_OPTION_OBSERVE, &option)) {
+        /* notification of a relation we no longer keep, RFC 7641 3.6 */
+        COAP_DEBUG("Reject notification of unknown relation, message id %d", message->header.msgid);
+        CoAPRstMessage_send(context, message->header.msgid);
+        return COAP_ERROR_NOT_FOUND;
+    }
 
-            COAP_DEBUG("Find the node by token");
-            message->user  = node->user;
-            if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code) {
-                /* TODO:i */
-                if (NULL != context->notifier) {
-                    context->notifier(message->header.code, message);
-                }
-            }
+    if (COAP_MESSAGE_TYPE_CON == message->header.type) {
+        CoAPAckMessage_send(context, message->header.msgid);
+    }
 
-            if (NULL != node->handler) {
-                node->handler(node->user, message);
-            }
-            COAP_DEBUG("Remove the message id %d from list", node->msgid);
-            list_del_init(&node->sendlist);
-            context->list.count--;
-            if (NULL != node->message) {
-                coap_free(node->message);
+    if (observed) {
+        /* the response to a (re-)registration is the first notification */
+        if (NULL != found) {
+            CoAPSendNode_free(context, found);
+        }
+        return CoAPObserve_handle(context, message);
+    }
+
+    node = found;
+    if (NULL != node) {
+        COAP_DEBUG("Find the node by token");
+        message->user  = node->user;
+        if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code) {
+            /* TODO:i */
+            if (NULL != context->notifier) {
+                context->notifier(message->header.code, message);
             }
-            coap_free(node);
-            node = NULL;
-            return COAP_SUCCESS;
         }
+
+        if (NULL != node->handler) {
+            node->handler(node->user, message);
+        }
+        CoAPSendNode_free(context, node);
+        node = NULL;
+        return COAP_SUCCESS;
     }
     return COAP_ERROR_NOT_FOUND;
 }
@@ -386,21 +471,19 @@ static void CoAPMessage_handle(CoAPContext *context,
     memset(&message, 0x00, sizeof(CoAPMessage));
 
     ret = CoAPDeserialize_Message(&message, buf, datalen);
+    if (COAP_SUCCESS != ret) {
+        COAP_INFO("Drop malformed CoAP message, len %d, return 0x%x", datalen, ret);
+        return;
+    }
+
     if (NULL != message.payload) {
-        COAP_DEBUG("-----payload: %s---", message.payload);
+        COAP_DEBUG("-----payload: %.*s---", message.payloadlen, message.payload);
     }
     COAP_DEBUG("-----code   : 0x%x---", message.header.code);
     COAP_DEBUG("-----type   : 0x%x---", message.header.type);
     COAP_DEBUG("-----msgid  : %d---", message.header.msgid);
     COAP_DEBUG("-----opt    : %d---", message.optnum);
 
-    if (COAP_SUCCESS != ret) {
-        if (NULL != context->notifier) {
-            /* TODO: */
-            /* context->notifier(context, event); */
-        }
-    }
-
     if (COAPAckMsg(message.header)) {
         COAP_DEBUG("Receive CoAP ACK Message,ID %d", message.header.msgid);
         CoAPAckMessage_handle(context, &message);
@@ -414,24 +497,31 @@ static void CoAPMessage_handle(CoAPContext *context,
 int CoAPMessage_recv(CoAPContext *context, unsigned int timeout, int readcount)
 {
     int len = 0;
+    int ret = 0;
     int count = readcount;
+    udp_datagram_t *gram = NULL;
 
     while (1) {
-        len = CoAPNetwork_read(&context->network, context->recvbuf,
-                               COAP_MSG_MAX_PDU_LEN, timeout);
-        if (len > 0) {
-            if(0 == readcount){
-                CoAPMessage_handle(context, context->recvbuf, len);
+        if (context->recvpos >= context->recvnum) {
+            context->recvpos = 0;
+            context->recvnum = 0;
+            ret = CoAPNetwork_readBatch(&context->network, context->recvpool,
+                                        context->recvbatch, timeout);
+            if (ret <= 0) {
+                return 0;
             }
-            else{
-                count--;
-                CoAPMessage_handle(context, context->recvbuf, len);
-                if(0 == count){
-                    return len;
-                }
+            context->recvnum = (unsigned char)ret;
+        }
+
+        /* datagrams left in the pool are handled by the next call if we stop early */
+        gram = &context->recvpool[context->recvpos++];
+        len = (int)gram->len;
+        CoAPMessage_handle(context, gram->p_data, len);
+        if (0 != readcount) {
+            count--;
+            if (0 == count) {
+                return len;
             }
-        } else {
-            return 0;
         }
     }
 }
@@ -440,6 +530,7 @@ int CoAPMessage_cycle(CoAPContext *context)
 {
     unsigned int ret = 0;
     CoAPMessage_recv(context, context->waittime, 0);
+    CoAPObserve_cycle(context);
 
     CoAPSendNode *node = NULL, *next = NULL;
     list_for_each_entry_safe(node, next, &context->list.sendlist, sendlist) {
@@ -53,6 +53,13 @@ int CoAPMessage_destory(CoAPMessage *message);
 
 int CoAPMessage_send(CoAPContext *context, CoAPMessage *message);
 
+/* Send the serialized @data again under the message id and token of @message */
+int CoAPMessage_resend(CoAPContext *context, CoAPMessage *message,
+                       unsigned char *data, unsigned int datalen);
+
+/* Forget the pending messages and observe relations whose user data is @user */
+void CoAPMessage_purge(CoAPContext *context, void *user);
+
 int CoAPMessage_recv(CoAPContext *context, unsigned int timeout, int readcount);
 
 int CoAPMessage_cycle(CoAPContext *context);
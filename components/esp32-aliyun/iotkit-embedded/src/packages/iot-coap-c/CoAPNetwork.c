@@ -29,27 +29,215 @@
 #include "iot_import_dtls.h"
 #include "CoAPNetwork.h"
 
+#define COAP_BATCH_POLL_MS      1   /* wait for DTLS records after the first of a batch */
+
 #ifdef COAP_DTLS_SUPPORT
+#define COAP_DTLS_SESSION_MAX_LEN   512
+#define COAP_DTLS_SESSION_HOST_LEN  128
+#define COAP_DTLS_SESSION_CACHE_NUM 2     /* servers a session is kept for */
+
+/* A session, offered only to the server it was negotiated with */
+typedef struct
+{
+    char                     host[COAP_DTLS_SESSION_HOST_LEN];
+    unsigned short           port;
+    unsigned int             len;
+    unsigned int             used;        /* the least recently used one is replaced */
+    unsigned char            session[COAP_DTLS_SESSION_MAX_LEN];
+} coap_dtls_cached_t;
+
+/* the sessions of the last handshakes, see CoAPNetworkDTLS_saveSession() */
+static coap_dtls_cached_t *coap_dtls_sessions[COAP_DTLS_SESSION_CACHE_NUM] = {NULL};
+static coap_dtls_cached_t *coap_dtls_session_last = NULL;
+static unsigned int        coap_dtls_session_used = 0;
+
 static void CoAPNetworkDTLS_freeSession(void *p_session);
 
-unsigned int CoAPNetworkDTLS_read(void *p_session,
-                                  unsigned char              *p_data,
-                                  unsigned int               *p_datalen,
-                                  unsigned int                timeout)
+static coap_dtls_cached_t *CoAPNetworkDTLS_findSession(const char *p_host, unsigned short port, int create)
+{
+    int i = 0;
+    coap_dtls_cached_t *p_cached = NULL;
+    coap_dtls_cached_t *p_oldest = NULL;
+
+    if (NULL == p_host || COAP_DTLS_SESSION_HOST_LEN <= strlen(p_host)) {
+        return NULL;
+    }
+
+    for (i = 0; i < COAP_DTLS_SESSION_CACHE_NUM; i++) {
+        p_cached = coap_dtls_sessions[i];
+        if (NULL == p_cached) {
+            if (!create) {
+                continue;
+            }
+            p_cached = coap_malloc(sizeof(coap_dtls_cached_t));
+            if (NULL == p_cached) {
+                return NULL;
+            }
+            memset(p_cached, 0x00, sizeof(coap_dtls_cached_t));
+            coap_dtls_sessions[i] = p_cached;
+            p_oldest = p_cached;
+            break;
+        }
+        if (port == p_cached->port && 0 == strcmp(p_host, p_cached->host)) {
+            p_cached->used = ++coap_dtls_session_used;
+            return p_cached;
+        }
+        if (NULL == p_oldest || p_cached->used < p_oldest->used) {
+            p_oldest = p_cached;
+        }
+    }
+    if (!create || NULL == p_oldest) {
+        return NULL;
+    }
+
+    memset(p_oldest, 0x00, sizeof(coap_dtls_cached_t));
+    strcpy(p_oldest->host, p_host);
+    p_oldest->port = port;
+    p_oldest->used = ++coap_dtls_session_used;
+    return p_oldest;
+}
+
+static unsigned int CoAPNetworkDTLS_cacheSession(coap_network_t *p_network)
+{
+    unsigned int len = COAP_DTLS_SESSION_MAX_LEN;
+    coap_dtls_cached_t *p_cached = NULL;
+
+    p_cached = CoAPNetworkDTLS_findSession(p_network->p_host, p_network->port, 1);
+    if (NULL == p_cached) {
+        return COAP_ERROR_NULL;
+    }
+
+    p_cached->len = 0;
+    if (DTLS_SUCCESS != HAL_DTLSSession_save((DTLSContext *)p_network->context, p_cached->session, &len)) {
+        COAP_INFO("The DTLS session can't be saved, the next handshake is a full one");
+        return COAP_ERROR_INTERNAL;
+    }
+    p_cached->len = len;
+    coap_dtls_session_last = p_cached;
+
+    return COAP_SUCCESS;
+}
+
+/* port, host length, host, then the session of HAL_DTLSSession_save() */
+unsigned int CoAPNetworkDTLS_saveSession(unsigned char *p_buf, unsigned int *p_len)
+{
+    unsigned int host_len = 0;
+    coap_dtls_cached_t *p_cached = coap_dtls_session_last;
+
+    if (NULL == p_buf || NULL == p_len) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+    if (NULL == p_cached || 0 == p_cached->len) {
+        return COAP_ERROR_NOT_FOUND;
+    }
+    host_len = strlen(p_cached->host);
+    if (*p_len < 3 + host_len + p_cached->len) {
+        return COAP_ERROR_DATA_SIZE;
+    }
+
+    p_buf[0] = (unsigned char)(p_cached->port >> 8);
+    p_buf[1] = (unsigned char)(p_cached->port & 0xFF);
+    p_buf[2] = (unsigned char)host_len;
+    memcpy(p_buf + 3, p_cached->host, host_len);
+    memcpy(p_buf + 3 + host_len, p_cached->session, p_cached->len);
+    *p_len = 3 + host_len + p_cached->len;
+    return COAP_SUCCESS;
+}
+
+unsigned int CoAPNetworkDTLS_loadSession(const unsigned char *p_buf, unsigned int len)
+{
+    char host[COAP_DTLS_SESSION_HOST_LEN];
+    unsigned int host_len = 0;
+    coap_dtls_cached_t *p_cached = NULL;
+
+    if (NULL == p_buf || 3 > len) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+    host_len = p_buf[2];
+    if (0 == host_len || COAP_DTLS_SESSION_HOST_LEN <= host_len || len <= 3 + host_len) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+    if (COAP_DTLS_SESSION_MAX_LEN < len - 3 - host_len) {
+        return COAP_ERROR_DATA_SIZE;
+    }
+
+    memcpy(host, p_buf + 3, host_len);
+    host[host_len] = '\0';
+    p_cached = CoAPNetworkDTLS_findSession(host, (unsigned short)((p_buf[0] << 8) | p_buf[1]), 1);
+    if (NULL == p_cached) {
+        return COAP_ERROR_NULL;
+    }
+    p_cached->len = len - 3 - host_len;
+    memcpy(p_cached->session, p_buf + 3 + host_len, p_cached->len);
+    coap_dtls_session_last = p_cached;
+
+    return COAP_SUCCESS;
+}
+
+static unsigned int CoAPNetworkDTLS_connect(coap_network_t *p_network)
+{
+    coap_dtls_options_t     dtls_options;
+    dtls_handshake_stats_t  stats;
+    coap_dtls_stats_t      *p_stats = &p_network->dtls_stats;
+    coap_dtls_cached_t     *p_cached = NULL;
+
+    memset(&stats, 0x00, sizeof(dtls_handshake_stats_t));
+    memset(&dtls_options, 0x00, sizeof(coap_dtls_options_t));
+    dtls_options.p_ca_cert_pem     = p_network->p_ca_cert_pem;
+    dtls_options.p_host            = p_network->p_host;
+    dtls_options.port              = p_network->port;
+    dtls_options.p_stats           = &stats;
+    p_cached = CoAPNetworkDTLS_findSession(p_network->p_host, p_network->port, 0);
+    if (NULL != p_cached && 0 != p_cached->len) {
+        dtls_options.p_session     = p_cached->session;
+        dtls_options.session_len   = p_cached->len;
+    }
+
+    p_network->context = HAL_DTLSSession_create(&dtls_options);
+    if (NULL == p_network->context && NULL != dtls_options.p_session) {
+        /* the saved session is broken, don't offer it again */
+        COAP_INFO("Resume DTLS session failed, fall back to a full handshake");
+        p_cached->len = 0;
+        dtls_options.p_session   = NULL;
+        dtls_options.session_len = 0;
+        p_network->context = HAL_DTLSSession_create(&dtls_options);
+    }
+    if (NULL == p_network->context) {
+        return COAP_ERROR_NET_INIT_FAILED;
+    }
+
+    p_stats->handshakes++;
+    p_stats->resumed     += stats.resumed;
+    p_stats->bytes_sent  += stats.bytes_sent;
+    p_stats->bytes_recv  += stats.bytes_recv;
+    p_stats->round_trips += stats.round_trips;
+    memcpy(&p_stats->last, &stats, sizeof(dtls_handshake_stats_t));
+
+    /* a new ticket or session id may have been issued */
+    CoAPNetworkDTLS_cacheSession(p_network);
+    return COAP_SUCCESS;
+}
+
+static unsigned int CoAPNetworkDTLS_read(coap_network_t *p_network,
+        unsigned char              *p_data,
+        unsigned int               *p_datalen,
+        unsigned int                timeout)
 {
     unsigned int           err_code  = DTLS_SUCCESS;
     const unsigned int     read_len  = *p_datalen;
     DTLSContext           *context   = NULL;
 
     COAP_TRC("<< secure_datagram_read, read buffer len %d, timeout %d", read_len, timeout);
-    if (NULL != p_session) {
+    if (NULL != p_network->context) {
         /* read dtls application data*/
-        context = (DTLSContext *)p_session;
+        context = (DTLSContext *)p_network->context;
         err_code = HAL_DTLSSession_read(context, p_data, p_datalen, timeout);
         if (DTLS_PEER_CLOSE_NOTIFY == err_code
             || DTLS_FATAL_ALERT_MESSAGE  == err_code) {
+            /* the next write handshakes again, resuming the cached session */
             COAP_INFO("dtls session read failed return (0x%04x)", err_code);
             CoAPNetworkDTLS_freeSession(context);
+            p_network->context = NULL;
         }
         if (DTLS_SUCCESS == err_code) {
             return COAP_SUCCESS;
@@ -58,23 +246,26 @@ unsigned int CoAPNetworkDTLS_read(void *p_session,
         }
     }
 
+    *p_datalen = 0;
     return COAP_ERROR_INVALID_PARAM;
 }
 
-unsigned int CoAPNetworkDTLS_write(void *p_session,
-                                   const unsigned char        *p_data,
-                                   unsigned int               *p_datalen)
+static unsigned int CoAPNetworkDTLS_write(coap_network_t *p_network,
+        const unsigned char        *p_data,
+        unsigned int               *p_datalen)
 {
     unsigned int err_code = DTLS_SUCCESS;
-    if (NULL != p_session) {
-        err_code =  HAL_DTLSSession_write((DTLSContext *)p_session, p_data, p_datalen);
-        if (DTLS_SUCCESS == err_code) {
-            return COAP_SUCCESS;
-        } else {
-            return COAP_ERROR_WRITE_FAILED;
-        }
+
+    if (NULL == p_network->context && COAP_SUCCESS != CoAPNetworkDTLS_connect(p_network)) {
+        return COAP_ERROR_WRITE_FAILED;
+    }
+
+    err_code =  HAL_DTLSSession_write((DTLSContext *)p_network->context, p_data, p_datalen);
+    if (DTLS_SUCCESS == err_code) {
+        return COAP_SUCCESS;
+    } else {
+        return COAP_ERROR_WRITE_FAILED;
     }
-    return COAP_ERROR_INVALID_PARAM;
 }
 
 static  void CoAPNetworkDTLS_freeSession(void *p_session)
@@ -83,22 +274,6 @@ static  void CoAPNetworkDTLS_freeSession(void *p_session)
     HAL_DTLSSession_free((DTLSContext *)p_session);
 }
 
-void *CoAPNetworkDTLS_createSession(char *p_host,
-                                    unsigned short         port,
-                                    unsigned char         *p_ca_cert_pem)
-{
-    DTLSContext *context = NULL;
-    coap_dtls_options_t dtls_options;
-
-    memset(&dtls_options, 0x00, sizeof(coap_dtls_options_t));
-    dtls_options.p_ca_cert_pem     = p_ca_cert_pem;
-    dtls_options.p_host            = p_host;
-    dtls_options.port              = port;
-
-    context = HAL_DTLSSession_create(&dtls_options);
-    return (void *)context;
-}
-
 #endif
 
 unsigned int CoAPNetwork_write(coap_network_t *p_network,
@@ -109,7 +284,7 @@ unsigned int CoAPNetwork_write(coap_network_t *p_network,
 
 #ifdef COAP_DTLS_SUPPORT
     if (COAP_ENDPOINT_DTLS == p_network->ep_type) {
-        rc = CoAPNetworkDTLS_write(p_network->context, p_data, &datalen);
+        rc = CoAPNetworkDTLS_write(p_network, p_data, &datalen);
     } else {
 #endif
         rc = HAL_UDP_write((void *)p_network->context, p_data, datalen);
@@ -135,7 +310,7 @@ int CoAPNetwork_read(coap_network_t *network, unsigned char  *data,
     if (COAP_ENDPOINT_DTLS == network->ep_type)  {
         len = datalen;
         memset(data, 0x00, datalen);
-        CoAPNetworkDTLS_read(network->context, data, &len, timeout);
+        CoAPNetworkDTLS_read(network, data, &len, timeout);
     } else {
 #endif
         memset(data, 0x00, datalen);
@@ -148,6 +323,43 @@ int CoAPNetwork_read(coap_network_t *network, unsigned char  *data,
     return len;
 }
 
+int CoAPNetwork_readBatch(coap_network_t *network, udp_datagram_t *grams,
+                          unsigned int count, unsigned int timeout)
+{
+    int ret = 0;
+    int i = 0;
+
+#ifdef COAP_DTLS_SUPPORT
+    if (COAP_ENDPOINT_DTLS == network->ep_type)  {
+        unsigned int len = 0;
+
+        /* records have to be decrypted one by one, poll for the ones after the first */
+        for (i = 0; i < (int)count; i++) {
+            len = grams[i].datalen;
+            if (COAP_SUCCESS != CoAPNetworkDTLS_read(network, grams[i].p_data, &len,
+                                                     0 == i ? timeout : COAP_BATCH_POLL_MS)
+                || 0 == len) {
+                /* a read timeout is reported as success with no data */
+                break;
+            }
+            grams[i].len = len;
+        }
+        ret = i;
+    } else {
+#endif
+        ret = HAL_UDP_readBatchTimeout((void *)network->context, grams, count, timeout);
+#ifdef COAP_DTLS_SUPPORT
+    }
+#endif
+
+    /* callers treat payloads as C strings, terminate instead of clearing the buffer */
+    for (i = 0; i < ret; i++) {
+        grams[i].p_data[grams[i].len] = '\0';
+    }
+    COAP_TRC("<< CoAP recv %d datagrams", ret);
+    return ret;
+}
+
 unsigned int CoAPNetwork_init(const coap_network_init_t *p_param, coap_network_t *p_network)
 {
     unsigned int    err_code = COAP_SUCCESS;
@@ -161,10 +373,21 @@ unsigned int CoAPNetwork_init(const coap_network_init_t *p_param, coap_network_t
 
 #ifdef COAP_DTLS_SUPPORT
     if (COAP_ENDPOINT_DTLS == p_param->ep_type) {
-        p_network->context = CoAPNetworkDTLS_createSession(p_param->p_host,
-                             p_param->port, p_param->p_ca_cert_pem);
-        if (NULL == p_network->context) {
-            return COAP_ERROR_NET_INIT_FAILED;
+        memset(&p_network->dtls_stats, 0x00, sizeof(coap_dtls_stats_t));
+        p_network->context       = NULL;
+        p_network->port          = p_param->port;
+        p_network->p_ca_cert_pem = p_param->p_ca_cert_pem;
+        p_network->p_host        = coap_malloc(strlen(p_param->p_host) + 1);
+        if (NULL == p_network->p_host) {
+            return COAP_ERROR_NULL;
+        }
+        strcpy(p_network->p_host, p_param->p_host);
+
+        err_code = CoAPNetworkDTLS_connect(p_network);
+        if (COAP_SUCCESS != err_code) {
+            coap_free(p_network->p_host);
+            p_network->p_host = NULL;
+            return err_code;
         }
     }
 #endif
@@ -185,8 +408,14 @@ unsigned int CoAPNetwork_deinit(coap_network_t *p_network)
 
 #ifdef COAP_DTLS_SUPPORT
     if (COAP_ENDPOINT_DTLS == p_network->ep_type) {
-        CoAPNetworkDTLS_freeSession(p_network->context);
-        p_network->context = NULL;
+        if (NULL != p_network->context) {
+            CoAPNetworkDTLS_freeSession(p_network->context);
+            p_network->context = NULL;
+        }
+        if (NULL != p_network->p_host) {
+            coap_free(p_network->p_host);
+            p_network->p_host = NULL;
+        }
     }
 #endif
     if (COAP_ENDPOINT_NOSEC == p_network->ep_type) {
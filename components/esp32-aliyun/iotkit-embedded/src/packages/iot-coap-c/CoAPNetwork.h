@@ -18,6 +18,7 @@
 
 
 #include <stdint.h>
+#include "iot_import_coap.h"
 #include "iot_import_dtls.h"
 
 #ifndef COAP_TRANSPORT_H__
@@ -36,11 +37,28 @@ typedef struct
 } coap_remote_session_t;
 
 
+/* Handshakes of a network, summed up */
+typedef struct
+{
+    unsigned int             handshakes;
+    unsigned int             resumed;      /* abbreviated ones */
+    unsigned int             bytes_sent;
+    unsigned int             bytes_recv;
+    unsigned int             round_trips;
+    dtls_handshake_stats_t   last;
+} coap_dtls_stats_t;
+
 typedef struct
 {
     int                      socket_id;
     coap_endpoint_type       ep_type;
     void                    *context;
+#ifdef COAP_DTLS_SUPPORT
+    char                    *p_host;       /* kept to handshake again when the session is lost */
+    unsigned short           port;
+    unsigned char           *p_ca_cert_pem;
+    coap_dtls_stats_t        dtls_stats;
+#endif
 }coap_network_t;
 
 
@@ -63,8 +81,27 @@ unsigned int CoAPNetwork_write(coap_network_t *p_network,
 int CoAPNetwork_read(coap_network_t *network, unsigned char  *data,
                       unsigned int datalen, unsigned int timeout);
 
+/*
+ * Fill up to @count datagram slots, waiting at most @timeout ms for the first one.
+ * Every datagram is NUL terminated, so slot buffers must hold datalen + 1 bytes.
+ */
+int CoAPNetwork_readBatch(coap_network_t *network, udp_datagram_t *grams,
+                          unsigned int count, unsigned int timeout);
+
 unsigned int CoAPNetwork_deinit(coap_network_t *p_network);
 
+#ifdef COAP_DTLS_SUPPORT
+/*
+ * The DTLS sessions of the last handshakes are cached per host:port, so a network
+ * created after CoAPNetwork_deinit() resumes the one of its own server. Save copies
+ * the latest one out with its host:port to be kept across a reboot, load seeds the
+ * cache with it before the first CoAPNetwork_init().
+ */
+unsigned int CoAPNetworkDTLS_saveSession(unsigned char *p_buf, unsigned int *p_len);
+
+unsigned int CoAPNetworkDTLS_loadSession(const unsigned char *p_buf, unsigned int len);
+#endif
+
 
 #endif
 
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdio.h>
+#include "iot_import.h"
+#include "CoAPExport.h"
+#include "CoAPSerialize.h"
+#include "CoAPDeserialize.h"
+#include "CoAPMessage.h"
+#include "CoAPObserve.h"
+
+#define COAP_OBSERVE_DEFAULT_MAXAGE     60          /* seconds, RFC 7252 5.10.5 */
+#define COAP_OBSERVE_REREGISTER_MARGIN  2000        /* ms after Max-Age before re-registering */
+#define COAP_OBSERVE_FRESH_TIME_MS      (128000)    /* RFC 7641 3.4 */
+#define COAP_OBSERVE_SEQ_HALF           (1 << 23)   /* half of the 24-bit sequence space */
+
+CoAPObserveNode *CoAPObserve_find(CoAPContext *context, unsigned char *token, unsigned char tokenlen)
+{
+    CoAPObserveNode *node = NULL;
+
+    if (0 == tokenlen) {
+        return NULL;
+    }
+    list_for_each_entry(node, &context->observelist, observelist) {
+        if (node->tokenlen == tokenlen && 0 == memcmp(node->token, token, tokenlen)) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+static void CoAPObserve_release(CoAPObserveNode *node)
+{
+    list_del_init(&node->observelist);
+    if (NULL != node->request) {
+        coap_free(node->request);
+    }
+    coap_free(node);
+}
+
+static unsigned int CoAPObserve_maxage(CoAPMessage *message)
+{
+    CoAPMsgOption option;
+
+    if (COAP_SUCCESS == CoAPOption_find(message, COAP_OPTION_MAXAGE, &option)) {
+        return CoAPOption_getUint(&option);
+    }
+
+    return COAP_OBSERVE_DEFAULT_MAXAGE;
+}
+
+/* RFC 7641 3.4: is @seq newer than the last notification we accepted */
+static int CoAPObserve_isFresh(CoAPObserveNode *node, unsigned int seq, unsigned int now)
+{
+    if (!node->registered) {
+        return 1;
+    }
+
+    if ((node->seq < seq && seq - node->seq < COAP_OBSERVE_SEQ_HALF)
+        || (node->seq > seq && node->seq - seq > COAP_OBSERVE_SEQ_HALF)
+        || (now - node->seq_time > COAP_OBSERVE_FRESH_TIME_MS)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int CoAPObserve_register(CoAPContext *context, CoAPMessage *message)
+{
+    int              ret = COAP_SUCCESS;
+    unsigned short   msglen = 0;
+    CoAPObserveNode *node = NULL;
+
+    if (NULL == context || NULL == message || 0 == message->header.tokenlen
+        || sizeof(node->token) < message->header.tokenlen) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    if (NULL != CoAPObserve_find(context, message->token, message->header.tokenlen)) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    msglen = CoAPSerialize_MessageLength(message);
+    node = coap_malloc(sizeof(CoAPObserveNode));
+    if (NULL == node) {
+        return COAP_ERROR_NULL;
+    }
+    memset(node, 0x00, sizeof(CoAPObserveNode));
+
+    ret = CoAPMessage_send(context, message);
+    if (COAP_SUCCESS != ret) {
+        coap_free(node);
+        return ret;
+    }
+
+    /* keep the serialized request, re-registration only needs a new message id */
+    node->request = coap_malloc(msglen);
+    if (NULL == node->request) {
+        coap_free(node);
+        return COAP_ERROR_NULL;
+    }
+    memcpy(node->request, context->sendbuf, msglen);
+    node->reqlen   = msglen;
+    node->user     = message->user;
+    node->handler  = message->handler;
+    node->tokenlen = message->header.tokenlen;
+    memcpy(node->token, message->token, message->header.tokenlen);
+    node->expire   = HAL_UptimeMs() + COAP_OBSERVE_DEFAULT_MAXAGE * 1000 + COAP_OBSERVE_REREGISTER_MARGIN;
+
+    list_add_tail(&node->observelist, &context->observelist);
+    COAP_DEBUG("Observe relation added, message id %d", message->header.msgid);
+
+    return COAP_SUCCESS;
+}
+
+int CoAPObserve_cancel(CoAPContext *context, unsigned char *token, unsigned char tokenlen)
+{
+    CoAPObserveNode *node = NULL;
+
+    if (NULL == context || NULL == token) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    node = CoAPObserve_find(context, token, tokenlen);
+    if (NULL == node) {
+        return COAP_ERROR_NOT_FOUND;
+    }
+
+    /* RFC 7641 3.6: forget the relation, the next notification is answered with RST */
+    CoAPObserve_release(node);
+    return COAP_SUCCESS;
+}
+
+int CoAPObserve_handle(CoAPContext *context, CoAPMessage *message)
+{
+    unsigned int        now = 0;
+    unsigned int        seq = 0;
+    void               *user = NULL;
+    CoAPRespMsgHandler  handler = NULL;
+    CoAPObserveNode    *node = NULL;
+    CoAPMsgOption       option;
+
+    node = CoAPObserve_find(context, message->token, message->header.tokenlen);
+    if (NULL == node) {
+        return COAP_ERROR_NOT_FOUND;
+    }
+
+    now = HAL_UptimeMs();
+    user = node->user;
+    handler = node->handler;
+    message->user = user;
+
+    if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code && NULL != context->notifier) {
+        context->notifier(message->header.code, message);
+    }
+
+    if (COAP_SUCCESS != CoAPOption_find(message, COAP_OPTION_OBSERVE, &option)) {
+        /* a response without Observe ends the relation, RFC 7641 3.2 */
+        COAP_DEBUG("Observe relation ended by server, code 0x%x", message->header.code);
+        CoAPObserve_release(node);
+        if (NULL != handler) {
+            handler(user, message);
+        }
+        return COAP_SUCCESS;
+    }
+
+    seq = CoAPOption_getUint(&option);
+    if (!CoAPObserve_isFresh(node, seq, now)) {
+        COAP_DEBUG("Drop reordered notification, seq %u last %u", seq, node->seq);
+        return COAP_SUCCESS;
+    }
+
+    node->registered = 1;
+    node->seq        = seq;
+    node->seq_time   = now;
+    node->expire     = now + CoAPObserve_maxage(message) * 1000 + COAP_OBSERVE_REREGISTER_MARGIN;
+
+    /* the handler may cancel the relation, so the node is not touched afterwards */
+    if (NULL != handler) {
+        handler(user, message);
+    }
+
+    return COAP_SUCCESS;
+}
+
+void CoAPObserve_cycle(CoAPContext *context)
+{
+    unsigned int     now = HAL_UptimeMs();
+    CoAPObserveNode *node = NULL;
+    CoAPMessage      message;
+
+    list_for_each_entry(node, &context->observelist, observelist) {
+        if ((int)(now - node->expire) < 0) {
+            continue;
+        }
+
+        /* re-register with the same token so notifications keep matching */
+        CoAPMessage_init(&message);
+        CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_CON);
+        CoAPMessageCode_set(&message, COAP_MSG_CODE_GET);
+        CoAPMessageId_set(&message, CoAPMessageId_gen(context));
+        CoAPMessageToken_set(&message, node->token, node->tokenlen);
+        message.user = node->user;
+
+        COAP_DEBUG("Max-Age expired, re-register observe with message id %d", message.header.msgid);
+        if (COAP_SUCCESS != CoAPMessage_resend(context, &message, node->request, node->reqlen)) {
+            COAP_INFO("Re-register observe failed, retry in %d ms", COAP_OBSERVE_REREGISTER_MARGIN);
+            node->expire = now + COAP_OBSERVE_REREGISTER_MARGIN;
+        } else {
+            node->expire = now + COAP_OBSERVE_DEFAULT_MAXAGE * 1000 + COAP_OBSERVE_REREGISTER_MARGIN;
+        }
+    }
+}
+
+void CoAPObserve_purge(CoAPContext *context, void *user)
+{
+    CoAPObserveNode *node = NULL, *next = NULL;
+
+    list_for_each_entry_safe(node, next, &context->observelist, observelist) {
+        if (node->user == user) {
+            CoAPObserve_release(node);
+        }
+    }
+}
+
+void CoAPObserve_free(CoAPContext *context)
+{
+    CoAPObserveNode *node = NULL, *next = NULL;
+
+    list_for_each_entry_safe(node, next, &context->observelist, observelist) {
+        CoAPObserve_release(node);
+    }
+}
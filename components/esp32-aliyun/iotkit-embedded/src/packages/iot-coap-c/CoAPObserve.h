@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "CoAPExport.h"
+
+#ifndef __COAP_OBSERVE_H__
+#define __COAP_OBSERVE_H__
+
+/* Observe option values in a GET request, RFC 7641 2 */
+#define COAP_OBSERVE_REGISTER       0
+#define COAP_OBSERVE_DEREGISTER     1
+
+/*
+ * Send @message, a GET carrying Observe=0 and a token, and keep the relation:
+ * every notification with the same token is passed to message->handler, in
+ * Observe sequence order, until the server ends it or it is cancelled.
+ */
+int CoAPObserve_register(CoAPContext *context, CoAPMessage *message);
+
+CoAPObserveNode *CoAPObserve_find(CoAPContext *context, unsigned char *token, unsigned char tokenlen);
+
+int CoAPObserve_cancel(CoAPContext *context, unsigned char *token, unsigned char tokenlen);
+
+/* Dispatch a response/notification, COAP_ERROR_NOT_FOUND if no relation owns its token */
+int CoAPObserve_handle(CoAPContext *context, CoAPMessage *message);
+
+/* Re-register relations whose Max-Age has run out */
+void CoAPObserve_cycle(CoAPContext *context);
+
+/* Drop the relations registered with user data @user */
+void CoAPObserve_purge(CoAPContext *context, void *user);
+
+void CoAPObserve_free(CoAPContext *context);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <time.h>
+#include "coap_fuzz_compat.h"
+
+#define BENCH_MAX_PACKETS       64
+#define BENCH_DEFAULT_ROUNDS    200000
+
+typedef struct {
+    unsigned char   data[COAP_MSG_MAX_PDU_LEN];
+    int             len;
+} bench_packet_t;
+
+static bench_packet_t   packets[BENCH_MAX_PACKETS];
+
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* usage: ./bench [-n rounds] in/*.bin */
+int main(int argc, char **argv)
+{
+    FILE           *fp = NULL;
+    int             count = 0;
+    long            rounds = BENCH_DEFAULT_ROUNDS;
+    long            bytes = 0;
+    long            r = 0;
+    unsigned int    sum = 0;
+    int             i = 1;
+    double          start, cost;
+
+    if (argc > 2 && 0 == strcmp(argv[1], "-n")) {
+        rounds = atol(argv[2]);
+        i = 3;
+    }
+    for (; i < argc && count < BENCH_MAX_PACKETS; i++) {
+        fp = fopen(argv[i], "rb");
+        if (NULL == fp) {
+            continue;
+        }
+        packets[count].len = (int)fread(packets[count].data, 1, COAP_MSG_MAX_PDU_LEN, fp);
+        bytes += packets[count].len;
+        fclose(fp);
+        count++;
+    }
+    if (0 == count) {
+        fprintf(stderr, "no packets in corpus\n");
+        return 1;
+    }
+
+    start = bench_now();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < count; i++) {
+            coap_fuzz_parse(packets[i].data, packets[i].len, &sum);
+        }
+    }
+    cost = bench_now() - start;
+
+    printf("packets: %d, bytes: %ld, rounds: %ld, checksum: %u\n", count, bytes, rounds, sum);
+    printf("parse: %.1f ns/packet, %.1f Mpackets/s, %.1f MB/s\n",
+           cost * 1e9 / ((double)rounds * count),
+           (double)rounds * count / cost / 1e6,
+           (double)rounds * bytes / cost / 1e6);
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef __COAP_FUZZ_COMPAT_H__
+#define __COAP_FUZZ_COMPAT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CoAPExport.h"
+#include "CoAPDeserialize.h"
+
+/* Parse @buf and walk every option and payload byte, returns the deserializer result */
+static int coap_fuzz_parse(unsigned char *buf, int len, unsigned int *sum)
+{
+    CoAPMessage     message;
+    CoAPOptionIter  iter;
+    CoAPMsgOption   option;
+    int             ret = 0;
+    int             i = 0;
+
+    memset(&message, 0x00, sizeof(CoAPMessage));
+    ret = CoAPDeserialize_Message(&message, buf, len);
+    if (COAP_SUCCESS != ret) {
+        return ret;
+    }
+
+    CoAPOption_iter_init(&message, &iter);
+    while (CoAPOption_iter_next(&iter, &option)) {
+        *sum += option.num;
+        for (i = 0; i < option.len; i++) {
+            *sum += option.val[i];
+        }
+    }
+    for (i = 0; i < message.payloadlen; i++) {
+        *sum += message.payload[i];
+    }
+
+    return ret;
+}
+
+#endif  /* __COAP_FUZZ_COMPAT_H__ */
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "coap_fuzz_compat.h"
+
+#if defined(COAP_FUZZ_LIBFUZZER)
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+    unsigned int    sum = 0;
+
+    if (size > COAP_MSG_MAX_PDU_LEN) {
+        return 0;
+    }
+    /* parse in place, libFuzzer sizes @data exactly so ASan sees any over-read */
+    coap_fuzz_parse((unsigned char *)data, (int)size, &sum);
+    return 0;
+}
+
+#else
+
+#ifndef __AFL_LOOP
+#define __AFL_LOOP(n)   (0 == afl_loop_once++)
+static int afl_loop_once = 0;
+#endif
+
+static void dump_packet(const char *name)
+{
+    FILE           *fp = NULL;
+    unsigned char   buf[COAP_MSG_MAX_PDU_LEN];
+    CoAPMessage     message;
+    CoAPOptionIter  iter;
+    CoAPMsgOption   option;
+    int             len = 0;
+    int             ret = 0;
+
+    fp = fopen(name, "rb");
+    if (NULL == fp) {
+        abort();
+    }
+    len = (int)fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+
+    printf("Input: %s\n", name);
+    printf("Packet Length: %d\n", len);
+
+    memset(&message, 0x00, sizeof(CoAPMessage));
+    ret = CoAPDeserialize_Message(&message, buf, len);
+    if (COAP_SUCCESS != ret) {
+        printf("Result: 0x%x\n\n", ret);
+        return;
+    }
+    printf("Type: %d, Code: %d.%02d, MsgId: %d, Token: %d bytes\n",
+           message.header.type, message.header.code >> 5, message.header.code & 0x1F,
+           message.header.msgid, message.header.tokenlen);
+    printf("Options: %d\n", message.optnum);
+    CoAPOption_iter_init(&message, &iter);
+    while (CoAPOption_iter_next(&iter, &option)) {
+        printf("  O: %d, %d bytes\n", option.num, option.len);
+    }
+    printf("Payload: %d bytes\n\n", message.payloadlen);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char   buf[COAP_MSG_MAX_PDU_LEN];
+    unsigned int    sum = 0;
+    ssize_t         len = 0;
+    int             i = 0;
+
+    /* ./test in/*.bin prints what the parser makes of each packet */
+    if (argc > 1) {
+        for (i = 1; i < argc; i++) {
+            dump_packet(argv[i]);
+        }
+        return 0;
+    }
+
+    while (__AFL_LOOP(1000)) {
+        memset(buf, 0, sizeof(buf));
+        len = read(0, buf, sizeof(buf));
+        if (len < 0) {
+            len = 0;
+        }
+        coap_fuzz_parse(buf, (int)len, &sum);
+    }
+    return (int)(sum & 0);
+}
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Loopback test of the batched receive of CoAPMessage_recv(). A UDP socket on 127.0.0.1 plays the
+ * server, queues ACKs to a CoAP context before it reads, and the test checks how many datagrams
+ * HAL_UDP_readBatchTimeout() takes at once, that they are terminated for the handlers, and that
+ * the ones left in the pool when readcount is reached are handled by the next call before the
+ * socket is read again.
+ *
+ *   make batch
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "CoAPNetwork.h"
+
+static int failed;
+
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("line %d: %s FAILED\n", __LINE__, #cond); \
+            failed++; \
+        } \
+    } while (0)
+
+static int server_fd;
+static struct sockaddr_in client_addr;
+
+/* queue @count empty ACKs to the client, message ids from @msgid on */
+static void test_queue(int count, unsigned short msgid)
+{
+    unsigned char ack[4];
+    int i;
+
+    for (i = 0; i < count; i++, msgid++) {
+        ack[0] = 0x60;  /* version 1, ACK, no token */
+        ack[1] = 0x00;
+        ack[2] = msgid >> 8;
+        ack[3] = msgid & 0xff;
+        sendto(server_fd, ack, sizeof(ack), 0, (struct sockaddr *)&client_addr, sizeof(client_addr));
+    }
+    usleep(10000);
+}
+
+int main(int argc, char **argv)
+{
+    char url[64];
+    unsigned char hello = 0;
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    CoAPInitParam param;
+    CoAPContext *ctx;
+    udp_datagram_t *pool;
+    int i, ret;
+    unsigned int start;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (server_fd < 0 || 0 != bind(server_fd, (struct sockaddr *)&addr, sizeof(addr))
+        || 0 != getsockname(server_fd, (struct sockaddr *)&addr, &addr_len)) {
+        perror("server");
+        return 1;
+    }
+
+    sprintf(url, "coap://127.0.0.1:%d", ntohs(addr.sin_port));
+    memset(&param, 0, sizeof(param));
+    param.url = url;
+    param.maxcount = 16;
+    param.waittime = 100;
+    param.recvbatch = 8;
+    ctx = CoAPContext_create(&param);
+    if (NULL == ctx) {
+        printf("create context FAILED\n");
+        return 1;
+    }
+
+    /* the server learns the address of the client from a first datagram */
+    CoAPNetwork_write(&ctx->network, &hello, 1);
+    addr_len = sizeof(client_addr);
+    if (recvfrom(server_fd, &hello, 1, 0, (struct sockaddr *)&client_addr, &addr_len) != 1) {
+        printf("hello FAILED\n");
+        return 1;
+    }
+
+    /* one read takes all the datagrams queued, each terminated after its length */
+    pool = ctx->recvpool;
+    for (i = 0; i < ctx->recvbatch; i++) {
+        memset(pool[i].p_data, 0xff, COAP_MSG_MAX_PDU_LEN + 1);
+    }
+    test_queue(5, 1);
+    ret = CoAPNetwork_readBatch(&ctx->network, pool, ctx->recvbatch, 100);
+    TEST_CHECK(5 == ret);
+    for (i = 0; i < 5; i++) {
+        TEST_CHECK(4 == pool[i].len && 0x60 == pool[i].p_data[0] && i + 1 == pool[i].p_data[3]);
+        TEST_CHECK('\0' == pool[i].p_data[4]);
+    }
+
+    /* more than the pool holds: the rest comes with the next read */
+    test_queue(12, 10);
+    TEST_CHECK(8 == CoAPNetwork_readBatch(&ctx->network, pool, ctx->recvbatch, 100));
+    TEST_CHECK(4 == CoAPNetwork_readBatch(&ctx->network, pool, ctx->recvbatch, 100));
+
+    /* an empty socket times out with nothing, the HAL tells a timeout by a negative value */
+    start = HAL_UptimeMs();
+    TEST_CHECK(CoAPNetwork_readBatch(&ctx->network, pool, ctx->recvbatch, 50) <= 0);
+    TEST_CHECK(HAL_UptimeMs() - start >= 40);
+
+    /* readcount reached: the datagrams left stay in the pool */
+    test_queue(5, 30);
+    TEST_CHECK(4 == CoAPMessage_recv(ctx, 100, 2));
+    TEST_CHECK(5 == ctx->recvnum && 2 == ctx->recvpos);
+
+    /* the next call handles them before reading the socket, where a new one waits */
+    test_queue(1, 40);
+    TEST_CHECK(4 == CoAPMessage_recv(ctx, 100, 3));
+    TEST_CHECK(5 == ctx->recvnum && 5 == ctx->recvpos);
+    TEST_CHECK(4 == CoAPMessage_recv(ctx, 100, 1));
+    TEST_CHECK(1 == ctx->recvnum && 1 == ctx->recvpos && 40 == ctx->recvpool[0].p_data[3]);
+
+    /* readcount 0 drains the socket, in as many reads as it takes */
+    test_queue(20, 50);
+    TEST_CHECK(0 == CoAPMessage_recv(ctx, 50, 0));
+    TEST_CHECK(0 == ctx->recvnum && 0 == ctx->recvpos);
+    TEST_CHECK(CoAPNetwork_readBatch(&ctx->network, pool, ctx->recvbatch, 10) <= 0);
+
+    CoAPContext_free(ctx);
+    close(server_fd);
+
+    printf("test_batch: %s\n", failed ? "FAILED" : "ok");
+    return failed;
+}
@@ -22,14 +22,22 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <memory.h>
+#include <errno.h>
 
 #include <pthread.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/prctl.h>
 #include <sys/time.h>
 
 #include "iot_import.h"
 
+/* every key of HAL_Kv_Set() is a file of this directory */
+#ifndef HAL_KV_DIR
+    #define HAL_KV_DIR      "."
+#endif
+#define HAL_KV_PATH_LEN     (128)
+
 void *HAL_MutexCreate(void)
 {
     int err_num;
@@ -73,6 +81,85 @@ void HAL_MutexUnlock(_IN_ void *mutex)
     }
 }
 
+/* a count under a mutex, sem_timedwait() is not in the POSIX level the SDK is built for */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    uint32_t        count;
+} hal_semaphore_t;
+
+void *HAL_SemaphoreCreate(void)
+{
+    hal_semaphore_t *sem = (hal_semaphore_t *)HAL_Malloc(sizeof(hal_semaphore_t));
+    if (NULL == sem) {
+        return NULL;
+    }
+
+    sem->count = 0;
+    if (0 != pthread_mutex_init(&sem->mutex, NULL)) {
+        perror("create semaphore failed");
+        HAL_Free(sem);
+        return NULL;
+    }
+    if (0 != pthread_cond_init(&sem->cond, NULL)) {
+        perror("create semaphore failed");
+        pthread_mutex_destroy(&sem->mutex);
+        HAL_Free(sem);
+        return NULL;
+    }
+
+    return sem;
+}
+
+void HAL_SemaphoreDestroy(_IN_ void *sem)
+{
+    hal_semaphore_t *p_sem = (hal_semaphore_t *)sem;
+
+    pthread_cond_destroy(&p_sem->cond);
+    pthread_mutex_destroy(&p_sem->mutex);
+    HAL_Free(p_sem);
+}
+
+void HAL_SemaphorePost(_IN_ void *sem)
+{
+    hal_semaphore_t *p_sem = (hal_semaphore_t *)sem;
+
+    pthread_mutex_lock(&p_sem->mutex);
+    p_sem->count++;
+    pthread_cond_signal(&p_sem->cond);
+    pthread_mutex_unlock(&p_sem->mutex);
+}
+
+int HAL_SemaphoreWait(_IN_ void *sem, _IN_ uint32_t timeout_ms)
+{
+    int ret = 0;
+    struct timeval now;
+    struct timespec deadline;
+    hal_semaphore_t *p_sem = (hal_semaphore_t *)sem;
+
+    gettimeofday(&now, NULL);
+    deadline.tv_sec = now.tv_sec + timeout_ms / 1000;
+    deadline.tv_nsec = now.tv_usec * 1000 + (timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&p_sem->mutex);
+    while (0 == p_sem->count && 0 == ret) {
+        ret = pthread_cond_timedwait(&p_sem->cond, &p_sem->mutex, &deadline);
+    }
+    if (p_sem->count > 0) {
+        p_sem->count--;
+        ret = 0;
+    } else {
+        ret = -1;
+    }
+    pthread_mutex_unlock(&p_sem->mutex);
+
+    return ret;
+}
+
 void *HAL_Malloc(_IN_ uint32_t size)
 {
     return malloc(size);
@@ -127,3 +214,84 @@ char *HAL_GetPartnerID(char pid_str[])
 {
     return NULL;
 }
+
+static void _linux_kv_path(char *path, const char *key, const char *suffix)
+{
+    snprintf(path, HAL_KV_PATH_LEN, "%s/.iotx_kv_%s%s", HAL_KV_DIR, key, suffix);
+}
+
+/* written aside then renamed over the previous value, so a crash leaves one or the other */
+int HAL_Kv_Set(_IN_ const char *key, _IN_ const void *val, _IN_ int len, _IN_ int sync)
+{
+    int fd;
+    char path[HAL_KV_PATH_LEN], path_new[HAL_KV_PATH_LEN];
+
+    _linux_kv_path(path, key, "");
+    _linux_kv_path(path_new, key, ".new");
+
+    fd = open(path_new, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("open kv failed");
+        return -1;
+    }
+
+    if (len != write(fd, val, len) || (sync && 0 != fsync(fd))) {
+        perror("write kv failed");
+        close(fd);
+        unlink(path_new);
+        return -1;
+    }
+    close(fd);
+
+    if (0 != rename(path_new, path)) {
+        perror("rename kv failed");
+        unlink(path_new);
+        return -1;
+    }
+
+    return 0;
+}
+
+int HAL_Kv_Get(_IN_ const char *key, _OU_ void *val, int *buffer_len)
+{
+    int fd, len;
+    char path[HAL_KV_PATH_LEN];
+
+    _linux_kv_path(path, key, "");
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* one byte more to tell a value of exactly @buffer_len from a longer one */
+    len = read(fd, val, *buffer_len);
+    if (len == *buffer_len) {
+        char extra;
+        if (0 != read(fd, &extra, 1)) {
+            len = -1;
+        }
+    }
+    close(fd);
+
+    if (len < 0) {
+        return -1;
+    }
+
+    *buffer_len = len;
+    return 0;
+}
+
+int HAL_Kv_Del(_IN_ const char *key)
+{
+    char path[HAL_KV_PATH_LEN];
+
+    _linux_kv_path(path, key, "");
+
+    if (0 != unlink(path) && ENOENT != errno) {
+        perror("remove kv failed");
+        return -1;
+    }
+
+    return 0;
+}
@@ -18,6 +18,8 @@
 
 
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,6 +33,8 @@
 #include <pthread.h>
 #include "iot_import_coap.h"
 
+#define HAL_UDP_BATCH_MAX       (32)
+
 void *HAL_UDP_create(char *host, unsigned short port)
 {
     int rc = -1;
@@ -126,18 +130,11 @@ int HAL_UDP_read(void                   *p_socket,
 
 
 
-int HAL_UDP_readTimeout( void *p_socket, unsigned char  *p_data,
-                    unsigned int datalen,     unsigned int timeout)
+static int HAL_UDP_wait(long socket_id, unsigned int timeout)
 {
     int ret;
     struct timeval tv;
     fd_set read_fds;
-    long socket_id = -1;
-
-    if(NULL == p_socket || NULL == p_data){
-        return -1;
-    }
-    socket_id = (long)p_socket;
 
     if( socket_id < 0 )
       return -1;
@@ -162,10 +159,71 @@ int HAL_UDP_readTimeout( void *p_socket, unsigned char  *p_data,
         return -4; /* receive failed */
     }
 
+    return 0;
+}
+
+int HAL_UDP_readTimeout( void *p_socket, unsigned char  *p_data,
+                    unsigned int datalen,     unsigned int timeout)
+{
+    int ret;
+
+    if(NULL == p_socket || NULL == p_data){
+        return -1;
+    }
+
+    ret = HAL_UDP_wait((long)p_socket, timeout);
+    if (0 != ret) {
+        return ret;
+    }
+
     /* This call will not block */
     return HAL_UDP_read(p_socket, p_data, datalen);
 }
 
+int HAL_UDP_readBatchTimeout(void *p_socket, udp_datagram_t *p_grams,
+                    unsigned int count, unsigned int timeout)
+{
+    struct mmsghdr  msgs[HAL_UDP_BATCH_MAX];
+    struct iovec    iovs[HAL_UDP_BATCH_MAX];
+    unsigned int    i = 0;
+    int             ret;
+
+    if(NULL == p_socket || NULL == p_grams || 0 == count){
+        return -1;
+    }
+
+    ret = HAL_UDP_wait((long)p_socket, timeout);
+    if (0 != ret) {
+        return ret;
+    }
+
+    if (count > HAL_UDP_BATCH_MAX) {
+        count = HAL_UDP_BATCH_MAX;
+    }
+    memset(msgs, 0x00, count * sizeof(struct mmsghdr));
+    for (i = 0; i < count; i++) {
+        iovs[i].iov_base = p_grams[i].p_data;
+        iovs[i].iov_len  = p_grams[i].datalen;
+        msgs[i].msg_hdr.msg_iov    = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    /* one syscall for everything queued, the first datagram is already there */
+    ret = recvmmsg((long)p_socket, msgs, count, MSG_DONTWAIT, NULL);
+    if (ret < 0) {
+        if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+            return -3; /* want read */
+        }
+        return -4; /* receive failed */
+    }
+
+    for (i = 0; i < (unsigned int)ret; i++) {
+        p_grams[i].len = msgs[i].msg_len;
+    }
+
+    return ret;
+}
+
 
 int HAL_UDP_resolveAddress(const char *p_host,  char addr[NETWORK_ADDR_LEN])
 {
@@ -22,6 +22,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "iot_import.h"
 #include "iot_import_dtls.h"
 #ifdef COAP_DTLS_SUPPORT
 #include "mbedtls/ssl.h"
@@ -33,6 +34,19 @@
 #include "mbedtls/entropy.h"
 #include "mbedtls/ssl_cookie.h"
 #include "mbedtls/net_sockets.h"
+#include "mbedtls/version.h"
+
+#define DTLS_SESSION_MAGIC           0x4454  /* "DT" */
+#define DTLS_SESSION_VERSION         2
+
+/* Byte and round-trip counters wrapped around the socket while handshaking */
+typedef struct
+{
+    mbedtls_net_context         *fd;
+    char                         counting;
+    char                         sent_last;    /* a flight went out and no answer came yet */
+    dtls_handshake_stats_t       stats;
+} dtls_bio_t;
 
 typedef struct
 {
@@ -46,8 +60,22 @@ typedef struct
     mbedtls_net_context          fd;
     mbedtls_timing_delay_context timer;
     mbedtls_ssl_cookie_ctx       cookie_ctx;
+    dtls_bio_t                   bio;
+    char                         loaded;       /* a saved session was offered */
+    unsigned char                master[48];   /* its master secret */
 } dtls_session_t;
 
+/* Serialized session, see HAL_DTLSSession_save() */
+typedef struct
+{
+    unsigned short               magic;
+    unsigned char                version;
+    unsigned char                reserved;
+    unsigned int                 len;          /* bytes after this header */
+    unsigned int                 mbedtls;      /* MBEDTLS_VERSION_NUMBER of the writer */
+    unsigned int                 struct_len;   /* its sizeof(mbedtls_ssl_session) */
+} dtls_saved_session_t;
+
 
 static  void *_DTLSCalloc_wrapper(size_t n, size_t s)
 {
@@ -107,6 +135,137 @@ static void _DTLSLog_wrapper(void       * p_ctx, int level,
     DTLS_INFO("[mbedTLS]:[%s]:[%d]: %s\r\n", p_file, line, p_str);
 }
 
+static int _DTLSNet_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    dtls_bio_t *p_bio = (dtls_bio_t *)ctx;
+    int ret = mbedtls_net_send(p_bio->fd, buf, len);
+
+    if (p_bio->counting && 0 < ret) {
+        p_bio->stats.bytes_sent += ret;
+        p_bio->sent_last = 1;
+    }
+    return ret;
+}
+
+static int _DTLSNet_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    dtls_bio_t *p_bio = (dtls_bio_t *)ctx;
+    int ret = mbedtls_net_recv(p_bio->fd, buf, len);
+
+    if (p_bio->counting && 0 < ret) {
+        p_bio->stats.bytes_recv += ret;
+        if (p_bio->sent_last) {
+            p_bio->stats.round_trips++;
+            p_bio->sent_last = 0;
+        }
+    }
+    return ret;
+}
+
+static int _DTLSNet_recv_timeout(void *ctx, unsigned char *buf, size_t len, uint32_t timeout)
+{
+    dtls_bio_t *p_bio = (dtls_bio_t *)ctx;
+    int ret = mbedtls_net_recv_timeout(p_bio->fd, buf, len, timeout);
+
+    if (p_bio->counting && 0 < ret) {
+        p_bio->stats.bytes_recv += ret;
+        if (p_bio->sent_last) {
+            p_bio->stats.round_trips++;
+            p_bio->sent_last = 0;
+        }
+    }
+    return ret;
+}
+
+static unsigned int _DTLSSession_load(dtls_session_t *p_dtls_session,
+                                      const unsigned char *p_buf, unsigned int len)
+{
+    int result = 0;
+    dtls_saved_session_t header;
+
+    if (sizeof(header) > len) {
+        return DTLS_INVALID_PARAM;
+    }
+    memcpy(&header, p_buf, sizeof(header));
+    if (DTLS_SESSION_MAGIC != header.magic || DTLS_SESSION_VERSION != header.version
+        || len - sizeof(header) < header.len) {
+        return DTLS_INVALID_PARAM;
+    }
+    /* a session of another mbedtls build, or another config of it, has another layout */
+    if (MBEDTLS_VERSION_NUMBER != header.mbedtls || sizeof(mbedtls_ssl_session) != header.struct_len) {
+        DTLS_INFO("Saved DTLS session is of mbedtls 0x%08x/%u, not 0x%08x/%u\r\n",
+                  header.mbedtls, header.struct_len,
+                  (unsigned int)MBEDTLS_VERSION_NUMBER, (unsigned int)sizeof(mbedtls_ssl_session));
+        return DTLS_INVALID_PARAM;
+    }
+    p_buf += sizeof(header);
+
+#if MBEDTLS_VERSION_NUMBER >= 0x02130000
+    {
+        mbedtls_ssl_session session;
+
+        mbedtls_ssl_session_init(&session);
+        result = mbedtls_ssl_session_load(&session, p_buf, header.len);
+        if (0 == result) {
+            result = mbedtls_ssl_set_session(&p_dtls_session->context, &session);
+            memcpy(p_dtls_session->master, session.master, sizeof(p_dtls_session->master));
+        }
+        mbedtls_ssl_session_free(&session);
+    }
+#else
+    {
+        /* the struct as it was saved, then what its pointers referred to */
+        mbedtls_ssl_session session;
+
+        if (sizeof(session) > header.len) {
+            return DTLS_INVALID_PARAM;
+        }
+        memcpy(&session, p_buf, sizeof(session));
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        session.peer_cert = NULL;
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+        if (header.len - sizeof(session) != session.ticket_len) {
+            return DTLS_INVALID_PARAM;
+        }
+        session.ticket = 0 == session.ticket_len ? NULL : (unsigned char *)p_buf + sizeof(session);
+#endif
+        /* copies the ticket, the buffer is not referenced afterwards */
+        result = mbedtls_ssl_set_session(&p_dtls_session->context, &session);
+        memcpy(p_dtls_session->master, session.master, sizeof(p_dtls_session->master));
+    }
+#endif
+    p_dtls_session->loaded = (0 == result);
+
+    DTLS_TRC("mbedtls_ssl_set_session result 0x%04x\r\n", result);
+    return (0 == result) ? DTLS_SUCCESS : DTLS_INVALID_PARAM;
+}
+
+static void _DTLSHandshake_stats(dtls_session_t *p_dtls_session, coap_dtls_options_t *p_options)
+{
+    dtls_handshake_stats_t *p_stats = &p_dtls_session->bio.stats;
+
+    /* only an abbreviated handshake keeps the master secret of the offered session */
+    p_stats->resumed = p_dtls_session->loaded
+                       && 0 == memcmp(p_dtls_session->context.session->master, p_dtls_session->master,
+                                      sizeof(p_dtls_session->master));
+#if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID)
+    {
+        int enabled = MBEDTLS_SSL_CID_DISABLED;
+        mbedtls_ssl_get_peer_cid(&p_dtls_session->context, &enabled, NULL, NULL);
+        p_stats->cid = (MBEDTLS_SSL_CID_ENABLED == enabled);
+    }
+#endif
+    memset(p_dtls_session->master, 0x00, sizeof(p_dtls_session->master));
+
+    DTLS_INFO("DTLS handshake %s, %u bytes out, %u bytes in, %u round trips, %u ms\r\n",
+              p_stats->resumed ? "resumed" : "full", p_stats->bytes_sent, p_stats->bytes_recv,
+              p_stats->round_trips, p_stats->time_ms);
+    if (NULL != p_options->p_stats) {
+        memcpy(p_options->p_stats, p_stats, sizeof(dtls_handshake_stats_t));
+    }
+}
+
 static unsigned int _DTLSContext_setup(dtls_session_t *p_dtls_session, coap_dtls_options_t  *p_options)
 {
     int   result = 0;
@@ -130,18 +289,40 @@ static unsigned int _DTLSContext_setup(dtls_session_t *p_dtls_session, coap_dtls
         DTLS_TRC("mbedtls_ssl_set_hostname %s\r\n", p_options->p_host);
         mbedtls_ssl_set_hostname(&p_dtls_session->context, p_options->p_host);
 #endif
+        p_dtls_session->bio.fd = &p_dtls_session->fd;
         mbedtls_ssl_set_bio(&p_dtls_session->context,
-                            (void *)&p_dtls_session->fd,
-                            mbedtls_net_send,
-                            mbedtls_net_recv,
-                            mbedtls_net_recv_timeout);
+                            (void *)&p_dtls_session->bio,
+                            _DTLSNet_send,
+                            _DTLSNet_recv,
+                            _DTLSNet_recv_timeout);
         DTLS_TRC("mbedtls_ssl_set_bio result 0x%04x\r\n", result);
 
+#if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID)
+        /* let the server tag our records, so a NAT rebinding keeps the session */
+        mbedtls_ssl_set_cid(&p_dtls_session->context, MBEDTLS_SSL_CID_ENABLED, NULL, 0);
+#endif
+
+        /* a stale or rejected session just ends in a full handshake */
+        if (NULL != p_options->p_session
+            && DTLS_SUCCESS != _DTLSSession_load(p_dtls_session, p_options->p_session,
+                                                 p_options->session_len)) {
+            DTLS_INFO("Ignore the saved DTLS session, it can't be loaded\r\n");
+        }
+
+        memset(&p_dtls_session->bio.stats, 0x00, sizeof(dtls_handshake_stats_t));
+        p_dtls_session->bio.counting = 1;
+        p_dtls_session->bio.stats.time_ms = HAL_UptimeMs();
         do{
             result = mbedtls_ssl_handshake(&p_dtls_session->context);
         }while( result == MBEDTLS_ERR_SSL_WANT_READ ||
                     result == MBEDTLS_ERR_SSL_WANT_WRITE );
+        p_dtls_session->bio.counting = 0;
+        p_dtls_session->bio.stats.time_ms = HAL_UptimeMs() - p_dtls_session->bio.stats.time_ms;
         DTLS_TRC("mbedtls_ssl_handshake result 0x%04x\r\n", result);
+
+        if (0 == result) {
+            _DTLSHandshake_stats(p_dtls_session, p_options);
+        }
     }
 
     return (result ? DTLS_HANDSHAKE_FAILED : DTLS_SUCCESS);
@@ -155,6 +336,7 @@ dtls_session_t *_DTLSSession_init()
     mbedtls_debug_set_threshold(0);
     mbedtls_platform_set_calloc_free(_DTLSCalloc_wrapper, _DTLSFree_wrapper);
     if(NULL != p_dtls_session) {
+        memset(p_dtls_session, 0x00, sizeof(dtls_session_t));
         mbedtls_net_init(&p_dtls_session->fd);
         mbedtls_ssl_init(&p_dtls_session->context);
         mbedtls_ssl_config_init(&p_dtls_session->conf);
@@ -226,6 +408,9 @@ DTLSContext *HAL_DTLSSession_create(coap_dtls_options_t            *p_options)
         }
         mbedtls_ssl_conf_rng(&p_dtls_session->conf, mbedtls_ctr_drbg_random, &p_dtls_session->ctr_drbg);
         mbedtls_ssl_conf_dbg(&p_dtls_session->conf, _DTLSLog_wrapper, NULL);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets(&p_dtls_session->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
 
         result = mbedtls_ssl_cookie_setup(&p_dtls_session->cookie_ctx,
                                           mbedtls_ctr_drbg_random, &p_dtls_session->ctr_drbg);
@@ -357,6 +542,76 @@ unsigned int HAL_DTLSSession_read(DTLSContext *context,
     return err_code;
 }
 
+unsigned int HAL_DTLSSession_save(DTLSContext *context,
+                                  unsigned char   *p_buf,
+                                  unsigned int    *p_len)
+{
+    int result = 0;
+    size_t len = 0;
+    dtls_saved_session_t header;
+    mbedtls_ssl_session session;
+    dtls_session_t *p_dtls_session = (dtls_session_t *)context;
+
+    if (NULL == p_dtls_session || NULL == p_buf || NULL == p_len || sizeof(header) > *p_len) {
+        return DTLS_INVALID_PARAM;
+    }
+
+    mbedtls_ssl_session_init(&session);
+    result = mbedtls_ssl_get_session(&p_dtls_session->context, &session);
+    if (0 != result) {
+        DTLS_ERR("mbedtls_ssl_get_session result 0x%04x\r\n", result);
+        mbedtls_ssl_session_free(&session);
+        return DTLS_SESSION_SAVE_FAILED;
+    }
+
+#if MBEDTLS_VERSION_NUMBER >= 0x02130000
+    result = mbedtls_ssl_session_save(&session, p_buf + sizeof(header), *p_len - sizeof(header), &len);
+#else
+    {
+        size_t ticket_len = 0;
+        mbedtls_ssl_session copy;
+
+        /* the struct with its pointers cleared, then the ticket it points to */
+        memcpy(&copy, &session, sizeof(copy));
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+        copy.peer_cert = NULL;
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+        copy.ticket = NULL;
+        ticket_len = session.ticket_len;
+#endif
+        len = sizeof(copy) + ticket_len;
+        if (*p_len - sizeof(header) < len) {
+            result = -1;
+        } else {
+            memcpy(p_buf + sizeof(header), &copy, sizeof(copy));
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+            if (0 != ticket_len) {
+                memcpy(p_buf + sizeof(header) + sizeof(copy), session.ticket, ticket_len);
+            }
+#endif
+        }
+        memset(&copy, 0x00, sizeof(copy));
+    }
+#endif
+    mbedtls_ssl_session_free(&session);
+    if (0 != result) {
+        DTLS_ERR("DTLS session needs more than %u bytes\r\n", *p_len);
+        return DTLS_SESSION_SAVE_FAILED;
+    }
+
+    header.magic      = DTLS_SESSION_MAGIC;
+    header.version    = DTLS_SESSION_VERSION;
+    header.reserved   = 0;
+    header.len        = (unsigned int)len;
+    header.mbedtls    = MBEDTLS_VERSION_NUMBER;
+    header.struct_len = sizeof(mbedtls_ssl_session);
+    memcpy(p_buf, &header, sizeof(header));
+    *p_len = sizeof(header) + len;
+
+    return DTLS_SUCCESS;
+}
+
 unsigned int HAL_DTLSSession_free(DTLSContext *context)
 {
     dtls_session_t *p_dtls_session = NULL;
@@ -28,6 +28,9 @@
 #include "mbedtls/pk.h"
 #include "mbedtls/debug.h"
 #include "mbedtls/platform.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include "iot_import.h"
 
@@ -236,6 +239,7 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
                       const char *client_pwd, size_t client_pwd_len)
 {
     int ret = -1;
+    int nodelay = 1;
     /*
      * 0. Init
      */
@@ -255,6 +259,8 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
         SSL_LOG(" failed ! net_connect returned -0x%04x", -ret);
         return ret;
     }
+    /* a request is written at once, it goes out without waiting for the ack of the previous one */
+    setsockopt(pTlsData->fd.fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
     SSL_LOG(" ok");
 
     /*
@@ -342,8 +348,9 @@ static int _network_ssl_read(TLSDataParams_t *pTlsData, char *buffer, int len, i
             readLen += ret;
             net_status = 0;
         } else if (ret == 0) {
-            /* if ret is 0 and net_status is -2, indicate the connection is closed during last call */
-            return (net_status == -2) ? net_status : readLen;
+            /* mbedtls_ssl_read() returns 0 at the end of the connection, closed without close notify,
+             * or by the close notify of the last call if net_status is -2 */
+            return (readLen > 0) ? readLen : ((net_status == -2) ? net_status : -1);
         } else {
             if (MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY == ret) {
                 mbedtls_strerror(ret, err_str, sizeof(err_str));
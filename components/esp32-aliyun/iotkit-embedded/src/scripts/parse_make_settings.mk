@@ -20,6 +20,7 @@ SWITCH_VARS := \
     FEATURE_MQTT_ID2_CRYPTO \
     FEATURE_MQTT_ID2_ENV \
     FEATURE_HTTP_COMM_ENABLED \
+    FEATURE_HTTP_INFLATE \
 
 $(foreach v, \
     $(SETTING_VARS) $(SWITCH_VARS), \
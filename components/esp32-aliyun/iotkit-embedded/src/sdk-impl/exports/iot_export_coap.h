@@ -93,7 +93,7 @@ typedef struct
 typedef struct
 {
     char                 *p_url;        /*Can be NULL*/
-    int                   wait_time_ms; /*unit is micro second*/
+    int                   wait_time_ms; /*unit is millisecond*/
     iotx_deviceinfo_t    *p_devinfo;    /*Device info*/
     iotx_event_handle_t   event_handle; /*TODO, not supported now*/
 }iotx_coap_config_t;
@@ -113,9 +113,33 @@ typedef struct
 }iotx_message_t;
 
 
+/* IoTx gateway engine parameters */
+typedef struct
+{
+    char                 *p_url;          /*Can be NULL, then the default server of p_product_key*/
+    char                 *p_product_key;  /*Used only when p_url is NULL*/
+    int                   wait_time_ms;   /*unit is millisecond*/
+    unsigned char         max_pending;    /*Requests awaiting response over all sessions, 0 is 255*/
+}iotx_coap_engine_config_t;
+
+/* DTLS handshakes of a CoAP client, summed up */
+typedef struct
+{
+    unsigned int          handshakes;     /*Full and resumed ones*/
+    unsigned int          resumed;        /*Abbreviated ones, from the saved session*/
+    unsigned int          bytes_sent;     /*Handshake bytes*/
+    unsigned int          bytes_recv;
+    unsigned int          round_trips;
+    unsigned int          last_time_ms;   /*Duration of the last handshake*/
+    unsigned char         cid;            /*The last handshake negotiated a Connection ID*/
+}iotx_coap_dtls_stats_t;
+
 /*iotx coap context definition*/
 typedef void iotx_coap_context_t;
 
+/*iotx coap gateway engine definition*/
+typedef void iotx_coap_engine_context_t;
+
 
 /**
  * @brief   Initialize the CoAP client
@@ -132,6 +156,7 @@ iotx_coap_context_t *IOT_CoAP_Init(iotx_coap_config_t *p_config);
  * @brief   De-initialize the CoAP client
  *        This function release CoAP DTLS session,
  *        and release the related resource.
+ *        For a session of IOT_CoAP_SessionOpen() only the session is released.
  *
  * @param p_context  Pointer of contex, specify the CoAP client.
  *
@@ -140,6 +165,54 @@ iotx_coap_context_t *IOT_CoAP_Init(iotx_coap_config_t *p_config);
 void IOT_CoAP_Deinit(iotx_coap_context_t **p_context);
 
 
+/**
+ * @brief   Initialize a CoAP engine for a gateway. The engine owns one UDP/DTLS
+ *        connection, one pair of send/receive buffers and one retransmission
+ *        list, all shared by the device sessions opened on it, so a sub-device
+ *        costs a session instead of a socket and its buffers.
+ *
+ * @param p_config  Specify the engine parameter.
+ *
+ * @return NULL, initialize failed; NOT NULL, the contex of the engine.
+ */
+iotx_coap_engine_context_t *IOT_CoAP_EngineInit(iotx_coap_engine_config_t *p_config);
+
+/**
+ * @brief   De-initialize the engine, the sessions still open on it are closed
+ *        and their contexts must not be used any more.
+ *
+ * @param pp_engine  Pointer of the engine contex.
+ *
+ * @return void
+ */
+void IOT_CoAP_EngineDeinit(iotx_coap_engine_context_t **pp_engine);
+
+/**
+ * @brief   Open a device session on the engine. The returned contex is used with
+ *        IOT_CoAP_DeviceNameAuth(), IOT_CoAP_SendMessage(), IOT_CoAP_Observe() etc.
+ *        like the one of IOT_CoAP_Init(); it has its own auth token and CoAP token
+ *        space, so responses reach the session which sent the request.
+ *        Close it with IOT_CoAP_Deinit(), the engine is kept.
+ *
+ * @param p_engine      The engine contex.
+ * @param p_devinfo     Device info of the sub-device.
+ * @param event_handle  Can be NULL.
+ *
+ * @return NULL, open failed; NOT NULL, the contex of the session.
+ */
+iotx_coap_context_t *IOT_CoAP_SessionOpen(iotx_coap_engine_context_t *p_engine,
+        iotx_deviceinfo_t *p_devinfo, iotx_event_handle_t event_handle);
+
+/**
+ * @brief   Handle CoAP packets of all sessions of the engine,
+ *        same as IOT_CoAP_Yield() on any of them.
+ *
+ * @param p_engine  The engine contex.
+ *
+ * @return status.
+ */
+int  IOT_CoAP_EngineYield(iotx_coap_engine_context_t *p_engine);
+
 /**
  * @brief   Handle device name authentication with remote server.
  *
@@ -174,9 +247,88 @@ int  IOT_CoAP_Yield(iotx_coap_context_t *p_context);
  * @return IOTX_SUCCESS Send the message success
  *        IOTX_ERR_MSG_TOO_LOOG The message length is too loog
  *        IOTX_ERR_NOT_AUTHED The client hasn't authenticated with server
+ *        IOTX_ERR_SEND_MSG_FAILED Too many messages await a response, or the write failed
  */
 int  IOT_CoAP_SendMessage(iotx_coap_context_t *p_context,   char *p_path, iotx_message_t *p_message);
 
+/**
+ * @brief   Observe a resource with specific path (RFC 7641), so the server pushes
+ *        its changes instead of the client polling for them.
+ *        Client must authentication with server before observe.
+ *
+ *        p_message->resp_callback is called for the registration response and
+ *        every later notification, stale or reordered notifications are dropped.
+ *        The relation is re-registered from IOT_CoAP_Yield() when the Max-Age of
+ *        the last notification runs out, and it ends when the server answers
+ *        without the Observe option, e.g. an error code.
+ *
+ * @param p_context     Pointer of contex, specify the CoAP client.
+ * @param p_path        Specify the path name.
+ * @param p_message     resp_callback and content_type are used, the payload is ignored.
+ * @param p_observe_id  Output, identifies the relation for IOT_CoAP_ObserveCancel().
+ *
+ * @return IOTX_SUCCESS Send the registration success
+ *        IOTX_ERR_NOT_AUTHED The client hasn't authenticated with server
+ *        IOTX_ERR_SEND_MSG_FAILED Send the registration failed
+ */
+int  IOT_CoAP_Observe(iotx_coap_context_t *p_context, char *p_path, iotx_message_t *p_message,
+                      unsigned int *p_observe_id);
+
+/**
+ * @brief   Stop observing, later notifications of the relation are rejected.
+ *
+ * @param p_context     Pointer of contex, specify the CoAP client.
+ * @param observe_id    The id returned by IOT_CoAP_Observe().
+ *
+ * @return IOTX_SUCCESS The relation is removed
+ *        IOTX_ERR_INVALID_PARAM No such relation
+ */
+int  IOT_CoAP_ObserveCancel(iotx_coap_context_t *p_context, unsigned int observe_id);
+
+/**
+ * @brief   Get the DTLS handshake counters of the client, how many handshakes
+ *        were needed, how many were resumed and what they cost on the air.
+ *
+ * @param p_context  Pointer of contex, specify the CoAP client.
+ * @param p_stats    Output.
+ *
+ * @return IOTX_SUCCESS Success
+ *        IOTX_ERR_INVALID_PARAM Not a coaps:// client, or DTLS isn't compiled in
+ */
+int  IOT_CoAP_GetDTLSStats(iotx_coap_context_t *p_context, iotx_coap_dtls_stats_t *p_stats);
+
+/**
+ * @brief   Copy out the DTLS session of the last handshake, with the host:port of
+ *        its server. A client of that server created by IOT_CoAP_Init() later in
+ *        the same process resumes it by itself; a device which powers down
+ *        keeps the copy in flash and gives it back with IOT_CoAP_LoadDTLSSession()
+ *        after waking up, so it skips the full handshake.
+ *        It holds the master secret, store it like a key.
+ *
+ * @param p_buf     Buffer, 640 bytes are enough.
+ * @param p_len     Input the buffer size, output the session length.
+ *
+ * @return IOTX_SUCCESS Success
+ *        IOTX_ERR_BUFF_TOO_SHORT The buffer is too short
+ *        IOTX_ERR_INVALID_PARAM No session yet, or DTLS isn't compiled in
+ */
+int  IOT_CoAP_SaveDTLSSession(unsigned char *p_buf, int *p_len);
+
+/**
+ * @brief   Give back a session of IOT_CoAP_SaveDTLSSession(), call it before
+ *        IOT_CoAP_Init(). It is only offered to the server it was saved from,
+ *        and only by the mbedtls build which saved it. A session the server
+ *        doesn't know any more only costs the full handshake it would have
+ *        taken anyway.
+ *
+ * @param p_buf     The saved session.
+ * @param len       Its length.
+ *
+ * @return IOTX_SUCCESS Success
+ *        IOTX_ERR_INVALID_PARAM Bad length, or DTLS isn't compiled in
+ */
+int  IOT_CoAP_LoadDTLSSession(unsigned char *p_buf, int len);
+
 /**
 * @brief Retrieves the length and payload pointer of specified message.
 *
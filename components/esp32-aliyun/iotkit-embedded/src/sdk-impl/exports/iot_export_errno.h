@@ -65,6 +65,7 @@ typedef enum IOT_RETURN_CODES {
     MQTT_NETWORK_ERROR = -14,
     MQTT_PUBLISH_ACK_TYPE_ERROR = -13,
 
+    ERROR_SHADOW_INVALID_VALUE = -2009,       /**< value does not parse as or fit in the attribute */
     ERROR_SHADOW_NO_METHOD = -2008,
     ERROR_SHADOW_UNDEF_TYPE = -2007,
     ERROR_SHADOW_UPDATE_TIMEOUT = -2006,
@@ -80,6 +81,7 @@ typedef enum IOT_RETURN_CODES {
     ERROR_MALLOC = -1014,
     ERROR_NO_ENOUGH_MEM = -1013,               /**< Writes more than size value. */
 
+    ERROR_HTTP_TIMEOUT = -13,                /**< No data of the body came in the time given. */
     ERROR_NO_SUPPORT = -12,
     ERROR_NO_PERSISTENCE = -11,
     ERROR_HTTP_BREAK = -10,
@@ -19,6 +19,14 @@
 #ifndef _IOT_EXPORT_HTTP_H_
 #define _IOT_EXPORT_HTTP_H_
 
+/* Counters of the connections to the server, see IOT_HTTP_GetConnStats() */
+typedef struct {
+    uint32_t            connects;       /* connections opened, a TLS handshake each */
+    uint32_t            reuses;         /* requests sent on a connection kept from a previous one */
+    uint32_t            retries;        /* requests sent again as their kept connection was closed */
+    uint32_t            expired;        /* kept connections closed as idle or found closed by the server */
+} iotx_http_conn_stats_t;
+
 /* IoTx http context */
 typedef struct {
     char               *p_auth_token;
@@ -29,6 +37,9 @@ typedef struct {
     const char         *sign;
     iotx_device_info_t *p_devinfo;
     const char         *timestamp;
+    void               *p_conns;        /* connections kept alive between requests */
+    uint32_t            keepalive_idle_ms;
+    iotx_http_conn_stats_t conn_stats;
 } iotx_http_t, *iotx_http_pt;
 
 /* IoTx http message definition 
@@ -44,6 +55,21 @@ typedef struct {
     uint32_t   timeout_ms;
 } iotx_http_message_param_t;
 
+/* Result of a message sent by IOT_HTTP_SendMessages() */
+typedef struct {
+    int         result;         /* 0 if the server accepted the message, -1 if not or if it was not answered */
+    int         response_code;  /* code of the response, see iotx_http_upstream_response_t, -1 without response */
+    uint32_t    latency_ms;     /* from the write of the request to the end of its response */
+} iotx_http_message_result_t;
+
+/* Totals of a batch sent by IOT_HTTP_SendMessages() */
+typedef struct {
+    uint32_t    accepted;       /* messages accepted by the server */
+    uint32_t    writes;         /* writes of requests to the connection, a TLS record each up to 16 KB */
+    uint32_t    bytes;          /* bytes of requests written, with the ones sent again */
+    uint32_t    elapsed_ms;     /* time of the whole batch */
+} iotx_http_batch_stats_t;
+
 /* The response code from sever */
 typedef enum {
     IOTX_HTTP_SUCCESS = 0,
@@ -100,6 +126,59 @@ int     IOT_HTTP_DeviceNameAuth(void *p_context);
  */
 int     IOT_HTTP_SendMessage(void *p_context, iotx_http_message_param_t *msg_param);
 
+/**
+ * @brief   Send several messages on the connection kept to the server, without waiting for the
+ *        response of a message before sending the next ones: the requests are written together,
+ *        up to 8 ahead of their responses, which are read in order. A message gets the time of its
+ *        request through the network, not a round trip of its own.
+ *        Requests the server did not answer before it closed the connection after a response are
+ *        sent again on a new connection, one at a time until a response shows the connection is
+ *        kept; the others fail with the message they were sent after.
+ *        A connection closed without "Connection: close" may have had a request processed but not
+ *        answered, so a message may be delivered twice: the messages of a batch must be safe to
+ *        repeat, or be sent with IOT_HTTP_SendMessage() one by one.
+ *
+ * @param p_context   Pointer of contex, specify the HTTP client.
+ * @param msg_params  Specify the messages, the timeout_ms of a message bounds the wait for its response.
+ * @param results     Specify where the result of every message is stored, @count of them.
+ * @param count       Specify the number of messages.
+ * @param stats       Specify where the totals of the batch are stored, NULL if not needed.
+ *
+ * @return 0   every message was accepted.
+ *        -1   failed, see @results.
+ */
+int     IOT_HTTP_SendMessages(void *p_context,
+                              iotx_http_message_param_t *msg_params,
+                              iotx_http_message_result_t *results,
+                              int count,
+                              iotx_http_batch_stats_t *stats);
+
+/**
+ * @brief   Keep the connection to the server open between requests, so that a message does not pay
+ *        for a TCP and TLS handshake. A connection idle for longer than @idle_ms is closed before the
+ *        next request, one idle for a second is checked first, and a request whose kept connection
+ *        turns out closed by the server before it is answered is sent again on a new connection.
+ *        It is enabled with 15 seconds by default.
+ *
+ * @param p_context  Pointer of contex, specify the HTTP client.
+ * @param idle_ms    Specify the longest idle time of a kept connection, 0 to close it after every request.
+ *
+ * @return 0   success.
+ *        -1   failed.
+ */
+int     IOT_HTTP_SetKeepAlive(void *p_context, uint32_t idle_ms);
+
+/**
+ * @brief   Get the counters of the connections to the server.
+ *
+ * @param p_context  Pointer of contex, specify the HTTP client.
+ * @param stats      Specify where the counters are copied.
+ *
+ * @return 0   success.
+ *        -1   failed.
+ */
+int     IOT_HTTP_GetConnStats(void *p_context, iotx_http_conn_stats_t *stats);
+
 /*
 TEST MACROS
     Daily Test Environment:         -DTEST_HTTP_DAILY
@@ -27,6 +27,14 @@
 #define OTA_CH_SIGNAL_COAP      (1)
 #define OTA_CH_FETCH_HTTP       (1)
 
+/* A manifest starts with the magic, the block length and the file size as 32 bits big endian */
+#define IOT_OTA_MANIFEST_MAGIC      "OTAM"
+#define IOT_OTA_MANIFEST_HEADER_LEN (12)
+
+/* A patch starts with the magic, the sizes and the SHA-256 of the running and the new firmware */
+#define IOT_OTA_PATCH_MAGIC         "OTAD"
+#define IOT_OTA_PATCH_HEADER_LEN    (76)
+
 
 typedef enum {
 
@@ -37,6 +45,8 @@ typedef enum {
     IOT_OTAE_FETCH_FAILED = -5,
     IOT_OTAE_NOMEM = -6,
     IOT_OTAE_OSC_FAILED = -7,
+    IOT_OTAE_SINK_FAILED = -8,
+    IOT_OTAE_CHECK_FAILED = -9,
     IOT_OTAE_NONE = 0,
 
 } IOT_OTA_Err_t;
@@ -84,11 +94,83 @@ typedef enum {
     IOT_OTAG_FILE_SIZE,        /* size of file */
     IOT_OTAG_MD5SUM,           /* md5 in string format */
     IOT_OTAG_VERSION,          /* version in string format */
-    IOT_OTAG_CHECK_FIRMWARE    /* Check firmware is valid or not */
+    IOT_OTAG_CHECK_FIRMWARE,   /* Check firmware is valid or not */
+    IOT_OTAG_PIPELINE_STATS,   /* counters of the stages of the pipeline */
+    IOT_OTAG_IS_DIFF,          /* the file is a patch of the running firmware or not */
+    IOT_OTAG_FETCH_STATS       /* rate and stalls of the download */
 
 } IOT_OTA_CmdType_t;
 
 
+/* Where the pipeline stores the firmware */
+typedef struct {
+    /* write @len bytes at @offset of the firmware, the offsets follow each other.
+     * 0, successful; otherwise, failed, the download is aborted. */
+    int (*write)(void *ctx, uint32_t offset, const char *buf, uint32_t len);
+    void *ctx;
+} IOT_OTA_Sink_t;
+
+
+/* Where a patch reads the running firmware */
+typedef struct {
+    /* read @len bytes at @offset of the running firmware. 0, successful; otherwise, failed. */
+    int (*read)(void *ctx, uint32_t offset, char *buf, uint32_t len);
+    void *ctx;
+} IOT_OTA_Source_t;
+
+
+typedef struct {
+    uint32_t bytes;             /* bytes through the stage */
+    uint32_t busy_ms;           /* time spent on them */
+    uint32_t stall_ms;          /* time waiting for the other stage */
+    uint32_t stalls;            /* number of waits */
+} IOT_OTA_StageStats_t;
+
+
+typedef struct {
+    IOT_OTA_StageStats_t fetch; /* waits for a free buffer */
+    IOT_OTA_StageStats_t hash;  /* runs in IOT_OTA_PipelineFlush() before the sink, never waits */
+    IOT_OTA_StageStats_t sink;  /* waits for a filled buffer */
+} IOT_OTA_PipelineStats_t;
+
+
+/* Timeouts of the download and how much a fetch call asks for, see IOT_OTA_SetFetchConfig() */
+typedef struct {
+    uint32_t connect_timeout_ms;    /* from opening a connection to the head of its response, 0 for 10 s */
+    uint32_t read_timeout_ms;       /* longest a fetch call waits for data, 0 for the timeout of the call */
+    uint32_t idle_timeout_ms;       /* a connection without data for this long is dropped and the rest
+                                     * of the file asked for on a new one, 0 for 30 s */
+    uint32_t read_time_ms;          /* a fetch call returns once it has the bytes the measured rate
+                                     * brings in this time, at most its buffer, 0 for 1 s */
+} IOT_OTA_FetchConfig_t;
+
+
+typedef struct {
+    uint32_t bytes;             /* bytes received, the ones dropped when a range is ignored too */
+    uint32_t busy_ms;           /* time spent in the fetch calls */
+    uint32_t rate;              /* bytes per second over the last second or so, before half a second
+                                 * of fetch calls their average so far */
+    uint32_t read_len;          /* bytes the last fetch call asked for: from @rate, at most its buffer */
+    uint32_t connections;       /* connections opened */
+    uint32_t requests;          /* requests sent, several on a connection kept between segments */
+    uint32_t parallel;          /* connections used at a time now, see IOT_OTA_PipelineSegments() */
+    uint32_t connect_ms;        /* time from sending the requests to the heads of their responses */
+    uint32_t timeouts;          /* fetch calls which got no data */
+    uint32_t timeout_ms;        /* time spent in them */
+    uint32_t stalls;            /* connections dropped after idle_timeout_ms without data */
+    uint32_t failures;          /* connections lost, refused or not answered in connect_timeout_ms */
+} IOT_OTA_FetchStats_t;
+
+
+/* Checks the signature of a manifest */
+typedef struct {
+    /* check that @sign of @sign_len bytes is a signature of @digest, the SHA-256 of the manifest
+     * without @sign. 0, valid; otherwise, invalid. */
+    int (*verify)(void *ctx, const unsigned char digest[32], const char *sign, uint32_t sign_len);
+    void *ctx;
+} IOT_OTA_Verifier_t;
+
+
 /**
  * @brief Initialize OTA module, and return handle.
  *        The MQTT client must be construct before calling this interface.
@@ -161,17 +243,21 @@ bool IOT_OTA_IsFetchFinish(void *handle);
 /**
  * @brief fetch firmware from remote server with specific timeout value.
  *        NOTE: If you want to download more faster, the bigger @buf should be given.
+ *        The data goes at offset IOT_OTAG_FETCHED_SIZE of the file as read before the call, which is
+ *        not 0 when a download goes on from a checkpoint, see IOT_OTA_SetCheckpoint().
+ *        A broken connection is retried with a HTTP Range request from that offset.
  *
  * @param [in] handle, specify the OTA module.
  * @param [out] buf, specify the space for storing firmware data.
  * @param [in] buf_len, specify the length of @buf in bytes.
- * @param [in] timeout_s, specify the timeout value in second.
+ * @param [in] timeout_s, specify the timeout value in second, read_timeout_ms of IOT_OTA_SetFetchConfig()
+ *        replaces it when set.
  *
  * @return
    @verbatim
         < 0 : error occur.
-          0 : No any data be downloaded in @timeout_ms timeout period.
-   (0, len] : The length of data be downloaded in @timeout_ms timeout period in bytes.
+          0 : No any data be downloaded in @timeout_s timeout period.
+   (0, len] : The length of data be downloaded in @timeout_s timeout period in bytes.
    @endverbatim
  */
 int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_s);
@@ -192,7 +278,16 @@ int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeo
       3) When @type is IOT_OTAG_MD5SUM, @buf should be a buffer, and @buf_len should be 33.
       4) When @type is IOT_OTAG_VERSION, @buf should be a buffer, and @buf_len should be OTA_VERSION_LEN_MAX.
       5) When @type is IOT_OTAG_CHECK_FIRMWARE, @buf should be pointer of uint32_t, and @buf_len should be 4.
-         0, firmware is invalid; 1, firmware is valid.
+         0, firmware is invalid; 1, firmware is valid. The file is checked against the SHA-256 "sign"
+         of the upgrade message when its "signMethod" is "SHA256", against the MD5 otherwise, or block
+         by block against the manifest of IOT_OTA_SetManifest().
+      6) When @type is IOT_OTAG_PIPELINE_STATS, @buf should be pointer of IOT_OTA_PipelineStats_t,
+         and @buf_len should be sizeof(IOT_OTA_PipelineStats_t).
+      7) When @type is IOT_OTAG_IS_DIFF, @buf should be pointer of uint32_t, and @buf_len should be 4.
+         1, the file is a patch to give to IOT_OTA_PatchWrite(), "isDiff" of the upgrade message is 1;
+         0, the file is the whole firmware.
+      8) When @type is IOT_OTAG_FETCH_STATS, @buf should be pointer of IOT_OTA_FetchStats_t,
+         and @buf_len should be sizeof(IOT_OTA_FetchStats_t).
    @endverbatim
  *
  * @return 0, successful; < 0, failed, the value is error code.
@@ -200,6 +295,201 @@ int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeo
 int IOT_OTA_Ioctl(void *handle, IOT_OTA_CmdType_t type, void *buf, size_t buf_len);
 
 
+/**
+ * @brief Download through a ring of @buf_count buffers of @buf_len bytes into @sink, instead of
+ *        IOT_OTA_FetchYield(). IOT_OTA_PipelineFetch() fills the buffers from the network and
+ *        IOT_OTA_PipelineFlush() hashes them and gives them to @sink. Called from two tasks, the
+ *        download goes on while the flash is written; called one after the other from a task, it
+ *        works as IOT_OTA_FetchYield() does. It must be called before the download starts.
+ *
+ * @param [in] handle, specify the OTA module.
+ * @param [in] sink, specify where the firmware is written.
+ * @param [in] buf_count, specify the number of buffers.
+ * @param [in] buf_len, specify the length of a buffer in bytes.
+ *
+ * @return 0, successful; < 0, failed, the value is error code.
+ */
+int IOT_OTA_PipelineInit(void *handle, const IOT_OTA_Sink_t *sink, uint32_t buf_count, uint32_t buf_len);
+
+
+/**
+ * @brief Fill a free buffer of the pipeline from the network.
+ *        It waits up to @timeout_ms for a free buffer when the sink is behind, and as long for data,
+ *        or read_timeout_ms of IOT_OTA_SetFetchConfig() when set. With IOT_OTA_PipelineSegments(),
+ *        it returns once the next buffer in the order of the file is complete or the time is up,
+ *        the other segments go on at the next call.
+ *
+ * @param [in] handle, specify the OTA module.
+ * @param [in] timeout_ms, specify the timeout value in millisecond.
+ *
+ * @return < 0, error occur; 0, no buffer filled; > 0, the bytes in the buffers filled.
+ */
+int IOT_OTA_PipelineFetch(void *handle, uint32_t timeout_ms);
+
+
+/**
+ * @brief Hash a filled buffer of the pipeline and write it to the sink.
+ *        It waits up to @timeout_ms for a filled buffer when the network is behind.
+ *        IOT_OTA_IsFetchFinish() is true once the last byte of the file is written.
+ *
+ * @param [in] handle, specify the OTA module.
+ * @param [in] timeout_ms, specify the timeout value in millisecond.
+ *
+ * @return < 0, error occur in the sink or in the fetch stage; 0, no buffer written;
+ *         > 0, the bytes written.
+ */
+int IOT_OTA_PipelineFlush(void *handle, uint32_t timeout_ms);
+
+
+/**
+ * @brief Fetch the buffers of the pipeline as segments of the file on up to @max_connections
+ *        connections at a time, each a Range request of a buffer, when a connection alone is held
+ *        back by the round trip of a distant server. IOT_OTA_PipelineFetch() then reads all of them
+ *        in turn and hands the buffers to IOT_OTA_PipelineFlush() in the order of the file. The
+ *        connections are kept from a segment to the next, and their number follows the rate: one
+ *        more while it brings 10% more, one less when it does not, and again when the rate falls by
+ *        a quarter. With a manifest, a segment is of whole blocks, checked once it is complete and
+ *        fetched again if one does not match; without, IOT_OTA_PipelineFlush() hashes the whole
+ *        file in order as without segments.
+ *        It must be called after IOT_OTA_PipelineInit() and before the download starts, a segment
+ *        being a buffer, there are no more connections than @buf_count.
+ *
+ * @param [in] handle, specify the OTA module.
+ * @param [in] max_connections, specify the most connections at a time.
+ *
+ * @return 0, successful; < 0, failed, the value is error code.
+ */
+int IOT_OTA_PipelineSegments(void *handle, uint32_t max_connections);
+
+
+/**
+ * @brief Save the progress of the download by HAL_Kv_Set() every @interval bytes, so that a download
+ *        broken by a reboot goes on from the last checkpoint instead of from byte 0.
+ *        It must be called before the download starts. A checkpoint is saved when IOT_OTA_FetchYield()
+ *        is called and covers the data returned before, the application must have stored them by then;
+ *        with a pipeline, it is saved by IOT_OTA_PipelineFlush() after the sink.
+ *        It is disabled by default, as the application must be able to write at any offset of the file.
+ *
+ * @param [in] handle, specify the OTA module.
+ * @param [in] interval, bytes between two checkpoints, 0 to disable.
+ *
+ * @return 0, successful; < 0, failed, the value is error code.
+ */
+int IOT_OTA_SetCheckpoint(void *handle, uint32_t interval);
+
+
+/**
+ * @brief Set the timeouts of the download. A fetch call which gets no data returns 0 and keeps the
+ *        connection, which is dropped after @config->idle_timeout_ms without data, and the rest of the
+ *        file asked for with a Range request on a new one. A call returns once it has the bytes the
+ *        rate measured brings in @config->read_time_ms, so that a large buffer does not make it wait
+ *        for its timeout on a slow link. It may be called at any time after IOT_OTA_Init(), and
+ *        applies to the next fetch call; IOT_OTAG_FETCH_STATS tells what the download looks like.
+ *
+ * @param [in] handle, specify the OTA module.
+ * @param [in] config, specify the timeouts, it is copied.
+ *
+ * @return 0, successful; < 0, failed, the value is error code.
+ */
+int IOT_OTA_SetFetchConfig(void *handle, const IOT_OTA_FetchConfig_t *config);
+
+
+/**
+ * @brief Check every block of the firmware against its SHA-256 in a signed manifest as soon as it is
+ *        fetched. A block which does not match is fetched again, up to 5 times, and the data of the
+ *        next calls go at IOT_OTAG_FETCHED_SIZE again, so the application must be able to write at
+ *        any offset of the file. The hash of the whole file is not computed then.
+ *        It must be called after IOT_OTA_IsFetching() is true and before anything is fetched, and
+ *        again after a reboot when the download goes on from a checkpoint. With
+ *        IOT_OTA_PipelineSegments(), a buffer of the pipeline must hold a block at least.
+ *
+   @verbatim
+      The manifest is, integers in big endian:
+          "OTAM"                    4 bytes
+          block length              4 bytes
+          file size                 4 bytes
+          SHA-256 of every block    32 bytes * (file size + block length - 1) / block length
+          signature                 the rest, checked by @verifier
+   @endverbatim
+ *
+ * @param [in] handle, specify the OTA module.
+ * @param [in] manifest, specify the manifest, it is copied.
+ * @param [in] manifest_len, specify the length of @manifest in bytes.
+ * @param [in] verifier, specify how the signature is checked.
+ *
+ * @return 0, successful; < 0, failed, the value is error code.
+ */
+int IOT_OTA_SetManifest(void *handle, const char *manifest, uint32_t manifest_len,
+                        const IOT_OTA_Verifier_t *verifier);
+
+
+/**
+ * @brief Initialize a patcher which builds the new firmware into @sink from a patch and the running
+ *        firmware read from @source, when IOT_OTAG_IS_DIFF is 1. The patch is given to
+ *        IOT_OTA_PatchWrite() as it is fetched, so it may be the sink of IOT_OTA_PipelineInit().
+ *        It needs @buf_len bytes besides its state whatever the size of the firmware. Before the
+ *        first byte is written, the whole running firmware is read once to check it is the one the
+ *        patch is made from. A patch is applied from byte 0 to the end in order, so it cannot go on
+ *        from a checkpoint or with a manifest.
+ *
+   @verbatim
+      The patch is, integers of the header in big endian:
+          "OTAD"                        4 bytes
+          size of running firmware      4 bytes
+          size of new firmware          4 bytes
+          SHA-256 of running firmware   32 bytes
+          SHA-256 of new firmware       32 bytes
+          ops, till the end op:
+              0 end
+              1 copy, offset, length    copy from the running firmware, the offset is added to the
+                                        end of the last copy, it is a zigzag encoded signed integer
+              2 insert, length, bytes   copy the bytes from the patch
+      The offsets and lengths of the ops are unsigned LEB128 varints.
+   @endverbatim
+ *
+ * @param [in] source, specify where the running firmware is read.
+ * @param [in] sink, specify where the new firmware is written.
+ * @param [in] buf_len, specify the length in bytes of the buffer of the reads.
+ *
+ * @return handle of the patcher; NULL, failed.
+ */
+void *IOT_OTA_PatchInit(const IOT_OTA_Source_t *source, const IOT_OTA_Sink_t *sink, uint32_t buf_len);
+
+
+/**
+ * @brief Apply the next @len bytes of the patch, at @offset of it, as an IOT_OTA_Sink_t would.
+ *
+ * @param [in] handle, specify the patcher.
+ * @param [in] offset, specify the offset of @buf in the patch, the offsets follow each other.
+ * @param [in] buf, specify the bytes of the patch.
+ * @param [in] len, specify the length of @buf in bytes.
+ *
+ * @return 0, successful; < 0, failed, the value is error code, the patcher is unusable then.
+ */
+int IOT_OTA_PatchWrite(void *handle, uint32_t offset, const char *buf, uint32_t len);
+
+
+/**
+ * @brief Check the new firmware once the whole patch is written.
+ *
+ * @param [in] handle, specify the patcher.
+ *
+ * @return 0, the new firmware is complete and matches its SHA-256 in the patch;
+ *         < 0, failed, the value is error code.
+ */
+int IOT_OTA_PatchFinish(void *handle);
+
+
+/**
+ * @brief Deinitialize the patcher and release the resource.
+ *
+ * @param [in] handle, specify the patcher.
+ *
+ * @return 0, successful; < 0, failed, the value is error code.
+ */
+int IOT_OTA_PatchDeinit(void *handle);
+
+
 /**
  * @brief Get last error code.
  *
@@ -45,8 +45,29 @@ typedef enum {
     IOTX_SHADOW_NULL,
     IOTX_SHADOW_INT32,
     IOTX_SHADOW_STRING,
+    IOTX_SHADOW_INT64,      /* int64_t */
+    IOTX_SHADOW_FLOAT,      /* float, reported with the fewest digits which read back to it, 9 at most */
+    IOTX_SHADOW_DOUBLE,     /* double, reported with the fewest digits which read back to it, 17 at most */
+    IOTX_SHADOW_BOOL,       /* bool, reported as true or false */
+    IOTX_SHADOW_BINARY,     /* iotx_shadow_binary_t, reported as a base64 string */
+    IOTX_SHADOW_ARRAY,      /* iotx_shadow_array_t of numbers or bools */
 } iotx_shadow_attr_datatype_t;
 
+/* data of an IOTX_SHADOW_BINARY attribute */
+typedef struct {
+    uint8_t *pbuf;
+    uint32_t size;          /* size of @pbuf */
+    uint32_t len;           /* bytes of @pbuf in use */
+} iotx_shadow_binary_t, *iotx_shadow_binary_pt;
+
+/* data of an IOTX_SHADOW_ARRAY attribute */
+typedef struct {
+    iotx_shadow_attr_datatype_t item_type;  /* INT32, INT64, FLOAT, DOUBLE or BOOL */
+    void *pitems;
+    uint32_t size;          /* number of items @pitems can hold */
+    uint32_t count;         /* items of @pitems in use */
+} iotx_shadow_array_t, *iotx_shadow_array_pt;
+
 typedef struct {
     bool flag_new;
     uint32_t buf_size;
@@ -75,12 +96,43 @@ typedef struct iotx_shadow_attr_st {
     iotx_shadow_attr_datatype_t attr_type;  /* data type */
     uint32_t timestamp;                     /* timestamp in Epoch(Unix) format */
     iotx_shadow_attr_cb_t callback;         /* callback when related control message come. */
+    uint32_t data_size;                     /* size of the buffer of a STRING attribute, 0 if unknown */
 } iotx_shadow_attr_t, *iotx_shadow_attr_pt;
 
+/* encoding of the documents on the shadow topics, the API takes and gives JSON in both cases */
+typedef enum {
+    IOTX_SHADOW_FORMAT_JSON,
+    IOTX_SHADOW_FORMAT_CBOR,    /* RFC 7049, for a cloud side which decodes CBOR on the shadow topics */
+} iotx_shadow_format_t;
+
 typedef struct {
     iotx_mqtt_param_t mqtt;
+    iotx_shadow_format_t format;
 } iotx_shadow_para_t, *iotx_shadow_para_pt;
 
+typedef struct {
+    uint32_t reports;           /* reports published by IOT_Shadow_Yield() */
+    uint32_t acked;             /* reports acknowledged by cloud */
+    uint32_t attrs_sent;        /* attributes carried by those reports */
+    uint32_t attrs_suppressed;  /* changes not sent since cloud already holds the value */
+    uint32_t bytes_sent;        /* bytes of those reports */
+    uint32_t bytes_saved;       /* bytes of "name":value left out, against reporting every attribute each time */
+} iotx_shadow_report_stats_t, *iotx_shadow_report_stats_pt;
+
+#define IOTX_SHADOW_ACK_LATENCY_BUCKETS     (8)
+
+typedef struct {
+    uint32_t pending;           /* updates waiting for ACK now */
+    uint32_t pending_max;       /* the most updates ever waiting at once */
+    uint32_t acked;
+    uint32_t timeouts;
+    uint32_t overflows;         /* updates refused since too many were waiting */
+    uint32_t latency_min_ms;
+    uint32_t latency_max_ms;
+    uint32_t latency_avg_ms;
+    uint32_t latency_hist[IOTX_SHADOW_ACK_LATENCY_BUCKETS]; /* <50, <100, <200, <500, <1000, <2000, <5000, more ms */
+} iotx_shadow_ack_stats_t, *iotx_shadow_ack_stats_pt;
+
 /**
  * @brief Construct the Device Shadow
  *        This function initialize the data structures, establish MQTT connection
@@ -146,4 +198,30 @@ int IOT_Shadow_Push_Async(
 
 /* Synchronize device shadow data from cloud. It is a synchronous interface. */
 iotx_err_t IOT_Shadow_Pull(void *handle);
+
+
+/**
+ * @brief Mark a registered attribute as changed after its data was modified.
+ *        IOT_Shadow_Yield() reports the changed attributes only, all the changes made
+ *        within the report window of the first one go in one update. A change back to
+ *        the value cloud acknowledged is dropped unless the shadow version moved since.
+ *
+ * @param handle, The device shadow.
+ * @param pattr, The attribute registered by IOT_Shadow_RegisterAttribute().
+ *
+ * @return SUCCESS_RETURN, or ERROR_SHADOW_ATTR_NO_EXIST if it is not registered.
+ */
+iotx_err_t IOT_Shadow_MarkDirty(void *handle, iotx_shadow_attr_pt pattr);
+
+
+/* Set how long changes are coalesced before they are reported, 0 reports at the next yield. */
+iotx_err_t IOT_Shadow_SetReportWindow(void *handle, uint32_t window_ms);
+
+
+/* Get the statistics of the reports made for IOT_Shadow_MarkDirty() */
+iotx_err_t IOT_Shadow_GetReportStats(void *handle, iotx_shadow_report_stats_pt pstats);
+
+
+/* Get the number of updates waiting for ACK and the distribution of ACK latency */
+iotx_err_t IOT_Shadow_GetAckStats(void *handle, iotx_shadow_ack_stats_pt pstats);
 /* From shadow.h */
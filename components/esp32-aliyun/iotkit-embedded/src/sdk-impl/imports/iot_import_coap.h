@@ -23,6 +23,13 @@
 
 #define NETWORK_ADDR_LEN      (16)
 
+/* One slot of a batched UDP read */
+typedef struct {
+    unsigned char   *p_data;
+    unsigned int     datalen;   /* size of p_data */
+    unsigned int     len;       /* length of the datagram received into p_data */
+} udp_datagram_t;
+
 
 #define coap_malloc(size) HAL_Malloc(size)
 #define coap_free(ptr)    HAL_Free(ptr)
@@ -35,6 +42,14 @@ int   HAL_UDP_read(void         *p_socket, unsigned char   *p_data, unsigned int
 int   HAL_UDP_readTimeout( void *p_socket,unsigned char  *p_data,
                 unsigned int datalen,     unsigned int timeout );
 
+/*
+ * Wait up to @timeout ms for the first datagram like HAL_UDP_readTimeout(), then
+ * take the datagrams already queued on the socket without waiting, at most @count.
+ * Returns the number of slots filled, or the negative HAL_UDP_readTimeout() codes.
+ */
+int   HAL_UDP_readBatchTimeout(void *p_socket, udp_datagram_t *p_grams,
+                unsigned int count, unsigned int timeout);
+
 int HAL_UDP_resolveAddress(const char *p_host,  char addr[NETWORK_ADDR_LEN]);
 
 
@@ -49,12 +49,26 @@
 #define DTLS_PEER_CLOSE_NOTIFY         (DTLS_ERROR_BASE | 6)
 #define DTLS_SESSION_CREATE_FAILED     (DTLS_ERROR_BASE | 7)
 #define DTLS_READ_DATA_FAILED          (DTLS_ERROR_BASE | 8)
+#define DTLS_SESSION_SAVE_FAILED       (DTLS_ERROR_BASE | 9)
 
 
+/* What the last handshake of a session cost */
+typedef struct {
+    unsigned int               bytes_sent;     /* handshake records written, retransmissions included */
+    unsigned int               bytes_recv;
+    unsigned int               round_trips;    /* flights answered by the server */
+    unsigned int               time_ms;
+    unsigned char              resumed;        /* abbreviated handshake from p_session */
+    unsigned char              cid;            /* the server uses a Connection ID for us */
+} dtls_handshake_stats_t;
+
 typedef struct {
     unsigned char             *p_ca_cert_pem;
     char                      *p_host;
     unsigned short             port;
+    const unsigned char       *p_session;      /* from HAL_DTLSSession_save(), NULL for a full handshake */
+    unsigned int               session_len;
+    dtls_handshake_stats_t    *p_stats;        /* can be NULL */
 } coap_dtls_options_t;
 
 
@@ -74,5 +88,15 @@ unsigned int HAL_DTLSSession_read(DTLSContext *context,
 
 unsigned int HAL_DTLSSession_free(DTLSContext *context);
 
+/*
+ * Serialize what an abbreviated handshake needs (session id or ticket and the
+ * master secret) into @p_buf. Pass it back as coap_dtls_options_t.p_session,
+ * also after a reboot if it was kept in flash, to skip the full handshake.
+ * The state is as secret as a key. On input *p_len is the size of @p_buf.
+ */
+unsigned int HAL_DTLSSession_save(DTLSContext *context,
+                                  unsigned char   *p_buf,
+                                  unsigned int    *p_len);
+
 
 #endif
@@ -25,6 +25,7 @@
 #include "lite-log.h"
 #include "json_parser.h"
 #include "utils_md5.h"
+#include "utils_sha256.h"
 #include "utils_debug.h"
 #include "utils_httpc.h"
 
@@ -27,6 +27,21 @@ int main(int argc, char *argv[])
 
     unittest_string_utils();
     unittest_json_token();
+    if (0 != unittest_cbor()) {
+        return -1;
+    }
+    if (0 != unittest_json_tokenizer()) {
+        return -1;
+    }
+    if (0 != unittest_json_path()) {
+        return -1;
+    }
+    if (0 != unittest_json_writer()) {
+        return -1;
+    }
+    if (0 != unittest_json_keys()) {
+        return -1;
+    }
 
 #ifdef MQTT_ID2_AUTH
     uint64_t    fake_timestamp = 1493274903;
@@ -1,2 +1,3 @@
 LIBA_TARGET := libshadow.a
+LIB_SRCS    := $(wildcard *.c)
 HDR_REFS    := src
@@ -26,6 +26,8 @@
 #include "shadow_common.h"
 #include "shadow_update.h"
 #include "shadow_delta.h"
+#include "shadow_parser.h"
+#include "shadow_report.h"
 
 
 /* check return code */
@@ -57,52 +59,70 @@ static void iotx_ds_handle_expire(iotx_shadow_pt pshadow)
 /* This function will be called back when message published to topic(/shadow/get/) arrives. */
 static void iotx_shadow_callback_get(iotx_shadow_pt pshadow, void *pclient, iotx_mqtt_event_msg_pt msg)
 {
-    const char *pname;
+    int index, len;
+    char *pdoc = NULL;
+    iotx_ds_json_t json;
 
     iotx_mqtt_topic_info_pt topic_info = (iotx_mqtt_topic_info_pt)msg->msg;
 
     log_debug("topic=%.*s", topic_info->topic_len, topic_info->ptopic);
-    log_debug("data of topic=%.*s", topic_info->payload_len, (char *)topic_info->payload);
+
+    if (IOTX_SHADOW_FORMAT_CBOR == pshadow->inner_data.format) {
+        /* the handlers work on JSON text, convert the CBOR document once */
+        len = LITE_cbor_to_json((const uint8_t *)topic_info->payload, topic_info->payload_len, NULL, 0);
+        if ((len <= 0) || (NULL == (pdoc = LITE_malloc(len + 1)))) {
+            log_err("Invalid CBOR document");
+            return;
+        }
+        LITE_cbor_to_json((const uint8_t *)topic_info->payload, topic_info->payload_len, pdoc, len + 1);
+    } else {
+        pdoc = (char *)topic_info->payload;
+        len = topic_info->payload_len;
+    }
+
+    log_debug("data of topic=%.*s", len, pdoc);
+
+    /* tokenize once, every lookup below and in the handlers is answered from the index */
+    if (SUCCESS_RETURN != iotx_ds_json_parse(&json, pdoc, len)) {
+        iotx_ds_json_release(&json);
+        if (pdoc != topic_info->payload) {
+            LITE_free(pdoc);
+        }
+        return;
+    }
 
     /* update time if there is 'timestamp' key in JSON string */
-    pname = LITE_json_value_of((char *)"timestamp", (char *)topic_info->payload);
-    if (NULL != pname) {
-        iotx_ds_common_update_time(pshadow, atoi(pname));
+    index = iotx_ds_json_find(&json, 0, "timestamp", strlen("timestamp"));
+    if (index >= 0) {
+        iotx_ds_common_update_time(pshadow, iotx_ds_json_value_uint32(&json, index));
     }
-    LITE_free(pname);
 
     /* update 'version' if there is 'version' key in JSON string */
-    pname = LITE_json_value_of((char *)"version", (char *)topic_info->payload);
-    if (NULL != pname) {
-        iotx_ds_common_update_version(pshadow, atoi(pname));
-        LITE_free(pname);
+    index = iotx_ds_json_find(&json, 0, "version", strlen("version"));
+    if (index >= 0) {
+        iotx_ds_common_update_version(pshadow, iotx_ds_json_value_uint32(&json, index));
     }
 
     /* get 'method' */
-    pname = LITE_json_value_of((char *)"method", (char *)topic_info->payload);
-    /* log_debug("pname(%d) = %s", (int)strlen(pname), pname); */
-    if (NULL == pname) {
+    index = iotx_ds_json_find(&json, 0, "method", strlen("method"));
+    if (index < 0) {
         log_err("Invalid JSON document: not 'method' key");
-    } else if ((strlen("control") == strlen(pname)) && !strcmp(pname, "control")) {
+    } else if (iotx_ds_json_value_equal(&json, index, "control")) {
         /* call delta handle function */
         log_debug("receive 'control' method");
 
-        iotx_shadow_delta_entry(
-                    pshadow,
-                    topic_info->payload,
-                    topic_info->payload_len);
-        LITE_free(pname);
-    } else if ((strlen("reply") == strlen(pname)) && !strcmp(pname, "reply")) {
+        iotx_shadow_delta_entry(pshadow, &json);
+    } else if (iotx_ds_json_value_equal(&json, index, "reply")) {
         /* call update ACK handle function. */
         log_debug("receive 'reply' method");
-        iotx_ds_update_wait_ack_list_handle_response(
-                    pshadow,
-                    topic_info->payload,
-                    topic_info->payload_len);
-        LITE_free(pname);
+        iotx_ds_update_wait_ack_list_handle_response(pshadow, &json);
     } else {
         log_err("Invalid 'method' key");
-        LITE_free(pname);
+    }
+
+    iotx_ds_json_release(&json);
+    if (pdoc != topic_info->payload) {
+        LITE_free(pdoc);
     }
 
     log_debug("End of method handle");
@@ -159,7 +179,8 @@ int IOT_Shadow_Push_Async(
 {
     int rc = SUCCESS_RETURN;
     iotx_update_ack_wait_list_pt pelement;
-    const char *ptoken;
+    lite_json_path_t path;
+    lite_json_slice_t token;
     iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
 
     if ((NULL == handle) || (NULL == data)) {
@@ -174,16 +195,15 @@ int IOT_Shadow_Push_Async(
     /*Add to callback list */
 
     log_debug("data(%d) = %s", (int)data_len, data);
-    ptoken = LITE_json_value_of((char *)"clientToken", (char *)data);
+    LITE_json_path_compile(&path, "clientToken");
+    LITE_json_path_extract(data, data_len, &path, 1, &token);
 
-    IOTX_ASSERT(NULL != ptoken, "Token should always exist.");
+    IOTX_ASSERT(NULL != token.value, "Token should always exist.");
 
-    pelement = iotx_shadow_update_wait_ack_list_add(pshadow, ptoken, strlen(ptoken), cb_fpt, pcontext, timeout_s);
+    pelement = iotx_shadow_update_wait_ack_list_add(pshadow, token.value, token.len, cb_fpt, pcontext, timeout_s);
     if (NULL == pelement) {
-        LITE_free(ptoken);
         return ERROR_SHADOW_WAIT_LIST_OVERFLOW;
     }
-    LITE_free(ptoken);
 
     if ((rc = iotx_ds_common_publish2update(pshadow, data, data_len)) < 0) {
         iotx_shadow_update_wait_ack_list_remove(pshadow, pelement);
@@ -219,6 +239,7 @@ iotx_err_t IOT_Shadow_Push(
             uint32_t data_len,
             uint16_t timeout_s)
 {
+    int rc;
     iotx_shadow_ack_code_t ack_update = IOTX_SHADOW_ACK_NONE;
     iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
 
@@ -232,7 +253,11 @@ iotx_err_t IOT_Shadow_Push(
     }
 
     /* update asynchronously */
-    IOT_Shadow_Push_Async(pshadow, data, data_len, timeout_s, iotx_update_ack_cb, &ack_update);
+    rc = IOT_Shadow_Push_Async(pshadow, data, data_len, timeout_s, iotx_update_ack_cb, &ack_update);
+    if (SUCCESS_RETURN != rc) {
+        /* nothing is waiting for ACK */
+        return rc;
+    }
 
     /* wait ACK */
     while (IOTX_SHADOW_ACK_NONE == ack_update) {
@@ -343,6 +368,7 @@ void *IOT_Shadow_Construct(iotx_shadow_para_pt pparams)
         return NULL;
     }
     memset(pshadow, 0x0, sizeof(iotx_shadow_t));
+    pshadow->inner_data.format = pparams->format;
 
     if (NULL == (pshadow->mutex = HAL_MutexCreate())) {
         log_err("create mutex failed");
@@ -377,11 +403,11 @@ void *IOT_Shadow_Construct(iotx_shadow_para_pt pparams)
     }
 
 
-    pshadow->inner_data.attr_list = list_new();
-    if (NULL == pshadow->inner_data.attr_list) {
-        log_err("new list failed");
+    if (SUCCESS_RETURN != iotx_ds_common_attr_table_init(pshadow)) {
+        log_err("new attribute table failed");
         goto do_exit;
     }
+    iotx_ds_report_init(pshadow);
 
     return pshadow;
 
@@ -397,6 +423,7 @@ void IOT_Shadow_Yield(void *handle, uint32_t timeout)
     iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
     IOT_MQTT_Yield(pshadow->mqtt, timeout);
     iotx_ds_handle_expire(pshadow);
+    iotx_ds_report_handle(pshadow);
 }
 
 
@@ -421,9 +448,8 @@ iotx_err_t IOT_Shadow_Destroy(void *handle)
         LITE_free(pshadow->inner_data.ptopic_update);
     }
 
-    if (NULL != pshadow->inner_data.attr_list) {
-        list_destroy(pshadow->inner_data.attr_list);
-    }
+    iotx_ds_common_attr_table_release(pshadow);
+    iotx_ds_update_wait_ack_list_release(pshadow);
 
     if (NULL != pshadow->mutex) {
         HAL_MutexDestroy(pshadow->mutex);
@@ -469,7 +495,7 @@ iotx_err_t IOT_Shadow_DeleteAttribute(void *handle, iotx_shadow_attr_pt pattr)
         return ERROR_NO_MEM;
     }
 
-    iotx_ds_common_format_init(pshadow, &format, buf, SHADOW_DELETE_MSG_SIZE, "delete", ",\"state\":{\"reported\":{");
+    iotx_ds_common_format_init(pshadow, &format, buf, SHADOW_DELETE_MSG_SIZE, "delete", "\"state\":{\"reported\":{");
     iotx_ds_common_format_add(pshadow, &format, pattr->pattr_name, NULL, IOTX_SHADOW_NULL);
     iotx_ds_common_format_finalize(pshadow, &format, "}}");
 
@@ -485,3 +511,57 @@ iotx_err_t IOT_Shadow_DeleteAttribute(void *handle, iotx_shadow_attr_pt pattr)
 
 #undef SHADOW_DELETE_MSG_SIZE
 }
+
+
+iotx_err_t IOT_Shadow_MarkDirty(void *handle, iotx_shadow_attr_pt pattr)
+{
+    if ((NULL == handle) || (NULL == pattr)) {
+        return NULL_VALUE_ERROR;
+    }
+
+    return iotx_ds_report_mark((iotx_shadow_pt)handle, pattr);
+}
+
+
+iotx_err_t IOT_Shadow_SetReportWindow(void *handle, uint32_t window_ms)
+{
+    iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
+
+    if (NULL == pshadow) {
+        return NULL_VALUE_ERROR;
+    }
+
+    HAL_MutexLock(pshadow->mutex);
+    pshadow->inner_data.report.window_ms = window_ms;
+    HAL_MutexUnlock(pshadow->mutex);
+
+    return SUCCESS_RETURN;
+}
+
+
+iotx_err_t IOT_Shadow_GetReportStats(void *handle, iotx_shadow_report_stats_pt pstats)
+{
+    iotx_shadow_pt pshadow = (iotx_shadow_pt)handle;
+
+    if ((NULL == pshadow) || (NULL == pstats)) {
+        return NULL_VALUE_ERROR;
+    }
+
+    HAL_MutexLock(pshadow->mutex);
+    memcpy(pstats, &pshadow->inner_data.report.stats, sizeof(iotx_shadow_report_stats_t));
+    HAL_MutexUnlock(pshadow->mutex);
+
+    return SUCCESS_RETURN;
+}
+
+
+iotx_err_t IOT_Shadow_GetAckStats(void *handle, iotx_shadow_ack_stats_pt pstats)
+{
+    if ((NULL == handle) || (NULL == pstats)) {
+        return NULL_VALUE_ERROR;
+    }
+
+    iotx_ds_update_wait_ack_list_get_stats((iotx_shadow_pt)handle, pstats);
+
+    return SUCCESS_RETURN;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include "iot_import.h"
+#include "lite-log.h"
+#include "lite-utils.h"
+#include "shadow_codec.h"
+#include "shadow_cbor.h"
+
+/* JSON strings and CBOR text differ by the escapes only, which are rare in shadow documents */
+static int iotx_ds_cbor_put_string(lite_cbor_writer_t *pwriter, const char *str, uint32_t len)
+{
+    uint32_t i, out = 0, code, low;
+    char *ptext;
+
+    if (NULL == memchr(str, '\\', len)) {
+        LITE_cbor_put_text(pwriter, str, len);
+        return SUCCESS_RETURN;
+    }
+
+    /* unescaped text is never longer */
+    ptext = LITE_malloc(len);
+    if (NULL == ptext) {
+        return FAIL_RETURN;
+    }
+
+    for (i = 0; i < len; ++i) {
+        if (('\\' != str[i]) || (i + 1 >= len)) {
+            ptext[out++] = str[i];
+            continue;
+        }
+
+        switch (str[++i]) {
+            case 'b':
+                ptext[out++] = '\b';
+                break;
+            case 'f':
+                ptext[out++] = '\f';
+                break;
+            case 'n':
+                ptext[out++] = '\n';
+                break;
+            case 'r':
+                ptext[out++] = '\r';
+                break;
+            case 't':
+                ptext[out++] = '\t';
+                break;
+            case 'u':
+                if ((i + 4 >= len) || (1 != sscanf(str + i + 1, "%4x", &code))) {
+                    LITE_free(ptext);
+                    return FAIL_RETURN;
+                }
+                i += 4;
+                /* a surrogate pair makes one code point */
+                if ((code >= 0xD800) && (code < 0xDC00) && (i + 6 < len) && ('\\' == str[i + 1])
+                    && ('u' == str[i + 2]) && (1 == sscanf(str + i + 3, "%4x", &low))
+                    && (low >= 0xDC00) && (low < 0xE000)) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+                if (code < 0x80) {
+                    ptext[out++] = (char)code;
+                } else if (code < 0x800) {
+                    ptext[out++] = (char)(0xC0 | (code >> 6));
+                    ptext[out++] = (char)(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    ptext[out++] = (char)(0xE0 | (code >> 12));
+                    ptext[out++] = (char)(0x80 | ((code >> 6) & 0x3F));
+                    ptext[out++] = (char)(0x80 | (code & 0x3F));
+                } else {
+                    ptext[out++] = (char)(0xF0 | (code >> 18));
+                    ptext[out++] = (char)(0x80 | ((code >> 12) & 0x3F));
+                    ptext[out++] = (char)(0x80 | ((code >> 6) & 0x3F));
+                    ptext[out++] = (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            default:
+                /* \" \\ \/ */
+                ptext[out++] = str[i];
+                break;
+        }
+    }
+
+    LITE_cbor_put_text(pwriter, ptext, out);
+    LITE_free(ptext);
+
+    return SUCCESS_RETURN;
+}
+
+
+static int iotx_ds_cbor_put_number(lite_cbor_writer_t *pwriter, const char *str, uint32_t len)
+{
+    int64_t integer;
+    double real;
+
+    if ((NULL == memchr(str, '.', len)) && (NULL == memchr(str, 'e', len)) && (NULL == memchr(str, 'E', len))
+        && (SUCCESS_RETURN == iotx_ds_codec_parse_int64(str, len, &integer))) {
+        LITE_cbor_put_int(pwriter, integer);
+        return SUCCESS_RETURN;
+    }
+
+    /* fractions, exponents and integers beyond int64 */
+    if (SUCCESS_RETURN != iotx_ds_codec_parse_double(str, len, &real)) {
+        return FAIL_RETURN;
+    }
+    LITE_cbor_put_double(pwriter, real);
+
+    return SUCCESS_RETURN;
+}
+
+
+int iotx_ds_cbor_from_json(const iotx_ds_json_t *pjson, uint8_t *buf, uint32_t size)
+{
+    int index, depth = 0, rc = SUCCESS_RETURN;
+    int remaining[IOTX_DS_JSON_MAX_DEPTH + 1];
+    bool in_object[IOTX_DS_JSON_MAX_DEPTH + 1];
+    const iotx_ds_json_token_t *ptoken;
+    lite_cbor_writer_t writer;
+
+    LITE_cbor_writer_init(&writer, buf, size);
+
+    /* tokens are in document order, the CBOR items are written in the same order */
+    for (index = 0; (index < pjson->count) && (SUCCESS_RETURN == rc); ++index) {
+        ptoken = &pjson->tokens[index];
+
+        while ((depth > 0) && (0 == remaining[depth - 1])) {
+            --depth;
+        }
+        if (depth > 0) {
+            --remaining[depth - 1];
+            if (in_object[depth - 1]) {
+                rc = iotx_ds_cbor_put_string(&writer, pjson->doc + ptoken->key, ptoken->key_len);
+            }
+        }
+
+        switch (ptoken->type) {
+            case IOTX_DS_JSON_OBJECT:
+            case IOTX_DS_JSON_ARRAY:
+                if (depth > IOTX_DS_JSON_MAX_DEPTH) {
+                    return -1;
+                }
+                in_object[depth] = (IOTX_DS_JSON_OBJECT == ptoken->type);
+                remaining[depth++] = ptoken->size;
+                if (IOTX_DS_JSON_OBJECT == ptoken->type) {
+                    LITE_cbor_put_map(&writer, ptoken->size);
+                } else {
+                    LITE_cbor_put_array(&writer, ptoken->size);
+                }
+                break;
+            case IOTX_DS_JSON_STRING:
+                rc = iotx_ds_cbor_put_string(&writer, pjson->doc + ptoken->value, ptoken->value_len);
+                break;
+            case IOTX_DS_JSON_NUMBER:
+                rc = iotx_ds_cbor_put_number(&writer, pjson->doc + ptoken->value, ptoken->value_len);
+                break;
+            case IOTX_DS_JSON_BOOLEAN:
+                LITE_cbor_put_bool(&writer, 't' == pjson->doc[ptoken->value]);
+                break;
+            default:
+                LITE_cbor_put_null(&writer);
+                break;
+        }
+    }
+
+    if (SUCCESS_RETURN != rc) {
+        log_err("JSON document can not be converted to CBOR");
+        return -1;
+    }
+
+    return (int)writer.offset;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#ifndef _IOTX_SHADOW_CBOR_H_
+#define _IOTX_SHADOW_CBOR_H_
+
+#include "iot_import.h"
+#include "shadow_parser.h"
+
+/* encode the parsed JSON document @pjson as CBOR to @buf of @size bytes.
+ * Return the CBOR length, larger than @size if it does not fit, or -1 on error. */
+int iotx_ds_cbor_from_json(const iotx_ds_json_t *pjson, uint8_t *buf, uint32_t size);
+
+#endif /* _IOTX_SHADOW_CBOR_H_ */
@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include <stdlib.h>
+
+#include "iot_import.h"
+#include "lite-log.h"
+#include "utils_base64.h"
+#include "shadow_codec.h"
+
+/* numbers are formatted by LITE_json_format_int() and LITE_json_format_real(), as the JSON writer does */
+
+
+iotx_err_t iotx_ds_codec_parse_int64(const char *buf, uint32_t buf_len, int64_t *pvalue)
+{
+    uint32_t pos = 0;
+    uint64_t value = 0, limit = (uint64_t)INT64_MAX;
+    bool negative = false;
+
+    if ((pos < buf_len) && ('-' == buf[pos])) {
+        negative = true;
+        limit += 1;
+        ++pos;
+    }
+
+    if ((pos >= buf_len) || (buf[pos] < '0') || (buf[pos] > '9')) {
+        return FAIL_RETURN;
+    }
+
+    for (; (pos < buf_len) && (buf[pos] >= '0') && (buf[pos] <= '9'); ++pos) {
+        if (value > (limit - (buf[pos] - '0')) / 10) {
+            return FAIL_RETURN;
+        }
+        value = value * 10 + (buf[pos] - '0');
+    }
+
+    /* "12.0" is an integer sent by a loosely typed client, the fraction is dropped */
+    if ((pos < buf_len) && ('.' == buf[pos])) {
+        for (++pos; (pos < buf_len) && (buf[pos] >= '0') && (buf[pos] <= '9'); ++pos);
+    }
+
+    if (pos != buf_len) {
+        return FAIL_RETURN;
+    }
+
+    *pvalue = negative ? (int64_t)((uint64_t)0 - value) : (int64_t)value;
+
+    return SUCCESS_RETURN;
+}
+
+
+iotx_err_t iotx_ds_codec_parse_double(const char *buf, uint32_t buf_len, double *pvalue)
+{
+    char number[IOTX_DS_CODEC_NUMBER_LEN * 2];
+    char *pend;
+
+    /* @buf is not terminated, strtod() needs a copy */
+    if ((0 == buf_len) || (buf_len >= sizeof(number))) {
+        return FAIL_RETURN;
+    }
+    memcpy(number, buf, buf_len);
+    number[buf_len] = '\0';
+
+    *pvalue = strtod(number, &pend);
+    if (pend != number + buf_len) {
+        return FAIL_RETURN;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+
+static bool iotx_ds_codec_is_literal(const char *buf, uint32_t buf_len, const char *literal)
+{
+    return (strlen(literal) == buf_len) && (0 == memcmp(buf, literal, buf_len));
+}
+
+
+static uint32_t iotx_ds_codec_item_size(iotx_shadow_attr_datatype_t type)
+{
+    switch (type) {
+        case IOTX_SHADOW_INT32:
+            return sizeof(int32_t);
+        case IOTX_SHADOW_INT64:
+            return sizeof(int64_t);
+        case IOTX_SHADOW_FLOAT:
+            return sizeof(float);
+        case IOTX_SHADOW_DOUBLE:
+            return sizeof(double);
+        case IOTX_SHADOW_BOOL:
+            return sizeof(bool);
+        default:
+            return 0;
+    }
+}
+
+
+/* encode a number or bool to @buf of IOTX_DS_CODEC_NUMBER_LEN bytes */
+static int iotx_ds_codec_encode_scalar(char *buf, iotx_shadow_attr_datatype_t type, const void *pdata)
+{
+    switch (type) {
+        case IOTX_SHADOW_INT32:
+            return LITE_json_format_int(buf, *(const int32_t *)pdata);
+        case IOTX_SHADOW_INT64:
+            return LITE_json_format_int(buf, *(const int64_t *)pdata);
+        case IOTX_SHADOW_FLOAT:
+            return LITE_json_format_real(buf, *(const float *)pdata, 1);
+        case IOTX_SHADOW_DOUBLE:
+            return LITE_json_format_real(buf, *(const double *)pdata, 0);
+        case IOTX_SHADOW_BOOL:
+            if (*(const bool *)pdata) {
+                memcpy(buf, "true", 4);
+                return 4;
+            }
+            memcpy(buf, "false", 5);
+            return 5;
+        default:
+            return -1;
+    }
+}
+
+
+static iotx_err_t iotx_ds_codec_decode_scalar(const char *buf,
+        uint32_t buf_len,
+        iotx_shadow_attr_datatype_t type,
+        void *pdata)
+{
+    int64_t integer;
+    double real;
+
+    if (IOTX_SHADOW_BOOL == type) {
+        if (iotx_ds_codec_is_literal(buf, buf_len, "true") || iotx_ds_codec_is_literal(buf, buf_len, "1")) {
+            *(bool *)pdata = true;
+        } else if (iotx_ds_codec_is_literal(buf, buf_len, "false") || iotx_ds_codec_is_literal(buf, buf_len, "0")
+                   || iotx_ds_codec_is_literal(buf, buf_len, "null")) {
+            *(bool *)pdata = false;
+        } else {
+            return ERROR_SHADOW_INVALID_VALUE;
+        }
+        return SUCCESS_RETURN;
+    }
+
+    if ((IOTX_SHADOW_FLOAT == type) || (IOTX_SHADOW_DOUBLE == type)) {
+        if (iotx_ds_codec_is_literal(buf, buf_len, "null")) {
+            real = 0;
+        } else if (SUCCESS_RETURN != iotx_ds_codec_parse_double(buf, buf_len, &real)) {
+            return ERROR_SHADOW_INVALID_VALUE;
+        }
+
+        if (IOTX_SHADOW_FLOAT == type) {
+            *(float *)pdata = (float)real;
+        } else {
+            *(double *)pdata = real;
+        }
+        return SUCCESS_RETURN;
+    }
+
+    /* integers, the literals as the shadow always accepted them */
+    if (iotx_ds_codec_is_literal(buf, buf_len, "true")) {
+        integer = 1;
+    } else if (iotx_ds_codec_is_literal(buf, buf_len, "false") || iotx_ds_codec_is_literal(buf, buf_len, "null")) {
+        integer = 0;
+    } else if (SUCCESS_RETURN != iotx_ds_codec_parse_int64(buf, buf_len, &integer)) {
+        return ERROR_SHADOW_INVALID_VALUE;
+    }
+
+    if (IOTX_SHADOW_INT32 == type) {
+        if ((integer > INT32_MAX) || (integer < INT32_MIN)) {
+            return ERROR_SHADOW_INVALID_VALUE;
+        }
+        *(int32_t *)pdata = (int32_t)integer;
+    } else if (IOTX_SHADOW_INT64 == type) {
+        *(int64_t *)pdata = integer;
+    } else {
+        return ERROR_SHADOW_UNDEF_TYPE;
+    }
+
+    return SUCCESS_RETURN;
+}
+
+
+static int iotx_ds_codec_write_array(lite_json_writer_t *writer, const iotx_shadow_array_t *parray)
+{
+    uint32_t i, size = iotx_ds_codec_item_size(parray->item_type);
+    int ret;
+    char number[IOTX_DS_CODEC_NUMBER_LEN];
+
+    if ((0 == size) || (parray->count > parray->size) || ((parray->count > 0) && (NULL == parray->pitems))) {
+        return -1;
+    }
+
+    LITE_json_put_array(writer);
+    for (i = 0; i < parray->count; ++i) {
+        ret = iotx_ds_codec_encode_scalar(number, parray->item_type, (const char *)parray->pitems + i * size);
+        if (ret < 0) {
+            return -1;
+        }
+        LITE_json_put_number(writer, number, ret);
+    }
+    LITE_json_put_array_end(writer);
+
+    return 0;
+}
+
+
+static iotx_err_t iotx_ds_codec_decode_array(const char *buf, uint32_t buf_len, iotx_shadow_array_t *parray)
+{
+    uint32_t pos, start, end, count = 0, size = iotx_ds_codec_item_size(parray->item_type);
+    iotx_err_t rc;
+
+    if ((0 == size) || (buf_len < 2) || ('[' != buf[0]) || (']' != buf[buf_len - 1])) {
+        return ERROR_SHADOW_INVALID_VALUE;
+    }
+
+    for (pos = 1; pos < buf_len - 1;) {
+        while ((pos < buf_len - 1) && ((' ' == buf[pos]) || ('\t' == buf[pos])
+                                       || ('\r' == buf[pos]) || ('\n' == buf[pos]))) {
+            ++pos;
+        }
+        if (pos == buf_len - 1) {
+            break;
+        }
+
+        start = pos;
+        while ((pos < buf_len - 1) && (',' != buf[pos])) {
+            ++pos;
+        }
+        for (end = pos; (end > start) && ((' ' == buf[end - 1]) || ('\t' == buf[end - 1])
+                                          || ('\r' == buf[end - 1]) || ('\n' == buf[end - 1])); --end);
+
+        if (count >= parray->size) {
+            log_err("array of %u items at most", parray->size);
+            return ERROR_SHADOW_INVALID_VALUE;
+        }
+
+        rc = iotx_ds_codec_decode_scalar(buf + start, end - start, parray->item_type,
+                                         (char *)parray->pitems + count * size);
+        if (SUCCESS_RETURN != rc) {
+            return rc;
+        }
+        ++count;
+
+        /* skip the comma */
+        if (pos < buf_len - 1) {
+            ++pos;
+        }
+    }
+
+    parray->count = count;
+
+    return SUCCESS_RETURN;
+}
+
+
+int iotx_ds_codec_write(lite_json_writer_t *writer, iotx_shadow_attr_datatype_t type, const void *pdata)
+{
+    int ret;
+    char number[IOTX_DS_CODEC_NUMBER_LEN];
+    const iotx_shadow_binary_t *pbinary;
+
+    if ((IOTX_SHADOW_NULL != type) && (NULL == pdata)) {
+        return -1;
+    }
+
+    switch (type) {
+        case IOTX_SHADOW_NULL:
+            /* the string "null" is what the cloud expects to delete an attribute */
+            LITE_json_put_string(writer, "null", strlen("null"));
+            return 0;
+
+        case IOTX_SHADOW_STRING:
+            LITE_json_put_string(writer, (const char *)pdata, strlen((const char *)pdata));
+            return 0;
+
+        case IOTX_SHADOW_BINARY:
+            pbinary = (const iotx_shadow_binary_t *)pdata;
+            if ((pbinary->len > 0) && (NULL == pbinary->pbuf)) {
+                return -1;
+            }
+            LITE_json_put_base64(writer, pbinary->pbuf, pbinary->len);
+            return 0;
+
+        case IOTX_SHADOW_ARRAY:
+            return iotx_ds_codec_write_array(writer, (const iotx_shadow_array_t *)pdata);
+
+        default:
+            ret = iotx_ds_codec_encode_scalar(number, type, pdata);
+            if (ret < 0) {
+                log_err("Error data type");
+                return -1;
+            }
+            LITE_json_put_number(writer, number, ret);
+            return 0;
+    }
+}
+
+
+int iotx_ds_codec_encode(char *buf, uint32_t buf_len, iotx_shadow_attr_datatype_t type, const void *pdata)
+{
+    lite_json_writer_t writer;
+
+    if ((NULL == buf) || (0 == buf_len)) {
+        return -1;
+    }
+
+    LITE_json_writer_init(&writer, buf, buf_len);
+    if ((0 != iotx_ds_codec_write(&writer, type, pdata)) || writer.overflow) {
+        return -1;
+    }
+
+    return writer.len;
+}
+
+
+uint32_t iotx_ds_codec_encoded_len(iotx_shadow_attr_datatype_t type, const void *pdata)
+{
+    lite_json_writer_t writer;
+
+    /* a dry run */
+    LITE_json_writer_init(&writer, NULL, 0);
+    if (0 != iotx_ds_codec_write(&writer, type, pdata)) {
+        return 0;
+    }
+
+    return writer.len;
+}
+
+
+iotx_err_t iotx_ds_codec_decode(const char *buf,
+                                uint32_t buf_len,
+                                iotx_shadow_attr_datatype_t type,
+                                void *pdata,
+                                uint32_t data_size)
+{
+    uint32_t len;
+    iotx_shadow_binary_t *pbinary;
+
+    if ((NULL == buf) || (NULL == pdata)) {
+        return ERROR_NULL_VALUE;
+    }
+
+    switch (type) {
+        case IOTX_SHADOW_STRING:
+            if ((data_size > 0) && (buf_len >= data_size)) {
+                log_err("string of %u bytes does not fit in %u", buf_len, data_size);
+                return ERROR_SHADOW_INVALID_VALUE;
+            }
+            memcpy(pdata, buf, buf_len);
+            /* of an unknown size, the buffer may have no room for the NUL */
+            if (data_size > 0) {
+                ((char *)pdata)[buf_len] = '\0';
+            }
+            return SUCCESS_RETURN;
+
+        case IOTX_SHADOW_BINARY:
+            pbinary = (iotx_shadow_binary_t *)pdata;
+            len = 0;
+            if ((buf_len > 0)
+                && (SUCCESS_RETURN != utils_base64decode((const uint8_t *)buf, buf_len, pbinary->size,
+                        pbinary->pbuf, &len))) {
+                return ERROR_SHADOW_INVALID_VALUE;
+            }
+            pbinary->len = len;
+            return SUCCESS_RETURN;
+
+        case IOTX_SHADOW_ARRAY:
+            return iotx_ds_codec_decode_array(buf, buf_len, (iotx_shadow_array_t *)pdata);
+
+        case IOTX_SHADOW_INT32:
+        case IOTX_SHADOW_INT64:
+        case IOTX_SHADOW_FLOAT:
+        case IOTX_SHADOW_DOUBLE:
+        case IOTX_SHADOW_BOOL:
+            if (0 == buf_len) {
+                return ERROR_SHADOW_INVALID_VALUE;
+            }
+            return iotx_ds_codec_decode_scalar(buf, buf_len, type, pdata);
+
+        default:
+            log_err("Error data type");
+            return ERROR_SHADOW_UNDEF_TYPE;
+    }
+}
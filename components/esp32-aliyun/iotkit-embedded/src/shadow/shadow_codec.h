@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#ifndef _IOTX_SHADOW_CODEC_H_
+#define _IOTX_SHADOW_CODEC_H_
+
+#include "iot_import.h"
+#include "lite-utils.h"
+#include "shadow.h"
+
+#define IOTX_DS_CODEC_NUMBER_LEN        (LITE_JSON_REAL_LEN)  /**< indicate the buffer size which holds any formatted number, a real is the longest. */
+
+/* parse the number @buf (NOT a string), FAIL_RETURN if it is not one or overflows. */
+iotx_err_t iotx_ds_codec_parse_int64(const char *buf, uint32_t buf_len, int64_t *pvalue);
+
+iotx_err_t iotx_ds_codec_parse_double(const char *buf, uint32_t buf_len, double *pvalue);
+
+/* write the JSON value of @pdata to @writer, return 0, -1 if @type or @pdata is invalid. */
+int iotx_ds_codec_write(lite_json_writer_t *writer, iotx_shadow_attr_datatype_t type, const void *pdata);
+
+/* write the JSON value of @pdata to @buf, NOT NUL-terminated, return its length, -1 if it does not fit. */
+int iotx_ds_codec_encode(char *buf, uint32_t buf_len, iotx_shadow_attr_datatype_t type, const void *pdata);
+
+/* return the length iotx_ds_codec_encode() would write. */
+uint32_t iotx_ds_codec_encoded_len(iotx_shadow_attr_datatype_t type, const void *pdata);
+
+/* parse the JSON value @buf (NOT a string, without the quotes of a string) into @pdata.
+ * @data_size is the size of the buffer of a STRING, which gets NUL terminated;
+ * 0 copies the bytes alone, without check. */
+iotx_err_t iotx_ds_codec_decode(const char *buf,
+                                uint32_t buf_len,
+                                iotx_shadow_attr_datatype_t type,
+                                void *pdata,
+                                uint32_t data_size);
+
+#endif /* _IOTX_SHADOW_CODEC_H_ */
@@ -28,6 +28,9 @@
 
 #include "shadow.h"
 #include "shadow_common.h"
+#include "shadow_parser.h"
+#include "shadow_codec.h"
+#include "shadow_cbor.h"
 
 /* check return code */
 #define CHECK_RETURN_CODE(ret_code) \
@@ -38,15 +41,18 @@
     }while(0);
 
 
-/* check return code of HAL_Snprintf */
-#define CHECK_SNPRINTF_RET(ret_code, buf_len) \
-    do{ \
-        if ((ret_code) < 0) { \
-            return FAIL_RETURN; \
-        } else if ((ret_code) >= (buf_len)) { \
-            return ERROR_NO_ENOUGH_MEM; \
-        } \
-    }while(0);
+/* end the piece of JSON @pwriter wrote at @pformat->offset, it keeps room for the terminator */
+static iotx_err_t iotx_ds_common_format_end(format_data_pt pformat, lite_json_writer_t *pwriter)
+{
+    int ret = LITE_json_writer_finish(pwriter);
+
+    if ((ret < 0) || (ret >= pformat->buf_size - pformat->offset)) {
+        return ERROR_NO_ENOUGH_MEM;
+    }
+    pformat->offset += ret;
+
+    return SUCCESS_RETURN;
+}
 
 
 /* return handle of format data. */
@@ -57,8 +63,8 @@ iotx_err_t iotx_ds_common_format_init(iotx_shadow_pt pshadow,
                                       const char *method,
                                       const char *head_str)
 {
-    int ret;
-    uint32_t size_free_space;
+    lite_json_writer_t writer;
+
     memset(pformat, 0, sizeof(format_data_t));
 
     pformat->buf = buf;
@@ -68,27 +74,19 @@ iotx_err_t iotx_ds_common_format_init(iotx_shadow_pt pshadow,
         return ERROR_SHADOW_NO_METHOD;
     }
 
-    size_free_space = pformat->buf_size;
-
-    ret = HAL_Snprintf(pformat->buf,
-                       size_free_space,
-                       "{\"%s\":\"%s\"",
-                       "method",
-                       method);
-
-    CHECK_SNPRINTF_RET(ret, size_free_space);
-    pformat->offset = ret;
-
+    LITE_json_writer_init(&writer, pformat->buf, pformat->buf_size);
+    LITE_json_put_object(&writer);
+    LITE_json_put_key(&writer, "method", strlen("method"));
+    LITE_json_put_string(&writer, method, strlen(method));
 
     /* copy the JOSN head */
-    size_free_space = pformat->buf_size - pformat->offset;
     if (NULL != head_str) {
-        ret = HAL_Snprintf(pformat->buf + pformat->offset,
-                           size_free_space,
-                           ",%s",
-                           head_str);
-        CHECK_SNPRINTF_RET(ret, size_free_space);
-        pformat->offset += ret;
+        LITE_json_put_raw(&writer, ",", 1);
+        LITE_json_put_raw(&writer, head_str, strlen(head_str));
+    }
+
+    if (SUCCESS_RETURN != iotx_ds_common_format_end(pformat, &writer)) {
+        return ERROR_NO_ENOUGH_MEM;
     }
 
     pformat->flag_new = true;
@@ -103,46 +101,21 @@ iotx_err_t iotx_ds_common_format_add(iotx_shadow_pt pshadow,
                                      const void *pvalue,
                                      iotx_shadow_attr_datatype_t datatype)
 {
-    int ret;
-    uint32_t size_free_space;
+    lite_json_writer_t writer;
 
-    if (pformat->flag_new) {
-        pformat->flag_new = false;
-    } else {
-        /* Add comma char. */
-        size_free_space = pformat->buf_size - pformat->offset;
-        if (size_free_space > 1) { /* there is enough space to accommodate ',' char. */
-            *(pformat->buf + pformat->offset) = ',';
-            *(pformat->buf + pformat->offset + 1) = '\0';
-            ++pformat->offset;
-        } else {
-            return FAIL_RETURN;
-        }
+    /* the attribute goes in the object the head opened, the writer sees a fragment */
+    LITE_json_writer_init(&writer, pformat->buf + pformat->offset, pformat->buf_size - pformat->offset);
+    if (!pformat->flag_new) {
+        LITE_json_put_raw(&writer, ",", 1);
     }
+    LITE_json_put_key(&writer, name, strlen(name));
 
-    size_free_space = pformat->buf_size - pformat->offset;
-
-    /* add the string: "${pattr->pattr_name}":" */
-    ret = HAL_Snprintf(pformat->buf + pformat->offset,
-                       size_free_space,
-                       "\"%s\":",
-                       name);
-
-    CHECK_SNPRINTF_RET(ret, size_free_space);
-
-    pformat->offset += ret;
-    size_free_space = pformat->buf_size - pformat->offset;
-
-    /* convert attribute data to JSON string, and add to buffer */
-    ret = iotx_ds_common_convert_data2string(pformat->buf + pformat->offset,
-            size_free_space,
-            datatype,
-            pvalue);
-    if (ret < 0) {
+    if ((0 != iotx_ds_codec_write(&writer, datatype, pvalue))
+        || (SUCCESS_RETURN != iotx_ds_common_format_end(pformat, &writer))) {
         return FAIL_RETURN;
     }
 
-    pformat->offset += ret;
+    pformat->flag_new = false;
 
     return SUCCESS_RETURN;
 }
@@ -150,157 +123,224 @@ iotx_err_t iotx_ds_common_format_add(iotx_shadow_pt pshadow,
 
 iotx_err_t iotx_ds_common_format_finalize(iotx_shadow_pt pshadow, format_data_pt pformat, const char *tail_str)
 {
-#define UPDATE_JSON_STR_END         ",\"clientToken\":\"%s-%d\",\"version\":%d}"
+    char token[DEVICE_ID_LEN + 1 + LITE_JSON_INT_LEN];
+    uint32_t token_len;
+    lite_json_writer_t writer;
 
-    int ret;
-    uint16_t size_free_space = pformat->buf_size - pformat->offset;
+    /* clientToken is "${device_id}-${tokennum}" */
+    token_len = strlen(iotx_device_info_get()->device_id);
+    memcpy(token, iotx_device_info_get()->device_id, token_len);
+    token[token_len++] = '-';
+    token_len += LITE_json_format_uint(token + token_len, iotx_ds_common_get_tokennum(pshadow));
 
+    LITE_json_writer_init(&writer, pformat->buf + pformat->offset, pformat->buf_size - pformat->offset);
     if (NULL != tail_str) {
-        ret = HAL_Snprintf(pformat->buf + pformat->offset, size_free_space, "%s", tail_str);
-        CHECK_SNPRINTF_RET(ret, size_free_space);
-        pformat->offset += ret;
+        LITE_json_put_raw(&writer, tail_str, strlen(tail_str));
     }
+    LITE_json_put_raw(&writer, ",", 1);
+    LITE_json_put_key(&writer, "clientToken", strlen("clientToken"));
+    LITE_json_put_string(&writer, token, token_len);
+    LITE_json_put_raw(&writer, ",", 1);
+    LITE_json_put_key(&writer, "version", strlen("version"));
+    LITE_json_put_uint(&writer, iotx_ds_common_get_version(pshadow));
+    LITE_json_put_raw(&writer, "}", 1);
+
+    return iotx_ds_common_format_end(pformat, &writer);
+}
 
-    size_free_space = pformat->buf_size - pformat->offset;
 
-    ret = HAL_Snprintf(pformat->buf + pformat->offset,
-                       size_free_space,
-                       UPDATE_JSON_STR_END,
-                       iotx_device_info_get()->device_id,
-                       iotx_ds_common_get_tokennum(pshadow),
-                       iotx_ds_common_get_version(pshadow));
+void iotx_ds_common_update_time(iotx_shadow_pt pshadow, uint32_t new_timestamp)
+{
+    HAL_MutexLock(pshadow->mutex);
+    pshadow->inner_data.time.base_system_time = utils_time_get_ms();
+    pshadow->inner_data.time.epoch_time = new_timestamp;
+    HAL_MutexUnlock(pshadow->mutex);
 
-    CHECK_SNPRINTF_RET(ret, size_free_space);
-    pformat->offset += ret;
+    log_info("update system time");
+}
 
-    return SUCCESS_RETURN;
 
-#undef UPDATE_JSON_STR_END
+iotx_err_t iotx_ds_common_attr_table_init(iotx_shadow_pt pshadow)
+{
+    iotx_shadow_attr_table_pt ptable = &pshadow->inner_data.attr_table;
+
+    ptable->buckets = LITE_malloc(IOTX_DS_ATTR_TABLE_INIT_SIZE * sizeof(iotx_shadow_attr_entry_pt));
+    if (NULL == ptable->buckets) {
+        return ERROR_NO_MEM;
+    }
+    memset(ptable->buckets, 0, IOTX_DS_ATTR_TABLE_INIT_SIZE * sizeof(iotx_shadow_attr_entry_pt));
+    ptable->size = IOTX_DS_ATTR_TABLE_INIT_SIZE;
+    ptable->count = 0;
+
+    return SUCCESS_RETURN;
 }
 
 
-int iotx_ds_common_convert_data2string(
-            char *buf,
-            size_t buf_len,
-            iotx_shadow_attr_datatype_t type,
-            const void *pData)
+void iotx_ds_common_attr_table_release(iotx_shadow_pt pshadow)
 {
+    uint32_t i;
+    iotx_shadow_attr_entry_pt pentry, pnext;
+    iotx_shadow_attr_table_pt ptable = &pshadow->inner_data.attr_table;
 
-    int ret = -1;
+    if (NULL == ptable->buckets) {
+        return;
+    }
 
-    if ((NULL == buf) || (buf_len == 0)
-        || ((IOTX_SHADOW_NULL != type) && (NULL == pData))) {
-        return ERROR_NULL_VALUE;
+    for (i = 0; i < ptable->size; ++i) {
+        for (pentry = ptable->buckets[i]; NULL != pentry; pentry = pnext) {
+            pnext = pentry->next;
+            LITE_free(pentry);
+        }
     }
+    LITE_free(ptable->buckets);
+    ptable->size = 0;
+    ptable->count = 0;
+}
 
-    if (IOTX_SHADOW_INT32 == type) {
-        ret = HAL_Snprintf(buf, buf_len, "%" PRIi32, *(int32_t *)(pData));
-    } else if (IOTX_SHADOW_STRING == type) {
-        ret = HAL_Snprintf(buf, buf_len, "\"%s\"", (char *)(pData));
-    } else if (IOTX_SHADOW_NULL == type) {
-        ret = HAL_Snprintf(buf, buf_len, "%s", "\"null\"");
-    } else {
-        log_err("Error data type");
-        ret = -1;
+
+/* double the buckets once there are more attributes than buckets, keep the old ones if out of memory */
+static void iotx_ds_common_attr_table_grow(iotx_shadow_attr_table_pt ptable)
+{
+    uint32_t i, size = ptable->size * 2;
+    iotx_shadow_attr_entry_pt pentry, pnext, *buckets;
+
+    buckets = LITE_malloc(size * sizeof(iotx_shadow_attr_entry_pt));
+    if (NULL == buckets) {
+        log_warning("Not enough memory to grow attribute table");
+        return;
     }
+    memset(buckets, 0, size * sizeof(iotx_shadow_attr_entry_pt));
 
-    if ((ret < 0) || (ret >= buf_len)) {
-        return -1;
+    for (i = 0; i < ptable->size; ++i) {
+        for (pentry = ptable->buckets[i]; NULL != pentry; pentry = pnext) {
+            pnext = pentry->next;
+            pentry->next = buckets[pentry->hash & (size - 1)];
+            buckets[pentry->hash & (size - 1)] = pentry;
+        }
     }
 
-    return ret;
+    LITE_free(ptable->buckets);
+    ptable->buckets = buckets;
+    ptable->size = size;
 }
 
 
-iotx_err_t iotx_ds_common_convert_string2data(
-            const char *buf,
-            size_t buf_len,
-            iotx_shadow_attr_datatype_t type,
-            void *pdata)
+static iotx_shadow_attr_entry_pt *iotx_ds_common_lookup_entry(iotx_shadow_attr_table_pt ptable,
+        const char *name,
+        uint32_t name_len,
+        uint32_t hash)
 {
-    if ((NULL == buf) || (buf_len == 0) || (NULL == pdata)) {
-        return ERROR_NULL_VALUE;
-    }
+    iotx_shadow_attr_entry_pt *ppentry;
 
-    if (type == IOTX_SHADOW_INT32) {
-        if (0 == strcmp(pdata, "true")) {
-            *((int32_t *)pdata) = 1;
-        } else if (0 == strcmp(pdata, "false")) {
-            *((int32_t *)pdata) = 0;
-        } else if (0 == strcmp(pdata, "null")) {
-            *((int32_t *)pdata) = 0;
-        } else {
-            *((int32_t *)pdata) = atoi(buf);
+    for (ppentry = &ptable->buckets[hash & (ptable->size - 1)]; NULL != *ppentry; ppentry = &(*ppentry)->next) {
+        if (((*ppentry)->hash == hash) && ((*ppentry)->name_len == name_len)
+            && (0 == memcmp((*ppentry)->pattr->pattr_name, name, name_len))) {
+            break;
         }
-    } else if (type == IOTX_SHADOW_STRING) {
-        memcpy(pdata, buf, buf_len);
-    } else {
-        log_err("Error data type");
-        return ERROR_SHADOW_UNDEF_TYPE;
     }
 
-    return SUCCESS_RETURN;
+    return ppentry;
 }
 
 
-void iotx_ds_common_update_time(iotx_shadow_pt pshadow, uint32_t new_timestamp)
+iotx_shadow_attr_entry_pt iotx_ds_common_find_entry(iotx_shadow_pt pshadow,
+        const char *name,
+        uint32_t name_len,
+        uint32_t hash)
 {
-    HAL_MutexLock(pshadow->mutex);
-    pshadow->inner_data.time.base_system_time = utils_time_get_ms();
-    pshadow->inner_data.time.epoch_time = new_timestamp;
-    HAL_MutexUnlock(pshadow->mutex);
+    return *iotx_ds_common_lookup_entry(&pshadow->inner_data.attr_table, name, name_len, hash);
+}
 
-    log_info("update system time");
+
+iotx_shadow_attr_pt iotx_ds_common_find_attr(iotx_shadow_pt pshadow,
+        const char *name,
+        uint32_t name_len,
+        uint32_t hash)
+{
+    iotx_shadow_attr_entry_pt pentry;
+
+    pentry = iotx_ds_common_find_entry(pshadow, name, name_len, hash);
+
+    return (NULL == pentry) ? NULL : pentry->pattr;
 }
 
 
+/* an attribute exists if one with the same name is registered */
 bool iotx_ds_common_check_attr_existence(
             iotx_shadow_pt pshadow,
             iotx_shadow_attr_pt pattr)
 {
-    list_node_t *node;
+    iotx_shadow_attr_pt pfound;
+    uint32_t name_len = strlen(pattr->pattr_name);
 
     HAL_MutexLock(pshadow->mutex);
-    node = list_find(pshadow->inner_data.attr_list, pattr);
+    pfound = iotx_ds_common_find_attr(pshadow, pattr->pattr_name, name_len,
+                                      iotx_ds_json_hash(pattr->pattr_name, name_len));
     HAL_MutexUnlock(pshadow->mutex);
 
-    return (NULL != node);
+    return (NULL != pfound);
 }
 
 
-/* register attribute to list */
+/* register attribute to table */
 iotx_err_t iotx_ds_common_register_attr(
             iotx_shadow_pt pshadow,
             iotx_shadow_attr_pt pattr)
 {
-    list_node_t *node = list_node_new(pattr);
-    if (NULL == node) {
+    iotx_shadow_attr_entry_pt pentry, *ppentry;
+    iotx_shadow_attr_table_pt ptable = &pshadow->inner_data.attr_table;
+
+    pentry = LITE_malloc(sizeof(iotx_shadow_attr_entry_t));
+    if (NULL == pentry) {
         return ERROR_NO_MEM;
     }
+    memset(pentry, 0, sizeof(iotx_shadow_attr_entry_t));
+    pentry->pattr = pattr;
+    pentry->name_len = strlen(pattr->pattr_name);
+    pentry->hash = iotx_ds_json_hash(pattr->pattr_name, pentry->name_len);
 
     HAL_MutexLock(pshadow->mutex);
-    list_lpush(pshadow->inner_data.attr_list, node);
+    ppentry = iotx_ds_common_lookup_entry(ptable, pattr->pattr_name, pentry->name_len, pentry->hash);
+    if (NULL != *ppentry) {
+        HAL_MutexUnlock(pshadow->mutex);
+        LITE_free(pentry);
+        return ERROR_SHADOW_ATTR_EXIST;
+    }
+    pentry->next = NULL;
+    *ppentry = pentry;
+
+    if (++ptable->count > ptable->size) {
+        iotx_ds_common_attr_table_grow(ptable);
+    }
     HAL_MutexUnlock(pshadow->mutex);
 
     return SUCCESS_RETURN;
 }
 
 
-/* remove attribute to list */
+/* remove attribute from table */
 iotx_err_t iotx_ds_common_remove_attr(
             iotx_shadow_pt pshadow,
             iotx_shadow_attr_pt pattr)
 {
     iotx_err_t rc = SUCCESS_RETURN;
-    list_node_t *node;
+    iotx_shadow_attr_entry_pt pentry, *ppentry;
+    uint32_t name_len = strlen(pattr->pattr_name);
 
     HAL_MutexLock(pshadow->mutex);
-    node = list_find(pshadow->inner_data.attr_list, pattr);
-    if (NULL == node) {
+    ppentry = iotx_ds_common_lookup_entry(&pshadow->inner_data.attr_table, pattr->pattr_name, name_len,
+                                          iotx_ds_json_hash(pattr->pattr_name, name_len));
+    pentry = *ppentry;
+    if ((NULL == pentry) || (pentry->pattr != pattr)) {
         rc = ERROR_SHADOW_NO_ATTRIBUTE;
         log_err("Try to remove a non-existent attribute.");
     } else {
-        list_remove(pshadow->inner_data.attr_list, node);
+        *ppentry = pentry->next;
+        --pshadow->inner_data.attr_table.count;
+        if (pentry->report_flags & IOTX_DS_ATTR_DIRTY) {
+            --pshadow->inner_data.report.dirty_count;
+        }
+        LITE_free(pentry);
     }
     HAL_MutexUnlock(pshadow->mutex);
 
@@ -316,6 +356,7 @@ void iotx_ds_common_update_version(iotx_shadow_pt pshadow, uint32_t version)
     if (version > pshadow->inner_data.version) {
         pshadow->inner_data.version = version;
     }
+    pshadow->inner_data.cloud_version = version;
     HAL_MutexUnlock(pshadow->mutex);
 
     log_info("update shadow version");
@@ -381,6 +422,45 @@ char *iotx_ds_common_generate_topic_name(iotx_shadow_pt pshadow, const char *top
 }
 
 
+/* re-encode the JSON payload of @ptopic_msg as CBOR and publish it */
+static int iotx_ds_common_publish_cbor(iotx_shadow_pt pshadow, iotx_mqtt_topic_info_pt ptopic_msg)
+{
+    int rc, len;
+    uint8_t *buf;
+    iotx_ds_json_t json;
+
+    if (SUCCESS_RETURN != iotx_ds_json_parse(&json, ptopic_msg->payload, ptopic_msg->payload_len)) {
+        iotx_ds_json_release(&json);
+        return FAIL_RETURN;
+    }
+
+    len = iotx_ds_cbor_from_json(&json, NULL, 0);
+    if (len <= 0) {
+        iotx_ds_json_release(&json);
+        return FAIL_RETURN;
+    }
+
+    buf = LITE_malloc(len);
+    if (NULL == buf) {
+        iotx_ds_json_release(&json);
+        return ERROR_NO_MEM;
+    }
+
+    iotx_ds_cbor_from_json(&json, buf, len);
+    iotx_ds_json_release(&json);
+
+    log_debug("publish msg as CBOR: len=%d", len);
+
+    ptopic_msg->payload = (void *)buf;
+    ptopic_msg->payload_len = len;
+    rc = IOT_MQTT_Publish(pshadow->mqtt, pshadow->inner_data.ptopic_update, ptopic_msg);
+
+    LITE_free(buf);
+
+    return rc;
+}
+
+
 int iotx_ds_common_publish2update(iotx_shadow_pt pshadow, char *data, uint32_t data_len)
 {
     iotx_mqtt_topic_info_t topic_msg;
@@ -403,5 +483,9 @@ int iotx_ds_common_publish2update(iotx_shadow_pt pshadow, char *data, uint32_t d
     topic_msg.payload_len = data_len;
     topic_msg.packet_id = 0;
 
+    if (IOTX_SHADOW_FORMAT_CBOR == pshadow->inner_data.format) {
+        return iotx_ds_common_publish_cbor(pshadow, &topic_msg);
+    }
+
     return IOT_MQTT_Publish(pshadow->mqtt, pshadow->inner_data.ptopic_update, &topic_msg);
 }
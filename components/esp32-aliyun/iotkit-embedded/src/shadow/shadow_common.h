@@ -28,24 +28,76 @@
 #include "shadow.h"
 #include "shadow_config.h"
 
+/* one UPDATE waiting for ACK, allocated with its token right after it */
 typedef struct iotx_update_ack_wait_list_st {
-    bool flag_busy; /* 0, free; 1, busy. */
-    char token[IOTX_DS_TOKEN_LEN];
+    struct iotx_update_ack_wait_list_st *next; /* in the token bucket */
+    uint32_t token_hash;
+    uint32_t token_len;
+    char *token;        /* NOT a string */
+    int heap_index;     /* position in the deadline heap */
+    uint32_t start_ms;
+    uint32_t deadline_ms;
     iotx_push_cb_fpt callback;
     void *pcontext;
-    iotx_time_t timer;
 } iotx_update_ack_wait_list_t, *iotx_update_ack_wait_list_pt;
 
+/* pending UPDATEs, indexed by clientToken and ordered by deadline in a binary min-heap */
+typedef struct iotx_update_ack_table_st {
+    iotx_update_ack_wait_list_pt buckets[IOTX_DS_UPDATE_WAIT_ACK_HASH_SIZE];
+    iotx_update_ack_wait_list_pt *heap;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t latency_sum_ms;
+    iotx_shadow_ack_stats_t stats;
+} iotx_update_ack_table_t, *iotx_update_ack_table_pt;
+
+
+/* registered attributes, hashed by name with iotx_ds_json_hash() so that keys of a document
+ * are looked up with the hash the tokenizer already computed */
+#define IOTX_DS_ATTR_DIRTY          (0x01)  /* changed since the last report */
+#define IOTX_DS_ATTR_INFLIGHT       (0x02)  /* carried by the report waiting for ACK */
+#define IOTX_DS_ATTR_ACKED          (0x04)  /* acked_hash and acked_version are valid */
+
+typedef struct iotx_shadow_attr_entry_st {
+    uint32_t hash;
+    uint32_t name_len;
+    iotx_shadow_attr_pt pattr;
+    struct iotx_shadow_attr_entry_st *next;
+    uint32_t report_flags;
+    uint32_t sent_hash;     /* hash of the "name":value text in flight */
+    uint32_t acked_hash;    /* hash of the "name":value text the cloud acknowledged */
+    uint32_t acked_version; /* shadow version seen when it was acknowledged */
+} iotx_shadow_attr_entry_t, *iotx_shadow_attr_entry_pt;
+
+typedef struct iotx_shadow_attr_table_st {
+    uint32_t size;  /* number of buckets, power of 2 */
+    uint32_t count;
+    iotx_shadow_attr_entry_pt *buckets;
+} iotx_shadow_attr_table_t, *iotx_shadow_attr_table_pt;
+
+
+typedef struct iotx_shadow_report_st {
+    uint32_t window_ms;
+    iotx_time_t timer;      /* started by the first change of a window */
+    uint32_t dirty_count;
+    bool busy;              /* a report waits for ACK */
+    int ack_code;
+    iotx_shadow_report_stats_t stats;
+} iotx_shadow_report_t, *iotx_shadow_report_pt;
+
 
 typedef struct iotx_inner_data_st {
     uint32_t token_num;
     uint32_t version;
+    uint32_t cloud_version; /* the last version received from cloud */
     iotx_shadow_time_t time;
-    iotx_update_ack_wait_list_t update_ack_wait_list[IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM];
-    list_t *attr_list;
+    iotx_update_ack_table_t update_ack_table;
+    iotx_shadow_attr_table_t attr_table;
+    iotx_shadow_report_t report;
     char *ptopic_update;
     char *ptopic_get;
     int32_t sync_status;
+    iotx_shadow_format_t format;
 } iotx_inner_data_t, *iotx_inner_data_pt;;
 
 
@@ -72,17 +124,21 @@ iotx_err_t iotx_ds_common_format_finalize(iotx_shadow_pt pshadow, format_data_pt
 
 void iotx_ds_common_update_time(iotx_shadow_pt pshadow, uint32_t new_timestamp);
 
-int iotx_ds_common_convert_data2string(
-            char *buf,
-            size_t buf_len,
-            iotx_shadow_attr_datatype_t type,
-            const void *pData);
-
-iotx_err_t iotx_ds_common_convert_string2data(
-            const char *buf,
-            size_t buf_len,
-            iotx_shadow_attr_datatype_t type,
-            void *pData);
+iotx_err_t iotx_ds_common_attr_table_init(iotx_shadow_pt pshadow);
+
+void iotx_ds_common_attr_table_release(iotx_shadow_pt pshadow);
+
+/* NOTE: the shadow mutex must be held, @name is NOT a string. */
+iotx_shadow_attr_entry_pt iotx_ds_common_find_entry(iotx_shadow_pt pshadow,
+        const char *name,
+        uint32_t name_len,
+        uint32_t hash);
+
+/* NOTE: the shadow mutex must be held, @name is NOT a string. */
+iotx_shadow_attr_pt iotx_ds_common_find_attr(iotx_shadow_pt pshadow,
+        const char *name,
+        uint32_t name_len,
+        uint32_t hash);
 
 bool iotx_ds_common_check_attr_existence(iotx_shadow_pt pshadow, const iotx_shadow_attr_pt pattr);
 
@@ -24,6 +24,18 @@
 
 #define IOTX_DS_TOKEN_LEN                       (128) /**< indicate the maximum length of shadow token in byte. */
 
-#define IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM        (5)   /**< indicate the maximum element of UPDATE ACK list. */
+#define IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM        (64)  /**< indicate the maximum element of UPDATE ACK list. */
+
+#define IOTX_DS_UPDATE_WAIT_ACK_HASH_SIZE       (16)  /**< indicate the bucket number of token index of UPDATE ACK list, power of 2. */
+
+#define IOTX_DS_ATTR_TABLE_INIT_SIZE            (16)  /**< indicate the initial bucket number of attribute table, power of 2. */
+
+#define IOTX_DS_DELTA_CALLBACK_BATCH            (16)  /**< indicate the maximum attribute callbacks per lock of shadow mutex. */
+
+#define IOTX_DS_REPORT_WINDOW_MS                (1000) /**< indicate the default window to coalesce changed attributes. */
+
+#define IOTX_DS_REPORT_MSG_LEN                  (1024) /**< indicate the maximum length of one report, more changes wait. */
+
+#define IOTX_DS_REPORT_TIMEOUT_S                (10)  /**< indicate the time to wait ACK of one report in second. */
 
 #endif /* _IOTX_SHADOW_CONFIG_H_ */
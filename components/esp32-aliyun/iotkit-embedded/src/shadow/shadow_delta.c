@@ -22,8 +22,8 @@
 
 #include "lite-log.h"
 #include "lite-utils.h"
-#include "utils_list.h"
 #include "shadow_delta.h"
+#include "shadow_codec.h"
 
 static int iotx_shadow_delta_response(iotx_shadow_pt pshadow)
 {
@@ -51,21 +51,15 @@ static int iotx_shadow_delta_response(iotx_shadow_pt pshadow)
 
 
 
-static uint32_t iotx_shadow_get_timestamp(const char *pmetadata_desired,
-        size_t len_metadata_desired,
-        const char *pname)
+static uint32_t iotx_shadow_get_timestamp(const iotx_ds_json_t *pjson, int metadata_attr)
 {
-    const char *pdata;
+    int index;
 
     /* attribute be matched, and then get timestamp */
 
-    pdata = LITE_json_value_of((char *)pname, (char *)pmetadata_desired);
-
-    if (NULL != pdata) {
-        pdata = LITE_json_value_of((char *)"timestamp", (char *)pdata);
-        if (NULL != pdata) {
-            return atoi(pdata);
-        }
+    index = iotx_ds_json_find(pjson, metadata_attr, "timestamp", strlen("timestamp"));
+    if (index >= 0) {
+        return iotx_ds_json_value_uint32(pjson, index);
     }
 
     log_err("NOT timestamp in JSON doc");
@@ -78,97 +72,93 @@ static iotx_err_t iotx_shadow_delta_update_attr_value(
             const char *pvalue,
             size_t value_len)
 {
-    return iotx_ds_common_convert_string2data(pvalue, value_len, pattr->attr_type, pattr->pattr_data);
+    return iotx_ds_codec_decode(pvalue, value_len, pattr->attr_type, pattr->pattr_data, pattr->data_size);
 }
 
 
 static void iotx_shadow_delta_update_attr(iotx_shadow_pt pshadow,
-        const char *json_doc_attr,
-        uint32_t json_doc_attr_len,
-        const char *json_doc_metadata,
-        uint32_t json_doc_metadata_len)
+        const iotx_ds_json_t *pjson,
+        int state,
+        int metadata)
 {
+    int i, count, index, meta_index, meta_hint;
     const char *pvalue;
-    iotx_shadow_attr_pt pattr;
-    list_iterator_t *iter;
-    list_node_t *node;
+    uint32_t value_len;
+    const iotx_ds_json_token_t *ptoken;
+    iotx_shadow_attr_pt pattr, fired[IOTX_DS_DELTA_CALLBACK_BATCH];
 
-    /* Iterate the list and check JSON document according to list_node.val.pattr_name */
-    /* If the attribute be found, call the function registered by calling iotx_shadow_delta_register_attr() */
+    /* Walk the keys of the JSON document and look each one up in the attribute table */
+    /* If the attribute be found, call the function registered by calling IOT_Shadow_RegisterAttribute() */
 
-    HAL_MutexLock(pshadow->mutex);
-    iter = list_iterator_new(pshadow->inner_data.attr_list, LIST_TAIL);
-    if (NULL == iter) {
-        HAL_MutexUnlock(pshadow->mutex);
-        log_warning("Allocate memory failed");
-        return ;
-    }
+    index = iotx_ds_json_child(pjson, state);
+    meta_hint = iotx_ds_json_child(pjson, metadata);
+
+    while (index >= 0) {
+        count = 0;
+
+        HAL_MutexLock(pshadow->mutex);
+        for (; (index >= 0) && (count < IOTX_DS_DELTA_CALLBACK_BATCH); index = ptoken->next) {
+            ptoken = &pjson->tokens[index];
+            pattr = iotx_ds_common_find_attr(pshadow, pjson->doc + ptoken->key, ptoken->key_len, ptoken->key_hash);
+            if (NULL == pattr) {
+                continue;
+            }
 
-    while (node = list_iterator_next(iter), NULL != node) {
-        pattr = (iotx_shadow_attr_pt)node->val;
-        pvalue = LITE_json_value_of((char *)pattr->pattr_name, (char *)json_doc_attr);
+            /* metadata usually lists the keys in the same order as state */
+            meta_index = iotx_ds_json_find_hinted(pjson, metadata, meta_hint,
+                                                  pjson->doc + ptoken->key, ptoken->key_len, ptoken->key_hash);
+            if (meta_index >= 0) {
+                meta_hint = pjson->tokens[meta_index].next;
+            }
 
-        /* check if match attribute or not be matched */
-        if (NULL != pvalue) { /* attribute be matched */
             /* get timestamp */
-            pattr->timestamp = iotx_shadow_get_timestamp(
-                                           json_doc_metadata,
-                                           json_doc_metadata_len,
-                                           pattr->pattr_name);
+            pattr->timestamp = iotx_shadow_get_timestamp(pjson, meta_index);
 
             /* convert string of JSON value according to destination data type. */
-            if (SUCCESS_RETURN != iotx_shadow_delta_update_attr_value(pattr, pvalue, strlen(pvalue))) {
+            pvalue = iotx_ds_json_value(pjson, index, &value_len);
+            if (SUCCESS_RETURN != iotx_shadow_delta_update_attr_value(pattr, pvalue, value_len)) {
                 log_warning("Update attribute value failed.");
             }
 
             if (NULL != pattr->callback) {
-                HAL_MutexUnlock(pshadow->mutex);
-                /* call related callback function */
-                pattr->callback(pattr);
-                HAL_MutexLock(pshadow->mutex);
+                fired[count++] = pattr;
             }
         }
-    }
+        HAL_MutexUnlock(pshadow->mutex);
 
-    list_iterator_destroy(iter);
-    HAL_MutexUnlock(pshadow->mutex);
+        /* call related callback functions without the mutex, they may push to the shadow */
+        for (i = 0; i < count; ++i) {
+            fired[i]->callback(fired[i]);
+        }
+    }
 }
 
 /* handle response ACK of UPDATE */
 void iotx_shadow_delta_entry(
             iotx_shadow_pt pshadow,
-            const char *json_doc,
-            size_t json_doc_len)
+            const iotx_ds_json_t *pjson)
 {
     const char *key_metadata;
-    const char *pstate, *pmetadata;
+    int state, metadata;
 
-    pstate = LITE_json_value_of((char *)"payload.state.desired", (char *)json_doc);
-    if (NULL != pstate) {
+    state = iotx_ds_json_path(pjson, 0, "payload.state.desired");
+    if (state >= 0) {
         key_metadata = "payload.metadata.desired";
     } else {
         /* if have not desired key, get reported key instead. */
         key_metadata = "payload.metadata.reported";
-        pstate = LITE_json_value_of((char *)"payload.state.reported", (char *)json_doc);
+        state = iotx_ds_json_path(pjson, 0, "payload.state.reported");
     }
 
-    pmetadata = LITE_json_value_of((char *)key_metadata, (char *)json_doc);
+    metadata = iotx_ds_json_path(pjson, 0, key_metadata);
 
-    if ((NULL == pstate) || (NULL == pmetadata)) {
+    if ((state < 0) || (metadata < 0)) {
         log_err("Invalid JSON Doc");
         return;
     }
 
-    iotx_shadow_delta_update_attr(pshadow,
-                                  pstate,
-                                  strlen(pstate),
-                                  pmetadata,
-                                  strlen(pmetadata));
-
-    LITE_free(pstate);
-    LITE_free(pmetadata);
+    iotx_shadow_delta_update_attr(pshadow, pjson, state, metadata);
 
     /* generate ACK and publish to @update topic using QOS1 */
     iotx_shadow_delta_response(pshadow);
 }
-
@@ -26,14 +26,14 @@
 #include "shadow_config.h"
 #include "shadow_common.h"
 #include "shadow_update.h"
+#include "shadow_parser.h"
 
 
 bool iotx_shadow_delta_check_existence(iotx_shadow_pt pshadow, const char *attr_name);
 
 void iotx_shadow_delta_entry(
             iotx_shadow_pt pshadow,
-            const char *json_doc,
-            size_t json_doc_len);
+            const iotx_ds_json_t *pjson);
 
 iotx_err_t iotx_shadow_delta_register_attr(
             iotx_shadow_pt pshadow,
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include "iot_import.h"
+
+#include "lite-log.h"
+#include "lite-utils.h"
+#include "shadow_parser.h"
+
+/* a key is a string member of an object, its value is the next token */
+#define IOTX_DS_JSON_IS_KEY(tokens, i) \
+    ((LITE_JSON_STRING == (tokens)[i].type) && ((tokens)[i].parent >= 0) \
+     && (LITE_JSON_OBJECT == (tokens)[(tokens)[i].parent].type))
+
+typedef struct {
+    int token;
+    int last_child;
+} iotx_ds_json_frame_t;
+
+
+/* @pjson holds room for every value, see iotx_ds_json_parse() */
+static int iotx_ds_json_new_token(iotx_ds_json_pt pjson, iotx_ds_json_frame_t *pframe)
+{
+    int index;
+    iotx_ds_json_token_pt ptoken;
+
+    index = pjson->count++;
+    ptoken = &pjson->tokens[index];
+    memset(ptoken, 0, sizeof(iotx_ds_json_token_t));
+    ptoken->next = -1;
+
+    /* link it to the container it lives in */
+    if (NULL != pframe) {
+        if (pframe->last_child >= 0) {
+            pjson->tokens[pframe->last_child].next = index;
+        }
+        pframe->last_child = index;
+        ++pjson->tokens[pframe->token].size;
+    }
+
+    return index;
+}
+
+
+/* run LITE_json_tokenize() over @doc, growing the token array until the document fits.
+ * Return the number of tokens in *@ptokens, LITE_JSON_ERROR_* otherwise. */
+static int iotx_ds_json_tokenize(const char *doc, uint32_t doc_len, lite_json_token_t **ptokens,
+                                 uint32_t *perror_pos)
+{
+    lite_json_tokenizer_t tokenizer;
+    lite_json_token_t *tokens = NULL, *grown;
+    uint32_t capacity = IOTX_DS_JSON_INIT_TOKEN_NUM;
+    int count;
+
+    LITE_json_tokenizer_init(&tokenizer);
+    do {
+        /* NOT LITE_realloc(), it copies the new size out of the old buffer when memory stats are on */
+        grown = LITE_malloc(capacity * sizeof(lite_json_token_t));
+        if (NULL == grown) {
+            count = LITE_JSON_ERROR_NOMEM;
+            break;
+        }
+        if (NULL != tokens) {
+            /* the tokenizer goes on from where it stopped, with the tokens found so far */
+            memcpy(grown, tokens, tokenizer.toknext * sizeof(lite_json_token_t));
+            LITE_free(tokens);
+        }
+        tokens = grown;
+
+        count = LITE_json_tokenize(&tokenizer, doc, doc_len, tokens, capacity);
+        capacity *= 2;
+    } while (LITE_JSON_ERROR_NOMEM == count);
+
+    *ptokens = tokens;
+    *perror_pos = tokenizer.pos;
+    return count;
+}
+
+
+iotx_err_t iotx_ds_json_parse(iotx_ds_json_pt pjson, const char *doc, uint32_t doc_len)
+{
+    iotx_ds_json_frame_t stack[IOTX_DS_JSON_MAX_DEPTH];
+    iotx_ds_json_token_pt ptoken, pcontainer;
+    lite_json_token_t *tokens = NULL, *plite;
+    int depth = 0, count, values, index, i;
+    uint32_t pos = 0;
+
+    memset(pjson, 0, sizeof(iotx_ds_json_t));
+    pjson->doc = doc;
+    pjson->doc_len = doc_len;
+
+    if (NULL == doc) {
+        return NULL_VALUE_ERROR;
+    }
+
+    /* a payload of some brokers carries the terminating NUL, the tokenizer stops there */
+    count = iotx_ds_json_tokenize(doc, doc_len, &tokens, &pos);
+    if (count < 0) {
+        if (NULL != tokens) {
+            LITE_free(tokens);
+        }
+        if (LITE_JSON_ERROR_NOMEM == count) {
+            log_err("Not enough memory for the JSON tokens");
+            return ERROR_NO_MEM;
+        }
+        goto parse_error;
+    }
+
+    /* one index token per value, a key is folded into the value it names */
+    for (i = 0, values = 0; i < count; ++i) {
+        if (!IOTX_DS_JSON_IS_KEY(tokens, i)) {
+            ++values;
+        }
+    }
+    pjson->tokens = LITE_malloc(values * sizeof(iotx_ds_json_token_t));
+    if (NULL == pjson->tokens) {
+        LITE_free(tokens);
+        log_err("Not enough memory for %d JSON tokens", values);
+        return ERROR_NO_MEM;
+    }
+    pjson->capacity = values;
+
+    for (i = 0; i < count; ++i) {
+        plite = &tokens[i];
+        if (IOTX_DS_JSON_IS_KEY(tokens, i)) {
+            continue;
+        }
+        pos = plite->start;
+
+        /* tokens are in document order: step out of the containers which end before this value */
+        while (depth > 0) {
+            pcontainer = &pjson->tokens[stack[depth - 1].token];
+            if (pos < pcontainer->value + pcontainer->value_len) {
+                break;
+            }
+            --depth;
+        }
+
+        index = iotx_ds_json_new_token(pjson, (depth > 0) ? &stack[depth - 1] : NULL);
+        ptoken = &pjson->tokens[index];
+        ptoken->type = (uint8_t)plite->type;
+        ptoken->value = plite->start;
+        ptoken->value_len = plite->end - plite->start;
+
+        if ((plite->parent >= 0) && (LITE_JSON_STRING == tokens[plite->parent].type)) {
+            if (tokens[plite->parent].end - tokens[plite->parent].start > 0xFFFF) {
+                goto parse_error;
+            }
+            ptoken->key = tokens[plite->parent].start;
+            ptoken->key_len = tokens[plite->parent].end - tokens[plite->parent].start;
+            ptoken->key_hash = iotx_ds_json_hash(doc + ptoken->key, ptoken->key_len);
+        }
+
+        if ((LITE_JSON_OBJECT == plite->type) || (LITE_JSON_ARRAY == plite->type)) {
+            if (depth >= IOTX_DS_JSON_MAX_DEPTH) {
+                log_err("JSON document nests deeper than %d", IOTX_DS_JSON_MAX_DEPTH);
+                goto parse_error;
+            }
+            stack[depth].token = index;
+            stack[depth].last_child = -1;
+            ++depth;
+        }
+    }
+
+    LITE_free(tokens);
+    return SUCCESS_RETURN;
+
+parse_error:
+    if (NULL != tokens) {
+        LITE_free(tokens);
+    }
+    log_err("Invalid JSON document at offset %u", (unsigned int)pos);
+    return FAIL_RETURN;
+}
+
+
+void iotx_ds_json_release(iotx_ds_json_pt pjson)
+{
+    if (NULL != pjson->tokens) {
+        LITE_free(pjson->tokens);
+    }
+    pjson->count = 0;
+    pjson->capacity = 0;
+}
+
+
+int iotx_ds_json_child(const iotx_ds_json_t *pjson, int parent)
+{
+    if (parent < 0 || parent >= pjson->count || 0 == pjson->tokens[parent].size) {
+        return -1;
+    }
+
+    return parent + 1;
+}
+
+
+uint32_t iotx_ds_json_hash(const char *key, uint32_t key_len)
+{
+    uint32_t i, hash = 2166136261u;
+
+    for (i = 0; i < key_len; ++i) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+#define IOTX_DS_JSON_KEY_MATCH(pjson, ptoken, key, key_len, key_hash) \
+    (((ptoken)->key_hash == (key_hash)) && ((ptoken)->key_len == (key_len)) \
+     && (0 == memcmp((pjson)->doc + (ptoken)->key, (key), (key_len))))
+
+int iotx_ds_json_find_hinted(const iotx_ds_json_t *pjson,
+                             int parent,
+                             int hint,
+                             const char *key,
+                             uint32_t key_len,
+                             uint32_t key_hash)
+{
+    int index;
+    const iotx_ds_json_token_t *ptoken;
+
+    if (parent < 0 || parent >= pjson->count || IOTX_DS_JSON_OBJECT != pjson->tokens[parent].type) {
+        return -1;
+    }
+
+    /* a member of @parent is past it and before its end */
+    if (hint > parent && hint < pjson->count
+        && pjson->tokens[hint].value < pjson->tokens[parent].value + pjson->tokens[parent].value_len) {
+        ptoken = &pjson->tokens[hint];
+        if (IOTX_DS_JSON_KEY_MATCH(pjson, ptoken, key, key_len, key_hash)) {
+            return hint;
+        }
+    }
+
+    for (index = iotx_ds_json_child(pjson, parent); index >= 0; index = ptoken->next) {
+        ptoken = &pjson->tokens[index];
+        if (IOTX_DS_JSON_KEY_MATCH(pjson, ptoken, key, key_len, key_hash)) {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+
+int iotx_ds_json_find(const iotx_ds_json_t *pjson, int parent, const char *key, uint32_t key_len)
+{
+    return iotx_ds_json_find_hinted(pjson, parent, -1, key, key_len, iotx_ds_json_hash(key, key_len));
+}
+
+
+int iotx_ds_json_path(const iotx_ds_json_t *pjson, int parent, const char *path)
+{
+    const char *delim;
+
+    while (parent >= 0) {
+        delim = strchr(path, '.');
+        if (NULL == delim) {
+            return iotx_ds_json_find(pjson, parent, path, strlen(path));
+        }
+        parent = iotx_ds_json_find(pjson, parent, path, delim - path);
+        path = delim + 1;
+    }
+
+    return -1;
+}
+
+
+const char *iotx_ds_json_value(const iotx_ds_json_t *pjson, int index, uint32_t *value_len)
+{
+    if (index < 0 || index >= pjson->count) {
+        return NULL;
+    }
+
+    if (NULL != value_len) {
+        *value_len = pjson->tokens[index].value_len;
+    }
+
+    return pjson->doc + pjson->tokens[index].value;
+}
+
+
+bool iotx_ds_json_value_equal(const iotx_ds_json_t *pjson, int index, const char *str)
+{
+    uint32_t len;
+    const char *pvalue = iotx_ds_json_value(pjson, index, &len);
+
+    return (NULL != pvalue) && (strlen(str) == len) && (0 == memcmp(pvalue, str, len));
+}
+
+
+uint32_t iotx_ds_json_value_uint32(const iotx_ds_json_t *pjson, int index)
+{
+    uint32_t i, len, value = 0;
+    const char *pvalue = iotx_ds_json_value(pjson, index, &len);
+
+    if (NULL == pvalue || IOTX_DS_JSON_NUMBER != pjson->tokens[index].type) {
+        return 0;
+    }
+
+    for (i = 0; i < len && LITE_isdigit(pvalue[i]); ++i) {
+        value = value * 10 + (pvalue[i] - '0');
+    }
+
+    return value;
+}
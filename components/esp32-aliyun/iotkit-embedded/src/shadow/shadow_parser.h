@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#ifndef _IOTX_SHADOW_PARSER_H_
+#define _IOTX_SHADOW_PARSER_H_
+
+#include "iot_import.h"
+#include "lite-utils.h"
+#include "shadow.h"
+
+#define IOTX_DS_JSON_MAX_DEPTH          (16)  /**< indicate the maximum nesting of objects and arrays in a document. */
+#define IOTX_DS_JSON_INIT_TOKEN_NUM     (32)  /**< indicate the initial number of tokens, doubled until the document fits. */
+
+/* the types of LITE_json_tokenize(), which the index is built from */
+typedef enum {
+    IOTX_DS_JSON_STRING = LITE_JSON_STRING,
+    IOTX_DS_JSON_OBJECT = LITE_JSON_OBJECT,
+    IOTX_DS_JSON_ARRAY = LITE_JSON_ARRAY,
+    IOTX_DS_JSON_NUMBER = LITE_JSON_NUMBER,
+    IOTX_DS_JSON_BOOLEAN = LITE_JSON_BOOLEAN,
+    IOTX_DS_JSON_NULL = LITE_JSON_NULL
+} iotx_ds_json_type_t;
+
+/* One value of the document. Keys and values are offsets into the document, nothing is copied.
+ * Tokens are stored in document order, so the first child of a container is the next token. */
+typedef struct iotx_ds_json_token_st {
+    uint32_t key;           /* offset of the key, without quotes */
+    uint32_t value;         /* offset of the value, without quotes for a string */
+    uint32_t value_len;
+    uint32_t key_hash;      /* iotx_ds_json_hash() of the key */
+    uint16_t key_len;       /* 0 for array entries and the root */
+    uint8_t type;           /* iotx_ds_json_type_t */
+    uint8_t reserved;
+    int size;               /* number of children of an object or array */
+    int next;               /* index of the next sibling, -1 for the last one */
+} iotx_ds_json_token_t, *iotx_ds_json_token_pt;
+
+typedef struct iotx_ds_json_st {
+    const char *doc;
+    uint32_t doc_len;
+    int count;
+    int capacity;
+    iotx_ds_json_token_pt tokens;
+} iotx_ds_json_t, *iotx_ds_json_pt;
+
+/* tokenize @doc once with LITE_json_tokenize() and index its values, the root is token 0.
+ * Call iotx_ds_json_release() whatever the result. */
+iotx_err_t iotx_ds_json_parse(iotx_ds_json_pt pjson, const char *doc, uint32_t doc_len);
+
+void iotx_ds_json_release(iotx_ds_json_pt pjson);
+
+/* FNV-1a hash of @key (NOT a string), the same one the tokenizer stores in key_hash. */
+uint32_t iotx_ds_json_hash(const char *key, uint32_t key_len);
+
+/* return index of the member @key (NOT a string) of object @parent, -1 if not found. */
+int iotx_ds_json_find(const iotx_ds_json_t *pjson, int parent, const char *key, uint32_t key_len);
+
+/* same as iotx_ds_json_find() with the hash of @key known. @hint is a member of @parent or -1,
+ * it is checked first: passing the next sibling of the previous match walks two objects with the
+ * same key order at one comparison per key. */
+int iotx_ds_json_find_hinted(const iotx_ds_json_t *pjson,
+                             int parent,
+                             int hint,
+                             const char *key,
+                             uint32_t key_len,
+                             uint32_t key_hash);
+
+/* return index of the dotted @path like "payload.state.desired" under @parent, -1 if not found. */
+int iotx_ds_json_path(const iotx_ds_json_t *pjson, int parent, const char *path);
+
+/* return index of the first child of @parent, -1 if it is empty or not a container. */
+int iotx_ds_json_child(const iotx_ds_json_t *pjson, int parent);
+
+/* return pointer to the value of token @index in the document, NOT a string. */
+const char *iotx_ds_json_value(const iotx_ds_json_t *pjson, int index, uint32_t *value_len);
+
+/* check if value of token @index is the string or literal @str. */
+bool iotx_ds_json_value_equal(const iotx_ds_json_t *pjson, int index, const char *str);
+
+/* convert an unsigned integer value, return 0 if it is not a number. */
+uint32_t iotx_ds_json_value_uint32(const iotx_ds_json_t *pjson, int index);
+
+#endif /* _IOTX_SHADOW_PARSER_H_ */
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include "iot_import.h"
+
+#include "lite-log.h"
+#include "lite-utils.h"
+#include "utils_timer.h"
+#include "shadow_report.h"
+#include "shadow_parser.h"
+#include "shadow_codec.h"
+
+/* room kept for "}}" and the clientToken/version tail of iotx_ds_common_format_finalize() */
+#define IOTX_DS_REPORT_TAIL_LEN     (128)
+
+
+void iotx_ds_report_init(iotx_shadow_pt pshadow)
+{
+    iotx_shadow_report_pt preport = &pshadow->inner_data.report;
+
+    memset(preport, 0, sizeof(iotx_shadow_report_t));
+    preport->window_ms = IOTX_DS_REPORT_WINDOW_MS;
+    preport->ack_code = IOTX_SHADOW_ACK_NONE;
+    iotx_time_init(&preport->timer);
+}
+
+
+/* NOTE: the shadow mutex must be held. */
+static void iotx_ds_report_set_dirty(iotx_shadow_pt pshadow, iotx_shadow_attr_entry_pt pentry)
+{
+    iotx_shadow_report_pt preport = &pshadow->inner_data.report;
+
+    if (pentry->report_flags & IOTX_DS_ATTR_DIRTY) {
+        return;
+    }
+
+    pentry->report_flags |= IOTX_DS_ATTR_DIRTY;
+    if (0 == preport->dirty_count++) {
+        utils_time_countdown_ms(&preport->timer, preport->window_ms);
+    }
+}
+
+
+iotx_err_t iotx_ds_report_mark(iotx_shadow_pt pshadow, iotx_shadow_attr_pt pattr)
+{
+    iotx_shadow_attr_entry_pt pentry;
+    uint32_t name_len = strlen(pattr->pattr_name);
+
+    HAL_MutexLock(pshadow->mutex);
+    pentry = iotx_ds_common_find_entry(pshadow, pattr->pattr_name, name_len,
+                                       iotx_ds_json_hash(pattr->pattr_name, name_len));
+    if ((NULL == pentry) || (pentry->pattr != pattr)) {
+        HAL_MutexUnlock(pshadow->mutex);
+        return ERROR_SHADOW_ATTR_NO_EXIST;
+    }
+
+    iotx_ds_report_set_dirty(pshadow, pentry);
+    HAL_MutexUnlock(pshadow->mutex);
+
+    return SUCCESS_RETURN;
+}
+
+
+/* length of "name":value, in the report of every registered attribute */
+static uint32_t iotx_ds_report_attr_len(iotx_shadow_attr_entry_pt pentry)
+{
+    return pentry->name_len + 3 + iotx_ds_codec_encoded_len(pentry->pattr->attr_type, pentry->pattr->pattr_data) + 1;
+}
+
+
+/* NOTE: the shadow mutex must be held. */
+static void iotx_ds_report_ack(iotx_shadow_pt pshadow, int ack_code)
+{
+    uint32_t i;
+    iotx_shadow_attr_entry_pt pentry;
+    iotx_shadow_report_pt preport = &pshadow->inner_data.report;
+    iotx_shadow_attr_table_pt ptable = &pshadow->inner_data.attr_table;
+
+    for (i = 0; i < ptable->size; ++i) {
+        for (pentry = ptable->buckets[i]; NULL != pentry; pentry = pentry->next) {
+            if (!(pentry->report_flags & IOTX_DS_ATTR_INFLIGHT)) {
+                continue;
+            }
+
+            pentry->report_flags &= ~IOTX_DS_ATTR_INFLIGHT;
+            if (IOTX_SHADOW_ACK_SUCCESS == ack_code) {
+                pentry->report_flags |= IOTX_DS_ATTR_ACKED;
+                pentry->acked_hash = pentry->sent_hash;
+                pentry->acked_version = pshadow->inner_data.cloud_version;
+            } else {
+                /* report it again in the next window */
+                iotx_ds_report_set_dirty(pshadow, pentry);
+            }
+        }
+    }
+
+    if (IOTX_SHADOW_ACK_SUCCESS == ack_code) {
+        ++preport->stats.acked;
+    } else {
+        log_warning("shadow report failed, ack_code=%d", ack_code);
+    }
+
+    preport->busy = false;
+    preport->ack_code = IOTX_SHADOW_ACK_NONE;
+}
+
+
+/* NOTE: it may be called with or without the shadow mutex, handled by the next yield */
+static void iotx_ds_report_ack_cb(
+            void *pcontext,
+            int ack_code,
+            const char *ack_msg,
+            uint32_t ack_msg_len)
+{
+    ((iotx_shadow_pt)pcontext)->inner_data.report.ack_code = ack_code;
+}
+
+
+/* add the dirty attributes which fit in @pformat, return number of attributes added */
+static int iotx_ds_report_format(iotx_shadow_pt pshadow, format_data_pt pformat)
+{
+    int count = 0;
+    uint32_t i, offset, start, hash;
+    bool flag_new;
+    iotx_shadow_attr_entry_pt pentry;
+    iotx_shadow_report_pt preport = &pshadow->inner_data.report;
+    iotx_shadow_attr_table_pt ptable = &pshadow->inner_data.attr_table;
+
+    for (i = 0; i < ptable->size; ++i) {
+        for (pentry = ptable->buckets[i]; NULL != pentry; pentry = pentry->next) {
+            if (!(pentry->report_flags & IOTX_DS_ATTR_DIRTY)) {
+                preport->stats.bytes_saved += iotx_ds_report_attr_len(pentry);
+                continue;
+            }
+
+            offset = pformat->offset;
+            flag_new = pformat->flag_new;
+            if (SUCCESS_RETURN != iotx_ds_common_format_add(pshadow, pformat, pentry->pattr->pattr_name,
+                    pentry->pattr->pattr_data, pentry->pattr->attr_type)) {
+                pformat->offset = offset;
+                pformat->flag_new = flag_new;
+                pformat->buf[offset] = '\0';
+
+                if (flag_new) {
+                    /* it does not fit even alone */
+                    log_err("attribute '%s' is too large to report", pentry->pattr->pattr_name);
+                    pentry->report_flags &= ~IOTX_DS_ATTR_DIRTY;
+                    --preport->dirty_count;
+                }
+                /* otherwise it waits for the next report */
+                preport->stats.bytes_saved += iotx_ds_report_attr_len(pentry);
+                continue;
+            }
+
+            start = flag_new ? offset : offset + 1;
+            hash = iotx_ds_json_hash(pformat->buf + start, pformat->offset - start);
+            pentry->report_flags &= ~IOTX_DS_ATTR_DIRTY;
+            --preport->dirty_count;
+
+            /* cloud holds this value and nobody changed the document since it acknowledged it */
+            if ((pentry->report_flags & IOTX_DS_ATTR_ACKED) && (pentry->acked_hash == hash)
+                && (pentry->acked_version == pshadow->inner_data.cloud_version)) {
+                preport->stats.bytes_saved += pformat->offset - start + 1;
+                pformat->offset = offset;
+                pformat->flag_new = flag_new;
+                pformat->buf[offset] = '\0';
+                ++preport->stats.attrs_suppressed;
+                continue;
+            }
+
+            pentry->report_flags |= IOTX_DS_ATTR_INFLIGHT;
+            pentry->sent_hash = hash;
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+
+void iotx_ds_report_handle(iotx_shadow_pt pshadow)
+{
+    int rc, count;
+    char *buf;
+    format_data_t format;
+    iotx_shadow_report_pt preport = &pshadow->inner_data.report;
+
+    HAL_MutexLock(pshadow->mutex);
+    if (preport->busy) {
+        if (IOTX_SHADOW_ACK_NONE == preport->ack_code) {
+            HAL_MutexUnlock(pshadow->mutex);
+            return;
+        }
+        iotx_ds_report_ack(pshadow, preport->ack_code);
+    }
+
+    if ((0 == preport->dirty_count) || !utils_time_is_expired(&preport->timer)) {
+        HAL_MutexUnlock(pshadow->mutex);
+        return;
+    }
+    HAL_MutexUnlock(pshadow->mutex);
+
+    buf = LITE_malloc(IOTX_DS_REPORT_MSG_LEN);
+    if (NULL == buf) {
+        log_err("Not enough memory");
+        return;
+    }
+
+    rc = iotx_ds_common_format_init(pshadow, &format, buf, IOTX_DS_REPORT_MSG_LEN - IOTX_DS_REPORT_TAIL_LEN,
+                                    "update", "\"state\":{\"reported\":{");
+    if (SUCCESS_RETURN != rc) {
+        LITE_free(buf);
+        return;
+    }
+
+    HAL_MutexLock(pshadow->mutex);
+    count = iotx_ds_report_format(pshadow, &format);
+    if (0 == count) {
+        HAL_MutexUnlock(pshadow->mutex);
+        LITE_free(buf);
+        return;
+    }
+    preport->busy = true;
+    preport->ack_code = IOTX_SHADOW_ACK_NONE;
+    HAL_MutexUnlock(pshadow->mutex);
+
+    format.buf_size = IOTX_DS_REPORT_MSG_LEN;
+    iotx_ds_common_format_finalize(pshadow, &format, "}}");
+
+    rc = IOT_Shadow_Push_Async(pshadow, format.buf, format.offset, IOTX_DS_REPORT_TIMEOUT_S,
+                               iotx_ds_report_ack_cb, pshadow);
+
+    HAL_MutexLock(pshadow->mutex);
+    if (SUCCESS_RETURN != rc) {
+        log_err("publish shadow report failed, rc=%d", rc);
+        iotx_ds_report_ack(pshadow, rc);
+    } else {
+        ++preport->stats.reports;
+        preport->stats.attrs_sent += count;
+        preport->stats.bytes_sent += format.offset;
+    }
+    HAL_MutexUnlock(pshadow->mutex);
+
+    LITE_free(buf);
+}
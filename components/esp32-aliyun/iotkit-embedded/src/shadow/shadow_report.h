@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#ifndef _IOTX_SHADOW_REPORT_H_
+#define _IOTX_SHADOW_REPORT_H_
+
+#include "iot_import.h"
+#include "shadow.h"
+#include "shadow_config.h"
+#include "shadow_common.h"
+
+
+void iotx_ds_report_init(iotx_shadow_pt pshadow);
+
+iotx_err_t iotx_ds_report_mark(iotx_shadow_pt pshadow, iotx_shadow_attr_pt pattr);
+
+/* publish the changed attributes once the report window elapsed, called by IOT_Shadow_Yield() */
+void iotx_ds_report_handle(iotx_shadow_pt pshadow);
+
+#endif /* _IOTX_SHADOW_REPORT_H_ */
@@ -28,8 +28,106 @@
 
 extern void iotx_shadow_delta_entry(
             iotx_shadow_pt pshadow,
-            const char *json_doc,
-            size_t json_doc_len);
+            const iotx_ds_json_t *pjson);
+
+
+/* deadlines are compared modulo 2^32 as HAL_UptimeMs() wraps around */
+#define IOTX_DS_ACK_BEFORE(a, b)    ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
+
+#define IOTX_DS_ACK_HEAP_INIT_NUM   (8)
+
+static const uint32_t iotx_ds_ack_latency_bounds[IOTX_SHADOW_ACK_LATENCY_BUCKETS - 1] = {
+    50, 100, 200, 500, 1000, 2000, 5000
+};
+
+
+static void iotx_ds_ack_heap_set(iotx_update_ack_table_pt ptable, int index, iotx_update_ack_wait_list_pt pelement)
+{
+    ptable->heap[index] = pelement;
+    pelement->heap_index = index;
+}
+
+
+static void iotx_ds_ack_heap_up(iotx_update_ack_table_pt ptable, int index)
+{
+    int parent;
+    iotx_update_ack_wait_list_pt pelement = ptable->heap[index];
+
+    while (index > 0) {
+        parent = (index - 1) / 2;
+        if (!IOTX_DS_ACK_BEFORE(pelement->deadline_ms, ptable->heap[parent]->deadline_ms)) {
+            break;
+        }
+        iotx_ds_ack_heap_set(ptable, index, ptable->heap[parent]);
+        index = parent;
+    }
+    iotx_ds_ack_heap_set(ptable, index, pelement);
+}
+
+
+static void iotx_ds_ack_heap_down(iotx_update_ack_table_pt ptable, int index)
+{
+    int child;
+    iotx_update_ack_wait_list_pt pelement = ptable->heap[index];
+
+    while ((child = 2 * index + 1) < ptable->count) {
+        if ((child + 1 < ptable->count)
+            && IOTX_DS_ACK_BEFORE(ptable->heap[child + 1]->deadline_ms, ptable->heap[child]->deadline_ms)) {
+            ++child;
+        }
+        if (!IOTX_DS_ACK_BEFORE(ptable->heap[child]->deadline_ms, pelement->deadline_ms)) {
+            break;
+        }
+        iotx_ds_ack_heap_set(ptable, index, ptable->heap[child]);
+        index = child;
+    }
+    iotx_ds_ack_heap_set(ptable, index, pelement);
+}
+
+
+/* NOTE: the shadow mutex must be held. */
+static void iotx_ds_ack_unlink(iotx_update_ack_table_pt ptable, iotx_update_ack_wait_list_pt pelement)
+{
+    int index = pelement->heap_index;
+    iotx_update_ack_wait_list_pt *pplink;
+
+    pplink = &ptable->buckets[pelement->token_hash & (IOTX_DS_UPDATE_WAIT_ACK_HASH_SIZE - 1)];
+    while (*pplink != pelement) {
+        pplink = &(*pplink)->next;
+    }
+    *pplink = pelement->next;
+
+    if (index != --ptable->count) {
+        iotx_ds_ack_heap_set(ptable, index, ptable->heap[ptable->count]);
+        iotx_ds_ack_heap_down(ptable, index);
+        iotx_ds_ack_heap_up(ptable, ptable->heap[index]->heap_index);
+    }
+    ptable->stats.pending = ptable->count;
+}
+
+
+/* NOTE: the shadow mutex must be held. */
+static void iotx_ds_ack_account(iotx_update_ack_table_pt ptable, iotx_update_ack_wait_list_pt pelement)
+{
+    int i;
+    uint32_t latency = utils_time_get_ms() - pelement->start_ms;
+
+    if ((0 == ptable->stats.acked) || (latency < ptable->stats.latency_min_ms)) {
+        ptable->stats.latency_min_ms = latency;
+    }
+    if (latency > ptable->stats.latency_max_ms) {
+        ptable->stats.latency_max_ms = latency;
+    }
+    ++ptable->stats.acked;
+    ptable->latency_sum_ms += latency;
+
+    for (i = 0; i < IOTX_SHADOW_ACK_LATENCY_BUCKETS - 1; ++i) {
+        if (latency < iotx_ds_ack_latency_bounds[i]) {
+            break;
+        }
+    }
+    ++ptable->stats.latency_hist[i];
+}
 
 
 /* add a new wait element */
@@ -42,167 +140,226 @@ iotx_update_ack_wait_list_pt iotx_shadow_update_wait_ack_list_add(
             void *pcontext,
             uint32_t timeout)
 {
-    int i;
-    iotx_update_ack_wait_list_pt list = pshadow->inner_data.update_ack_wait_list;
+    uint32_t capacity;
+    iotx_update_ack_wait_list_pt pelement, *heap;
+    iotx_update_ack_table_pt ptable = &pshadow->inner_data.update_ack_table;
+
+    if (token_len >= IOTX_DS_TOKEN_LEN) {
+        log_err("token is too long.");
+        return NULL;
+    }
 
     HAL_MutexLock(pshadow->mutex);
 
-    for (i = 0; i < IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM; ++i) {
-        if (0 == list[i].flag_busy) {
-            list[i].flag_busy = 1;
-            break;
-        }
+    if (ptable->count >= IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM) {
+        ++ptable->stats.overflows;
+        HAL_MutexUnlock(pshadow->mutex);
+        log_err("%d updates are waiting for ACK already", IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM);
+        return NULL;
     }
 
-    HAL_MutexUnlock(pshadow->mutex);
+    if (ptable->count >= ptable->capacity) {
+        capacity = (0 == ptable->capacity) ? IOTX_DS_ACK_HEAP_INIT_NUM : ptable->capacity * 2;
+        capacity = LITE_MINIMUM(capacity, IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM);
+        heap = LITE_malloc(capacity * sizeof(iotx_update_ack_wait_list_pt));
+        if (NULL == heap) {
+            HAL_MutexUnlock(pshadow->mutex);
+            return NULL;
+        }
+        if (NULL != ptable->heap) {
+            memcpy(heap, ptable->heap, ptable->count * sizeof(iotx_update_ack_wait_list_pt));
+            LITE_free(ptable->heap);
+        }
+        ptable->heap = heap;
+        ptable->capacity = capacity;
+    }
 
-    if (i >= IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM) {
+    pelement = LITE_malloc(sizeof(iotx_update_ack_wait_list_t) + token_len);
+    if (NULL == pelement) {
+        HAL_MutexUnlock(pshadow->mutex);
         return NULL;
     }
 
-    list[i].callback = cb;
-    list[i].pcontext = pcontext;
-
-    if (token_len >= IOTX_DS_TOKEN_LEN) {
-        log_warning("token is too long.");
-        token_len = IOTX_DS_TOKEN_LEN - 1;
+    pelement->token = (char *)(pelement + 1);
+    memcpy(pelement->token, ptoken, token_len);
+    pelement->token_len = token_len;
+    pelement->token_hash = iotx_ds_json_hash(ptoken, token_len);
+    pelement->callback = cb;
+    pelement->pcontext = pcontext;
+    pelement->start_ms = utils_time_get_ms();
+    pelement->deadline_ms = pelement->start_ms + timeout * 1000;
+
+    pelement->next = ptable->buckets[pelement->token_hash & (IOTX_DS_UPDATE_WAIT_ACK_HASH_SIZE - 1)];
+    ptable->buckets[pelement->token_hash & (IOTX_DS_UPDATE_WAIT_ACK_HASH_SIZE - 1)] = pelement;
+    ptable->heap[ptable->count] = pelement;
+    iotx_ds_ack_heap_up(ptable, ptable->count++);
+
+    ptable->stats.pending = ptable->count;
+    if (ptable->count > ptable->stats.pending_max) {
+        ptable->stats.pending_max = ptable->count;
     }
-    memcpy(list[i].token, ptoken, token_len);
-    list[i].token[token_len] = '\0';
 
-    iotx_time_init(&list[i].timer);
-    utils_time_countdown_ms(&list[i].timer, timeout);
+    HAL_MutexUnlock(pshadow->mutex);
 
     log_debug("Add update ACK list");
 
-    return &list[i];
+    return pelement;
 }
 
 
 void iotx_shadow_update_wait_ack_list_remove(iotx_shadow_pt pshadow, iotx_update_ack_wait_list_pt element)
 {
     HAL_MutexLock(pshadow->mutex);
-    element->flag_busy = 0;
-    memset(element, 0, sizeof(iotx_update_ack_wait_list_t));
+    iotx_ds_ack_unlink(&pshadow->inner_data.update_ack_table, element);
     HAL_MutexUnlock(pshadow->mutex);
+
+    LITE_free(element);
 }
 
 
-void iotx_ds_update_wait_ack_list_handle_expire(iotx_shadow_pt pshadow)
+void iotx_ds_update_wait_ack_list_release(iotx_shadow_pt pshadow)
 {
-    size_t i;
+    iotx_update_ack_table_pt ptable = &pshadow->inner_data.update_ack_table;
+
+    while (ptable->count > 0) {
+        LITE_free(ptable->heap[--ptable->count]);
+    }
+    if (NULL != ptable->heap) {
+        LITE_free(ptable->heap);
+    }
+    memset(ptable->buckets, 0, sizeof(ptable->buckets));
+    ptable->capacity = 0;
+}
 
-    iotx_update_ack_wait_list_pt pelement = pshadow->inner_data.update_ack_wait_list;
+
+void iotx_ds_update_wait_ack_list_get_stats(iotx_shadow_pt pshadow, iotx_shadow_ack_stats_pt pstats)
+{
+    iotx_update_ack_table_pt ptable = &pshadow->inner_data.update_ack_table;
 
     HAL_MutexLock(pshadow->mutex);
+    memcpy(pstats, &ptable->stats, sizeof(iotx_shadow_ack_stats_t));
+    pstats->latency_avg_ms = (0 == ptable->stats.acked) ? 0 : ptable->latency_sum_ms / ptable->stats.acked;
+    HAL_MutexUnlock(pshadow->mutex);
+}
 
-    for (i = 0; i < IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM; ++i) {
-        if (0 != pelement[i].flag_busy) {
-            if (utils_time_is_expired(&pelement[i].timer)) {
-                if (NULL != pelement[i].callback) {
-                    pelement[i].callback(pelement[i].pcontext, IOTX_SHADOW_ACK_TIMEOUT, NULL, 0);
-                }
-                /* free it. */
-                memset(&pelement[i], 0, sizeof(iotx_update_ack_wait_list_t));
-            }
-        }
-    }
 
+void iotx_ds_update_wait_ack_list_handle_expire(iotx_shadow_pt pshadow)
+{
+    uint32_t now = utils_time_get_ms();
+    iotx_update_ack_wait_list_pt pelement, pexpired = NULL, *pptail = &pexpired;
+    iotx_update_ack_table_pt ptable = &pshadow->inner_data.update_ack_table;
+
+    /* only the earliest deadline has to be checked */
+    HAL_MutexLock(pshadow->mutex);
+    while ((ptable->count > 0) && !IOTX_DS_ACK_BEFORE(now, ptable->heap[0]->deadline_ms)) {
+        pelement = ptable->heap[0];
+        iotx_ds_ack_unlink(ptable, pelement);
+        ++ptable->stats.timeouts;
+
+        pelement->next = NULL;
+        *pptail = pelement;
+        pptail = &pelement->next;
+    }
     HAL_MutexUnlock(pshadow->mutex);
+
+    /* callbacks run without the mutex, in deadline order */
+    while (NULL != pexpired) {
+        pelement = pexpired;
+        pexpired = pelement->next;
+        if (NULL != pelement->callback) {
+            pelement->callback(pelement->pcontext, IOTX_SHADOW_ACK_TIMEOUT, NULL, 0);
+        }
+        LITE_free(pelement);
+    }
 }
 
 
 /* handle response ACK of UPDATE */
 void iotx_ds_update_wait_ack_list_handle_response(
             iotx_shadow_pt pshadow,
-            const char *json_doc,
-            size_t json_doc_len)
+            const iotx_ds_json_t *pjson)
 {
-    int i;
-    const char *pdata, *ppayload, *pToken;
-    iotx_update_ack_wait_list_pt pelement = pshadow->inner_data.update_ack_wait_list;
+    int index, payload;
+    const char *ptoken, *pdata;
+    uint32_t token_len, token_hash, data_len;
+    iotx_update_ack_wait_list_pt pelement;
+    iotx_update_ack_table_pt ptable = &pshadow->inner_data.update_ack_table;
 
     /* get token */
-    pdata = LITE_json_value_of("clientToken", (char *)json_doc);
-    if (NULL == pdata) {
+    index = iotx_ds_json_find(pjson, 0, "clientToken", strlen("clientToken"));
+    if (index < 0) {
         log_warning("Invalid JSON document: not 'clientToken' key");
         return;
     }
-    pToken = pdata;
+    ptoken = iotx_ds_json_value(pjson, index, &token_len);
+    token_hash = iotx_ds_json_hash(ptoken, token_len);
 
-    ppayload = LITE_json_value_of("payload", (char *)json_doc);
-    if (NULL == ppayload) {
+    payload = iotx_ds_json_find(pjson, 0, "payload", strlen("payload"));
+    if (payload < 0) {
         log_warning("Invalid JSON document: not 'payload' key");
-        LITE_free(pdata);
         return;
     } else {
-        log_debug("ppayload = %s", ppayload);
+        pdata = iotx_ds_json_value(pjson, payload, &data_len);
+        log_debug("ppayload = %.*s", (int)data_len, pdata);
     }
 
     HAL_MutexLock(pshadow->mutex);
-    for (i = 0; i < IOTX_DS_UPDATE_WAIT_ACK_LIST_NUM; ++i) {
-        if (0 != pelement[i].flag_busy) {
-            /* check the related */
-            if (0 == memcmp(pdata, pelement[i].token, strlen(pelement[i].token))) {
-                LITE_free(pdata);
-                HAL_MutexUnlock(pshadow->mutex);
-                log_debug("token=%s", pelement[i].token);
-                do {
-                    pdata = LITE_json_value_of("status", (char *)ppayload);
-                    if (NULL == pdata) {
-                        log_warning("Invalid JSON document: not 'payload.status' key");
-                        break;
-                    }
-
-                    if (0 == strncmp(pdata, "success", strlen(pdata))) {
-                        char    *temp = NULL;
-
-                        /* If have 'state' keyword in @json_shadow.payload, attribute value should be updated. */
-                        temp = LITE_json_value_of("state", (char *)ppayload);
-                        if (NULL != temp) {
-                            iotx_shadow_delta_entry(pshadow, json_doc, json_doc_len); /* update attribute */
-                            LITE_free(temp);
-                        }
-
-                        pelement[i].callback(pelement[i].pcontext, IOTX_SHADOW_ACK_SUCCESS, NULL, 0);
-                    } else if (0 == strncmp(pdata, "error", strlen(pdata))) {
-                        int ack_code;
-
-                        pdata = LITE_json_value_of("content.errorcode", (char *)ppayload);
-                        if (NULL == pdata) {
-                            log_warning("Invalid JSON document: not 'content.errorcode' key");
-                            break;
-                        }
-                        ack_code = atoi(pdata);
-                        LITE_free(pdata);
-
-                        pdata = LITE_json_value_of("content.errormessage", (char *)ppayload);
-                        if (NULL == pdata) {
-                            log_warning("Invalid JSON document: not 'content.errormessage' key");
-                            break;
-                        }
-
-                        pelement[i].callback(pelement[i].pcontext, ack_code, pdata, strlen(pdata));
-                        LITE_free(pdata);
-                    } else {
-                        log_warning("Invalid JSON document: value of 'status' key is invalid.");
-                        LITE_free(pdata);
-                    }
-
-                    LITE_free(pdata);
-                    LITE_free(ppayload);
-                } while (0);
-
-                HAL_MutexLock(pshadow->mutex);
-                memset(&pelement[i], 0, sizeof(iotx_update_ack_wait_list_t));
-                HAL_MutexUnlock(pshadow->mutex);
-                return;
-            }
+    for (pelement = ptable->buckets[token_hash & (IOTX_DS_UPDATE_WAIT_ACK_HASH_SIZE - 1)];
+         NULL != pelement;
+         pelement = pelement->next) {
+        if ((pelement->token_hash == token_hash) && (pelement->token_len == token_len)
+            && (0 == memcmp(pelement->token, ptoken, token_len))) {
+            break;
         }
     }
 
-    LITE_free(pToken);
-    LITE_free(ppayload);
+    if (NULL == pelement) {
+        HAL_MutexUnlock(pshadow->mutex);
+        log_warning("Not match any wait element in list.");
+        return;
+    }
+
+    iotx_ds_ack_unlink(ptable, pelement);
+    iotx_ds_ack_account(ptable, pelement);
     HAL_MutexUnlock(pshadow->mutex);
-    log_warning("Not match any wait element in list.");
+
+    log_debug("token=%.*s", (int)pelement->token_len, pelement->token);
+    do {
+        index = iotx_ds_json_find(pjson, payload, "status", strlen("status"));
+        if (index < 0) {
+            log_warning("Invalid JSON document: not 'payload.status' key");
+            break;
+        }
+
+        if (iotx_ds_json_value_equal(pjson, index, "success")) {
+            /* If have 'state' keyword in @json_shadow.payload, attribute value should be updated. */
+            if (iotx_ds_json_find(pjson, payload, "state", strlen("state")) >= 0) {
+                iotx_shadow_delta_entry(pshadow, pjson); /* update attribute */
+            }
+
+            pelement->callback(pelement->pcontext, IOTX_SHADOW_ACK_SUCCESS, NULL, 0);
+        } else if (iotx_ds_json_value_equal(pjson, index, "error")) {
+            int ack_code;
+
+            index = iotx_ds_json_path(pjson, payload, "content.errorcode");
+            if (index < 0) {
+                log_warning("Invalid JSON document: not 'content.errorcode' key");
+                break;
+            }
+            ack_code = atoi(iotx_ds_json_value(pjson, index, NULL));
+
+            index = iotx_ds_json_path(pjson, payload, "content.errormessage");
+            if (index < 0) {
+                log_warning("Invalid JSON document: not 'content.errormessage' key");
+                break;
+            }
+
+            pdata = iotx_ds_json_value(pjson, index, &data_len);
+            pelement->callback(pelement->pcontext, ack_code, pdata, data_len);
+        } else {
+            log_warning("Invalid JSON document: value of 'status' key is invalid.");
+        }
+    } while (0);
+
+    LITE_free(pelement);
 }
@@ -26,6 +26,7 @@
 #include "shadow.h"
 #include "shadow_config.h"
 #include "shadow_common.h"
+#include "shadow_parser.h"
 
 
 iotx_update_ack_wait_list_pt iotx_shadow_update_wait_ack_list_add(
@@ -38,12 +39,15 @@ iotx_update_ack_wait_list_pt iotx_shadow_update_wait_ack_list_add(
 
 void iotx_shadow_update_wait_ack_list_remove(iotx_shadow_pt pshadow, iotx_update_ack_wait_list_pt element);
 
+void iotx_ds_update_wait_ack_list_release(iotx_shadow_pt pshadow);
+
+void iotx_ds_update_wait_ack_list_get_stats(iotx_shadow_pt pshadow, iotx_shadow_ack_stats_pt pstats);
+
 void iotx_ds_update_wait_ack_list_handle_expire(iotx_shadow_pt pshadow);
 
 void iotx_ds_update_wait_ack_list_handle_response(
             iotx_shadow_pt pshadow,
-            const char *json_doc,
-            size_t json_doc_len);
+            const iotx_ds_json_t *pjson);
 
 
 #endif /* _IOTX_SHADOW_UPDATE_H_ */
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Cost of handling one 'control' message of the device shadow with N registered
+ * attributes, all of them present in the delta:
+ *
+ *   rescan : what the shadow did before, one LITE_json_value_of() per key
+ *   index  : iotx_ds_json_parse() once, then lookups in the token index
+ *
+ *   ./bench [-n rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "iot_import.h"
+#include "lite-utils.h"
+#include "shadow_parser.h"
+
+static unsigned long bench_mallocs;
+
+void *HAL_Malloc(uint32_t size)
+{
+    ++bench_mallocs;
+    return malloc(size);
+}
+
+void HAL_Free(void *ptr)
+{
+    free(ptr);
+}
+
+void HAL_Printf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+int HAL_Snprintf(char *str, const int len, const char *fmt, ...)
+{
+    int ret;
+    va_list args;
+
+    va_start(args, fmt);
+    ret = vsnprintf(str, len, fmt, args);
+    va_end(args);
+
+    return ret;
+}
+
+static double bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* a control message as pushed by the cloud, every attribute in desired and metadata */
+static char *bench_document(int attrs)
+{
+    int i, off = 0, size = 256 + attrs * 64;
+    char *doc = malloc(size);
+
+    off += sprintf(doc + off, "{\"method\":\"control\",\"payload\":{\"status\":\"success\",\"state\":{\"desired\":{");
+    for (i = 0; i < attrs; i++) {
+        off += sprintf(doc + off, "%s\"attr%d\":%d", i ? "," : "", i, i * 7);
+    }
+    off += sprintf(doc + off, "}},\"metadata\":{\"desired\":{");
+    for (i = 0; i < attrs; i++) {
+        off += sprintf(doc + off, "%s\"attr%d\":{\"timestamp\":%d}", i ? "," : "", i, 1500000000 + i);
+    }
+    sprintf(doc + off, "}}},\"timestamp\":1500000999,\"version\":%d}", attrs);
+
+    return doc;
+}
+
+static unsigned long bench_rescan(char *doc, char **names, int attrs)
+{
+    int i;
+    unsigned long sum = 0;
+    char *pvalue, *pstate, *pmetadata, *pdata;
+
+    pvalue = LITE_json_value_of("timestamp", doc);
+    sum += atoi(pvalue);
+    LITE_free(pvalue);
+    pvalue = LITE_json_value_of("version", doc);
+    sum += atoi(pvalue);
+    LITE_free(pvalue);
+    pvalue = LITE_json_value_of("method", doc);
+    LITE_free(pvalue);
+
+    pstate = LITE_json_value_of("payload.state.desired", doc);
+    pmetadata = LITE_json_value_of("payload.metadata.desired", doc);
+    for (i = 0; i < attrs; i++) {
+        pvalue = LITE_json_value_of(names[i], pstate);
+        if (NULL != pvalue) {
+            pdata = LITE_json_value_of(names[i], pmetadata);
+            if (NULL != pdata) {
+                char *ptimestamp = LITE_json_value_of("timestamp", pdata);
+                sum += atoi(ptimestamp);
+                LITE_free(ptimestamp);
+                LITE_free(pdata);
+            }
+            sum += atoi(pvalue);
+            LITE_free(pvalue);
+        }
+    }
+    LITE_free(pstate);
+    LITE_free(pmetadata);
+
+    return sum;
+}
+
+static unsigned long bench_index(const char *doc, uint32_t doc_len, char **names, int attrs)
+{
+    int i, index, state, metadata;
+    unsigned long sum = 0;
+    iotx_ds_json_t json;
+
+    if (SUCCESS_RETURN != iotx_ds_json_parse(&json, doc, doc_len)) {
+        iotx_ds_json_release(&json);
+        return 0;
+    }
+
+    sum += iotx_ds_json_value_uint32(&json, iotx_ds_json_find(&json, 0, "timestamp", 9));
+    sum += iotx_ds_json_value_uint32(&json, iotx_ds_json_find(&json, 0, "version", 7));
+    iotx_ds_json_value_equal(&json, iotx_ds_json_find(&json, 0, "method", 6), "control");
+
+    state = iotx_ds_json_path(&json, 0, "payload.state.desired");
+    metadata = iotx_ds_json_path(&json, 0, "payload.metadata.desired");
+    for (i = 0; i < attrs; i++) {
+        index = iotx_ds_json_find(&json, state, names[i], strlen(names[i]));
+        if (index >= 0) {
+            sum += iotx_ds_json_value_uint32(&json,
+                                             iotx_ds_json_path(&json, iotx_ds_json_find(&json, metadata, names[i], strlen(names[i])),
+                                                     "timestamp"));
+            sum += atoi(iotx_ds_json_value(&json, index, NULL));
+        }
+    }
+
+    iotx_ds_json_release(&json);
+
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    static const int attr_counts[] = {10, 100, 500};
+    int opt, rounds = 200, i, r, attrs;
+    unsigned long sum_rescan, sum_index, mallocs;
+    double start, rescan_us, index_us;
+    char *doc, **names;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-n rounds]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (rounds <= 0) {
+        return -1;
+    }
+
+    printf("%6s %8s | %12s %10s | %12s %10s | %8s\n",
+           "attrs", "bytes", "rescan us", "mallocs", "index us", "mallocs", "speedup");
+
+    for (i = 0; i < sizeof(attr_counts) / sizeof(attr_counts[0]); i++) {
+        attrs = attr_counts[i];
+        doc = bench_document(attrs);
+        names = malloc(attrs * sizeof(char *));
+        for (r = 0; r < attrs; r++) {
+            names[r] = malloc(16);
+            sprintf(names[r], "attr%d", r);
+        }
+
+        mallocs = bench_mallocs;
+        start = bench_now_us();
+        for (r = 0, sum_rescan = 0; r < rounds; r++) {
+            sum_rescan += bench_rescan(doc, names, attrs);
+        }
+        rescan_us = (bench_now_us() - start) / rounds;
+        mallocs = (bench_mallocs - mallocs) / rounds;
+
+        printf("%6d %8d | %12.1f %10lu |", attrs, (int)strlen(doc), rescan_us, mallocs);
+
+        mallocs = bench_mallocs;
+        start = bench_now_us();
+        for (r = 0, sum_index = 0; r < rounds; r++) {
+            sum_index += bench_index(doc, strlen(doc), names, attrs);
+        }
+        index_us = (bench_now_us() - start) / rounds;
+        mallocs = (bench_mallocs - mallocs) / rounds;
+
+        printf(" %12.1f %10lu | %7.1fx%s\n", index_us, mallocs, rescan_us / index_us,
+               sum_rescan == sum_index ? "" : "  MISMATCH");
+
+        for (r = 0; r < attrs; r++) {
+            free(names[r]);
+        }
+        free(names);
+        free(doc);
+    }
+
+    return 0;
+}
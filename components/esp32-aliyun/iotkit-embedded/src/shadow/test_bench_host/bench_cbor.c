@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/*
+ * Size and CPU cost of shadow documents as JSON text and as CBOR:
+ *
+ *   report  : an 'update' of N reported attributes, a third each int32, float and int64
+ *   control : a 'control' of N desired attributes with their metadata timestamps
+ *
+ * encode   : the document written from the attribute values, JSON by shadow_codec.c, CBOR by LITE_cbor_put_*()
+ * decode   : every number of the document read back, JSON by iotx_ds_json_parse(), CBOR by LITE_cbor_get()
+ * to/from  : the conversions the shadow does at the MQTT boundary in IOTX_SHADOW_FORMAT_CBOR,
+ *            a float with an integral value comes out of JSON as a shorter CBOR integer
+ *
+ *   ./bench_cbor [-n rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "iot_import.h"
+#include "lite-utils.h"
+#include "shadow_parser.h"
+#include "shadow_codec.h"
+#include "shadow_cbor.h"
+
+#define BENCH_BUF_LEN           (64 * 1024)
+
+void *HAL_Malloc(uint32_t size)
+{
+    return malloc(size);
+}
+
+void HAL_Free(void *ptr)
+{
+    free(ptr);
+}
+
+void HAL_Printf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+int HAL_Snprintf(char *str, const int len, const char *fmt, ...)
+{
+    int ret;
+    va_list args;
+
+    va_start(args, fmt);
+    ret = vsnprintf(str, len, fmt, args);
+    va_end(args);
+
+    return ret;
+}
+
+static double bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+typedef struct {
+    char name[16];
+    iotx_shadow_attr_datatype_t type;
+    int32_t i32;
+    float f;
+    int64_t i64;
+} bench_attr_t;
+
+static const void *bench_value(const bench_attr_t *pattr)
+{
+    return (IOTX_SHADOW_INT32 == pattr->type) ? (const void *)&pattr->i32 :
+           (IOTX_SHADOW_FLOAT == pattr->type) ? (const void *)&pattr->f : (const void *)&pattr->i64;
+}
+
+static int bench_json_put(char *buf, int len, const char *str)
+{
+    int n = strlen(str);
+
+    memcpy(buf + len, str, n);
+    return len + n;
+}
+
+static int bench_json_attrs(char *buf, int len, const bench_attr_t *attrs, int count, bool timestamps)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        len = bench_json_put(buf, len, i ? ",\"" : "\"");
+        len = bench_json_put(buf, len, attrs[i].name);
+        len = bench_json_put(buf, len, "\":");
+        if (timestamps) {
+            len = bench_json_put(buf, len, "{\"timestamp\":");
+            len += LITE_json_format_int(buf + len, 1500000000 + i);
+            buf[len++] = '}';
+        } else {
+            len += iotx_ds_codec_encode(buf + len, BENCH_BUF_LEN - len, attrs[i].type, bench_value(&attrs[i]));
+        }
+    }
+
+    return len;
+}
+
+static int bench_json_encode(char *buf, const bench_attr_t *attrs, int count, bool control)
+{
+    int len = 0;
+
+    if (control) {
+        len = bench_json_put(buf, len, "{\"method\":\"control\",\"payload\":{\"status\":\"success\",\"state\":{\"desired\":{");
+        len = bench_json_attrs(buf, len, attrs, count, false);
+        len = bench_json_put(buf, len, "}},\"metadata\":{\"desired\":{");
+        len = bench_json_attrs(buf, len, attrs, count, true);
+        len = bench_json_put(buf, len, "}}},\"timestamp\":1500000999,\"version\":12}");
+    } else {
+        len = bench_json_put(buf, len, "{\"method\":\"update\",\"state\":{\"reported\":{");
+        len = bench_json_attrs(buf, len, attrs, count, false);
+        len = bench_json_put(buf, len, "}},\"clientToken\":\"TestDevice-123\",\"version\":12}");
+    }
+
+    return len;
+}
+
+static void bench_cbor_attrs(lite_cbor_writer_t *pwriter, const bench_attr_t *attrs, int count, bool timestamps)
+{
+    int i;
+
+    LITE_cbor_put_map(pwriter, count);
+    for (i = 0; i < count; i++) {
+        LITE_cbor_put_text(pwriter, attrs[i].name, strlen(attrs[i].name));
+        if (timestamps) {
+            LITE_cbor_put_map(pwriter, 1);
+            LITE_cbor_put_text(pwriter, "timestamp", 9);
+            LITE_cbor_put_uint(pwriter, 1500000000 + i);
+        } else if (IOTX_SHADOW_INT32 == attrs[i].type) {
+            LITE_cbor_put_int(pwriter, attrs[i].i32);
+        } else if (IOTX_SHADOW_FLOAT == attrs[i].type) {
+            LITE_cbor_put_double(pwriter, attrs[i].f);
+        } else {
+            LITE_cbor_put_int(pwriter, attrs[i].i64);
+        }
+    }
+}
+
+static int bench_cbor_encode(uint8_t *buf, const bench_attr_t *attrs, int count, bool control)
+{
+    lite_cbor_writer_t writer;
+
+    LITE_cbor_writer_init(&writer, buf, BENCH_BUF_LEN);
+    LITE_cbor_put_map(&writer, 4);
+    LITE_cbor_put_text(&writer, "method", 6);
+    if (control) {
+        LITE_cbor_put_text(&writer, "control", 7);
+        LITE_cbor_put_text(&writer, "payload", 7);
+        LITE_cbor_put_map(&writer, 3);
+        LITE_cbor_put_text(&writer, "status", 6);
+        LITE_cbor_put_text(&writer, "success", 7);
+        LITE_cbor_put_text(&writer, "state", 5);
+        LITE_cbor_put_map(&writer, 1);
+        LITE_cbor_put_text(&writer, "desired", 7);
+        bench_cbor_attrs(&writer, attrs, count, false);
+        LITE_cbor_put_text(&writer, "metadata", 8);
+        LITE_cbor_put_map(&writer, 1);
+        LITE_cbor_put_text(&writer, "desired", 7);
+        bench_cbor_attrs(&writer, attrs, count, true);
+        LITE_cbor_put_text(&writer, "timestamp", 9);
+        LITE_cbor_put_uint(&writer, 1500000999);
+    } else {
+        LITE_cbor_put_text(&writer, "update", 6);
+        LITE_cbor_put_text(&writer, "state", 5);
+        LITE_cbor_put_map(&writer, 1);
+        LITE_cbor_put_text(&writer, "reported", 8);
+        bench_cbor_attrs(&writer, attrs, count, false);
+        LITE_cbor_put_text(&writer, "clientToken", 11);
+        LITE_cbor_put_text(&writer, "TestDevice-123", 14);
+    }
+    LITE_cbor_put_text(&writer, "version", 7);
+    LITE_cbor_put_uint(&writer, 12);
+
+    return writer.overflow ? -1 : (int)writer.offset;
+}
+
+/* read every number of the document */
+static double bench_json_decode(const char *doc, int len)
+{
+    int i;
+    double sum = 0, real;
+    int64_t integer;
+    const char *pvalue;
+    uint32_t value_len;
+    iotx_ds_json_t json;
+
+    if (SUCCESS_RETURN == iotx_ds_json_parse(&json, doc, len)) {
+        for (i = 0; i < json.count; i++) {
+            if (IOTX_DS_JSON_NUMBER != json.tokens[i].type) {
+                continue;
+            }
+            pvalue = iotx_ds_json_value(&json, i, &value_len);
+            if ((NULL == memchr(pvalue, '.', value_len))
+                && (SUCCESS_RETURN == iotx_ds_codec_parse_int64(pvalue, value_len, &integer))) {
+                sum += integer;
+            } else if (SUCCESS_RETURN == iotx_ds_codec_parse_double(pvalue, value_len, &real)) {
+                sum += real;
+            }
+        }
+    }
+    iotx_ds_json_release(&json);
+
+    return sum;
+}
+
+static double bench_cbor_decode(const uint8_t *doc, int len)
+{
+    double sum = 0;
+    lite_cbor_reader_t reader;
+    lite_cbor_item_t item;
+
+    LITE_cbor_reader_init(&reader, doc, len);
+    while ((reader.offset < reader.len) && (0 == LITE_cbor_get(&reader, &item))) {
+        if (LITE_CBOR_UINT == item.type) {
+            sum += (double)item.value;
+        } else if (LITE_CBOR_NEGINT == item.type) {
+            sum -= (double)item.value + 1;
+        } else if (LITE_CBOR_FLOAT == item.type) {
+            sum += item.real;
+        }
+    }
+
+    return sum;
+}
+
+static int bench_to_cbor(const char *doc, int len, uint8_t *buf)
+{
+    iotx_ds_json_t json;
+
+    if (SUCCESS_RETURN == iotx_ds_json_parse(&json, doc, len)) {
+        len = iotx_ds_cbor_from_json(&json, buf, BENCH_BUF_LEN);
+    } else {
+        len = -1;
+    }
+    iotx_ds_json_release(&json);
+
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    static const int attr_counts[] = {10, 100};
+    int opt, rounds = 2000, i, r, k, count, json_len, cbor_len;
+    bool control;
+    double start, t_json_enc, t_cbor_enc, t_json_dec, t_cbor_dec, t_to, t_from, sum_json, sum_cbor;
+    char *json, *text;
+    uint8_t *cbor, *converted;
+    bench_attr_t *attrs;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-n rounds]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (rounds <= 0) {
+        return -1;
+    }
+
+    json = malloc(BENCH_BUF_LEN);
+    text = malloc(BENCH_BUF_LEN);
+    cbor = malloc(BENCH_BUF_LEN);
+    converted = malloc(BENCH_BUF_LEN);
+    attrs = malloc(100 * sizeof(bench_attr_t));
+    for (i = 0; i < 100; i++) {
+        sprintf(attrs[i].name, "attr%d", i);
+        attrs[i].type = (0 == i % 3) ? IOTX_SHADOW_INT32 : (1 == i % 3) ? IOTX_SHADOW_FLOAT : IOTX_SHADOW_INT64;
+        attrs[i].i32 = 1000 + i * 37;
+        attrs[i].f = 20.5f + i * 0.25f;
+        attrs[i].i64 = 1500000000000LL + i;
+    }
+
+    printf("%-12s | %6s %6s %6s | %8s %8s | %8s %8s | %8s %8s\n", "document", "JSON", "CBOR", "ratio",
+           "enc JSON", "enc CBOR", "dec JSON", "dec CBOR", "to CBOR", "to JSON");
+
+    for (k = 0; k < 4; k++) {
+        count = attr_counts[k % 2];
+        control = (k >= 2);
+
+        json_len = bench_json_encode(json, attrs, count, control);
+        cbor_len = bench_cbor_encode(cbor, attrs, count, control);
+
+        start = bench_now_us();
+        for (r = 0; r < rounds; r++) {
+            bench_json_encode(json, attrs, count, control);
+        }
+        t_json_enc = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0; r < rounds; r++) {
+            bench_cbor_encode(cbor, attrs, count, control);
+        }
+        t_cbor_enc = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0, sum_json = 0; r < rounds; r++) {
+            sum_json = bench_json_decode(json, json_len);
+        }
+        t_json_dec = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0, sum_cbor = 0; r < rounds; r++) {
+            sum_cbor = bench_cbor_decode(cbor, cbor_len);
+        }
+        t_cbor_dec = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0; r < rounds; r++) {
+            bench_to_cbor(json, json_len, converted);
+        }
+        t_to = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0; r < rounds; r++) {
+            LITE_cbor_to_json(cbor, cbor_len, text, BENCH_BUF_LEN);
+        }
+        t_from = (bench_now_us() - start) / rounds;
+
+        printf("%-7s %4d | %6d %6d %5.2fx | %6.1fus %6.1fus | %6.1fus %6.1fus | %6.1fus %6.1fus%s\n",
+               control ? "control" : "report", count, json_len, cbor_len, (double)json_len / cbor_len,
+               t_json_enc, t_cbor_enc, t_json_dec, t_cbor_dec, t_to, t_from,
+               ((sum_json != sum_cbor) || (bench_cbor_decode(converted, bench_to_cbor(json, json_len, converted)) != sum_cbor))
+               ? "  MISMATCH" : "");
+    }
+
+    free(attrs);
+    free(converted);
+    free(cbor);
+    free(text);
+    free(json);
+
+    return 0;
+}
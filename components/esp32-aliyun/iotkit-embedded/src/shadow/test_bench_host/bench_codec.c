@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/*
+ * Serialization throughput of attribute values: HAL_Snprintf() with a format
+ * string, as the shadow formatted them before, against shadow_codec.c and the
+ * LITE-utils formatters it uses. The decode side compares atoi()/strtod() with the bounded
+ * parsers, which read the value in place.
+ *
+ *   ./bench_codec [-n values]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "iot_import.h"
+#include "shadow_codec.h"
+
+void *HAL_Malloc(uint32_t size)
+{
+    return malloc(size);
+}
+
+void HAL_Free(void *ptr)
+{
+    free(ptr);
+}
+
+void HAL_Printf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+int HAL_Snprintf(char *str, const int len, const char *fmt, ...)
+{
+    int ret;
+    va_list args;
+
+    va_start(args, fmt);
+    ret = vsnprintf(str, len, fmt, args);
+    va_end(args);
+
+    return ret;
+}
+
+static double bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void bench_report(const char *name, double snprintf_us, double codec_us, unsigned long bytes)
+{
+    printf("%-10s | %10.1f MB/s | %10.1f MB/s | %6.1fx\n", name,
+           bytes / snprintf_us, bytes / codec_us, snprintf_us / codec_us);
+}
+
+int main(int argc, char **argv)
+{
+    int opt, i, count = 1000000, len;
+    unsigned long bytes, sum;
+    double start, snprintf_us, codec_us, real;
+    int64_t integer;
+    int32_t *ints;
+    int64_t *longs;
+    double *reals;
+    float *floats;
+    char *out, number[IOTX_DS_CODEC_NUMBER_LEN];
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-n values]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (count <= 0) {
+        return -1;
+    }
+
+    ints = malloc(count * sizeof(int32_t));
+    longs = malloc(count * sizeof(int64_t));
+    reals = malloc(count * sizeof(double));
+    floats = malloc(count * sizeof(float));
+    out = malloc(count * IOTX_DS_CODEC_NUMBER_LEN);
+    srand(1);
+    for (i = 0; i < count; i++) {
+        ints[i] = rand() - RAND_MAX / 2;
+        longs[i] = (int64_t)1500000000000LL + rand();
+        reals[i] = (rand() - RAND_MAX / 2) / 1000.0;
+        floats[i] = (float)((rand() % 100000 - 50000) / 100.0);
+    }
+
+    printf("%-10s | %15s | %15s | %7s\n", "encode", "snprintf", "codec", "speedup");
+
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        bytes += HAL_Snprintf(out + bytes, IOTX_DS_CODEC_NUMBER_LEN, "%" PRIi32, ints[i]);
+    }
+    snprintf_us = bench_now_us() - start;
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        bytes += iotx_ds_codec_encode(out + bytes, IOTX_DS_CODEC_NUMBER_LEN, IOTX_SHADOW_INT32, &ints[i]);
+    }
+    codec_us = bench_now_us() - start;
+    bench_report("int32", snprintf_us, codec_us, bytes);
+
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        bytes += HAL_Snprintf(out + bytes, IOTX_DS_CODEC_NUMBER_LEN, "%" PRIi64, longs[i]);
+    }
+    snprintf_us = bench_now_us() - start;
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        bytes += iotx_ds_codec_encode(out + bytes, IOTX_DS_CODEC_NUMBER_LEN, IOTX_SHADOW_INT64, &longs[i]);
+    }
+    codec_us = bench_now_us() - start;
+    bench_report("int64", snprintf_us, codec_us, bytes);
+
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        bytes += HAL_Snprintf(out + bytes, IOTX_DS_CODEC_NUMBER_LEN, "%.17g", reals[i]);
+    }
+    snprintf_us = bench_now_us() - start;
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        bytes += iotx_ds_codec_encode(out + bytes, IOTX_DS_CODEC_NUMBER_LEN, IOTX_SHADOW_DOUBLE, &reals[i]);
+    }
+    codec_us = bench_now_us() - start;
+    bench_report("double", snprintf_us, codec_us, bytes);
+
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        bytes += HAL_Snprintf(out + bytes, IOTX_DS_CODEC_NUMBER_LEN, "%.9g", floats[i]);
+    }
+    snprintf_us = bench_now_us() - start;
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        bytes += iotx_ds_codec_encode(out + bytes, IOTX_DS_CODEC_NUMBER_LEN, IOTX_SHADOW_FLOAT, &floats[i]);
+    }
+    codec_us = bench_now_us() - start;
+    bench_report("float", snprintf_us, codec_us, bytes);
+
+    /* every value must read back as it was */
+    for (i = 0, sum = 0; i < count; i++) {
+        len = LITE_json_format_real(number, reals[i], 0);
+        if ((SUCCESS_RETURN != iotx_ds_codec_parse_double(number, len, &real)) || (real != reals[i])) {
+            ++sum;
+        }
+        len = LITE_json_format_real(number, floats[i], 1);
+        if ((SUCCESS_RETURN != iotx_ds_codec_parse_double(number, len, &real)) || ((float)real != floats[i])) {
+            ++sum;
+        }
+        len = LITE_json_format_int(number, longs[i]);
+        if ((SUCCESS_RETURN != iotx_ds_codec_parse_int64(number, len, &integer)) || (integer != longs[i])) {
+            ++sum;
+        }
+    }
+    printf("round trip mismatches: %lu\n\n", sum);
+
+    printf("%-10s | %15s | %15s | %7s\n", "decode", "atoi/strtod", "codec", "speedup");
+
+    for (i = 0, bytes = 0; i < count; i++) {
+        len = LITE_json_format_int(out + bytes, longs[i]);
+        out[bytes + len] = '\0';
+        bytes += len + 1;
+    }
+    start = bench_now_us();
+    for (i = 0, bytes = 0, sum = 0; i < count; i++) {
+        len = strlen(out + bytes);
+        sum += strtoll(out + bytes, NULL, 10);
+        bytes += len + 1;
+    }
+    snprintf_us = bench_now_us() - start;
+    start = bench_now_us();
+    for (i = 0, bytes = 0; i < count; i++) {
+        len = strlen(out + bytes);
+        iotx_ds_codec_parse_int64(out + bytes, len, &integer);
+        sum -= integer;
+        bytes += len + 1;
+    }
+    codec_us = bench_now_us() - start;
+    bench_report("int64", snprintf_us, codec_us, bytes);
+
+    free(out);
+    free(floats);
+    free(reals);
+    free(longs);
+    free(ints);
+
+    return 0;
+}
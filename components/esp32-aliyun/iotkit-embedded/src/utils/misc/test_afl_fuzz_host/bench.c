@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+/*
+ * Cost of reading a response from a stream in memory, with the reads httpclient makes:
+ *
+ *   parser : httpclient_parser_execute() with reads of httpclient_parser_want()
+ *   legacy : the strstr()/sscanf() parsing it replaced, with the head read up to its CRLF CRLF,
+ *            chunk headers found in a buffer of 256 bytes and moved to its front
+ *
+ * and the reads of each, and those longer than the rest of the response, which a HAL would only
+ * return from on timeout.
+ *
+ *   ./bench [-n rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "utils_http_parser.h"
+
+#define BENCH_BODY_LEN      (64 * 1024)
+#define BENCH_CHUNK_SIZE    (256)           /* HTTPCLIENT_CHUNK_SIZE */
+
+typedef struct {
+    const char *data;
+    int         len;
+    int         pos;
+    int         reads;
+    int         stalls;         /* reads longer than the rest of the response */
+} bench_stream_t;
+
+static double bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* a HAL read: @max_len bytes, or what is left after waiting for the timeout */
+static int bench_read(bench_stream_t *stream, char *buf, int max_len)
+{
+    int len = stream->len - stream->pos;
+
+    stream->reads++;
+    if (max_len > len) {
+        stream->stalls++;
+    } else {
+        len = max_len;
+    }
+    memcpy(buf, stream->data + stream->pos, len);
+    stream->pos += len;
+    return len;
+}
+
+/* httpclient_retrieve_content() with a buffer for the whole body: the number of body bytes */
+static int bench_parser(bench_stream_t *stream, char *body, int body_size)
+{
+    httpclient_parser_t parser;
+    char frame[BENCH_CHUNK_SIZE];
+    char *data;
+    int count = 0, len, pos, n, body_len;
+    uint32_t want;
+
+    httpclient_parser_init(&parser);
+    while (!httpclient_parser_is_done(&parser)) {
+        want = httpclient_parser_want_body(&parser);
+        if (want >= sizeof(frame)) {
+            data = body + count;
+            len = (want < (uint32_t)(body_size - count)) ? (int)want : body_size - count;
+        } else {
+            data = frame;
+            want = httpclient_parser_want(&parser);
+            len = (want < sizeof(frame)) ? (int)want : (int)sizeof(frame);
+        }
+        len = bench_read(stream, data, len);
+        if (0 == len) {
+            return -1;
+        }
+        for (pos = 0; pos < len; pos += n) {
+            n = httpclient_parser_execute(&parser, data + pos, len - pos, &body_len);
+            if (n <= 0) {
+                return -1;
+            }
+            if (body_len > 0 && data == frame) {
+                memcpy(body + count, data + pos + n - body_len, body_len);
+            }
+            count += body_len;
+        }
+    }
+    return count;
+}
+
+/* the head, the status line and the headers parsed as before, with a memmove() after each line */
+static int bench_legacy_head(bench_stream_t *stream, char *data, int *p_len, int *p_content_len, int *p_chunked)
+{
+    static const char end[] = "\r\n\r\n";
+    int len = 0, want = 16, matched, code, crlf_pos;
+    char key[32], value[32], *crlf_ptr;
+
+    for (;;) {
+        len += bench_read(stream, data + len, want);
+        for (matched = 4; matched > 0; matched--) {
+            if (len >= matched && 0 == memcmp(data + len - matched, end, matched)) {
+                break;
+            }
+        }
+        if (4 == matched) {
+            break;
+        }
+        want = 4 - matched;
+        if (len + want >= BENCH_CHUNK_SIZE) {
+            return -1;
+        }
+    }
+    data[len] = '\0';
+
+    crlf_ptr = strstr(data, "\r\n");
+    crlf_pos = crlf_ptr - data;
+    data[crlf_pos] = '\0';
+    if (sscanf(data, "HTTP/%*d.%*d %d %*[^\r\n]", &code) != 1) {
+        return -1;
+    }
+    memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1);
+    len -= (crlf_pos + 2);
+
+    *p_content_len = -1;
+    *p_chunked = 0;
+    for (;;) {
+        crlf_ptr = strstr(data, "\r\n");
+        crlf_pos = crlf_ptr - data;
+        if (crlf_pos == 0) {
+            memmove(data, &data[2], len - 2 + 1);
+            len -= 2;
+            break;
+        }
+        data[crlf_pos] = '\0';
+        if (sscanf(data, "%31[^:]: %31[^\r\n]", key, value) != 2) {
+            return -1;
+        }
+        if (!strcmp(key, "Content-Length")) {
+            sscanf(value, "%d", p_content_len);
+        } else if (!strcmp(key, "Transfer-Encoding")) {
+            *p_chunked = !strcmp(value, "Chunked") || !strcmp(value, "chunked");
+        }
+        memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1);
+        len -= (crlf_pos + 2);
+    }
+
+    *p_len = len;
+    return code;
+}
+
+/* the body as before: reads of up to 255 bytes, chunk headers searched byte by byte and moved */
+static int bench_legacy(bench_stream_t *stream, char *body, int body_size)
+{
+    char data[BENCH_CHUNK_SIZE + 1];
+    int len, content_len, chunked, count = 0, crlf_pos, templen, found;
+    unsigned int readLen;
+
+    if (bench_legacy_head(stream, data, &len, &content_len, &chunked) < 0) {
+        return -1;
+    }
+
+    if (!chunked) {
+        for (readLen = content_len; ; ) {
+            templen = (len < (int)readLen) ? len : (int)readLen;
+            memcpy(body + count, data, templen);
+            count += templen;
+            readLen -= templen;
+            if (0 == readLen) {
+                return count;
+            }
+            len = bench_read(stream, data, readLen < BENCH_CHUNK_SIZE - 1 ? readLen : BENCH_CHUNK_SIZE - 1);
+            if (0 == len) {
+                return -1;
+            }
+        }
+    }
+
+    for (;;) {
+        do {
+            found = 0;
+            data[len] = 0;
+            for (crlf_pos = 0; len >= 2 && crlf_pos < len - 2; crlf_pos++) {
+                if (data[crlf_pos] == '\r' && data[crlf_pos + 1] == '\n') {
+                    found = 1;
+                    break;
+                }
+            }
+            if (!found) {
+                if (len >= BENCH_CHUNK_SIZE) {
+                    return -1;
+                }
+                len += bench_read(stream, data + len, BENCH_CHUNK_SIZE - len - 1);
+            }
+        } while (!found);
+        data[crlf_pos] = '\0';
+        if (sscanf(data, "%x", &readLen) != 1) {
+            return -1;
+        }
+        memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2));
+        len -= (crlf_pos + 2);
+        if (0 == readLen) {
+            return count;
+        }
+
+        do {
+            templen = (len < (int)readLen) ? len : (int)readLen;
+            memcpy(body + count, data, templen);
+            count += templen;
+            if (len > (int)readLen) {
+                memmove(data, &data[readLen], len - readLen);
+                len -= readLen;
+                readLen = 0;
+            } else {
+                readLen -= len;
+                len = 0;
+            }
+            if (readLen) {
+                len = bench_read(stream, data, readLen < BENCH_CHUNK_SIZE - 1 ? readLen : BENCH_CHUNK_SIZE - 1);
+            }
+        } while (readLen);
+
+        if (len < 2) {
+            len += bench_read(stream, data + len, BENCH_CHUNK_SIZE - len - 1);
+        }
+        if (data[0] != '\r' || data[1] != '\n') {
+            return -1;
+        }
+        memmove(data, &data[2], len - 2);
+        len -= 2;
+    }
+}
+
+/* a response of the auth request, or of @body_len bytes in chunks of @chunk bytes, 0 not chunked */
+static int bench_response(char *buf, int body_len, int chunk)
+{
+    int off = 0, n, i;
+
+    off += sprintf(buf + off, "HTTP/1.1 200 OK\r\nServer: Tengine\r\nDate: Mon, 19 Oct 2026 08:00:00 GMT\r\n"
+                   "Content-Type: application/octet-stream\r\nConnection: keep-alive\r\n");
+    if (0 == chunk) {
+        off += sprintf(buf + off, "Content-Length: %d\r\n\r\n", body_len);
+        for (i = 0; i < body_len; i++) {
+            buf[off++] = 'a' + i % 26;
+        }
+        return off;
+    }
+
+    off += sprintf(buf + off, "Transfer-Encoding: chunked\r\n\r\n");
+    for (i = 0; i < body_len; i += n) {
+        n = (body_len - i < chunk) ? body_len - i : chunk;
+        off += sprintf(buf + off, "%x\r\n", n);
+        memset(buf + off, 'a' + i % 26, n);
+        off += n;
+        off += sprintf(buf + off, "\r\n");
+    }
+    off += sprintf(buf + off, "0\r\n\r\n");
+    return off;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        int         body_len;
+        int         chunk;
+    } cases[] = {
+        {"auth response", 96, 0},
+        {"content-length 64KB", BENCH_BODY_LEN, 0},
+        {"chunked 64KB / 64", BENCH_BODY_LEN, 64},
+        {"chunked 64KB / 1KB", BENCH_BODY_LEN, 1024},
+        {"chunked 64KB / 16KB", BENCH_BODY_LEN, 16 * 1024},
+    };
+    int             opt, rounds = 200, i, r, len, got_parser = 0, got_legacy = 0;
+    double          start, parser_us, legacy_us;
+    char           *response, *body;
+    bench_stream_t  parser_stream, legacy_stream;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            default:
+                printf("usage: %s [-n rounds]\n", argv[0]);
+                return 0;
+        }
+    }
+    if (rounds <= 0) {
+        return -1;
+    }
+
+    response = malloc(2 * BENCH_BODY_LEN);
+    body = malloc(BENCH_BODY_LEN + 1);
+
+    printf("%-20s %8s | %10s %8s %6s %6s | %10s %8s %6s %6s\n", "response", "bytes",
+           "parser us", "MB/s", "reads", "stalls", "legacy us", "MB/s", "reads", "stalls");
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        len = bench_response(response, cases[i].body_len, cases[i].chunk);
+
+        start = bench_now_us();
+        for (r = 0; r < rounds; r++) {
+            memset(&parser_stream, 0, sizeof(bench_stream_t));
+            parser_stream.data = response;
+            parser_stream.len = len;
+            got_parser = bench_parser(&parser_stream, body, BENCH_BODY_LEN);
+        }
+        parser_us = (bench_now_us() - start) / rounds;
+
+        start = bench_now_us();
+        for (r = 0; r < rounds; r++) {
+            memset(&legacy_stream, 0, sizeof(bench_stream_t));
+            legacy_stream.data = response;
+            legacy_stream.len = len;
+            got_legacy = bench_legacy(&legacy_stream, body, BENCH_BODY_LEN);
+        }
+        legacy_us = (bench_now_us() - start) / rounds;
+
+        printf("%-20s %8d | %10.1f %8.1f %6d %6d | %10.1f %8.1f %6d %6d%s\n", cases[i].name, len,
+               parser_us, len / parser_us, parser_stream.reads, parser_stream.stalls,
+               legacy_us, len / legacy_us, legacy_stream.reads, legacy_stream.stalls,
+               got_parser == cases[i].body_len && got_legacy == cases[i].body_len ? "" : "  MISMATCH");
+    }
+
+    free(body);
+    free(response);
+    return 0;
+}
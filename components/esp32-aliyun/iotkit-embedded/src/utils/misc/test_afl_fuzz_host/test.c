@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "utils_http_parser.h"
+#include "utils_inflate.h"
+
+#define HTTP_FUZZ_MAX_LEN       (4096)
+#define HTTP_FUZZ_MAX_INFLATED  (64 * 1024)
+
+/* what a parse of a response gives, it must not depend on where the response is cut */
+typedef struct {
+    int     consumed;       /* bytes up to the end of the response, or to the end of the data */
+    int     result;         /* 0 complete, 1 cut short, ERROR_HTTP_PRTCL malformed */
+    int     response_code;
+    int     content_len;
+    int     is_chunked;
+    int     is_closing;
+    int     encoding;
+    int     body_len;
+    char    body[HTTP_FUZZ_MAX_LEN];
+} http_fuzz_result_t;
+
+static http_fuzz_result_t   whole, parts;
+static uint32_t             wants[HTTP_FUZZ_MAX_LEN];
+static uint8_t              window[1 << UTILS_INFLATE_MAX_WINDOW_BITS];
+static uint8_t              inflated[2][HTTP_FUZZ_MAX_INFLATED];
+static int                  inflated_len;
+
+/* parse @buf in slices of @slice bytes, with the reads of httpclient_retrieve_content(): no longer
+ * than httpclient_parser_want(), which is kept in @p_wants for every byte if not NULL */
+static void http_fuzz_parse(const char *buf, int len, int slice, http_fuzz_result_t *r, uint32_t *p_wants)
+{
+    httpclient_parser_t parser;
+    int                 pos = 0, n, body_len, cut;
+
+    memset(r, 0, sizeof(http_fuzz_result_t));
+    httpclient_parser_init(&parser);
+
+    while (pos < len && !httpclient_parser_is_done(&parser)) {
+        if (NULL != p_wants) {
+            p_wants[pos] = httpclient_parser_want(&parser);
+            if (0 == p_wants[pos]) {
+                abort();
+            }
+        }
+        cut = (len - pos < slice) ? len - pos : slice;
+        n = httpclient_parser_execute(&parser, buf + pos, cut, &body_len);
+        if (n < 0) {
+            r->result = n;
+            break;
+        }
+        if (0 == n || n > cut || body_len > n) {
+            abort();
+        }
+        memcpy(r->body + r->body_len, buf + pos + n - body_len, body_len);
+        r->body_len += body_len;
+        pos += n;
+    }
+
+    r->consumed = pos;
+    if (0 == r->result) {
+        r->result = (0 == httpclient_parser_finish(&parser)) ? 0 : 1;
+    }
+    r->response_code = parser.response_code;
+    r->content_len = parser.content_len;
+    r->is_chunked = parser.is_chunked;
+    r->is_closing = parser.is_closing;
+    r->encoding = parser.encoding;
+    if (0 == r->result && 0 != httpclient_parser_want(&parser)) {
+        abort();
+    }
+}
+
+static int http_fuzz_same(const http_fuzz_result_t *a, const http_fuzz_result_t *b)
+{
+    if (ERROR_HTTP_PRTCL == a->result || ERROR_HTTP_PRTCL == b->result) {
+        /* where the error is seen depends on the slices */
+        return a->result == b->result;
+    }
+    return a->consumed == b->consumed && a->result == b->result && a->response_code == b->response_code
+           && a->content_len == b->content_len && a->is_chunked == b->is_chunked
+           && a->is_closing == b->is_closing && a->encoding == b->encoding && a->body_len == b->body_len
+           && 0 == memcmp(a->body, b->body, a->body_len);
+}
+
+/* decode @in into @out fed @slice bytes of input and given @slice bytes of room at a time, as
+ * httpclient does with what it reads: the bytes decoded up to the end of the stream or of @out,
+ * -1 if the stream is refused and -2 if it is cut short */
+static int http_fuzz_inflate(int format, const uint8_t *in, int len, int slice, uint8_t *out)
+{
+    utils_inflate_t s;
+    int             pos = 0, count = 0, cut, room, used, n;
+
+    utils_inflate_init(&s, format, window, UTILS_INFLATE_MAX_WINDOW_BITS);
+    while (!utils_inflate_is_done(&s) && count < HTTP_FUZZ_MAX_INFLATED) {
+        cut = (len - pos < slice) ? len - pos : slice;
+        room = (HTTP_FUZZ_MAX_INFLATED - count < slice) ? HTTP_FUZZ_MAX_INFLATED - count : slice;
+        n = utils_inflate(&s, in + pos, cut, &used, out + count, room);
+        if (n < 0) {
+            return -1;
+        }
+        if (n > room || used < 0 || used > cut) {
+            abort();
+        }
+        if (0 == n && 0 == used && !utils_inflate_is_done(&s)) {
+            /* with input and room left a call always gets somewhere */
+            if (pos < len) {
+                abort();
+            }
+            return -2;
+        }
+        pos += used;
+        count += n;
+    }
+
+    return count;
+}
+
+/* Parse @buf at once, a byte at a time and in three slices, all must agree. A complete response must
+ * never have been asked for more than what was left of it. */
+static int http_fuzz_check(const char *buf, int len)
+{
+    int i;
+
+    http_fuzz_parse(buf, len, len > 0 ? len : 1, &whole, NULL);
+
+    http_fuzz_parse(buf, len, 1, &parts, wants);
+    if (!http_fuzz_same(&whole, &parts)) {
+        abort();
+    }
+    if (0 == whole.result) {
+        for (i = 0; i < whole.consumed; i++) {
+            /* a body ending with the connection has no bound */
+            if (wants[i] > (uint32_t)(whole.consumed - i) && HTTPCLIENT_PARSER_WANT_ANY != wants[i]) {
+                abort();
+            }
+        }
+    }
+
+    http_fuzz_parse(buf, len, len / 3 + 1, &parts, NULL);
+    if (!http_fuzz_same(&whole, &parts)) {
+        abort();
+    }
+
+    /* a compressed body must decode the same whatever the reads */
+    inflated_len = 0;
+    if (0 == whole.result && (HTTPCLIENT_ENCODING_GZIP == whole.encoding
+                              || HTTPCLIENT_ENCODING_DEFLATE == whole.encoding)) {
+        i = (HTTPCLIENT_ENCODING_GZIP == whole.encoding) ? UTILS_INFLATE_GZIP : UTILS_INFLATE_ZLIB;
+        inflated_len = http_fuzz_inflate(i, (uint8_t *)whole.body, whole.body_len,
+                                         HTTP_FUZZ_MAX_INFLATED, inflated[0]);
+        if (inflated_len != http_fuzz_inflate(i, (uint8_t *)whole.body, whole.body_len, 1, inflated[1])
+            || (inflated_len > 0 && 0 != memcmp(inflated[0], inflated[1], inflated_len))) {
+            abort();
+        }
+    }
+
+    return 0;
+}
+
+#if defined(HTTP_FUZZ_LIBFUZZER)
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+    char   *buf;
+
+    if (size > HTTP_FUZZ_MAX_LEN) {
+        return 0;
+    }
+    /* an exact copy, not NUL terminated, so ASan sees any over-read */
+    buf = malloc(size + 1);
+    memcpy(buf, data, size);
+    http_fuzz_check(buf, (int)size);
+    free(buf);
+    return 0;
+}
+
+#else
+
+#ifndef __AFL_LOOP
+#define __AFL_LOOP(n)   (0 == afl_loop_once++)
+static int afl_loop_once = 0;
+#endif
+
+static void dump_response(const char *name)
+{
+    FILE           *fp = NULL;
+    static char     buf[HTTP_FUZZ_MAX_LEN];
+    int             len = 0;
+
+    fp = fopen(name, "rb");
+    if (NULL == fp) {
+        abort();
+    }
+    len = (int)fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+
+    http_fuzz_check(buf, len);
+    printf("Input: %s\n", name);
+    printf("Result: %d, %d of %d bytes\n", whole.result, whole.consumed, len);
+    printf("  code %d, content length %d, chunked %d, closing %d, encoding %d\n",
+           whole.response_code, whole.content_len, whole.is_chunked, whole.is_closing, whole.encoding);
+    if (HTTPCLIENT_ENCODING_IDENTITY != whole.encoding) {
+        printf("  body %d bytes, inflated %d: %.*s\n\n", whole.body_len, inflated_len,
+               inflated_len > 32 ? 32 : (inflated_len > 0 ? inflated_len : 0), inflated[0]);
+        return;
+    }
+    printf("  body %d bytes: %.*s\n\n", whole.body_len, whole.body_len > 32 ? 32 : whole.body_len, whole.body);
+}
+
+int main(int argc, char **argv)
+{
+    static char     buf[HTTP_FUZZ_MAX_LEN];
+    ssize_t         len = 0;
+    int             i = 0;
+
+    /* ./test in/*.http prints what each response parses to */
+    if (argc > 1) {
+        for (i = 1; i < argc; i++) {
+            dump_response(argv[i]);
+        }
+        return 0;
+    }
+
+    while (__AFL_LOOP(1000)) {
+        memset(buf, 0, sizeof(buf));
+        len = read(0, buf, sizeof(buf));
+        if (len < 0) {
+            len = 0;
+        }
+        http_fuzz_check(buf, (int)len);
+    }
+    return 0;
+}
+
+#endif
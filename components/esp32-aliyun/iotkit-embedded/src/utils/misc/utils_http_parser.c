@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <string.h>
+#include "iot_import.h"
+#include "iot_export.h"
+#include "utils_http_parser.h"
+
+enum {
+    HTTPCLIENT_PARSER_STATUS,           /* "HTTP/1.1 " */
+    HTTPCLIENT_PARSER_CODE,             /* "200" */
+    HTTPCLIENT_PARSER_REASON,           /* " OK" */
+    HTTPCLIENT_PARSER_STATUS_LF,
+    HTTPCLIENT_PARSER_FIELD_NAME,       /* at the start of a header line too */
+    HTTPCLIENT_PARSER_FIELD_VALUE,
+    HTTPCLIENT_PARSER_FIELD_LF,
+    HTTPCLIENT_PARSER_HEAD_LF,          /* the empty line after the headers */
+    HTTPCLIENT_PARSER_BODY,             /* Content-Length bytes */
+    HTTPCLIENT_PARSER_BODY_UNTIL_CLOSE,
+    HTTPCLIENT_PARSER_CHUNK_SIZE,
+    HTTPCLIENT_PARSER_CHUNK_EXT,
+    HTTPCLIENT_PARSER_CHUNK_SIZE_LF,
+    HTTPCLIENT_PARSER_CHUNK_DATA,
+    HTTPCLIENT_PARSER_CHUNK_DATA_CR,
+    HTTPCLIENT_PARSER_CHUNK_DATA_LF,
+    HTTPCLIENT_PARSER_TRAILER,          /* at the start of a trailer line */
+    HTTPCLIENT_PARSER_TRAILER_LINE,
+    HTTPCLIENT_PARSER_TRAILER_LF,
+    HTTPCLIENT_PARSER_TRAILER_END_LF,
+    HTTPCLIENT_PARSER_DONE,
+    HTTPCLIENT_PARSER_ERROR
+};
+
+/* the headers the parser looks at, their names in lower case */
+enum {
+    HTTPCLIENT_FIELD_CONTENT_LENGTH,
+    HTTPCLIENT_FIELD_TRANSFER_ENCODING,
+    HTTPCLIENT_FIELD_CONNECTION,
+    HTTPCLIENT_FIELD_CONTENT_ENCODING,
+    HTTPCLIENT_FIELD_OTHER
+};
+
+static const char *const httpclient_field_names[HTTPCLIENT_FIELD_OTHER] = {
+    "content-length", "transfer-encoding", "connection", "content-encoding"
+};
+
+/* the tokens looked for in the lists of these headers, and the header of each */
+enum {
+    HTTPCLIENT_TOKEN_CHUNKED,
+    HTTPCLIENT_TOKEN_CLOSE,
+    HTTPCLIENT_TOKEN_GZIP,
+    HTTPCLIENT_TOKEN_X_GZIP,
+    HTTPCLIENT_TOKEN_DEFLATE,
+    HTTPCLIENT_TOKEN_IDENTITY,
+    HTTPCLIENT_TOKEN_OTHER
+};
+
+static const char *const httpclient_token_names[HTTPCLIENT_TOKEN_OTHER] = {
+    "chunked", "close", "gzip", "x-gzip", "deflate", "identity"
+};
+static const uint8_t httpclient_token_fields[HTTPCLIENT_TOKEN_OTHER] = {
+    HTTPCLIENT_FIELD_TRANSFER_ENCODING, HTTPCLIENT_FIELD_CONNECTION, HTTPCLIENT_FIELD_CONTENT_ENCODING,
+    HTTPCLIENT_FIELD_CONTENT_ENCODING, HTTPCLIENT_FIELD_CONTENT_ENCODING, HTTPCLIENT_FIELD_CONTENT_ENCODING
+};
+
+#define HTTPCLIENT_MIN_CHUNKS_END   (5)     /* "0\r\n\r\n" */
+#define HTTPCLIENT_MAX_CHUNK_SIZE   (0x0fffffff)
+
+#define _http_is_digit(c)   ((c) >= '0' && (c) <= '9')
+#define _http_is_ows(c)     ((c) == ' ' || (c) == '\t')
+#define _http_is_ctl(c)     ((c) < 0x20 || (c) == 0x7f)
+#define _http_lower(c)      (((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
+
+static int _http_hex_value(int c)
+{
+    if (_http_is_digit(c)) {
+        return c - '0';
+    }
+    c = _http_lower(c);
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static int _http_is_tchar(int c)
+{
+    if (_http_is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+        return 1;
+    }
+    return NULL != strchr("!#$%&'*+-.^_`|~", c) && '\0' != c;
+}
+
+void httpclient_parser_init(httpclient_parser_t *parser)
+{
+    memset(parser, 0, sizeof(httpclient_parser_t));
+    parser->state = HTTPCLIENT_PARSER_STATUS;
+    parser->content_len = -1;
+}
+
+/* a token of a list header starts, any of those of the header may follow */
+static void _http_token_start(httpclient_parser_t *parser)
+{
+    int i;
+
+    parser->fields = 0;
+    for (i = 0; i < HTTPCLIENT_TOKEN_OTHER; i++) {
+        if (httpclient_token_fields[i] == parser->field) {
+            parser->fields |= 1u << i;
+        }
+    }
+    parser->index = 0;
+    parser->matched = 1;
+}
+
+/* the token of a list header ends at a comma or at the end of the line */
+static void _http_token_end(httpclient_parser_t *parser)
+{
+    int i, token = HTTPCLIENT_TOKEN_OTHER;
+
+    if (0 == parser->index && 1 == parser->matched) {
+        /* an empty element of the list */
+        return;
+    }
+
+    for (i = 0; i < HTTPCLIENT_TOKEN_OTHER; i++) {
+        if ((parser->fields & (1u << i)) && '\0' == httpclient_token_names[i][parser->index]) {
+            token = i;
+        }
+    }
+
+    if (HTTPCLIENT_FIELD_TRANSFER_ENCODING == parser->field) {
+        /* the body is chunked if chunked is the last coding */
+        parser->is_chunked = (HTTPCLIENT_TOKEN_CHUNKED == token);
+    } else if (HTTPCLIENT_FIELD_CONNECTION == parser->field) {
+        parser->is_closing |= (HTTPCLIENT_TOKEN_CLOSE == token);
+    } else if (HTTPCLIENT_TOKEN_IDENTITY != token) {
+        /* one coding is decoded, not several */
+        if (HTTPCLIENT_ENCODING_IDENTITY != parser->encoding) {
+            parser->encoding = HTTPCLIENT_ENCODING_OTHER;
+        } else if (HTTPCLIENT_TOKEN_GZIP == token || HTTPCLIENT_TOKEN_X_GZIP == token) {
+            parser->encoding = HTTPCLIENT_ENCODING_GZIP;
+        } else if (HTTPCLIENT_TOKEN_DEFLATE == token) {
+            parser->encoding = HTTPCLIENT_ENCODING_DEFLATE;
+        } else {
+            parser->encoding = HTTPCLIENT_ENCODING_OTHER;
+        }
+    }
+}
+
+/* a byte of the value of a header, 0 or -1 if the value is malformed */
+static int _http_field_value(httpclient_parser_t *parser, int c)
+{
+    int i;
+
+    if (HTTPCLIENT_FIELD_OTHER == parser->field) {
+        return 0;
+    }
+
+    if (HTTPCLIENT_FIELD_CONTENT_LENGTH == parser->field) {
+        if (_http_is_ows(c)) {
+            /* no digit after the blanks following the number */
+            parser->matched = (0 == parser->index);
+        } else if (!_http_is_digit(c) || !parser->matched
+                   || parser->remaining > (uint32_t)(HTTPCLIENT_PARSER_WANT_ANY - (c - '0')) / 10) {
+            return -1;
+        } else {
+            parser->remaining = parser->remaining * 10 + (c - '0');
+            parser->index++;
+        }
+        return 0;
+    }
+
+    if (',' == c) {
+        _http_token_end(parser);
+        _http_token_start(parser);
+    } else if (_http_is_ows(c)) {
+        if (parser->index > 0) {
+            /* the token ends, another byte of it matches none */
+            parser->matched = 2;
+        }
+    } else if (1 == parser->matched) {
+        /* drop the tokens this byte does not match, the longer tokens stop at their NUL */
+        for (i = 0; i < HTTPCLIENT_TOKEN_OTHER; i++) {
+            if ((parser->fields & (1u << i)) && _http_lower(c) != httpclient_token_names[i][parser->index]) {
+                parser->fields &= ~(1u << i);
+            }
+        }
+        parser->index++;
+    } else {
+        parser->fields = 0;
+    }
+    return 0;
+}
+
+/* the end of the value of a header, 0 or -1 if the value is malformed */
+static int _http_field_end(httpclient_parser_t *parser)
+{
+    if (HTTPCLIENT_FIELD_CONTENT_LENGTH == parser->field) {
+        if (0 == parser->index
+            || (parser->content_len >= 0 && parser->content_len != (int)parser->remaining)) {
+            /* empty, or differing from a previous Content-Length */
+            return -1;
+        }
+        parser->content_len = (int)parser->remaining;
+        parser->remaining = 0;
+    } else if (HTTPCLIENT_FIELD_OTHER != parser->field) {
+        _http_token_end(parser);
+    }
+    return 0;
+}
+
+/* the empty line after the headers: where the body ends */
+static void _http_head_end(httpclient_parser_t *parser)
+{
+    if (parser->response_code >= 100 && parser->response_code < 200) {
+        /* an interim response, the final one follows */
+        httpclient_parser_init(parser);
+        return;
+    }
+
+    parser->index = 0;
+    parser->remaining = 0;
+    if (204 == parser->response_code || 304 == parser->response_code) {
+        parser->is_chunked = 0;
+        parser->content_len = 0;
+        parser->state = HTTPCLIENT_PARSER_DONE;
+    } else if (parser->is_chunked) {
+        parser->content_len = 0;
+        parser->state = HTTPCLIENT_PARSER_CHUNK_SIZE;
+    } else if (parser->content_len >= 0) {
+        parser->remaining = parser->content_len;
+        parser->state = (0 == parser->remaining) ? HTTPCLIENT_PARSER_DONE : HTTPCLIENT_PARSER_BODY;
+    } else {
+        parser->is_closing = 1;
+        parser->state = HTTPCLIENT_PARSER_BODY_UNTIL_CLOSE;
+    }
+}
+
+/* a byte of the status line, the headers or the framing of the chunks: the next state */
+static int _http_parse_byte(httpclient_parser_t *parser, int c)
+{
+    int i, hex;
+
+    switch (parser->state) {
+        case HTTPCLIENT_PARSER_STATUS:
+            /* "HTTP/" digit "." digit SP */
+            i = parser->index++;
+            if ((i < 5 && c != "HTTP/"[i]) || ((5 == i || 7 == i) && !_http_is_digit(c))
+                || (6 == i && '.' != c) || (8 == i && ' ' != c)) {
+                return HTTPCLIENT_PARSER_ERROR;
+            }
+            return (8 == i) ? HTTPCLIENT_PARSER_CODE : HTTPCLIENT_PARSER_STATUS;
+
+        case HTTPCLIENT_PARSER_CODE:
+            if (parser->index < 12) {
+                if (!_http_is_digit(c)) {
+                    return HTTPCLIENT_PARSER_ERROR;
+                }
+                parser->response_code = parser->response_code * 10 + (c - '0');
+                parser->index++;
+                return HTTPCLIENT_PARSER_CODE;
+            }
+            /* the reason phrase may be missing, with the space before it */
+            if (' ' == c) {
+                return HTTPCLIENT_PARSER_REASON;
+            }
+            return ('\r' == c) ? HTTPCLIENT_PARSER_STATUS_LF : HTTPCLIENT_PARSER_ERROR;
+
+        case HTTPCLIENT_PARSER_REASON:
+            if ('\r' == c) {
+                return HTTPCLIENT_PARSER_STATUS_LF;
+            }
+            return (_http_is_ctl(c) && '\t' != c) ? HTTPCLIENT_PARSER_ERROR : HTTPCLIENT_PARSER_REASON;
+
+        case HTTPCLIENT_PARSER_STATUS_LF:
+        case HTTPCLIENT_PARSER_FIELD_LF:
+            if ('\n' != c) {
+                return HTTPCLIENT_PARSER_ERROR;
+            }
+            parser->index = 0;
+            parser->fields = (1u << HTTPCLIENT_FIELD_OTHER) - 1;
+            return HTTPCLIENT_PARSER_FIELD_NAME;
+
+        case HTTPCLIENT_PARSER_FIELD_NAME:
+            if ('\r' == c && 0 == parser->index) {
+                return HTTPCLIENT_PARSER_HEAD_LF;
+            }
+            if (':' == c && parser->index > 0) {
+                parser->field = HTTPCLIENT_FIELD_OTHER;
+                for (i = 0; i < HTTPCLIENT_FIELD_OTHER; i++) {
+                    if ((parser->fields & (1u << i)) && '\0' == httpclient_field_names[i][parser->index]) {
+                        parser->field = i;
+                    }
+                }
+                _http_token_start(parser);
+                parser->remaining = 0;
+                return HTTPCLIENT_PARSER_FIELD_VALUE;
+            }
+            if (!_http_is_tchar(c)) {
+                return HTTPCLIENT_PARSER_ERROR;
+            }
+            /* drop the names this byte does not match, the longer names stop at their NUL */
+            for (i = 0; i < HTTPCLIENT_FIELD_OTHER; i++) {
+                if ((parser->fields & (1u << i)) && _http_lower(c) != httpclient_field_names[i][parser->index]) {
+                    parser->fields &= ~(1u << i);
+                }
+            }
+            if (0 != parser->fields) {
+                parser->index++;
+            } else {
+                parser->index = 1;
+            }
+            return HTTPCLIENT_PARSER_FIELD_NAME;
+
+        case HTTPCLIENT_PARSER_FIELD_VALUE:
+            if ('\r' == c) {
+                return (0 == _http_field_end(parser)) ? HTTPCLIENT_PARSER_FIELD_LF : HTTPCLIENT_PARSER_ERROR;
+            }
+            if ((_http_is_ctl(c) && '\t' != c) || 0 != _http_field_value(parser, c)) {
+                return HTTPCLIENT_PARSER_ERROR;
+            }
+            return HTTPCLIENT_PARSER_FIELD_VALUE;
+
+        case HTTPCLIENT_PARSER_HEAD_LF:
+            if ('\n' != c) {
+                return HTTPCLIENT_PARSER_ERROR;
+            }
+            _http_head_end(parser);
+            return parser->state;
+
+        case HTTPCLIENT_PARSER_CHUNK_SIZE:
+            hex = _http_hex_value(c);
+            if (hex >= 0) {
+                if (parser->remaining > (HTTPCLIENT_MAX_CHUNK_SIZE >> 4)) {
+                    return HTTPCLIENT_PARSER_ERROR;
+                }
+                parser->remaining = (parser->remaining << 4) | hex;
+                parser->index++;
+                return HTTPCLIENT_PARSER_CHUNK_SIZE;
+            }
+            if (0 == parser->index) {
+                return HTTPCLIENT_PARSER_ERROR;
+            }
+            if ('\r' == c) {
+                return HTTPCLIENT_PARSER_CHUNK_SIZE_LF;
+            }
+            return (';' == c || _http_is_ows(c)) ? HTTPCLIENT_PARSER_CHUNK_EXT : HTTPCLIENT_PARSER_ERROR;
+
+        case HTTPCLIENT_PARSER_CHUNK_EXT:
+            if ('\r' == c) {
+                return HTTPCLIENT_PARSER_CHUNK_SIZE_LF;
+            }
+            return (_http_is_ctl(c) && '\t' != c) ? HTTPCLIENT_PARSER_ERROR : HTTPCLIENT_PARSER_CHUNK_EXT;
+
+        case HTTPCLIENT_PARSER_CHUNK_SIZE_LF:
+            if ('\n' != c) {
+                return HTTPCLIENT_PARSER_ERROR;
+            }
+            if (0 == parser->remaining) {
+                /* the last chunk */
+                return HTTPCLIENT_PARSER_TRAILER;
+            }
+            if (parser->remaining > (uint32_t)(HTTPCLIENT_PARSER_WANT_ANY - parser->content_len)) {
+                return HTTPCLIENT_PARSER_ERROR;
+            }
+            parser->content_len += parser->remaining;
+            return HTTPCLIENT_PARSER_CHUNK_DATA;
+
+        case HTTPCLIENT_PARSER_CHUNK_DATA_CR:
+            return ('\r' == c) ? HTTPCLIENT_PARSER_CHUNK_DATA_LF : HTTPCLIENT_PARSER_ERROR;
+
+        case HTTPCLIENT_PARSER_CHUNK_DATA_LF:
+            parser->index = 0;
+            return ('\n' == c) ? HTTPCLIENT_PARSER_CHUNK_SIZE : HTTPCLIENT_PARSER_ERROR;
+
+        case HTTPCLIENT_PARSER_TRAILER:
+            if ('\r' == c) {
+                return HTTPCLIENT_PARSER_TRAILER_END_LF;
+            }
+            return _http_is_tchar(c) ? HTTPCLIENT_PARSER_TRAILER_LINE : HTTPCLIENT_PARSER_ERROR;
+
+        case HTTPCLIENT_PARSER_TRAILER_LINE:
+            if ('\r' == c) {
+                return HTTPCLIENT_PARSER_TRAILER_LF;
+            }
+            return (_http_is_ctl(c) && '\t' != c) ? HTTPCLIENT_PARSER_ERROR : HTTPCLIENT_PARSER_TRAILER_LINE;
+
+        case HTTPCLIENT_PARSER_TRAILER_LF:
+            return ('\n' == c) ? HTTPCLIENT_PARSER_TRAILER : HTTPCLIENT_PARSER_ERROR;
+
+        case HTTPCLIENT_PARSER_TRAILER_END_LF:
+            return ('\n' == c) ? HTTPCLIENT_PARSER_DONE : HTTPCLIENT_PARSER_ERROR;
+
+        default:
+            return HTTPCLIENT_PARSER_ERROR;
+    }
+}
+
+int httpclient_parser_execute(httpclient_parser_t *parser, const char *data, int len, int *p_body_len)
+{
+    int pos, n;
+
+    *p_body_len = 0;
+
+    for (pos = 0; pos < len; ++pos) {
+        switch (parser->state) {
+            case HTTPCLIENT_PARSER_BODY:
+            case HTTPCLIENT_PARSER_CHUNK_DATA:
+                /* as much of the body as the slice has, at once */
+                n = ((uint32_t)(len - pos) < parser->remaining) ? len - pos : (int)parser->remaining;
+                parser->remaining -= n;
+                parser->body_len += n;
+                if (0 == parser->remaining) {
+                    parser->state = (HTTPCLIENT_PARSER_BODY == parser->state) ?
+                                    HTTPCLIENT_PARSER_DONE : HTTPCLIENT_PARSER_CHUNK_DATA_CR;
+                }
+                *p_body_len = n;
+                return pos + n;
+
+            case HTTPCLIENT_PARSER_BODY_UNTIL_CLOSE:
+                parser->body_len += len - pos;
+                *p_body_len = len - pos;
+                return len;
+
+            case HTTPCLIENT_PARSER_DONE:
+                return pos;
+
+            case HTTPCLIENT_PARSER_ERROR:
+                return ERROR_HTTP_PRTCL;
+
+            default:
+                parser->state = _http_parse_byte(parser, (unsigned char)data[pos]);
+                break;
+        }
+    }
+
+    return (HTTPCLIENT_PARSER_ERROR == parser->state) ? ERROR_HTTP_PRTCL : pos;
+}
+
+uint32_t httpclient_parser_want(httpclient_parser_t *parser)
+{
+    /* the shortest rest of the response the state allows, the next chunk may be the last one */
+    uint32_t chunk = (parser->remaining > 0) ? parser->remaining + 2 + HTTPCLIENT_MIN_CHUNKS_END : 2;
+
+    switch (parser->state) {
+        case HTTPCLIENT_PARSER_STATUS:
+        case HTTPCLIENT_PARSER_CODE:
+            return HTTPCLIENT_MIN_HEAD_LEN - parser->index;
+        case HTTPCLIENT_PARSER_REASON:
+        case HTTPCLIENT_PARSER_FIELD_VALUE:
+            return 4;
+        case HTTPCLIENT_PARSER_STATUS_LF:
+        case HTTPCLIENT_PARSER_FIELD_LF:
+            return 3;
+        case HTTPCLIENT_PARSER_FIELD_NAME:
+            return (0 == parser->index) ? 2 : 4;
+        case HTTPCLIENT_PARSER_HEAD_LF:
+            return 1;
+        case HTTPCLIENT_PARSER_BODY:
+            return parser->remaining;
+        case HTTPCLIENT_PARSER_BODY_UNTIL_CLOSE:
+            return HTTPCLIENT_PARSER_WANT_ANY;
+        case HTTPCLIENT_PARSER_CHUNK_SIZE:
+            return (0 == parser->index) ? HTTPCLIENT_MIN_CHUNKS_END : 2 + chunk;
+        case HTTPCLIENT_PARSER_CHUNK_EXT:
+            return 2 + chunk;
+        case HTTPCLIENT_PARSER_CHUNK_SIZE_LF:
+            return 1 + chunk;
+        case HTTPCLIENT_PARSER_CHUNK_DATA:
+            return parser->remaining + 2 + HTTPCLIENT_MIN_CHUNKS_END;
+        case HTTPCLIENT_PARSER_CHUNK_DATA_CR:
+            return 2 + HTTPCLIENT_MIN_CHUNKS_END;
+        case HTTPCLIENT_PARSER_CHUNK_DATA_LF:
+            return 1 + HTTPCLIENT_MIN_CHUNKS_END;
+        case HTTPCLIENT_PARSER_TRAILER:
+            return 2;
+        case HTTPCLIENT_PARSER_TRAILER_LINE:
+            return 4;
+        case HTTPCLIENT_PARSER_TRAILER_LF:
+            return 3;
+        case HTTPCLIENT_PARSER_TRAILER_END_LF:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+uint32_t httpclient_parser_want_body(httpclient_parser_t *parser)
+{
+    switch (parser->state) {
+        case HTTPCLIENT_PARSER_BODY:
+        case HTTPCLIENT_PARSER_CHUNK_DATA:
+            return parser->remaining;
+        case HTTPCLIENT_PARSER_BODY_UNTIL_CLOSE:
+            return HTTPCLIENT_PARSER_WANT_ANY;
+        default:
+            return 0;
+    }
+}
+
+int httpclient_parser_finish(httpclient_parser_t *parser)
+{
+    if (HTTPCLIENT_PARSER_BODY_UNTIL_CLOSE == parser->state) {
+        parser->state = HTTPCLIENT_PARSER_DONE;
+    }
+    return (HTTPCLIENT_PARSER_DONE == parser->state) ? 0 : ERROR_HTTP_PRTCL;
+}
+
+int httpclient_parser_is_head_done(httpclient_parser_t *parser)
+{
+    return parser->state >= HTTPCLIENT_PARSER_BODY && HTTPCLIENT_PARSER_ERROR != parser->state;
+}
+
+int httpclient_parser_is_done(httpclient_parser_t *parser)
+{
+    return HTTPCLIENT_PARSER_DONE == parser->state;
+}
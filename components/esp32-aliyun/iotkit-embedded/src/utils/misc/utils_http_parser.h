@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _IOTX_COMMON_HTTP_PARSER_H_
+#define _IOTX_COMMON_HTTP_PARSER_H_
+
+#include "iot_import.h"
+
+/**
+ * @brief Incremental parser of a HTTP/1.1 response: the status line, the headers, a body of
+ *   Content-Length, chunked or ending with the connection, and the trailers. The body is given as
+ *   it comes, still in the coding of its Content-Encoding. It takes the response
+ *   in slices of any length, cut anywhere, and keeps nothing of them but its state.
+ */
+typedef struct {
+    int         state;          /**< HTTPCLIENT_PARSER_* of utils_http_parser.c */
+    int         index;          /**< bytes of the status line, or of the token being matched */
+    int         field;          /**< header being read */
+    uint32_t    fields;         /**< headers the name being read may still be, or tokens the token being
+                                     read may still be, one bit each */
+    int         response_code;  /**< status code, 0 until the status line is read */
+    int         content_len;    /**< Content-Length, -1 without, or the size of the chunks so far */
+    uint32_t    remaining;      /**< bytes of the content or of the current chunk still to come */
+    uint32_t    body_len;       /**< bytes of the body so far */
+    uint8_t     is_chunked;     /**< Transfer-Encoding ends with chunked */
+    uint8_t     is_closing;     /**< "Connection: close", or the body ends with the connection */
+    uint8_t     matched;        /**< 1 while the token or number being read may go on, 0 or 2 after blanks */
+    uint8_t     encoding;       /**< HTTPCLIENT_ENCODING_* of Content-Encoding */
+} httpclient_parser_t;
+
+/* the Content-Encoding of the body */
+#define HTTPCLIENT_ENCODING_IDENTITY    (0)
+#define HTTPCLIENT_ENCODING_GZIP        (1)     /* gzip or x-gzip */
+#define HTTPCLIENT_ENCODING_DEFLATE     (2)     /* zlib */
+#define HTTPCLIENT_ENCODING_OTHER       (3)     /* another coding, or several */
+
+void httpclient_parser_init(httpclient_parser_t *parser);
+
+/**
+ * @brief Parse a slice of the response. It returns at the end of the response, or after a span of
+ *   the body, which is the last @p_body_len bytes of those consumed: call it again on the rest.
+ *
+ * @param[in] parser @n The parser, initialized before the response
+ * @param[in] data @n The next bytes of the response
+ * @param[in] len @n Their length
+ * @param[out] p_body_len @n Bytes of the body at the end of those consumed, 0 if none
+ * @returns The bytes consumed, ERROR_HTTP_PRTCL if the response is malformed.
+ * @see None.
+ * @note It stops at the end of the response, the bytes after it are not consumed.
+ */
+int httpclient_parser_execute(httpclient_parser_t *parser, const char *data, int len, int *p_body_len);
+
+/**
+ * @brief Bytes of the response which are certainly still to come, a read of that many returns
+ *   without waiting past the end of the response.
+ *
+ * @param[in] parser @n The parser
+ * @returns At least 1 until the response is complete, then 0. A body ending with the connection
+ *   has no bound, it returns HTTPCLIENT_PARSER_WANT_ANY then.
+ * @see None.
+ * @note None.
+ */
+uint32_t httpclient_parser_want(httpclient_parser_t *parser);
+
+/* bytes of the body right ahead, which need no parsing: 0 in the head and in the framing of the
+ * chunks, HTTPCLIENT_PARSER_WANT_ANY in a body ending with the connection */
+uint32_t httpclient_parser_want_body(httpclient_parser_t *parser);
+
+/* the body ends with the connection, which was closed: 0, or ERROR_HTTP_PRTCL if the response
+ * is cut short */
+int httpclient_parser_finish(httpclient_parser_t *parser);
+
+/* whether the status line and the headers are read */
+int httpclient_parser_is_head_done(httpclient_parser_t *parser);
+
+/* whether the whole response is read */
+int httpclient_parser_is_done(httpclient_parser_t *parser);
+
+#define HTTPCLIENT_PARSER_WANT_ANY  (0x7fffffff)
+#define HTTPCLIENT_MIN_HEAD_LEN     (16)    /* "HTTP/1.1 200\r\n\r\n", httpclient_parser_want() of a new response */
+
+#endif /* _IOTX_COMMON_HTTP_PARSER_H_ */
@@ -23,6 +23,10 @@
 #include "utils_timer.h"
 #include "lite-log.h"
 #include "utils_httpc.h"
+#if defined(HTTP_INFLATE)
+    #include "lite-utils.h"
+    #include "utils_inflate.h"
+#endif
 
 #define HTTPCLIENT_MIN(x,y) (((x)<(y))?(x):(y))
 #define HTTPCLIENT_MAX(x,y) (((x)>(y))?(x):(y))
@@ -41,16 +45,32 @@
     #define DEBUG_LEVEL 2
 #endif
 
+#if defined(HTTP_INFLATE)
+#ifndef HTTPCLIENT_INFLATE_WINDOW_BITS
+    /* the window of the compressed bodies, servers compress with the 32 KB of the format by default */
+    #define HTTPCLIENT_INFLATE_WINDOW_BITS  UTILS_INFLATE_MAX_WINDOW_BITS
+#endif
+
+#define HTTPCLIENT_ACCEPT_ENCODING  "Accept-Encoding: gzip, deflate\r\n"
+
+/* the decoder of the compressed bodies of a connection, with the compressed bytes read and not
+ * decoded yet. It is allocated with its window for the first compressed body. */
+typedef struct {
+    int             active;     /* the body of the current response is compressed */
+    int             pos;
+    int             len;
+    uint8_t         input[HTTPCLIENT_CHUNK_SIZE];
+    utils_inflate_t stream;
+} httpclient_inflate_t;
+#endif
+
 static int httpclient_parse_host(const char *url, char *host, uint32_t maxhost_len);
 static int httpclient_parse_url(const char *url, char *scheme, uint32_t max_scheme_len, char *host,
                                 uint32_t maxhost_len, int *port, char *path, uint32_t max_path_len);
 static int httpclient_conn(httpclient_t *client);
 static int httpclient_recv(httpclient_t *client, char *buf, int min_len, int max_len, int *p_read_len,
                            uint32_t timeout);
-static int httpclient_retrieve_content(httpclient_t *client, char *data, int len, uint32_t timeout,
-                                       httpclient_data_t *client_data);
-static int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_t timeout,
-                                     httpclient_data_t *client_data);
+static int httpclient_retrieve_content(httpclient_t *client, uint32_t timeout_ms, httpclient_data_t *client_data);
 
 static void httpclient_base64enc(char *out, const char *in)
 {
@@ -152,6 +172,7 @@ int httpclient_parse_host(const char *url, char *host, uint32_t maxhost_len)
     const char *host_ptr = (const char *) strstr(url, "://");
     uint32_t host_len = 0;
     char *path_ptr;
+    const char *port_ptr;
 
     if (host_ptr == NULL) {
         log_err("Could not find host");
@@ -164,6 +185,12 @@ int httpclient_parse_host(const char *url, char *host, uint32_t maxhost_len)
         host_len = path_ptr - host_ptr;
     }
 
+    /* the port, if any, is given to httpclient_common() apart */
+    port_ptr = memchr(host_ptr, ':', host_len);
+    if (NULL != port_ptr) {
+        host_len = port_ptr - host_ptr;
+    }
+
     if (maxhost_len < host_len + 1) {
         /* including NULL-terminating char */
         log_err("Host str is too small (%d >= %d)", maxhost_len, host_len + 1);
@@ -175,43 +202,15 @@ int httpclient_parse_host(const char *url, char *host, uint32_t maxhost_len)
     return SUCCESS_RETURN;
 }
 
-int httpclient_get_info(httpclient_t *client, char *send_buf, int *send_idx, char *buf,
-                        uint32_t len) /* 0 on success, err code on failure */
+/* append @len bytes of @str to @buf of @buf_len bytes, which holds *@p_len bytes */
+static int httpclient_append(char *buf, int buf_len, int *p_len, const char *str, int len)
 {
-    int ret;
-    int cp_len;
-    int idx = *send_idx;
-
-    if (len == 0) {
-        len = strlen(buf);
+    if (*p_len + len > buf_len) {
+        return ERROR_HTTP;
     }
 
-    do {
-        if ((HTTPCLIENT_SEND_BUF_SIZE - idx) >= len) {
-            cp_len = len;
-        } else {
-            cp_len = HTTPCLIENT_SEND_BUF_SIZE - idx;
-        }
-
-        memcpy(send_buf + idx, buf, cp_len);
-        idx += cp_len;
-        len -= cp_len;
-
-        if (idx == HTTPCLIENT_SEND_BUF_SIZE) {
-            /*            if (client->remote_port == HTTPS_PORT) */
-            /*            { */
-            /*                WRITE_IOT_ERROR_LOG("send buffer overflow"); */
-            /*                return ERROR_HTTP; */
-            /*            } */
-            /* ret = httpclient_tcp_send_all(client->handle, send_buf, HTTPCLIENT_SEND_BUF_SIZE); */
-            ret = client->net.write(&client->net, send_buf, HTTPCLIENT_SEND_BUF_SIZE, 5000);
-            if (ret) {
-                return (ret);
-            }
-        }
-    } while (len);
-
-    *send_idx = idx;
+    memcpy(buf + *p_len, str, len);
+    *p_len += len;
     return SUCCESS_RETURN;
 }
 
@@ -230,91 +229,96 @@ int httpclient_basic_auth(httpclient_t *client, char *user, char *password)
     return SUCCESS_RETURN;
 }
 
-int httpclient_send_auth(httpclient_t *client, char *send_buf, int *send_idx)
-{
-    char b_auth[(int)((HTTPCLIENT_AUTHB_SIZE + 3) * 4 / 3 + 1)];
-    char base64buff[HTTPCLIENT_AUTHB_SIZE + 3];
-
-    httpclient_get_info(client, send_buf, send_idx, "Authorization: Basic ", 0);
-    sprintf(base64buff, "%s:%s", client->auth_user, client->auth_password);
-    log_debug("bAuth: %s", base64buff) ;
-    httpclient_base64enc(b_auth, base64buff);
-    b_auth[strlen(b_auth) + 1] = '\0';
-    b_auth[strlen(b_auth)] = '\n';
-    log_debug("b_auth:%s", b_auth) ;
-    httpclient_get_info(client, send_buf, send_idx, b_auth, 0);
-    return SUCCESS_RETURN;
-}
-
-int httpclient_send_header(httpclient_t *client, const char *url, int method, httpclient_data_t *client_data)
+/* write the request line and the headers into @buf, return their length or ERROR_HTTP if they do
+ * not fit in @buf_len bytes */
+static int httpclient_format_header(httpclient_t *client, const char *url, int method,
+                                    httpclient_data_t *client_data, char *buf, int buf_len)
 {
     char scheme[8] = { 0 };
     char host[HTTPCLIENT_MAX_HOST_LEN] = { 0 };
     char path[HTTPCLIENT_MAX_URL_LEN] = { 0 };
-    int len;
-    char send_buf[HTTPCLIENT_SEND_BUF_SIZE] = { 0 };
-    char buf[HTTPCLIENT_SEND_BUF_SIZE] = { 0 };
+    char line[(int)((HTTPCLIENT_AUTHB_SIZE + 3) * 4 / 3 + 1) + 32];
+    char base64buff[HTTPCLIENT_AUTHB_SIZE + 3];
     char *meth = (method == HTTPCLIENT_GET) ? "GET" : (method == HTTPCLIENT_POST) ? "POST" :
                  (method == HTTPCLIENT_PUT) ? "PUT" : (method == HTTPCLIENT_DELETE) ? "DELETE" :
                  (method == HTTPCLIENT_HEAD) ? "HEAD" : "";
-    int ret;
+    int len = 0, ret = 0;
     int port;
 
     /* First we need to parse the url (http[s]://host[:port][/[path]]) */
-    /* int res = httpclient_parse_url(url, scheme, sizeof(scheme), host, sizeof(host), &(client->remote_port), path, sizeof(path)); */
     int res = httpclient_parse_url(url, scheme, sizeof(scheme), host, sizeof(host), &port, path, sizeof(path));
     if (res != SUCCESS_RETURN) {
         log_err("httpclient_parse_url returned %d", res);
         return res;
     }
 
-    /* if (client->remote_port == 0) */
-    /* { */
-    if (strcmp(scheme, "http") == 0) {
-        /* client->remote_port = HTTP_PORT; */
-    } else if (strcmp(scheme, "https") == 0) {
-        /* client->remote_port = HTTPS_PORT; */
-    }
-    /* } */
-
-    /* Send request */
-    memset(send_buf, 0, HTTPCLIENT_SEND_BUF_SIZE);
-    len = 0; /* Reset send buffer */
-
-    HAL_Snprintf(buf, sizeof(buf), "%s %s HTTP/1.1\r\nHost: %s\r\n", meth, path, host); /* Write request */
-    ret = httpclient_get_info(client, send_buf, &len, buf, strlen(buf));
-    if (ret) {
-        log_err("Could not write request");
-        return ERROR_HTTP_CONN;
+    len = HAL_Snprintf(buf, buf_len, "%s %s HTTP/1.1\r\nHost: %s\r\n", meth, path, host); /* Write request */
+    if (len < 0 || len >= buf_len) {
+        return ERROR_HTTP;
     }
 
-    /* Send all headers */
     if (client->auth_user) {
-        httpclient_send_auth(client, send_buf, &len); /* send out Basic Auth header */
+        /* Basic Auth header */
+        sprintf(base64buff, "%s:%s", client->auth_user, client->auth_password);
+        log_debug("bAuth: %s", base64buff) ;
+        strcpy(line, "Authorization: Basic ");
+        httpclient_base64enc(line + strlen(line), base64buff);
+        strcat(line, "\r\n");
+        ret |= httpclient_append(buf, buf_len, &len, line, strlen(line));
     }
 
     /* Add user header information */
     if (client->header) {
-        httpclient_get_info(client, send_buf, &len, (char *) client->header, strlen(client->header));
+        ret |= httpclient_append(buf, buf_len, &len, client->header, strlen(client->header));
+    }
+
+#if defined(HTTP_INFLATE)
+    /* compressed bodies are decoded, unless the caller asks for a coding itself */
+    if (NULL == client->header || NULL == strstr(client->header, "Accept-Encoding:")) {
+        ret |= httpclient_append(buf, buf_len, &len, HTTPCLIENT_ACCEPT_ENCODING,
+                                 strlen(HTTPCLIENT_ACCEPT_ENCODING));
     }
+#endif
 
     if (client_data->post_buf != NULL) {
-        HAL_Snprintf(buf, sizeof(buf), "Content-Length: %d\r\n", client_data->post_buf_len);
-        httpclient_get_info(client, send_buf, &len, buf, strlen(buf));
+        HAL_Snprintf(line, sizeof(line), "Content-Length: %d\r\n", client_data->post_buf_len);
+        ret |= httpclient_append(buf, buf_len, &len, line, strlen(line));
 
         if (client_data->post_content_type != NULL) {
-            HAL_Snprintf(buf, sizeof(buf), "Content-Type: %s\r\n", client_data->post_content_type);
-            httpclient_get_info(client, send_buf, &len, buf, strlen(buf));
+            ret |= httpclient_append(buf, buf_len, &len, "Content-Type: ", 14);
+            ret |= httpclient_append(buf, buf_len, &len, client_data->post_content_type,
+                                     strlen(client_data->post_content_type));
+            ret |= httpclient_append(buf, buf_len, &len, "\r\n", 2);
         }
     }
 
     /* Close headers */
-    httpclient_get_info(client, send_buf, &len, "\r\n", 0);
+    ret |= httpclient_append(buf, buf_len, &len, "\r\n", 2);
 
-    log_multi_line(LOG_DEBUG_LEVEL, "REQUEST", "%s", send_buf, ">");
+    return (ret != 0) ? ERROR_HTTP : len;
+}
 
+int httpclient_format_request(httpclient_t *client, const char *url, int method, httpclient_data_t *client_data,
+                              char *buf, int buf_len)
+{
+    int len = httpclient_format_header(client, url, method, client_data, buf, buf_len);
+
+    if (len >= 0 && client_data->post_buf && client_data->post_buf_len
+        && (method == HTTPCLIENT_POST || method == HTTPCLIENT_PUT)) {
+        if (0 != httpclient_append(buf, buf_len, &len, client_data->post_buf, client_data->post_buf_len)) {
+            return ERROR_HTTP;
+        }
+    }
+
+    return len;
+}
+
+/* 0 on success, err code on failure */
+int httpclient_write(httpclient_t *client, const char *buf, int len)
+{
     /* ret = httpclient_tcp_send_all(client->net.handle, send_buf, len); */
-    ret = client->net.write(&client->net, send_buf, len, 5000);
+    int ret = client->net.write(&client->net, buf, len, 5000);
+
     if (ret > 0) {
         log_debug("Written %d bytes", ret);
     } else if (ret == 0) {
@@ -328,25 +332,27 @@ int httpclient_send_header(httpclient_t *client, const char *url, int method, ht
     return SUCCESS_RETURN;
 }
 
-int httpclient_send_userdata(httpclient_t *client, httpclient_data_t *client_data)
+int httpclient_send_header(httpclient_t *client, const char *url, int method, httpclient_data_t *client_data)
 {
-    int ret = 0;
+    char send_buf[HTTPCLIENT_SEND_BUF_SIZE] = { 0 };
+    int len;
+
+    len = httpclient_format_header(client, url, method, client_data, send_buf, HTTPCLIENT_SEND_BUF_SIZE - 1);
+    if (len < 0) {
+        log_err("Could not write request");
+        return ERROR_HTTP_CONN;
+    }
 
+    log_multi_line(LOG_DEBUG_LEVEL, "REQUEST", "%s", send_buf, ">");
+
+    return httpclient_write(client, send_buf, len);
+}
+
+int httpclient_send_userdata(httpclient_t *client, httpclient_data_t *client_data)
+{
     if (client_data->post_buf && client_data->post_buf_len) {
         log_debug("client_data->post_buf: %s", client_data->post_buf);
-        {
-            /* ret = httpclient_tcp_send_all(client->handle, (char *)client_data->post_buf, client_data->post_buf_len); */
-            ret = client->net.write(&client->net, (char *)client_data->post_buf, client_data->post_buf_len, 5000);
-            if (ret > 0) {
-                log_debug("Written %d bytes", ret);
-            } else if (ret == 0) {
-                log_err("ret == 0,Connection was closed by server");
-                return ERROR_HTTP_CLOSED; /* Connection was closed by server */
-            } else {
-                log_err("Connection error (send returned %d)", ret);
-                return ERROR_HTTP_CONN;
-            }
-        }
+        return httpclient_write(client, client_data->post_buf, client_data->post_buf_len);
     }
 
     return SUCCESS_RETURN;
@@ -410,282 +416,206 @@ int httpclient_recv(httpclient_t *client, char *buf, int min_len, int max_len, i
     /*    return 0; */
 }
 
-int httpclient_retrieve_content(httpclient_t *client, char *data, int len, uint32_t timeout_ms,
-                                httpclient_data_t *client_data)
+#if defined(HTTP_INFLATE)
+/* keep the @len bytes of a compressed body at @data until they are decoded */
+static int httpclient_inflate_input(httpclient_t *client, int encoding, const char *data, int len)
 {
-    int count = 0;
-    int templen = 0;
-    int crlf_pos;
-    iotx_time_t timer;
-
-    iotx_time_init(&timer);
-    utils_time_countdown_ms(&timer, timeout_ms);
-
-    /* Receive data */
-    log_debug("Current data: %s", data);
-
-    client_data->is_more = true;
-
-    if (client_data->response_content_len == -1 && client_data->is_chunked == false) {
-        while (true) {
-            int ret, max_len;
-            if (count + len < client_data->response_buf_len - 1) {
-                memcpy(client_data->response_buf + count, data, len);
-                count += len;
-                client_data->response_buf[count] = '\0';
-            } else {
-                memcpy(client_data->response_buf + count, data, client_data->response_buf_len - 1 - count);
-                client_data->response_buf[client_data->response_buf_len - 1] = '\0';
-                return HTTP_RETRIEVE_MORE_DATA;
-            }
+    httpclient_inflate_t *decoder = (httpclient_inflate_t *)client->inflate;
 
-            max_len = HTTPCLIENT_MIN(HTTPCLIENT_CHUNK_SIZE - 1, client_data->response_buf_len - 1 - count);
-            ret = httpclient_recv(client, data, 1, max_len, &len, iotx_time_left(&timer));
-
-            /* Receive data */
-            log_debug("data len: %d %d", len, count);
-
-            if (ret == ERROR_HTTP_CONN) {
-                log_debug("ret == ERROR_HTTP_CONN");
-                return ret;
-            }
-
-            if (len == 0) {
-                /* read no more data */
-                log_debug("no more len == 0");
-                client_data->is_more = false;
-                return SUCCESS_RETURN;
-            }
+    if (NULL == decoder) {
+        decoder = LITE_malloc(sizeof(httpclient_inflate_t) + (1 << HTTPCLIENT_INFLATE_WINDOW_BITS));
+        if (NULL == decoder) {
+            log_err("no memory to decode a compressed body");
+            return ERROR_HTTP;
         }
+        decoder->active = 0;
+        client->inflate = decoder;
     }
 
-    while (true) {
-        uint32_t readLen = 0;
-
-        if (client_data->is_chunked && client_data->retrieve_len <= 0) {
-            /* Read chunk header */
-            bool foundCrlf;
-            int n;
-            do {
-                foundCrlf = false;
-                crlf_pos = 0;
-                data[len] = 0;
-                if (len >= 2) {
-                    for (; crlf_pos < len - 2; crlf_pos++) {
-                        if (data[crlf_pos] == '\r' && data[crlf_pos + 1] == '\n') {
-                            foundCrlf = true;
-                            break;
-                        }
-                    }
-                }
-                if (!foundCrlf) {
-                    /* Try to read more */
-                    if (len < HTTPCLIENT_CHUNK_SIZE) {
-                        int new_trf_len, ret;
-                        ret = httpclient_recv(client,
-                                              data + len,
-                                              0,
-                                              HTTPCLIENT_CHUNK_SIZE - len - 1,
-                                              &new_trf_len,
-                                              iotx_time_left(&timer));
-                        len += new_trf_len;
-                        if (ret == ERROR_HTTP_CONN) {
-                            return ret;
-                        } else {
-                            continue;
-                        }
-                    } else {
-                        return ERROR_HTTP;
-                    }
-                }
-            } while (!foundCrlf);
-            data[crlf_pos] = '\0';
-            n = sscanf(data, "%x", &readLen);/* chunk length */
-            client_data->retrieve_len = readLen;
-            client_data->response_content_len += client_data->retrieve_len;
-            if (n != 1) {
-                log_err("Could not read chunk length");
-                return ERROR_HTTP_UNRESOLVED_DNS;
-            }
-
-            memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2)); /* Not need to move NULL-terminating char any more */
-            len -= (crlf_pos + 2);
-
-            if (readLen == 0) {
-                /* Last chunk */
-                client_data->is_more = false;
-                log_debug("no more (last chunk)");
-                break;
-            }
-        } else {
-            readLen = client_data->retrieve_len;
+    if (!decoder->active) {
+        if (HTTPCLIENT_ENCODING_OTHER == encoding) {
+            log_err("unsupported Content-Encoding");
+            return ERROR_HTTP_PRTCL;
         }
+        utils_inflate_init(&decoder->stream,
+                           (HTTPCLIENT_ENCODING_GZIP == encoding) ? UTILS_INFLATE_GZIP : UTILS_INFLATE_ZLIB,
+                           (uint8_t *)(decoder + 1), HTTPCLIENT_INFLATE_WINDOW_BITS);
+        decoder->active = 1;
+        decoder->pos = 0;
+        decoder->len = 0;
+    }
 
-        log_debug("Total-Payload: %d Bytes; Read: %d Bytes", readLen, len);
-
-        do {
-            templen = HTTPCLIENT_MIN(len, readLen);
-            if (count + templen < client_data->response_buf_len - 1) {
-                memcpy(client_data->response_buf + count, data, templen);
-                count += templen;
-                client_data->response_buf[count] = '\0';
-                client_data->retrieve_len -= templen;
-            } else {
-                memcpy(client_data->response_buf + count, data, client_data->response_buf_len - 1 - count);
-                client_data->response_buf[client_data->response_buf_len - 1] = '\0';
-                client_data->retrieve_len -= (client_data->response_buf_len - 1 - count);
-                return HTTP_RETRIEVE_MORE_DATA;
-            }
+    if (decoder->pos == decoder->len) {
+        decoder->pos = 0;
+        decoder->len = 0;
+    }
+    if (len > (int)sizeof(decoder->input) - decoder->len) {
+        return ERROR_HTTP;
+    }
+    memcpy(decoder->input + decoder->len, data, len);
+    decoder->len += len;
 
-            if (len > readLen) {
-                log_debug("memmove %d %d %d\n", readLen, len, client_data->retrieve_len);
-                memmove(data, &data[readLen], len - readLen); /* chunk case, read between two chunks */
-                len -= readLen;
-                readLen = 0;
-                client_data->retrieve_len = 0;
-            } else {
-                readLen -= len;
-            }
+    return SUCCESS_RETURN;
+}
 
-            if (readLen) {
-                int ret;
-                int max_len = HTTPCLIENT_MIN(HTTPCLIENT_CHUNK_SIZE - 1, client_data->response_buf_len - 1 - count);
-                max_len = HTTPCLIENT_MIN(max_len, readLen);
-                ret = httpclient_recv(client, data, 1, max_len, &len, iotx_time_left(&timer));
-                if (ret == ERROR_HTTP_CONN) {
-                    return ret;
-                }
-            }
-        } while (readLen);
-
-        if (client_data->is_chunked) {
-            if (len < 2) {
-                int new_trf_len, ret;
-                /* Read missing chars to find end of chunk */
-                ret = httpclient_recv(client, data + len, 2 - len, HTTPCLIENT_CHUNK_SIZE - len - 1, &new_trf_len,
-                                      iotx_time_left(&timer));
-                if (ret == ERROR_HTTP_CONN) {
-                    return ret;
-                }
-                len += new_trf_len;
-            }
-            if ((data[0] != '\r') || (data[1] != '\n')) {
-                log_err("Format error, %s", data); /* after memmove, the beginning of next chunk */
-                return ERROR_HTTP_UNRESOLVED_DNS;
-            }
-            memmove(data, &data[2], len - 2); /* remove the \r\n */
-            len -= 2;
-        } else {
-            log_debug("no more (content-length)");
-            client_data->is_more = false;
-            break;
-        }
+/* decode the compressed bytes kept into @buf of @len bytes, return the bytes of data put in it or
+ * ERROR_HTTP_PRTCL if the body is corrupt */
+static int httpclient_inflate_output(httpclient_t *client, char *buf, int len)
+{
+    httpclient_inflate_t *decoder = (httpclient_inflate_t *)client->inflate;
+    int n, used;
 
+    n = utils_inflate(&decoder->stream, decoder->input + decoder->pos, decoder->len - decoder->pos, &used,
+                      (uint8_t *)buf, len);
+    if (n < 0) {
+        log_err("corrupt compressed body");
+        return ERROR_HTTP_PRTCL;
     }
+    decoder->pos += used;
 
-    return SUCCESS_RETURN;
+    return n;
 }
+#else
+/* no decoder is built in and no coding is accepted, a compressed body is not usable */
+static int httpclient_inflate_input(httpclient_t *client, int encoding, const char *data, int len)
+{
+    log_err("unsupported Content-Encoding");
+    return ERROR_HTTP_PRTCL;
+}
+#endif
 
-int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_t timeout_ms,
-                              httpclient_data_t *client_data)
+/* read the rest of the response into the buffer of @client_data, or as much of its body as fits.
+ * No read is longer than the rest of the response is at the least: the HALs return when the length
+ * asked for is read or on timeout, a longer read would wait for its timeout, and take the beginning
+ * of the next response on a kept connection. The body goes straight into the buffer, the head and
+ * the framing of the chunks are read apart and dropped once parsed. A compressed body is read apart
+ * too, and decoded into the buffer as it has room. */
+int httpclient_retrieve_content(httpclient_t *client, uint32_t timeout_ms, httpclient_data_t *client_data)
 {
-    int crlf_pos;
+    httpclient_parser_t *parser = &client_data->parser;
+    char frame[HTTPCLIENT_CHUNK_SIZE];
+    char *data;
+    int count = 0, space, len, pos, n, body_len, ret = 0, timed_out = 0;
+    uint32_t want;
     iotx_time_t timer;
+#if defined(HTTP_INFLATE)
+    httpclient_inflate_t *decoder = NULL;
+#endif
 
     iotx_time_init(&timer);
     utils_time_countdown_ms(&timer, timeout_ms);
 
-    client_data->response_content_len = -1;
-
-    char *crlf_ptr = strstr(data, "\r\n");
-    if (crlf_ptr == NULL) {
-        log_err("\r\n not found");
-        return ERROR_HTTP_UNRESOLVED_DNS;
-    }
-
-    crlf_pos = crlf_ptr - data;
-    data[crlf_pos] = '\0';
-
-    /* Parse HTTP response */
-    if (sscanf(data, "HTTP/%*d.%*d %d %*[^\r\n]", &(client->response_code)) != 1) {
-        /* Cannot match string, error */
-        log_err("Not a correct HTTP answer : %s\n", data);
-        return ERROR_HTTP_UNRESOLVED_DNS;
-    }
-
-    if ((client->response_code < 200) || (client->response_code >= 400)) {
-        /* Did not return a 2xx code; TODO fetch headers/(&data?) anyway and implement a mean of writing/reading headers */
-        log_warning("Response code %d", client->response_code);
-    }
-
-    log_debug("Reading headers%s", data);
-
-    memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1); /* Be sure to move NULL-terminating char as well */
-    len -= (crlf_pos + 2);
-
-    client_data->is_chunked = false;
-
-    /* Now get headers */
-    while (true) {
-        char key[32];
-        char value[32];
-        int n;
-
-        key[31] = '\0';
-        value[31] = '\0';
+    for (;;) {
+        space = client_data->response_buf_len - 1 - count;
+#if defined(HTTP_INFLATE)
+        decoder = (httpclient_inflate_t *)client->inflate;
+        if (NULL != decoder && decoder->active) {
+            n = httpclient_inflate_output(client, client_data->response_buf + count, space);
+            if (n < 0) {
+                return n;
+            }
+            count += n;
+            space -= n;
+            if (decoder->pos < decoder->len) {
+                /* the buffer is full */
+                break;
+            }
+        }
+#endif
+        if (httpclient_parser_is_done(parser)) {
+            break;
+        }
 
-        crlf_ptr = strstr(data, "\r\n");
-        if (crlf_ptr == NULL) {
-            if (len < HTTPCLIENT_CHUNK_SIZE - 1) {
-                int new_trf_len, ret;
-                ret = httpclient_recv(client, data + len, 1, HTTPCLIENT_CHUNK_SIZE - len - 1, &new_trf_len, iotx_time_left(&timer));
-                len += new_trf_len;
-                data[len] = '\0';
-                log_debug("Read %d chars; In buf: [%s]", new_trf_len, data);
-                if (ret == ERROR_HTTP_CONN) {
-                    return ret;
-                } else {
-                    continue;
+        want = httpclient_parser_want_body(parser);
+        if (want >= sizeof(frame) && HTTPCLIENT_ENCODING_IDENTITY == parser->encoding) {
+            /* body only, into the buffer */
+            if (space <= 0) {
+                break;
+            }
+            data = client_data->response_buf + count;
+            len = HTTPCLIENT_MIN(want, (uint32_t)space);
+        } else {
+            /* the head, a short span of the body with the framing of the chunks around it, or a
+             * span of a compressed body */
+            data = frame;
+            len = HTTPCLIENT_MIN(httpclient_parser_want(parser), sizeof(frame));
+            if (httpclient_parser_is_head_done(parser)) {
+                if (space <= 0) {
+                    break;
                 }
-            } else {
-                log_debug("header len > chunksize");
-                return ERROR_HTTP;
+                len = HTTPCLIENT_MIN(len, space);
             }
         }
 
-        crlf_pos = crlf_ptr - data;
-        if (crlf_pos == 0) {
-            /* End of headers */
-            memmove(data, &data[2], len - 2 + 1); /* Be sure to move NULL-terminating char as well */
-            len -= 2;
+        ret = httpclient_recv(client, data, 1, len, &len, iotx_time_left(&timer));
+        if (ERROR_HTTP_CONN == ret && 0 == httpclient_parser_finish(parser)) {
+            /* the body ends with the connection, what is kept of it is decoded still */
+            ret = 0;
+            continue;
+        }
+        if (0 != ret) {
+            return ret;
+        }
+        if (0 == len) {
+            log_debug("timeout, %d bytes of body read", count);
+            timed_out = 1;
             break;
         }
 
-        data[crlf_pos] = '\0';
-
-        n = sscanf(data, "%31[^:]: %31[^\r\n]", key, value);
-        if (n == 2) {
-            log_debug("Read header : %s: %s", key, value);
-            if (!strcmp(key, "Content-Length")) {
-                sscanf(value, "%d", &(client_data->response_content_len));
-                client_data->retrieve_len = client_data->response_content_len;
-            } else if (!strcmp(key, "Transfer-Encoding")) {
-                if (!strcmp(value, "Chunked") || !strcmp(value, "chunked")) {
-                    client_data->is_chunked = true;
-                    client_data->response_content_len = 0;
-                    client_data->retrieve_len = 0;
+        for (pos = 0; pos < len; pos += n) {
+            n = httpclient_parser_execute(parser, data + pos, len - pos, &body_len);
+            if (n <= 0) {
+                log_err("malformed response (%d)", n);
+                return ERROR_HTTP_PRTCL;
+            }
+            if (body_len > 0 && HTTPCLIENT_ENCODING_IDENTITY != parser->encoding) {
+                ret = httpclient_inflate_input(client, parser->encoding, data + pos + n - body_len, body_len);
+                if (0 != ret) {
+                    return ret;
                 }
+                continue;
             }
-            memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1); /* Be sure to move NULL-terminating char as well */
-            len -= (crlf_pos + 2);
+            if (body_len > 0 && data == frame) {
+                memcpy(client_data->response_buf + count, data + pos + n - body_len, body_len);
+            }
+            count += body_len;
+        }
+    }
 
-        } else {
-            log_err("Could not parse header");
-            return ERROR_HTTP;
+    client_data->response_buf[count] = '\0';
+    client_data->response_data_len = count;
+
+    client->response_code = httpclient_parser_is_head_done(parser) ? parser->response_code : 0;
+    client->is_closing = parser->is_closing;
+    client_data->is_chunked = parser->is_chunked;
+    client_data->response_content_len = parser->content_len;
+    client_data->retrieve_len = (parser->content_len < 0) ? 0 : httpclient_parser_want_body(parser);
+    client_data->is_more = !httpclient_parser_is_done(parser);
+
+#if defined(HTTP_INFLATE)
+    if (NULL != decoder && decoder->active && !utils_inflate_is_done(&decoder->stream)) {
+        if (!client_data->is_more && count < client_data->response_buf_len - 1) {
+            /* all of the body is decoded, the compressed stream is not */
+            log_err("compressed body cut short");
+            return ERROR_HTTP_PRTCL;
         }
+        client_data->is_more = true;
+    }
+#endif
+
+    if (!httpclient_parser_is_head_done(parser)) {
+        /* no response at all, or one cut in its head */
+        return httpclient_parser_want(parser) < HTTPCLIENT_MIN_HEAD_LEN ? ERROR_HTTP : SUCCESS_RETURN;
+    }
+
+    if (timed_out && 0 == count) {
+        /* the server stalls in the body, the connection is left as it is for the caller to wait more */
+        return ERROR_HTTP_TIMEOUT;
     }
 
-    return httpclient_retrieve_content(client, data, len, iotx_time_left(&timer), client_data);
+    log_debug("response code %d, %d bytes of body%s", client->response_code, count,
+              client_data->is_more ? ", more to come" : "");
+    return client_data->is_more ? HTTP_RETRIEVE_MORE_DATA : SUCCESS_RETURN;
 }
 
 int httpclient_connect(httpclient_t *client)
@@ -706,13 +636,28 @@ int httpclient_connect(httpclient_t *client)
 int httpclient_send_request(httpclient_t *client, const char *url, int method, httpclient_data_t *client_data)
 {
     int ret = ERROR_HTTP_CONN;
+    int len;
+    char send_buf[HTTPCLIENT_SEND_BUF_SIZE];
 
     if (0 == client->net.handle) {
         log_debug("not connection have been established");
         return ret;
     }
 
-    ret = httpclient_send_header(client, url, method, client_data);
+    /* the header and the body in one write when they fit, that is one TLS record, and one segment
+     * the network does not hold back until the header is acknowledged */
+    len = httpclient_format_request(client, url, method, client_data, send_buf, HTTPCLIENT_SEND_BUF_SIZE);
+    if (len > 0) {
+        return httpclient_write(client, send_buf, len);
+    }
+
+    len = httpclient_format_header(client, url, method, client_data, send_buf, HTTPCLIENT_SEND_BUF_SIZE);
+    if (len < 0) {
+        log_err("Could not write request");
+        return ERROR_HTTP_CONN;
+    }
+
+    ret = httpclient_write(client, send_buf, len);
     if (ret != 0) {
         log_err("httpclient_send_header is error,ret = %d", ret);
         return ret;
@@ -727,37 +672,23 @@ int httpclient_send_request(httpclient_t *client, const char *url, int method, h
 
 int httpclient_recv_response(httpclient_t *client, uint32_t timeout_ms, httpclient_data_t *client_data)
 {
-    int reclen = 0, ret = ERROR_HTTP_CONN;
-    char buf[HTTPCLIENT_CHUNK_SIZE] = { 0 };
-    iotx_time_t timer;
-
-    iotx_time_init(&timer);
-    utils_time_countdown_ms(&timer, timeout_ms);
-
     if (0 == client->net.handle) {
         log_debug("not connection have been established");
-        return ret;
+        return ERROR_HTTP_CONN;
     }
 
-    if (client_data->is_more) {
-        client_data->response_buf[0] = '\0';
-        ret = httpclient_retrieve_content(client, buf, reclen, iotx_time_left(&timer), client_data);
-    } else {
-        client_data->is_more = 1;
-        ret = httpclient_recv(client, buf, 1, HTTPCLIENT_CHUNK_SIZE - 1, &reclen, iotx_time_left(&timer));
-        if (ret != 0) {
-            return ret;
-        }
-
-        buf[reclen] = '\0';
-
-        if (reclen) {
-            log_multi_line(LOG_DEBUG_LEVEL, "RESPONSE", "%s", buf, "<");
-            ret = httpclient_response_parse(client, buf, reclen, iotx_time_left(&timer), client_data);
+    if (!client_data->is_more) {
+        /* a new response */
+        client_data->is_more = true;
+        httpclient_parser_init(&client_data->parser);
+#if defined(HTTP_INFLATE)
+        if (NULL != client->inflate) {
+            ((httpclient_inflate_t *)client->inflate)->active = 0;
         }
+#endif
     }
 
-    return ret;
+    return httpclient_retrieve_content(client, timeout_ms, client_data);
 }
 
 void httpclient_close(httpclient_t *client)
@@ -766,6 +697,31 @@ void httpclient_close(httpclient_t *client)
         client->net.disconnect(&client->net);
     }
     client->net.handle = 0;
+
+#if defined(HTTP_INFLATE)
+    if (NULL != client->inflate) {
+        LITE_free(client->inflate);
+    }
+#endif
+}
+
+int httpclient_is_alive(httpclient_t *client)
+{
+    char byte;
+
+    if (0 == client->net.handle) {
+        return 0;
+    }
+
+    /* nothing comes from the server between two responses, a read which does not time out gets the
+     * end of the connection or data out of any response */
+    if (0 != client->net.read(&client->net, &byte, 1, 1)) {
+        log_info("kept connection closed by server");
+        httpclient_close(client);
+        return 0;
+    }
+
+    return 1;
 }
 
 int httpclient_common(httpclient_t *client, const char *url, int port, const char *ca_crt, int method,
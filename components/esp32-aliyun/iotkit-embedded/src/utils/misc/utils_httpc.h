@@ -22,6 +22,7 @@
 #include "iot_import.h"
 #include "iot_export.h"
 #include "utils_net.h"
+#include "utils_http_parser.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -79,9 +80,11 @@ typedef struct {
     int                 remote_port;    /**< HTTP or HTTPS port. */
     utils_network_t     net;
     int                 response_code;  /**< Response code. */
+    bool                is_closing;     /**< The server closes the connection after the response. */
     char               *header;         /**< Custom header. */
     char               *auth_user;      /**< Username for basic authentication. */
     char               *auth_password;  /**< Password for basic authentication. */
+    void               *inflate;        /**< Decoder of compressed bodies, freed by httpclient_close(). */
 } httpclient_t;
 
 /** @brief   This structure defines the HTTP data structure.  */
@@ -92,9 +95,11 @@ typedef struct {
     int     response_content_len;   /**< Response content length. */
     int     post_buf_len;           /**< Post data length. */
     int     response_buf_len;       /**< Response buffer length. */
+    int     response_data_len;      /**< Bytes of the body put in the buffer by the last call, decoded. */
     char   *post_content_type;      /**< Content type of the post data. */
     char   *post_buf;               /**< User data to be posted. */
     char   *response_buf;           /**< Buffer to store the response data. */
+    httpclient_parser_t parser;     /**< State of the response being read. */
 } httpclient_data_t;
 
 
@@ -142,6 +147,25 @@ int httpclient_common(httpclient_t *client, const char *url, int port, const cha
                       uint32_t timeout_ms,
                       httpclient_data_t *client_data);
 
+void httpclient_close(httpclient_t *client);
+
+int httpclient_connect(httpclient_t *client);
+
+int httpclient_send_request(httpclient_t *client, const char *url, int method, httpclient_data_t *client_data);
+
+/* write the request line, the headers and the body of a request into @buf, to send several requests
+ * in one httpclient_write(). return its length, or ERROR_HTTP if it does not fit in @buf_len bytes */
+int httpclient_format_request(httpclient_t *client, const char *url, int method, httpclient_data_t *client_data,
+                              char *buf, int buf_len);
+
+int httpclient_write(httpclient_t *client, const char *buf, int len);
+
+int httpclient_recv_response(httpclient_t *client, uint32_t timeout_ms, httpclient_data_t *client_data);
+
+/* check that the connection of @client kept from a previous request is still open, close it if not.
+ * return 1 if it is open, 0 if not */
+int httpclient_is_alive(httpclient_t *client);
+
 #ifdef __cplusplus
 }
 #endif
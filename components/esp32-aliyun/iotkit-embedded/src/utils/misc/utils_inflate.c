@@ -0,0 +1,670 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <string.h>
+#include "iot_import.h"
+#include "iot_export.h"
+#include "utils_inflate.h"
+
+enum {
+    UTILS_INFLATE_HEADER,           /* the zlib or gzip header */
+    UTILS_INFLATE_GZIP_EXTRA_LEN,
+    UTILS_INFLATE_GZIP_EXTRA,
+    UTILS_INFLATE_GZIP_NAME,
+    UTILS_INFLATE_GZIP_COMMENT,
+    UTILS_INFLATE_GZIP_HCRC,
+    UTILS_INFLATE_BLOCK,            /* the 3 bits starting a block */
+    UTILS_INFLATE_STORED,           /* LEN and NLEN of a stored block */
+    UTILS_INFLATE_COPY,             /* the bytes of a stored block */
+    UTILS_INFLATE_TABLE,            /* HLIT, HDIST and HCLEN of a dynamic block */
+    UTILS_INFLATE_LENLENS,          /* the lengths of the code length code */
+    UTILS_INFLATE_CODELENS,         /* the lengths of the literal/length and distance codes */
+    UTILS_INFLATE_CODES,            /* a literal, a length or the end of the block */
+    UTILS_INFLATE_LENEXT,
+    UTILS_INFLATE_DIST,
+    UTILS_INFLATE_DISTEXT,
+    UTILS_INFLATE_MATCH,            /* the bytes of a match */
+    UTILS_INFLATE_TRAILER,          /* the check of zlib, the CRC-32 and the size of gzip */
+    UTILS_INFLATE_DONE,
+    UTILS_INFLATE_ERROR
+};
+
+#define UTILS_INFLATE_MAX_BITS  (15)    /* of a code */
+
+#define GZIP_FLAG_HCRC          (0x02)
+#define GZIP_FLAG_EXTRA         (0x04)
+#define GZIP_FLAG_NAME          (0x08)
+#define GZIP_FLAG_COMMENT       (0x10)
+#define GZIP_FLAG_RESERVED      (0xe0)
+
+static const uint8_t inflate_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+static const uint16_t inflate_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t inflate_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t inflate_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t inflate_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* CRC-32 of gzip a nibble at a time, 64 bytes of table */
+static const uint32_t inflate_crc_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+/* add the data given since the last time to the check */
+static void _inflate_sum(utils_inflate_t *s)
+{
+    const uint8_t *p = s->out + s->sum_pos, *end = s->out + s->out_pos;
+    uint32_t a, b, n;
+
+    if (UTILS_INFLATE_GZIP == s->format) {
+        uint32_t crc = ~s->check;
+
+        for (; p < end; p++) {
+            crc ^= *p;
+            crc = (crc >> 4) ^ inflate_crc_table[crc & 0x0f];
+            crc = (crc >> 4) ^ inflate_crc_table[crc & 0x0f];
+        }
+        s->check = ~crc;
+    } else if (UTILS_INFLATE_ZLIB == s->format) {
+        /* Adler-32, the sums fit in 32 bits for 5552 bytes between two reductions */
+        a = s->check & 0xffff;
+        b = s->check >> 16;
+        while (p < end) {
+            n = (end - p < 5552) ? end - p : 5552;
+            while (n-- > 0) {
+                a += *p++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        s->check = (b << 16) | a;
+    }
+    s->sum_pos = s->out_pos;
+}
+
+/* read the stream ahead, as much as fits in the bits held */
+static void _inflate_pull(utils_inflate_t *s)
+{
+    while (s->bits <= 24 && s->in_pos < s->in_len) {
+        s->hold |= (uint32_t)s->in[s->in_pos++] << s->bits;
+        s->bits += 8;
+    }
+}
+
+/* whether @n bits are held, up to 25 */
+static int _inflate_need(utils_inflate_t *s, int n)
+{
+    if (s->bits < n) {
+        _inflate_pull(s);
+    }
+    return s->bits >= n;
+}
+
+static uint32_t _inflate_bits(utils_inflate_t *s, int n)
+{
+    uint32_t value = s->hold & ((1u << n) - 1);
+
+    s->hold >>= n;
+    s->bits -= n;
+    return value;
+}
+
+/* the next byte of a byte aligned stream, -1 if the input is used up */
+static int _inflate_byte(utils_inflate_t *s)
+{
+    if (s->bits >= 8) {
+        return (int)_inflate_bits(s, 8);
+    }
+    if (s->in_pos < s->in_len) {
+        return s->in[s->in_pos++];
+    }
+    return -1;
+}
+
+/* a byte of data, into the output and the window */
+static void _inflate_put(utils_inflate_t *s, uint8_t c)
+{
+    s->window[s->window_pos] = c;
+    s->window_pos = (s->window_pos + 1) & (s->window_size - 1);
+    s->out[s->out_pos++] = c;
+}
+
+/* the canonical code of the @n code @lens: the codes of every length and the symbols in code order.
+ * 0 if the code is complete, or if it has a single code of 1 bit, or none, which a stream of one
+ * distance or of literals only has; -1 otherwise */
+static int _inflate_build(uint16_t *count, uint16_t *symbol, const uint8_t *lens, int n)
+{
+    int i, left = 1;
+    uint16_t offs[UTILS_INFLATE_MAX_BITS + 1];
+
+    memset(count, 0, (UTILS_INFLATE_MAX_BITS + 1) * sizeof(uint16_t));
+    for (i = 0; i < n; i++) {
+        count[lens[i]]++;
+    }
+    count[0] = 0;
+
+    for (i = 1; i <= UTILS_INFLATE_MAX_BITS; i++) {
+        left = (left << 1) - count[i];
+        if (left < 0) {
+            /* over-subscribed */
+            return -1;
+        }
+    }
+
+    offs[1] = 0;
+    for (i = 1; i < UTILS_INFLATE_MAX_BITS; i++) {
+        offs[i + 1] = offs[i] + count[i];
+    }
+    for (i = 0; i < n; i++) {
+        if (0 != lens[i]) {
+            symbol[offs[lens[i]]++] = i;
+        }
+    }
+
+    if (left > 0 && offs[UTILS_INFLATE_MAX_BITS] + count[UTILS_INFLATE_MAX_BITS] > count[1]) {
+        /* incomplete with codes longer than a bit */
+        return -1;
+    }
+    return 0;
+}
+
+/* the symbol of the code at the head of the bits held: the length of the code, 0 if the bits held
+ * end within it, -1 if it is not a code. The bits are not dropped. */
+static int _inflate_decode(utils_inflate_t *s, const uint16_t *count, const uint16_t *symbol, int *p_sym)
+{
+    int len, code = 0, first = 0, index = 0;
+
+    for (len = 1; len <= UTILS_INFLATE_MAX_BITS; len++) {
+        if (len > s->bits) {
+            return 0;
+        }
+        code |= (s->hold >> (len - 1)) & 1;
+        if (code - (int)count[len] < first) {
+            *p_sym = symbol[index + code - first];
+            return len;
+        }
+        index += count[len];
+        first = (first + count[len]) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+/* the codes of a block with fixed Huffman codes */
+static void _inflate_fixed(utils_inflate_t *s)
+{
+    int i;
+
+    for (i = 0; i < 288; i++) {
+        s->lens[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    }
+    _inflate_build(s->lencount, s->lensym, s->lens, 288);
+    memset(s->lens, 5, 30);
+    _inflate_build(s->distcount, s->distsym, s->lens, 30);
+}
+
+/* the end of a block, the trailer follows the last one */
+static int _inflate_block_end(utils_inflate_t *s)
+{
+    if (!s->last) {
+        return UTILS_INFLATE_BLOCK;
+    }
+    _inflate_bits(s, s->bits & 7);
+    _inflate_sum(s);
+    s->index = 0;
+    s->value = 0;
+    return (UTILS_INFLATE_RAW == s->format) ? UTILS_INFLATE_DONE : UTILS_INFLATE_TRAILER;
+}
+
+/* a byte of the zlib or gzip header: the next state */
+static int _inflate_header(utils_inflate_t *s, int c)
+{
+    if (UTILS_INFLATE_ZLIB == s->format) {
+        s->value = (s->value << 8) | c;
+        if (++s->index < 2) {
+            return UTILS_INFLATE_HEADER;
+        }
+        /* CM 8, a window we have, no preset dictionary */
+        if (0 != s->value % 31 || 8 != ((s->value >> 8) & 0x0f)
+            || (1u << (((s->value >> 12) & 0x0f) + 8)) > s->window_size || (s->value & 0x20)) {
+            return UTILS_INFLATE_ERROR;
+        }
+        return UTILS_INFLATE_BLOCK;
+    }
+
+    /* ID1 ID2 CM FLG MTIME(4) XFL OS */
+    switch (s->index++) {
+        case 0:
+            return (0x1f == c) ? UTILS_INFLATE_HEADER : UTILS_INFLATE_ERROR;
+        case 1:
+            return (0x8b == c) ? UTILS_INFLATE_HEADER : UTILS_INFLATE_ERROR;
+        case 2:
+            return (8 == c) ? UTILS_INFLATE_HEADER : UTILS_INFLATE_ERROR;
+        case 3:
+            s->value = c;
+            return (c & GZIP_FLAG_RESERVED) ? UTILS_INFLATE_ERROR : UTILS_INFLATE_HEADER;
+        default:
+            break;
+    }
+    if (s->index < 10) {
+        return UTILS_INFLATE_HEADER;
+    }
+    s->index = 0;
+    return UTILS_INFLATE_GZIP_EXTRA_LEN;
+}
+
+/* the optional fields of the gzip header, which are skipped: the next state, or -1 for more input */
+static int _inflate_gzip_fields(utils_inflate_t *s)
+{
+    /* s->value keeps FLG in its low byte, the length of FEXTRA above */
+    int c;
+
+    switch (s->state) {
+        case UTILS_INFLATE_GZIP_EXTRA_LEN:
+            if (!(s->value & GZIP_FLAG_EXTRA)) {
+                return UTILS_INFLATE_GZIP_NAME;
+            }
+            while (s->index < 2) {
+                if ((c = _inflate_byte(s)) < 0) {
+                    return -1;
+                }
+                s->value |= (uint32_t)c << (8 + 8 * s->index++);
+            }
+            return UTILS_INFLATE_GZIP_EXTRA;
+
+        case UTILS_INFLATE_GZIP_EXTRA:
+            while (s->value > 0xff) {
+                if (_inflate_byte(s) < 0) {
+                    return -1;
+                }
+                s->value -= 0x100;
+            }
+            return UTILS_INFLATE_GZIP_NAME;
+
+        case UTILS_INFLATE_GZIP_NAME:
+        case UTILS_INFLATE_GZIP_COMMENT:
+            if (s->value & (UTILS_INFLATE_GZIP_NAME == s->state ? GZIP_FLAG_NAME : GZIP_FLAG_COMMENT)) {
+                do {
+                    if ((c = _inflate_byte(s)) < 0) {
+                        return -1;
+                    }
+                } while (0 != c);
+            }
+            s->index = 0;
+            return s->state + 1;
+
+        default:
+            if (s->value & GZIP_FLAG_HCRC) {
+                while (s->index < 2) {
+                    if (_inflate_byte(s) < 0) {
+                        return -1;
+                    }
+                    s->index++;
+                }
+            }
+            return UTILS_INFLATE_BLOCK;
+    }
+}
+
+/* the trailer: the next state, or -1 for more input */
+static int _inflate_trailer(utils_inflate_t *s)
+{
+    int c, len = (UTILS_INFLATE_GZIP == s->format) ? 8 : 4;
+
+    while (s->index < len) {
+        if ((c = _inflate_byte(s)) < 0) {
+            return -1;
+        }
+        if (UTILS_INFLATE_ZLIB == s->format) {
+            s->value = (s->value << 8) | c;
+        } else {
+            s->value |= (uint32_t)c << (8 * (s->index & 3));
+        }
+
+        if (3 == s->index && s->value != s->check) {
+            return UTILS_INFLATE_ERROR;
+        }
+        if (7 == s->index && s->value != s->total + s->out_pos) {
+            /* ISIZE, the size modulo 2^32 */
+            return UTILS_INFLATE_ERROR;
+        }
+        if (3 == s->index) {
+            s->value = 0;
+        }
+        s->index++;
+    }
+    return UTILS_INFLATE_DONE;
+}
+
+/* the lengths of the codes of a dynamic block: the next state, or -1 for more input */
+static int _inflate_code_lengths(utils_inflate_t *s)
+{
+    int len, sym, rep, value, extra;
+
+    if (UTILS_INFLATE_LENLENS == s->state) {
+        for (; s->index < s->ncode; s->index++) {
+            if (!_inflate_need(s, 3)) {
+                return -1;
+            }
+            s->lens[inflate_order[s->index]] = _inflate_bits(s, 3);
+        }
+        for (; s->index < 19; s->index++) {
+            s->lens[inflate_order[s->index]] = 0;
+        }
+        if (0 != _inflate_build(s->lencount, s->lensym, s->lens, 19)) {
+            return UTILS_INFLATE_ERROR;
+        }
+        s->index = 0;
+        s->state = UTILS_INFLATE_CODELENS;
+    }
+
+    while (s->index < s->nlen + s->ndist) {
+        _inflate_pull(s);
+        len = _inflate_decode(s, s->lencount, s->lensym, &sym);
+        if (len <= 0) {
+            return (0 == len) ? -1 : UTILS_INFLATE_ERROR;
+        }
+        if (sym < 16) {
+            _inflate_bits(s, len);
+            s->lens[s->index++] = sym;
+            continue;
+        }
+
+        /* 16: the previous length 3 to 6 times, 17: 3 to 10 zeros, 18: 11 to 138 zeros */
+        extra = (16 == sym) ? 2 : (17 == sym) ? 3 : 7;
+        if (s->bits < len + extra) {
+            return -1;
+        }
+        if (16 == sym && 0 == s->index) {
+            return UTILS_INFLATE_ERROR;
+        }
+        value = (16 == sym) ? s->lens[s->index - 1] : 0;
+        _inflate_bits(s, len);
+        rep = _inflate_bits(s, extra) + ((18 == sym) ? 11 : 3);
+        if (s->index + rep > s->nlen + s->ndist) {
+            return UTILS_INFLATE_ERROR;
+        }
+        memset(s->lens + s->index, value, rep);
+        s->index += rep;
+    }
+
+    /* the end of block code is needed */
+    if (0 == s->lens[256]
+        || 0 != _inflate_build(s->lencount, s->lensym, s->lens, s->nlen)
+        || 0 != _inflate_build(s->distcount, s->distsym, s->lens + s->nlen, s->ndist)) {
+        return UTILS_INFLATE_ERROR;
+    }
+    return UTILS_INFLATE_CODES;
+}
+
+/* run the state machine until the output is full, the input is used up, the end or an error */
+static void _inflate_run(utils_inflate_t *s)
+{
+    int c, len, sym, next;
+    uint32_t from, n;
+
+    for (;;) {
+        switch (s->state) {
+            case UTILS_INFLATE_HEADER:
+                if (UTILS_INFLATE_RAW == s->format) {
+                    s->state = UTILS_INFLATE_BLOCK;
+                    break;
+                }
+                if ((c = _inflate_byte(s)) < 0) {
+                    return;
+                }
+                s->state = _inflate_header(s, c);
+                break;
+
+            case UTILS_INFLATE_GZIP_EXTRA_LEN:
+            case UTILS_INFLATE_GZIP_EXTRA:
+            case UTILS_INFLATE_GZIP_NAME:
+            case UTILS_INFLATE_GZIP_COMMENT:
+            case UTILS_INFLATE_GZIP_HCRC:
+                if ((next = _inflate_gzip_fields(s)) < 0) {
+                    return;
+                }
+                s->state = next;
+                break;
+
+            case UTILS_INFLATE_BLOCK:
+                if (!_inflate_need(s, 3)) {
+                    return;
+                }
+                s->last = _inflate_bits(s, 1);
+                switch (_inflate_bits(s, 2)) {
+                    case 0:
+                        _inflate_bits(s, s->bits & 7);
+                        s->index = 0;
+                        s->value = 0;
+                        s->state = UTILS_INFLATE_STORED;
+                        break;
+                    case 1:
+                        _inflate_fixed(s);
+                        s->state = UTILS_INFLATE_CODES;
+                        break;
+                    case 2:
+                        s->state = UTILS_INFLATE_TABLE;
+                        break;
+                    default:
+                        s->state = UTILS_INFLATE_ERROR;
+                        break;
+                }
+                break;
+
+            case UTILS_INFLATE_STORED:
+                for (; s->index < 4; s->index++) {
+                    if ((c = _inflate_byte(s)) < 0) {
+                        return;
+                    }
+                    s->value |= (uint32_t)c << (8 * s->index);
+                }
+                if ((s->value & 0xffff) != (~s->value >> 16)) {
+                    s->state = UTILS_INFLATE_ERROR;
+                    break;
+                }
+                s->length = s->value & 0xffff;
+                s->state = UTILS_INFLATE_COPY;
+                break;
+
+            case UTILS_INFLATE_COPY:
+                for (; s->length > 0; s->length--) {
+                    if (s->out_pos == s->out_len || (c = _inflate_byte(s)) < 0) {
+                        return;
+                    }
+                    _inflate_put(s, c);
+                }
+                s->state = _inflate_block_end(s);
+                break;
+
+            case UTILS_INFLATE_TABLE:
+                if (!_inflate_need(s, 14)) {
+                    return;
+                }
+                s->nlen = _inflate_bits(s, 5) + 257;
+                s->ndist = _inflate_bits(s, 5) + 1;
+                s->ncode = _inflate_bits(s, 4) + 4;
+                s->index = 0;
+                s->state = (s->nlen > 286 || s->ndist > 30) ? UTILS_INFLATE_ERROR : UTILS_INFLATE_LENLENS;
+                break;
+
+            case UTILS_INFLATE_LENLENS:
+            case UTILS_INFLATE_CODELENS:
+                if ((next = _inflate_code_lengths(s)) < 0) {
+                    return;
+                }
+                s->state = next;
+                break;
+
+            case UTILS_INFLATE_CODES:
+                /* the literals in a row, they are most of a stream */
+                for (;;) {
+                    if (s->out_pos == s->out_len) {
+                        return;
+                    }
+                    _inflate_pull(s);
+                    len = _inflate_decode(s, s->lencount, s->lensym, &sym);
+                    if (len <= 0) {
+                        if (0 == len) {
+                            return;
+                        }
+                        s->state = UTILS_INFLATE_ERROR;
+                        break;
+                    }
+                    _inflate_bits(s, len);
+                    if (sym < 256) {
+                        _inflate_put(s, sym);
+                        continue;
+                    }
+                    if (256 == sym) {
+                        s->state = _inflate_block_end(s);
+                    } else if (sym - 257 < 29) {
+                        s->length = inflate_len_base[sym - 257];
+                        s->extra = inflate_len_extra[sym - 257];
+                        s->state = UTILS_INFLATE_LENEXT;
+                    } else {
+                        s->state = UTILS_INFLATE_ERROR;
+                    }
+                    break;
+                }
+                break;
+
+            case UTILS_INFLATE_LENEXT:
+                if (!_inflate_need(s, s->extra)) {
+                    return;
+                }
+                s->length += _inflate_bits(s, s->extra);
+                s->state = UTILS_INFLATE_DIST;
+                break;
+
+            case UTILS_INFLATE_DIST:
+                _inflate_pull(s);
+                len = _inflate_decode(s, s->distcount, s->distsym, &sym);
+                if (0 == len) {
+                    return;
+                }
+                if (len < 0 || sym >= 30) {
+                    s->state = UTILS_INFLATE_ERROR;
+                    break;
+                }
+                _inflate_bits(s, len);
+                s->distance = inflate_dist_base[sym];
+                s->extra = inflate_dist_extra[sym];
+                s->state = UTILS_INFLATE_DISTEXT;
+                break;
+
+            case UTILS_INFLATE_DISTEXT:
+                if (!_inflate_need(s, s->extra)) {
+                    return;
+                }
+                s->distance += _inflate_bits(s, s->extra);
+                /* no further back than the data so far, nor than the window */
+                n = s->window_len + s->out_pos;
+                s->state = (s->distance > n || s->distance > s->window_size) ?
+                           UTILS_INFLATE_ERROR : UTILS_INFLATE_MATCH;
+                break;
+
+            case UTILS_INFLATE_MATCH:
+                n = (uint32_t)(s->out_len - s->out_pos);
+                n = (s->length < n) ? s->length : n;
+                from = (s->window_pos - s->distance) & (s->window_size - 1);
+                s->length -= n;
+                while (n-- > 0) {
+                    c = s->window[from];
+                    from = (from + 1) & (s->window_size - 1);
+                    _inflate_put(s, c);
+                }
+                if (s->length > 0) {
+                    return;
+                }
+                s->state = UTILS_INFLATE_CODES;
+                break;
+
+            case UTILS_INFLATE_TRAILER:
+                if ((next = _inflate_trailer(s)) < 0) {
+                    return;
+                }
+                s->state = next;
+                break;
+
+            case UTILS_INFLATE_DONE:
+                if (s->bits >= 8 || s->in_pos < s->in_len) {
+                    /* data after the end of the stream */
+                    s->state = UTILS_INFLATE_ERROR;
+                    break;
+                }
+                return;
+
+            default:
+                return;
+        }
+    }
+}
+
+void utils_inflate_init(utils_inflate_t *s, int format, uint8_t *window, int window_bits)
+{
+    memset(s, 0, sizeof(utils_inflate_t));
+    s->state = UTILS_INFLATE_HEADER;
+    s->format = format;
+    s->window = window;
+    s->window_size = 1u << window_bits;
+    s->check = (UTILS_INFLATE_ZLIB == format) ? 1 : 0;
+}
+
+int utils_inflate(utils_inflate_t *s, const uint8_t *in, int in_len, int *p_in_used, uint8_t *out, int out_len)
+{
+    int len;
+
+    s->in = in;
+    s->in_len = in_len;
+    s->in_pos = 0;
+    s->out = out;
+    s->out_len = out_len;
+    s->out_pos = 0;
+    s->sum_pos = 0;
+
+    _inflate_run(s);
+    _inflate_sum(s);
+
+    len = s->out_pos;
+    s->total += len;
+    s->window_len = (s->window_len + len < s->window_size) ? s->window_len + len : s->window_size;
+    *p_in_used = s->in_pos;
+    s->in = NULL;
+    s->out = NULL;
+
+    return (UTILS_INFLATE_ERROR == s->state) ? FAIL_RETURN : len;
+}
+
+int utils_inflate_is_done(utils_inflate_t *s)
+{
+    return UTILS_INFLATE_DONE == s->state;
+}
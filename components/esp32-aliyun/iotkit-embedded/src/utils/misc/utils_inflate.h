@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _IOTX_COMMON_INFLATE_H_
+#define _IOTX_COMMON_INFLATE_H_
+
+#include "iot_import.h"
+
+/* the wrappers of a deflate stream (RFC 1951): none, zlib (RFC 1950), which is the "deflate" of
+ * Content-Encoding, and gzip (RFC 1952) */
+#define UTILS_INFLATE_RAW               (0)
+#define UTILS_INFLATE_ZLIB              (1)
+#define UTILS_INFLATE_GZIP              (2)
+
+#define UTILS_INFLATE_MAX_WINDOW_BITS   (15)    /* the 32 KB window of the format */
+
+/**
+ * @brief Streaming decoder of a deflate stream. It takes the stream in slices of any length, cut
+ *   anywhere, and gives the data into buffers of any length. Besides its state it only uses the
+ *   window given by the caller, the last bytes of data a stream may copy from: a stream copying
+ *   from further back than the window is refused.
+ */
+typedef struct {
+    int             state;          /**< UTILS_INFLATE_* of utils_inflate.c */
+    int             format;         /**< UTILS_INFLATE_RAW, UTILS_INFLATE_ZLIB or UTILS_INFLATE_GZIP */
+    uint8_t        *window;
+    uint32_t        window_size;    /**< a power of 2 */
+    uint32_t        window_pos;     /**< where the next byte of data goes in the window */
+    uint32_t        window_len;     /**< bytes of data in the window */
+    uint32_t        total;          /**< bytes of data so far, modulo 2^32 as the gzip trailer has it */
+    uint32_t        check;          /**< Adler-32 or CRC-32 of the data so far */
+    uint32_t        hold;           /**< bits of the stream read ahead, the next one in bit 0 */
+    int             bits;           /**< how many */
+    int             last;           /**< the current block is the last one */
+    int             index;          /**< bytes of the header, trailer or stored length read, or code lengths */
+    uint32_t        value;          /**< the field of the header or trailer being read */
+    uint32_t        length;         /**< bytes of the stored block or of the match still to give */
+    uint32_t        distance;       /**< distance of the match */
+    int             extra;          /**< extra bits of the length or distance being read */
+    int             nlen;           /**< literal/length codes of the dynamic block */
+    int             ndist;          /**< distance codes of the dynamic block */
+    int             ncode;          /**< code length codes of the dynamic block */
+    uint8_t         lens[320];      /**< code lengths of the dynamic block */
+    uint16_t        lencount[16];   /**< literal/length code: the codes of every length, */
+    uint16_t        lensym[288];    /**< and the symbols in the order of their codes */
+    uint16_t        distcount[16];  /**< distance code, the same */
+    uint16_t        distsym[30];
+    /* the slices of the current call */
+    const uint8_t  *in;
+    int             in_len;
+    int             in_pos;
+    uint8_t        *out;
+    int             out_len;
+    int             out_pos;
+    int             sum_pos;        /**< bytes of out in the check */
+} utils_inflate_t;
+
+/**
+ * @brief Prepare @s for a new stream.
+ *
+ * @param[in] s @n The decoder
+ * @param[in] format @n UTILS_INFLATE_RAW, UTILS_INFLATE_ZLIB or UTILS_INFLATE_GZIP
+ * @param[in] window @n 2^@window_bits bytes, used by the decoder until the end of the stream
+ * @param[in] window_bits @n 8 to UTILS_INFLATE_MAX_WINDOW_BITS, the largest a stream may need
+ * @see None.
+ * @note A zlib header asking for a larger window is refused at once, a gzip or raw stream when it
+ *   copies from further back.
+ */
+void utils_inflate_init(utils_inflate_t *s, int format, uint8_t *window, int window_bits);
+
+/**
+ * @brief Decode the next slice of the stream into @out. It returns when @out is full, when all of
+ *   @in is used or at the end of the stream: call it again with more input or more room.
+ *
+ * @param[in] s @n The decoder
+ * @param[in] in @n The next bytes of the stream
+ * @param[in] in_len @n Their length
+ * @param[out] p_in_used @n Bytes of @in used, the rest is to be given again
+ * @param[out] out @n Where the data goes
+ * @param[in] out_len @n Its length
+ * @returns The bytes of data put in @out, FAIL_RETURN if the stream is corrupt, its check is wrong,
+ *   or bytes follow its end.
+ * @see None.
+ * @note None.
+ */
+int utils_inflate(utils_inflate_t *s, const uint8_t *in, int in_len, int *p_in_used, uint8_t *out, int out_len);
+
+/* whether the end of the stream, and of its trailer, was decoded */
+int utils_inflate_is_done(utils_inflate_t *s);
+
+#endif /* _IOTX_COMMON_INFLATE_H_ */
@@ -28,10 +28,23 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "nvs.h"
+
 #include "iot_import.h"
 #include "sdk-impl_internal.h"
 #include "id2_crypto.h"
 
+/* namespace of the values of HAL_Kv_Set(), nvs_flash_init() is called by the application */
+#define HAL_KV_NAMESPACE    "iotx_kv"
+
+/* @ms rounded up to ticks, so a short wait blocks for a tick instead of not at all */
+#define HAL_TICKS(ms)               (((ms) + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS)
+#define HAL_SEMAPHORE_MAX_COUNT     (0xFFFF)
+
 void mygettimeofday(struct timeval *tv, void *tz)
 {
     struct _reent r;
@@ -83,6 +96,26 @@ void HAL_MutexUnlock(_IN_ void *mutex)
     }
 }
 
+void *HAL_SemaphoreCreate(void)
+{
+    return (void *)xSemaphoreCreateCounting(HAL_SEMAPHORE_MAX_COUNT, 0);
+}
+
+void HAL_SemaphoreDestroy(_IN_ void *sem)
+{
+    vSemaphoreDelete((SemaphoreHandle_t)sem);
+}
+
+void HAL_SemaphorePost(_IN_ void *sem)
+{
+    xSemaphoreGive((SemaphoreHandle_t)sem);
+}
+
+int HAL_SemaphoreWait(_IN_ void *sem, _IN_ uint32_t timeout_ms)
+{
+    return (pdTRUE == xSemaphoreTake((SemaphoreHandle_t)sem, HAL_TICKS(timeout_ms))) ? 0 : -1;
+}
+
 void *HAL_Malloc(_IN_ uint32_t size)
 {
     return malloc(size);
@@ -107,7 +140,8 @@ uint32_t HAL_UptimeMs(void)
 
 void HAL_SleepMs(_IN_ uint32_t ms)
 {
-    usleep(1000 * ms);
+    /* usleep() spins below a tick, which starves the IDLE task the task watchdog checks */
+    vTaskDelay(HAL_TICKS(ms));
 }
 
 //#define HAL_Snprintf(str, len, fmt, ...) snprintf(str, len, fmt, ...)
@@ -142,3 +176,61 @@ char *HAL_GetPartnerID(char pid_str[])
 {
     return NULL;
 }
+
+/* NVS keeps the previous blob until the new one is completely written, @sync is implied */
+int HAL_Kv_Set(_IN_ const char *key, _IN_ const void *val, _IN_ int len, _IN_ int sync)
+{
+    esp_err_t err;
+    nvs_handle handle;
+
+    if (ESP_OK != nvs_open(HAL_KV_NAMESPACE, NVS_READWRITE, &handle)) {
+        return -1;
+    }
+
+    err = nvs_set_blob(handle, key, val, len);
+    if (ESP_OK == err) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return (ESP_OK == err) ? 0 : -1;
+}
+
+int HAL_Kv_Get(_IN_ const char *key, _OU_ void *val, int *buffer_len)
+{
+    esp_err_t err;
+    nvs_handle handle;
+    size_t len = *buffer_len;
+
+    if (ESP_OK != nvs_open(HAL_KV_NAMESPACE, NVS_READONLY, &handle)) {
+        return -1;
+    }
+
+    err = nvs_get_blob(handle, key, val, &len);
+    nvs_close(handle);
+
+    if (ESP_OK != err) {
+        return -1;
+    }
+
+    *buffer_len = len;
+    return 0;
+}
+
+int HAL_Kv_Del(_IN_ const char *key)
+{
+    esp_err_t err;
+    nvs_handle handle;
+
+    if (ESP_OK != nvs_open(HAL_KV_NAMESPACE, NVS_READWRITE, &handle)) {
+        return -1;
+    }
+
+    err = nvs_erase_key(handle, key);
+    if (ESP_OK == err) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return (ESP_OK == err || ESP_ERR_NVS_NOT_FOUND == err) ? 0 : -1;
+}
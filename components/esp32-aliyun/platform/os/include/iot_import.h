@@ -90,6 +90,57 @@ void HAL_MutexUnlock(_IN_ void *mutex);
 /** @} */ /* end of platform_mutex */
 
 
+/** @defgroup group_platform_semaphore semaphore
+ *  @{
+ */
+
+/**
+ * @brief Create a counting semaphore, its count starts at 0.
+ *
+ * @return NULL, initialize semaphore failed; not NULL, the semaphore handle.
+ * @see None.
+ * @note None.
+ */
+void *HAL_SemaphoreCreate(void);
+
+
+/**
+ * @brief Destroy the specified semaphore, no task must be waiting on it.
+ *
+ * @param [in] sem @n the specified semaphore.
+ * @return None.
+ * @see None.
+ * @note None.
+ */
+void HAL_SemaphoreDestroy(_IN_ void *sem);
+
+
+/**
+ * @brief Increase the count of the specified semaphore, waking up a task waiting on it.
+ *
+ * @param [in] sem @n the specified semaphore.
+ * @return None.
+ * @see None.
+ * @note None.
+ */
+void HAL_SemaphorePost(_IN_ void *sem);
+
+
+/**
+ * @brief Wait for the count of the specified semaphore to be above 0, and decrease it.
+ *
+ * @param [in] sem @n the specified semaphore.
+ * @param [in] timeout_ms @n longest wait in milliseconds.
+ * @return 0, the count was decreased; -1, the wait timed out.
+ * @see None.
+ * @note The task blocks while it waits, a wait shorter than the tick of the OS lasts one tick.
+ */
+int HAL_SemaphoreWait(_IN_ void *sem, _IN_ uint32_t timeout_ms);
+
+
+/** @} */ /* end of platform_semaphore */
+
+
 /** @defgroup group_platform_memory_manage memory
  *  @{
  */
@@ -180,6 +231,50 @@ char *HAL_GetPartnerID(char pid_str[]);
 
 /** @} */ /* end of group_platform_other */
 
+/** @defgroup group_platform_kv kv
+ *  @{
+ */
+
+/**
+ * @brief Store a value in the persistent key-value storage, replacing the previous one.
+ *
+ * @param [in] key: @n Name of the value, at most 15 characters.
+ * @param [in] val: @n The value to be stored.
+ * @param [in] len: @n Length of @val in bytes.
+ * @param [in] sync: @n 1, the value is written to the storage before return; 0, it may be cached.
+ * @return 0, success; < 0, fail.
+ * @see None.
+ * @note The value must read back either as it was before or as the new one, even on power loss.
+ */
+int HAL_Kv_Set(_IN_ const char *key, _IN_ const void *val, _IN_ int len, _IN_ int sync);
+
+
+/**
+ * @brief Read a value from the persistent key-value storage.
+ *
+ * @param [in] key: @n Name of the value.
+ * @param [out] val: @n Buffer of the value.
+ * @param [in,out] buffer_len: @n In, length of @val in bytes; out, length of the value.
+ * @return 0, success; < 0, fail, the key is not found or @val is too small.
+ * @see None.
+ * @note None.
+ */
+int HAL_Kv_Get(_IN_ const char *key, _OU_ void *val, int *buffer_len);
+
+
+/**
+ * @brief Remove a value from the persistent key-value storage.
+ *
+ * @param [in] key: @n Name of the value.
+ * @return 0, success or the key is not found; < 0, fail.
+ * @see None.
+ * @note None.
+ */
+int HAL_Kv_Del(_IN_ const char *key);
+
+
+/** @} */ /* end of group_platform_kv */
+
 /**
  * @brief Establish a TCP connection.
  *
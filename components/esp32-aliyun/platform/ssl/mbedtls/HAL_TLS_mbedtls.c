@@ -29,6 +29,7 @@
 #include "mbedtls/platform.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "lwip/sockets.h"
 
 #include "iot_import.h"
 
@@ -233,8 +234,9 @@ int utils_network_ssl_read(TLSDataParams_t *pTlsData, char *buffer, int len, int
             readLen += ret;
             net_status = 0;
         } else if (ret == 0) {
-            /* if ret is 0 and net_status is -2, indicate the connection is closed during last call */
-            return (net_status == -2) ? net_status : readLen;
+            /* mbedtls_ssl_read() returns 0 at the end of the connection, closed without close notify,
+             * or by the close notify of the last call if net_status is -2 */
+            return (readLen > 0) ? readLen : ((net_status == -2) ? net_status : -1);
         } else {
             if (MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY == ret) {
                 mbedtls_strerror(ret, err_str, sizeof(err_str));
@@ -328,6 +330,7 @@ int TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const char *p
                       const char *client_pwd, size_t client_pwd_len)
 {
     int ret = -1;
+    int nodelay = 1;
     /*
      * 0. Init
      */
@@ -347,6 +350,8 @@ int TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const char *p
         SSL_LOG(" failed ! net_connect returned -0x%04x", -ret);
         return ret;
     }
+    // a request is written at once, it goes out without waiting for the ack of the previous one
+    setsockopt(pTlsData->fd.fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
     SSL_LOG(" ok");
 
     /*
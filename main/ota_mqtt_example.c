@@ -29,13 +29,13 @@
 #define TOPIC_DATA              "/"PRODUCT_KEY"/"DEVICE_NAME"/data"
 
 #define MSG_LEN_MAX             (2048)
-#define BUFFSIZE 6000
+#define OTA_BUF_COUNT           (4)
+#define OTA_BUF_LEN             (4096)
 
 bool wifi_connected = 0;
 bool ota_init_flag = 0;
 const esp_partition_t * update_partition = NULL;
 static int binary_file_length = 0;
-static char ota_write_data[BUFFSIZE + 1] = { 0 };
 
 #define EXAMPLE_TRACE(fmt, args...)  \
     do { \
@@ -144,17 +144,66 @@ esp_ota_handle_t ota_init(void)
     return update_handle;
 }
 
+/* the sink of the OTA pipeline, the image comes in order so esp_ota_write() does not seek */
+static int ota_write(void *ctx, uint32_t offset, const char *buf, uint32_t len)
+{
+    esp_err_t err;
+    esp_ota_handle_t *update_handle = (esp_ota_handle_t *)ctx;
+
+    if (!ota_init_flag) {
+        *update_handle = ota_init();
+        ota_init_flag = 1;
+    }
+
+    err = esp_ota_write(*update_handle, (const void *)buf, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%x", err);
+        return -1;
+    }
+    binary_file_length += len;
+    ESP_LOGI(TAG, "Have written image length %d", binary_file_length);
+
+    return 0;
+}
+
+/* the patcher when the file is a delta of the running firmware, see IOT_OTA_PatchInit() */
+static void *ota_patch = NULL;
+
+static int ota_read_running(void *ctx, uint32_t offset, char *buf, uint32_t len)
+{
+    return (ESP_OK == esp_partition_read((const esp_partition_t *)ctx, offset, buf, len)) ? 0 : -1;
+}
+
+/* the sink of the OTA pipeline, a patch goes through the patcher which calls ota_write() */
+static int ota_sink_write(void *ctx, uint32_t offset, const char *buf, uint32_t len)
+{
+    if (NULL != ota_patch) {
+        return IOT_OTA_PatchWrite(ota_patch, offset, buf, len);
+    }
+    return ota_write(ctx, offset, buf, len);
+}
+
+/* write the flash while mqtt_client() downloads */
+static void ota_flush_proc(void *h_ota)
+{
+    while (!IOT_OTA_IsFetchFinish(h_ota)) {
+        if (IOT_OTA_PipelineFlush(h_ota, 100) < 0) {
+            break;
+        }
+    }
+    vTaskDelete(NULL);
+}
+
 int mqtt_client(void)
 {
-#define OTA_BUF_LEN        (5000)
     esp_err_t err;
     int rc = 0, ota_over = 0;
     void *pclient = NULL, *h_ota = NULL;
     iotx_conn_info_pt pconn_info;
     iotx_mqtt_param_t mqtt_params;
     char *msg_buf = NULL, *msg_readbuf = NULL;
-    char buf_ota[OTA_BUF_LEN];
     esp_ota_handle_t update_handle = 0;
+    IOT_OTA_Sink_t ota_sink = {ota_write, NULL}, pipeline_sink = {ota_sink_write, NULL};
 
     if (NULL == (msg_buf = (char *)HAL_Malloc(MSG_LEN_MAX))) {
         EXAMPLE_TRACE("not enough memory");
@@ -211,6 +260,14 @@ int mqtt_client(void)
         goto do_exit;
     }
 
+    ota_sink.ctx = &update_handle;
+    pipeline_sink.ctx = &update_handle;
+    if (0 != IOT_OTA_PipelineInit(h_ota, &pipeline_sink, OTA_BUF_COUNT, OTA_BUF_LEN)) {
+        rc = -1;
+        EXAMPLE_TRACE("initialize OTA pipeline failed");
+        goto do_exit;
+    }
+
     if (0 != IOT_OTA_ReportVersion(h_ota, "iotx_esp_1.0.0")) {
         rc = -1;
         EXAMPLE_TRACE("report OTA version failed");
@@ -231,26 +288,20 @@ int mqtt_client(void)
             if (IOT_OTA_IsFetching(h_ota)) {
                 uint32_t last_percent = 0, percent = 0;
                 char version[128], md5sum[33];
-                uint32_t len, size_downloaded, size_file;
+                uint32_t size_downloaded, size_file, is_diff = 0;
+
+                /* a delta is applied to the running firmware as it is downloaded */
+                IOT_OTA_Ioctl(h_ota, IOT_OTAG_IS_DIFF, &is_diff, 4);
+                if (is_diff) {
+                    IOT_OTA_Source_t running = {ota_read_running, NULL};
+                    running.ctx = (void *)esp_ota_get_running_partition();
+                    ota_patch = IOT_OTA_PatchInit(&running, &ota_sink, OTA_BUF_LEN);
+                }
 
-                do {
-                    len = IOT_OTA_FetchYield(h_ota, buf_ota, OTA_BUF_LEN, 1);
-                    if (len > 0) {
-
-                        if (!ota_init_flag) {
-                            update_handle = ota_init();
-                            ota_init_flag = 1;
-                        }
-                        memcpy(ota_write_data, buf_ota, len);
-
-                        err = esp_ota_write( update_handle, (const void *)ota_write_data, len);
-                        if (err != ESP_OK) {
-                            ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%x", err);
-                        }
-                        binary_file_length += len;
-                        ESP_LOGI(TAG, "Have written image length %d", binary_file_length);
+                xTaskCreate(&ota_flush_proc, "ota_flush_proc", 4096, h_ota, 4, NULL);
 
-                    }
+                do {
+                    IOT_OTA_PipelineFetch(h_ota, 1000);
 
                     /* get OTA information */
                     IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &size_downloaded, 4);
@@ -268,6 +319,14 @@ int mqtt_client(void)
                 } while (!IOT_OTA_IsFetchFinish(h_ota));
 
                 IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &firmware_valid, 4);
+                if (is_diff && (NULL == ota_patch || 0 != IOT_OTA_PatchFinish(ota_patch))) {
+                    /* the firmware built from the patch is checked too */
+                    firmware_valid = 0;
+                }
+                if (NULL != ota_patch) {
+                    IOT_OTA_PatchDeinit(ota_patch);
+                    ota_patch = NULL;
+                }
                 if (0 == firmware_valid) {
                     EXAMPLE_TRACE("The firmware is invalid");
                 } else {